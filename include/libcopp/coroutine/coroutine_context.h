@@ -4,6 +4,8 @@
 
 #include <libcopp/utils/config/libcopp_build_features.h>
 
+#include <libcopp/utils/gsl/span.h>
+
 #include "coroutine_context_base.h"
 
 #ifdef LIBCOPP_MACRO_USE_SEGMENTED_STACKS
@@ -30,6 +32,14 @@ class coroutine_context : public coroutine_context_base {
   using status_type = coroutine_context_base::status_type;
   using flag_type = coroutine_context_base::flag_type;
 
+  /**
+   * @brief callback of resume_with(), it's called on the stack of the resumed coroutine
+   * @param co the resumed coroutine
+   * @param data data passed to resume_with()
+   * @return private data passed to the resumed coroutine
+   */
+  using ontop_callback_type = void *(*)(coroutine_context *co, void *data);
+
   // Compability with libcopp-1.x
   using ptr_t = ptr_type;
   using callback_t = callback_type;
@@ -51,6 +61,7 @@ class coroutine_context : public coroutine_context_base {
     coroutine_context *from_co;
     coroutine_context *to_co;
     void *priv_data;
+    bool keep_caller; /** caller_ of to_co is already set, by switch_to() **/
   };
 
   friend struct libcopp_internal_api_set;
@@ -64,9 +75,38 @@ class coroutine_context : public coroutine_context_base {
   stack_context caller_stack_; /** caller stack context **/
 #endif
 
+ private:
+  size_t callee_stack_offset_; /** size reserved at the top of callee stack, the initial fcontext is below it **/
+
  protected:
   LIBCOPP_COPP_API coroutine_context() LIBCOPP_MACRO_NOEXCEPT;
 
+  /**
+   * @brief init coroutine context whose object and private buffer are not placed on the callee stack
+   * @note It's used by coroutines which run on shared stacks, call make_callee_fcontext() before start()
+   * @param runner runner
+   * @param priv_data private buffer, it must be available until the coroutine is destroyed
+   * @param private_buffer_size size of private buffer
+   * @return COPP_EC_SUCCESS or error code
+   */
+  LIBCOPP_COPP_API int init_detached(callback_type &&runner, void *priv_data,
+                                     size_t private_buffer_size) LIBCOPP_MACRO_NOEXCEPT;
+
+  /**
+   * @brief make the initial fcontext at the top of callee stack
+   * @param callee_stack stack to run this coroutine
+   * @return COPP_EC_SUCCESS or error code
+   */
+  LIBCOPP_COPP_API int make_callee_fcontext(const stack_context &callee_stack) LIBCOPP_MACRO_NOEXCEPT;
+
+  /**
+   * @brief reset an exited coroutine with a new runner, the stack and the reserved data on it are reused
+   * @note The old runner is destroyed, the private buffer is kept, return code and unhandled exception are cleared.
+   * @param runner new runner, if it's empty, set it by set_runner() later
+   * @return COPP_EC_SUCCESS or error code
+   */
+  LIBCOPP_COPP_API int reset_callee(callback_type &&runner) LIBCOPP_MACRO_NOEXCEPT;
+
  public:
   LIBCOPP_COPP_API ~coroutine_context();
 
@@ -83,20 +123,40 @@ class coroutine_context : public coroutine_context_base {
    * @param callee_stack stack context
    * @param coroutine_size size of coroutine object
    * @param private_buffer_size size of private buffer
+   * @param color_offset unused bytes between private buffer and the top of stack, @see next_stack_color_offset()
    * @return COPP_EC_SUCCESS or error code
    */
   static LIBCOPP_COPP_API int create(coroutine_context *p, callback_type &&runner, const stack_context &callee_stack,
-                                     size_t coroutine_size, size_t private_buffer_size) LIBCOPP_MACRO_NOEXCEPT;
+                                     size_t coroutine_size, size_t private_buffer_size,
+                                     size_t color_offset = 0) LIBCOPP_MACRO_NOEXCEPT;
 
   template <typename TRunner>
   static LIBCOPP_COPP_API_HEAD_ONLY int create(coroutine_context *p, TRunner *runner, const stack_context &callee_stack,
-                                               size_t coroutine_size,
-                                               size_t private_buffer_size) LIBCOPP_MACRO_NOEXCEPT {
+                                               size_t coroutine_size, size_t private_buffer_size,
+                                               size_t color_offset = 0) LIBCOPP_MACRO_NOEXCEPT {
     return create(
         p, [runner](void *private_data) { return (*runner)(private_data); }, callee_stack, coroutine_size,
-        private_buffer_size);
+        private_buffer_size, color_offset);
   }
 
+  /**
+   * @brief set how many cache colors are used by coroutine containers created later
+   * @param count color count, 0 or 1 disables coloring
+   */
+  static LIBCOPP_COPP_API void set_stack_color_count(size_t count) LIBCOPP_MACRO_NOEXCEPT;
+
+  /**
+   * @brief get how many cache colors are used by coroutine containers
+   * @return color count, 1 means no color
+   */
+  static LIBCOPP_COPP_API size_t get_stack_color_count() LIBCOPP_MACRO_NOEXCEPT;
+
+  /**
+   * @brief get color offset of the next stack, it cycles through multiples of LIBCOPP_MACRO_COROUTINE_STACK_COLOR_UNIT
+   * @return bytes to leave unused at the top of stack
+   */
+  static LIBCOPP_COPP_API size_t next_stack_color_offset() LIBCOPP_MACRO_NOEXCEPT;
+
   /**
    * @brief start coroutine
    * @param priv_data private data, will be passed to runner operator() or return to yield
@@ -133,12 +193,106 @@ class coroutine_context : public coroutine_context_base {
   LIBCOPP_COPP_API int resume(std::exception_ptr &unhandled, void *priv_data = nullptr) LIBCOPP_MACRO_NOEXCEPT;
 #endif
 
+  /**
+   * @brief resume coroutines one by one, for round-robin schedulers
+   * @note Object and saved frame of the following coroutines are prefetched while the current one is running.
+   *       nullptr and coroutines which are not ready or already finished are skipped without switching into them.
+   * @note Coroutines of coroutine_context_shared_stack are also skipped, they must be resumed by their own resume().
+   * @param cos coroutines to resume
+   * @param priv_data private data, will be passed to runner operator() or return to yield of every coroutine
+   * @exception if exception is enabled, it will throw the first unhandled exception after all coroutines are resumed,
+   *            others are thrown by the following calls
+   * @return number of coroutines which are resumed successfully
+   */
+  static LIBCOPP_COPP_API size_t resume_batch(gsl::span<coroutine_context *> cos, void *priv_data = nullptr);
+
+#if defined(LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR) && LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR
+  /**
+   * @brief resume coroutines one by one, for round-robin schedulers
+   * @param unhandled set exception_ptr of the first unhandled exception if it's exists and unhandled is empty
+   * @param cos coroutines to resume
+   * @param priv_data private data, will be passed to runner operator() or return to yield of every coroutine
+   * @return number of coroutines which are resumed successfully
+   */
+  static LIBCOPP_COPP_API size_t resume_batch(std::exception_ptr &unhandled, gsl::span<coroutine_context *> cos,
+                                              void *priv_data = nullptr) LIBCOPP_MACRO_NOEXCEPT;
+#endif
+
+  /**
+   * @brief prefetch this object, call it for the coroutine which will be resumed later
+   */
+  UTIL_FORCEINLINE void prefetch_context() const LIBCOPP_MACRO_NOEXCEPT {
+    for (size_t offset = 0; offset < sizeof(coroutine_context); offset += COPP_MACRO_CACHE_LINE_SIZE) {
+      COPP_PREFETCH(reinterpret_cast<const unsigned char *>(this) + offset);
+    }
+  }
+
+  /**
+   * @brief prefetch the frame saved on callee stack when it's suspended, call prefetch_context() earlier
+   */
+  UTIL_FORCEINLINE void prefetch_callee_frame() const LIBCOPP_MACRO_NOEXCEPT {
+    // registers are saved from callee_ upward, 2 cache lines cover all of them on x86_64 and most on others
+    COPP_PREFETCH(reinterpret_cast<const unsigned char *>(callee_));
+    COPP_PREFETCH(reinterpret_cast<const unsigned char *>(callee_) + COPP_MACRO_CACHE_LINE_SIZE);
+  }
+
+  /**
+   * @brief resume coroutine and call fn on top of its stack before it continues
+   * @note fn runs as part of the switch, this_coroutine is the resumed coroutine, fn must not yield or switch
+   * @note If the coroutine is not started yet, fn is called just before the first jump into it.
+   * @param fn callback, the return value will be passed to runner operator() or returned to yield, instead of data
+   * @param data data passed to fn
+   * @exception if exception is enabled, it will throw all unhandled exception after resumed
+   * @return COPP_EC_SUCCESS or error code
+   */
+  LIBCOPP_COPP_API int resume_with(ontop_callback_type fn, void *data = nullptr);
+
+#if defined(LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR) && LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR
+  /**
+   * @brief resume coroutine and call fn on top of its stack before it continues
+   * @param unhandled set exception_ptr of unhandled exception if it's exists
+   * @param fn callback, the return value will be passed to runner operator() or returned to yield, instead of data
+   * @param data data passed to fn
+   * @return COPP_EC_SUCCESS or error code
+   */
+  LIBCOPP_COPP_API int resume_with(std::exception_ptr &unhandled, ontop_callback_type fn,
+                                   void *data = nullptr) LIBCOPP_MACRO_NOEXCEPT;
+#endif
+
   /**
    * @brief yield coroutine
    * @param priv_data private data, if not nullptr, will get the value from start(priv_data) or resume(priv_data)
    * @return COPP_EC_SUCCESS or error code
    */
   LIBCOPP_COPP_API int yield(void **priv_data = nullptr) LIBCOPP_MACRO_NOEXCEPT;
+
+  /**
+   * @brief switch from this coroutine to next coroutine directly, without jumping back to the caller first
+   * @note This coroutine must be the running coroutine of current thread. next inherits the caller of this coroutine,
+   *       so when next yields or finishes, it jumps to the caller of this coroutine, and start()/resume() called by
+   *       that caller returns. This coroutine is suspended and can be resumed by start()/resume()/switch_to() later.
+   * @note Unhandled exception of next is kept in next and will not be rethrown by the caller.
+   * @note next can not be a coroutine_context_shared_stack, because its stack data may not be on the run stack.
+   * @param next coroutine to switch to, it must be ready
+   * @param priv_data private data, will be passed to runner operator() of next or return to yield of next
+   * @return COPP_EC_SUCCESS or error code, COPP_EC_ARGS_ERROR if next runs on a shared run stack
+   */
+  LIBCOPP_COPP_API int switch_to(coroutine_context &next, void *priv_data = nullptr) LIBCOPP_MACRO_NOEXCEPT;
+
+  /**
+   * @brief paint unused stack of this coroutine, so get_stack_watermark() can measure the high-water mark later
+   * @note It can be called before start() or when the coroutine is suspended, all pages of the stack will become
+   *       resident.
+   * @return COPP_EC_SUCCESS or error code
+   */
+  LIBCOPP_COPP_API int paint_stack_watermark() LIBCOPP_MACRO_NOEXCEPT;
+
+  /**
+   * @brief get the high-water mark of stack
+   * @return used bytes from the top of stack, 0 if the stack is not painted, or the whole stack size if it's used up
+   * @see stack_watermark
+   */
+  LIBCOPP_COPP_API size_t get_stack_watermark() const LIBCOPP_MACRO_NOEXCEPT;
 };
 
 namespace this_coroutine {
@@ -147,7 +301,13 @@ namespace this_coroutine {
  * @see detail::coroutine_context
  * @return pointer of current coroutine, if not in coroutine, return nullptr
  */
+#if defined(LIBCOPP_MACRO_ENABLE_INLINE_THIS_COROUTINE) && LIBCOPP_MACRO_ENABLE_INLINE_THIS_COROUTINE
+UTIL_FORCEINLINE coroutine_context *get_coroutine() LIBCOPP_MACRO_NOEXCEPT {
+  return static_cast<coroutine_context *>(detail::gt_current_coroutine);
+}
+#else
 LIBCOPP_COPP_API coroutine_context *get_coroutine() LIBCOPP_MACRO_NOEXCEPT;
+#endif
 
 /**
  * @brief get current coroutine and try to convert type
@@ -16,6 +16,7 @@
 #include <cstddef>
 #include <functional>
 #include <memory>
+#include <type_traits>
 #if defined(LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR) && LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR
 #  include <exception>
 #endif
@@ -23,6 +24,50 @@
 #include <libcopp/utils/config/stl_include_suffix.h>  // NOLINT(build/include_order)
 // clang-format on
 
+// Read the current coroutine by header inline functions when the TLS variable can be shared with libcopp.
+// TLS variables can not be imported from DLL on Windows, and fiber mode needs extra checks.
+#ifndef LIBCOPP_MACRO_ENABLE_INLINE_THIS_COROUTINE
+#  if ((defined(LIBCOPP_LOCK_DISABLE_THIS_MT) && LIBCOPP_LOCK_DISABLE_THIS_MT) || defined(COPP_MACRO_THREAD_LOCAL)) && \
+      !(defined(_WIN32) && defined(LIBCOPP_API_DLL) && LIBCOPP_API_DLL) &&                                          \
+      !(defined(LIBCOPP_MACRO_ENABLE_WIN_FIBER) && LIBCOPP_MACRO_ENABLE_WIN_FIBER)
+#    define LIBCOPP_MACRO_ENABLE_INLINE_THIS_COROUTINE 1
+#  else
+#    define LIBCOPP_MACRO_ENABLE_INLINE_THIS_COROUTINE 0
+#  endif
+#endif
+
+#if defined(LIBCOPP_MACRO_ENABLE_INLINE_THIS_COROUTINE) && LIBCOPP_MACRO_ENABLE_INLINE_THIS_COROUTINE
+#  if defined(LIBCOPP_LOCK_DISABLE_THIS_MT) && LIBCOPP_LOCK_DISABLE_THIS_MT
+#    define LIBCOPP_MACRO_THIS_COROUTINE_TLS
+#  elif (defined(__GNUC__) || defined(__clang__)) && defined(__ELF__) && \
+      !(defined(LIBCOPP_API_DLL) && LIBCOPP_API_DLL)
+// static library, the initial-exec model need no __tls_get_addr() call
+#    define LIBCOPP_MACRO_THIS_COROUTINE_TLS __thread __attribute__((tls_model("initial-exec")))
+#  elif defined(__GNUC__) || defined(__clang__)
+// __thread has no dynamic initialization, so there is no TLS wrapper call
+#    define LIBCOPP_MACRO_THIS_COROUTINE_TLS __thread
+#  else
+#    define LIBCOPP_MACRO_THIS_COROUTINE_TLS COPP_MACRO_THREAD_LOCAL
+#  endif
+#endif
+
+// Max size of functor runner which is moved to the top of coroutine stack by coroutine_context_container::create().
+// There is no heap fallback, bigger runners must be passed by pointer or std::function.
+#ifndef LIBCOPP_MACRO_COROUTINE_INLINE_RUNNER_SIZE
+#  define LIBCOPP_MACRO_COROUTINE_INLINE_RUNNER_SIZE 256
+#endif
+
+// Stacks are page aligned, so data at the top of every stack are mapped to the same cache sets. Coroutine containers
+// move the coroutine object, private data and the initial frame down by (N % COLOR_COUNT) * COLOR_UNIT bytes for the
+// N-th stack. The color count can also be changed by coroutine_context::set_stack_color_count(), 1 means no color.
+#ifndef LIBCOPP_MACRO_COROUTINE_STACK_COLOR_UNIT
+#  define LIBCOPP_MACRO_COROUTINE_STACK_COLOR_UNIT 64
+#endif
+
+#ifndef LIBCOPP_MACRO_COROUTINE_STACK_COLOR_COUNT
+#  define LIBCOPP_MACRO_COROUTINE_STACK_COLOR_COUNT 1
+#endif
+
 LIBCOPP_COPP_NAMESPACE_BEGIN
 
 namespace details {
@@ -62,16 +107,70 @@ struct LIBCOPP_COPP_API_HEAD_ONLY align_helper {
 
 static_assert(COROUTINE_CONTEXT_BASE_ALIGN_UNIT_SIZE >= 16 && 0 == COROUTINE_CONTEXT_BASE_ALIGN_UNIT_SIZE % 16,
               "COROUTINE_CONTEXT_BASE_ALIGN_UNIT_SIZE");
+static_assert(LIBCOPP_MACRO_COROUTINE_STACK_COLOR_UNIT > 0 &&
+                  0 == LIBCOPP_MACRO_COROUTINE_STACK_COLOR_UNIT % COROUTINE_CONTEXT_BASE_ALIGN_UNIT_SIZE,
+              "LIBCOPP_MACRO_COROUTINE_STACK_COLOR_UNIT");
 static_assert(COROUTINE_CONTEXT_STACK_ALIGN_UNIT_SIZE >= 16 && 0 == COROUTINE_CONTEXT_STACK_ALIGN_UNIT_SIZE % 16,
               "COROUTINE_CONTEXT_STACK_ALIGN_UNIT_SIZE");
+
+/**
+ * @brief type erased invoker and destructor of runner which is placed by coroutine containers
+ */
+template <class TRunner>
+struct LIBCOPP_COPP_API_HEAD_ONLY coroutine_runner_delegate {
+  static int invoke(void *runner, void *priv_data) { return (*reinterpret_cast<TRunner *>(runner))(priv_data); }
+
+  static void destroy(void *runner) { reinterpret_cast<TRunner *>(runner)->~TRunner(); }
+};
+
+/**
+ * @brief functors(include lambda) can be moved to the coroutine stack, function pointers and std::function can not
+ */
+template <class TRunner, class TCallback>
+struct LIBCOPP_COPP_API_HEAD_ONLY is_inline_runner
+    : public std::integral_constant<bool, std::is_class<typename std::decay<TRunner>::type>::value &&
+                                              !std::is_same<typename std::decay<TRunner>::type, TCallback>::value> {};
 }  // namespace details
 
+/**
+ * @brief thread policy of coroutine containers, the coroutine can be resumed and released by different threads
+ * @note status and reference count are atomic, unless LIBCOPP_DISABLE_ATOMIC_LOCK is set
+ */
+struct LIBCOPP_COPP_API_HEAD_ONLY coroutine_thread_policy_multi_thread {
+  static constexpr const bool thread_confined = false;
+
+#if defined(LIBCOPP_DISABLE_ATOMIC_LOCK) && LIBCOPP_DISABLE_ATOMIC_LOCK
+  template <class Ty>
+  using int_type =
+      LIBCOPP_COPP_NAMESPACE_ID::util::lock::atomic_int_type<
+          LIBCOPP_COPP_NAMESPACE_ID::util::lock::unsafe_int_type<Ty> >;
+#else
+  template <class Ty>
+  using int_type = LIBCOPP_COPP_NAMESPACE_ID::util::lock::atomic_int_type<Ty>;
+#endif
+};
+
+/**
+ * @brief thread policy of coroutine containers, the coroutine is created, resumed and released by only one thread
+ * @note status and reference count use plain loads and stores, even if other coroutines in the same binary are shared
+ */
+struct LIBCOPP_COPP_API_HEAD_ONLY coroutine_thread_policy_single_thread {
+  static constexpr const bool thread_confined = true;
+
+  template <class Ty>
+  using int_type =
+      LIBCOPP_COPP_NAMESPACE_ID::util::lock::atomic_int_type<
+          LIBCOPP_COPP_NAMESPACE_ID::util::lock::unsafe_int_type<Ty> >;
+};
+
 /**
  * @brief base type of all coroutine context
  */
 class coroutine_context_base {
  public:
   using callback_type = std::function<int(void *)>;
+  using runner_invoke_fn_type = int (*)(void *runner, void *priv_data);
+  using runner_destroy_fn_type = void (*)(void *runner);
 
   /**
    * @brief status of safe coroutine context base
@@ -91,6 +190,8 @@ class coroutine_context_base {
       EN_CFT_UNKNOWN = 0,
       EN_CFT_FINISHED = 0x01,
       EN_CFT_IS_FIBER = 0x02,
+      EN_CFT_THREAD_CONFINED = 0x04,
+      EN_CFT_SHARED_STACK = 0x08,
       EN_CFT_MASK = 0xFF,
     };
   };
@@ -101,18 +202,17 @@ class coroutine_context_base {
   using flag_t = flag_type;
 
  protected:
-  int runner_ret_code_;  /** coroutine return code **/
-  int flags_;            /** flags **/
-  callback_type runner_; /** coroutine runner **/
+  int runner_ret_code_;                      /** coroutine return code **/
+  int flags_;                                /** flags **/
+  callback_type runner_;                     /** coroutine runner **/
+  runner_invoke_fn_type runner_invoke_fn_;   /** call runner_object_ **/
+  runner_destroy_fn_type runner_destroy_fn_; /** destroy runner_object_, nullptr if it's not owned **/
+  void *runner_object_;                      /** &runner_ or runner placed by containers **/
   void *priv_data_;
   size_t private_buffer_size_;
 
-#if defined(LIBCOPP_DISABLE_ATOMIC_LOCK) && LIBCOPP_DISABLE_ATOMIC_LOCK
-  LIBCOPP_COPP_NAMESPACE_ID::util::lock::atomic_int_type<LIBCOPP_COPP_NAMESPACE_ID::util::lock::unsafe_int_type<int> >
-      status_; /** status **/
-#else
-  LIBCOPP_COPP_NAMESPACE_ID::util::lock::atomic_int_type<int> status_; /** status **/
-#endif
+  // coroutines with EN_CFT_THREAD_CONFINED only use relaxed loads and stores, @see compare_exchange_status()
+  coroutine_thread_policy_multi_thread::int_type<int> status_; /** status **/
 
 #if defined(LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR) && LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR
   std::exception_ptr unhandle_exception_;
@@ -121,6 +221,47 @@ class coroutine_context_base {
  protected:
   LIBCOPP_COPP_API coroutine_context_base() LIBCOPP_MACRO_NOEXCEPT;
 
+  /**
+   * @brief mark this coroutine to be used by only one thread, it must be called before the runner is set
+   * @note It can not be unset, status will not be synchronized between threads any more
+   */
+  UTIL_FORCEINLINE void confine_to_thread() LIBCOPP_MACRO_NOEXCEPT { flags_ |= flag_type::EN_CFT_THREAD_CONFINED; }
+
+  /**
+   * @brief mark this coroutine to run on a shared run stack, it can only be switched into by its container
+   * @note switch_to() and resume_batch() do not copy stack data of shared run stacks, so they reject these coroutines
+   */
+  UTIL_FORCEINLINE void mark_shared_stack() LIBCOPP_MACRO_NOEXCEPT { flags_ |= flag_type::EN_CFT_SHARED_STACK; }
+
+  UTIL_FORCEINLINE bool compare_exchange_status(int &expected, int desired) LIBCOPP_MACRO_NOEXCEPT {
+    if (flags_ & flag_type::EN_CFT_THREAD_CONFINED) {
+      int current = status_.load(LIBCOPP_COPP_NAMESPACE_ID::util::lock::memory_order_relaxed);
+      if (current != expected) {
+        expected = current;
+        return false;
+      }
+
+      status_.store(desired, LIBCOPP_COPP_NAMESPACE_ID::util::lock::memory_order_relaxed);
+      return true;
+    }
+
+    return status_.compare_exchange_strong(expected, desired,
+                                           LIBCOPP_COPP_NAMESPACE_ID::util::lock::memory_order_acq_rel,
+                                           LIBCOPP_COPP_NAMESPACE_ID::util::lock::memory_order_acquire);
+  }
+
+  UTIL_FORCEINLINE int load_status() const LIBCOPP_MACRO_NOEXCEPT {
+    return status_.load((flags_ & flag_type::EN_CFT_THREAD_CONFINED)
+                            ? LIBCOPP_COPP_NAMESPACE_ID::util::lock::memory_order_relaxed
+                            : LIBCOPP_COPP_NAMESPACE_ID::util::lock::memory_order_acquire);
+  }
+
+  UTIL_FORCEINLINE void store_status(int desired) LIBCOPP_MACRO_NOEXCEPT {
+    status_.store(desired, (flags_ & flag_type::EN_CFT_THREAD_CONFINED)
+                               ? LIBCOPP_COPP_NAMESPACE_ID::util::lock::memory_order_relaxed
+                               : LIBCOPP_COPP_NAMESPACE_ID::util::lock::memory_order_release);
+  }
+
  public:
   LIBCOPP_COPP_API ~coroutine_context_base();
 
@@ -151,16 +292,16 @@ class coroutine_context_base {
    * @param flags flags to be checked
    * @return true if flags any flags is true
    */
-  LIBCOPP_COPP_API bool check_flags(int flags) const LIBCOPP_MACRO_NOEXCEPT;
+  UTIL_FORCEINLINE bool check_flags(int flags) const LIBCOPP_MACRO_NOEXCEPT { return 0 != (flags_ & flags); }
 
  protected:
   /**
    * @brief coroutine entrance function
    */
   UTIL_FORCEINLINE void run_and_recv_retcode(void *priv_data) {
-    if (!runner_) return;
+    if (nullptr == runner_invoke_fn_) return;
 
-    runner_ret_code_ = runner_(priv_data);
+    runner_ret_code_ = (*runner_invoke_fn_)(runner_object_, priv_data);
   }
 
  public:
@@ -171,8 +312,19 @@ class coroutine_context_base {
    */
   LIBCOPP_COPP_API int set_runner(callback_type &&runner);
 
+  /**
+   * @brief set runner which is not stored in std::function
+   * @param runner runner object, it must be available until this coroutine is destroyed
+   * @param invoke_fn function to call runner
+   * @param destroy_fn function to destroy runner when this coroutine is destroyed, nullptr if runner is not owned
+   * @return COPP_EC_SUCCESS or error code
+   */
+  LIBCOPP_COPP_API int set_runner(void *runner, runner_invoke_fn_type invoke_fn,
+                                  runner_destroy_fn_type destroy_fn) LIBCOPP_MACRO_NOEXCEPT;
+
   /**
    * get runner of this coroutine context (const)
+   * @note It's empty if runner is set by set_runner(runner, invoke_fn, destroy_fn)
    * @return nullptr of pointer of runner
    */
   UTIL_FORCEINLINE const std::function<int(void *)> &get_runner() const LIBCOPP_MACRO_NOEXCEPT { return runner_; }
@@ -201,18 +353,11 @@ class coroutine_context_base {
 
  public:
   UTIL_FORCEINLINE static size_t align_private_data_size(size_t sz) {
-    // static size_t random_index = 0;
-    // constexpr const size_t random_mask = 63;
     constexpr const size_t align_mask = COROUTINE_CONTEXT_BASE_ALIGN_UNIT_SIZE - 1;
 
     // align
     sz += align_mask;
     sz &= ~align_mask;
-
-    // random
-    // ++random_index;
-    // random_index &= random_mask;
-    // sz += random_index * (align_mask + 1);
     return sz;
   }
 
@@ -258,4 +403,14 @@ class coroutine_context_base {
    */
   static LIBCOPP_COPP_API void set_this_coroutine_base(coroutine_context_base *ctx) LIBCOPP_MACRO_NOEXCEPT;
 };
+
+#if defined(LIBCOPP_MACRO_ENABLE_INLINE_THIS_COROUTINE) && LIBCOPP_MACRO_ENABLE_INLINE_THIS_COROUTINE
+namespace detail {
+/**
+ * @brief current coroutine of this thread
+ * @note Do not set it directly, it's only for header inline accessors, such as this_coroutine::get_coroutine()
+ */
+extern LIBCOPP_COPP_API LIBCOPP_MACRO_THIS_COROUTINE_TLS coroutine_context_base *gt_current_coroutine;
+}  // namespace detail
+#endif
 LIBCOPP_COPP_NAMESPACE_END
@@ -8,11 +8,14 @@
 #include <libcopp/stack/stack_allocator.h>
 #include <libcopp/stack/stack_traits.h>
 #include <libcopp/utils/errno.h>
+#include <libcopp/utils/gsl/span.h>
 
 // clang-format off
 #include <libcopp/utils/config/stl_include_prefix.h>  // NOLINT(build/include_order)
 // clang-format on
 #include <cstddef>
+#include <type_traits>
+#include <utility>
 // clang-format off
 #include <libcopp/utils/config/stl_include_suffix.h>  // NOLINT(build/include_order)
 // clang-format on
@@ -21,14 +24,17 @@ LIBCOPP_COPP_NAMESPACE_BEGIN
 /**
  * @brief coroutine container
  * contain stack context, stack allocator and runtime fcontext
+ * @note Use coroutine_thread_policy_single_thread as TPOLICY if the coroutine never leaves the thread creating it,
+ *       status and reference count will not use atomic instructions, no matter what other coroutines use.
  */
-template <typename TALLOC>
+template <typename TALLOC, typename TPOLICY = coroutine_thread_policy_multi_thread>
 class coroutine_context_container : public coroutine_context {
  public:
   using coroutine_context_type = coroutine_context;
   using base_type = coroutine_context;
   using allocator_type = TALLOC;
-  using this_type = coroutine_context_container<allocator_type>;
+  using thread_policy_type = TPOLICY;
+  using this_type = coroutine_context_container<allocator_type, thread_policy_type>;
   using ptr_type = LIBCOPP_COPP_NAMESPACE_ID::util::intrusive_ptr<this_type>;
   using callback_type = coroutine_context::callback_type;
 
@@ -39,10 +45,18 @@ class coroutine_context_container : public coroutine_context {
   COROUTINE_CONTEXT_BASE_USING_BASE(base_type)
 
  private:
-  coroutine_context_container(const allocator_type &alloc) LIBCOPP_MACRO_NOEXCEPT : alloc_(alloc), ref_count_(0) {}
+  coroutine_context_container(const allocator_type &alloc) LIBCOPP_MACRO_NOEXCEPT : alloc_(alloc), ref_count_(0) {
+    if (thread_policy_type::thread_confined) {
+      confine_to_thread();
+    }
+  }
 
   coroutine_context_container(allocator_type &&alloc) LIBCOPP_MACRO_NOEXCEPT : alloc_(std::move(alloc)),
-                                                                               ref_count_(0) {}
+                                                                               ref_count_(0) {
+    if (thread_policy_type::thread_confined) {
+      confine_to_thread();
+    }
+  }
 
  public:
   ~coroutine_context_container() {}
@@ -92,23 +106,38 @@ class coroutine_context_container : public coroutine_context {
       return ret;
     }
 
-    // placement new
-    unsigned char *this_addr = reinterpret_cast<unsigned char *>(callee_stack.sp);
-    // stack down
-    this_addr -= private_buffer_size + this_align_size;
-    ret.reset(new (reinterpret_cast<void *>(this_addr)) this_type(std::move(alloc)));
+    return create_on_stack(std::move(runner), alloc, callee_stack, coroutine_size, private_buffer_size);
+  }
 
-    // callee_stack and alloc unavailable any more.
-    if (ret) {
-      ret->callee_stack_ = std::move(callee_stack);
-    } else {
-      alloc.deallocate(callee_stack);
+  /**
+   * @brief create and init coroutine with functor runner and specify stack size
+   * @note runner is moved to the top of callee stack instead of std::function, so the stack is the only allocation
+   * @param runner functor or lambda, size must not be greater than LIBCOPP_MACRO_COROUTINE_INLINE_RUNNER_SIZE
+   * @param stack_sz stack size
+   * @param private_buffer_size private buffer size
+   * @param coroutine_size extend buffer before coroutine
+   * @return COPP_EC_SUCCESS or error code
+   */
+  template <class TRunner,
+            class = typename std::enable_if<details::is_inline_runner<TRunner, callback_type>::value>::type>
+  static ptr_type create(TRunner &&runner, allocator_type &alloc, size_t stack_sz = 0, size_t private_buffer_size = 0,
+                         size_t coroutine_size = 0) LIBCOPP_MACRO_NOEXCEPT {
+    using runner_type = typename std::decay<TRunner>::type;
+    static_assert(sizeof(runner_type) <= LIBCOPP_MACRO_COROUTINE_INLINE_RUNNER_SIZE,
+                  "runner is too large to be placed on coroutine stack, pass it by pointer or std::function");
+    static_assert(alignof(runner_type) <= COROUTINE_CONTEXT_BASE_ALIGN_UNIT_SIZE,
+                  "alignment of runner is too large to be placed on coroutine stack");
+
+    // stack down
+    // |STACK BUFFER........RUNNER..COROUTINE..this..padding..PRIVATE DATA..COLOR..callee_stack.sp |
+    coroutine_size = align_address_size(coroutine_size);
+    const size_t runner_size = align_address_size(sizeof(runner_type));
+    ptr_type ret = create(callback_type(), alloc, stack_sz, private_buffer_size, coroutine_size + runner_size);
+    if (!ret) {
       return ret;
     }
 
-    // after this call runner will be unavailable
-    if (coroutine_context::create(ret.get(), std::move(runner), ret->callee_stack_, coroutine_size,
-                                  private_buffer_size) < 0) {
+    if (!emplace_runner(*ret, std::forward<TRunner>(runner), coroutine_size, std::true_type())) {
       ret.reset();
     }
 
@@ -132,7 +161,8 @@ class coroutine_context_container : public coroutine_context {
       return create(callback_type(), alloc, stack_size, private_buffer_size, coroutine_size);
     }
 
-    return create(callback_type(fn), alloc, stack_size, private_buffer_size, coroutine_size);
+    return create([fn](void *private_data) { return (*fn)(private_data); }, alloc, stack_size, private_buffer_size,
+                  coroutine_size);
   }
 
   static ptr_type create(callback_type &&runner, size_t stack_size = 0, size_t private_buffer_size = 0,
@@ -141,16 +171,136 @@ class coroutine_context_container : public coroutine_context {
     return create(std::move(runner), alloc, stack_size, private_buffer_size, coroutine_size);
   }
 
+  template <class TRunner,
+            class = typename std::enable_if<details::is_inline_runner<TRunner, callback_type>::value>::type>
+  static inline ptr_type create(TRunner &&runner, size_t stack_size = 0, size_t private_buffer_size = 0,
+                                size_t coroutine_size = 0) LIBCOPP_MACRO_NOEXCEPT {
+    allocator_type alloc;
+    return create(std::forward<TRunner>(runner), alloc, stack_size, private_buffer_size, coroutine_size);
+  }
+
   template <class TRunner>
   static inline ptr_type create(TRunner *runner, size_t stack_size = 0, size_t private_buffer_size = 0,
                                 size_t coroutine_size = 0) LIBCOPP_MACRO_NOEXCEPT {
-    return create([runner](void *private_data) { return (*runner)(private_data); }, stack_size, private_buffer_size,
-                  coroutine_size);
+    allocator_type alloc;
+    return create(runner, alloc, stack_size, private_buffer_size, coroutine_size);
   }
 
   static inline ptr_type create(int (*fn)(void *), size_t stack_size = 0, size_t private_buffer_size = 0,
                                 size_t coroutine_size = 0) LIBCOPP_MACRO_NOEXCEPT {
-    return create(callback_type(fn), stack_size, private_buffer_size, coroutine_size);
+    allocator_type alloc;
+    return create(fn, alloc, stack_size, private_buffer_size, coroutine_size);
+  }
+
+  /**
+   * @brief create and init coroutines in batch
+   * @note Stacks are allocated by allocate_batch() of allocator if it's provided, such as stack_allocator_arena, so the
+   *       lock of allocator is taken once for a group of stacks.
+   * @param out output coroutines, out[0, return value) are created, and others are reset to empty
+   * @param runner_factory called with the index in out, it returns functor, lambda, function or callback_type
+   * @param alloc stack allocator, every coroutine keeps a copy of it
+   * @param stack_sz stack size
+   * @param private_buffer_size private buffer size
+   * @param coroutine_size extend buffer before coroutine
+   * @return number of created coroutines, it's less than out.size() if allocator or stack size is not enough
+   */
+  template <class TFactory>
+  static size_t create_batch(gsl::span<ptr_type> out, TFactory &&runner_factory, allocator_type &alloc,
+                             size_t stack_sz = 0, size_t private_buffer_size = 0,
+                             size_t coroutine_size = 0) LIBCOPP_MACRO_NOEXCEPT {
+    using runner_type = typename std::decay<decltype(runner_factory(static_cast<size_t>(0)))>::type;
+    using inline_runner_tag =
+        std::integral_constant<bool, details::is_inline_runner<runner_type, callback_type>::value>;
+    static_assert(!inline_runner_tag::value || sizeof(runner_type) <= LIBCOPP_MACRO_COROUTINE_INLINE_RUNNER_SIZE,
+                  "runner is too large to be placed on coroutine stack, return std::function instead");
+    static_assert(!inline_runner_tag::value || alignof(runner_type) <= COROUTINE_CONTEXT_BASE_ALIGN_UNIT_SIZE,
+                  "alignment of runner is too large to be placed on coroutine stack");
+
+    if (0 == stack_sz) {
+      stack_sz = stack_traits::default_size();
+    }
+
+    // |STACK BUFFER........RUNNER..COROUTINE..this..padding..PRIVATE DATA..COLOR..callee_stack.sp |
+    coroutine_size = align_address_size(coroutine_size);
+    const size_t runner_size = inline_runner_tag::value ? align_address_size(sizeof(runner_type)) : 0;
+    const size_t full_coroutine_size = coroutine_size + runner_size + align_address_size(sizeof(this_type));
+    private_buffer_size = coroutine_context::align_private_data_size(private_buffer_size);
+
+    size_t created = 0;
+    if (stack_sz > full_coroutine_size + private_buffer_size) {
+      // allocate stacks by group, so there is no extra heap allocation
+      stack_context callee_stacks[64];
+      bool failed = false;
+      while (!failed && created < out.size()) {
+        size_t group_size = out.size() - created;
+        if (group_size > sizeof(callee_stacks) / sizeof(callee_stacks[0])) {
+          group_size = sizeof(callee_stacks) / sizeof(callee_stacks[0]);
+        }
+
+        // use all allocated stacks and stop after this group if allocator is exhausted
+        size_t allocated = allocate_stacks(alloc, callee_stacks, group_size, stack_sz, 0);
+        failed = allocated < group_size;
+
+        size_t index = 0;
+        while (index < allocated) {
+          allocator_type co_alloc(alloc);
+          ptr_type &co = out[created];
+          // the stack is given back by co if it failed
+          co = create_on_stack(callback_type(), co_alloc, callee_stacks[index++], full_coroutine_size,
+                               private_buffer_size);
+          if (!co || !emplace_runner(*co, runner_factory(created), coroutine_size, inline_runner_tag())) {
+            co.reset();
+            failed = true;
+            break;
+          }
+          ++created;
+        }
+
+        // give back stacks which are not used
+        for (; index < allocated; ++index) {
+          alloc.deallocate(callee_stacks[index]);
+        }
+      }
+    }
+
+    for (size_t i = created; i < out.size(); ++i) {
+      out[i].reset();
+    }
+    return created;
+  }
+
+  template <class TFactory>
+  static inline size_t create_batch(gsl::span<ptr_type> out, TFactory &&runner_factory, size_t stack_sz = 0,
+                                    size_t private_buffer_size = 0,
+                                    size_t coroutine_size = 0) LIBCOPP_MACRO_NOEXCEPT {
+    allocator_type alloc;
+    return create_batch(out, std::forward<TFactory>(runner_factory), alloc, stack_sz, private_buffer_size,
+                        coroutine_size);
+  }
+
+  /**
+   * @brief reset an exited coroutine with a new runner, so it can be started again without allocating a new stack
+   * @note The old runner is destroyed, the private buffer and the extend buffer before coroutine are kept.
+   * @param runner new runner, if it's empty, set it by set_runner() later
+   * @return COPP_EC_SUCCESS or error code
+   */
+  inline int reset(callback_type &&runner) LIBCOPP_MACRO_NOEXCEPT { return reset_callee(std::move(runner)); }
+
+  template <class TRunner>
+  inline int reset(TRunner *runner) LIBCOPP_MACRO_NOEXCEPT {
+    if (nullptr == runner) {
+      return reset(callback_type());
+    }
+
+    return reset(callback_type([runner](void *private_data) { return (*runner)(private_data); }));
+  }
+
+  inline int reset(int (*fn)(void *)) LIBCOPP_MACRO_NOEXCEPT {
+    if (nullptr == fn) {
+      return reset(callback_type());
+    }
+
+    return reset(callback_type(fn));
   }
 
   inline size_t use_count() const LIBCOPP_MACRO_NOEXCEPT { return ref_count_.load(); }
@@ -158,6 +308,85 @@ class coroutine_context_container : public coroutine_context {
  private:
   coroutine_context_container(const coroutine_context_container &) = delete;
 
+  // coroutine_size contains this object and private_buffer_size is aligned, callee_stack is given back if it failed
+  static ptr_type create_on_stack(callback_type &&runner, allocator_type &alloc, stack_context &callee_stack,
+                                  size_t coroutine_size, size_t private_buffer_size) LIBCOPP_MACRO_NOEXCEPT {
+    ptr_type ret;
+
+    // move everything down by a different color for each stack, but never use more than 1/8 of free stack for it
+    size_t color_offset = coroutine_context::next_stack_color_offset();
+    if (callee_stack.size <= coroutine_size + private_buffer_size ||
+        color_offset * 8 > callee_stack.size - coroutine_size - private_buffer_size) {
+      color_offset = 0;
+    }
+
+    // placement new
+    unsigned char *this_addr = reinterpret_cast<unsigned char *>(callee_stack.sp);
+    // stack down
+    this_addr -= color_offset + private_buffer_size + align_address_size(sizeof(this_type));
+    ret.reset(new (reinterpret_cast<void *>(this_addr)) this_type(std::move(alloc)));
+
+    // callee_stack and alloc unavailable any more.
+    if (ret) {
+      ret->callee_stack_ = std::move(callee_stack);
+    } else {
+      alloc.deallocate(callee_stack);
+      return ret;
+    }
+
+    // after this call runner will be unavailable
+    if (coroutine_context::create(ret.get(), std::move(runner), ret->callee_stack_, coroutine_size,
+                                  private_buffer_size, color_offset) < 0) {
+      ret.reset();
+    }
+
+    return ret;
+  }
+
+  // place runner below the extend buffer before coroutine
+  template <class TRunner>
+  static bool emplace_runner(this_type &co, TRunner &&runner, size_t coroutine_size,
+                             std::true_type) LIBCOPP_MACRO_NOEXCEPT {
+    using runner_type = typename std::decay<TRunner>::type;
+    void *runner_addr =
+        reinterpret_cast<unsigned char *>(&co) - coroutine_size - align_address_size(sizeof(runner_type));
+    runner_type *runner_obj = new (runner_addr) runner_type(std::forward<TRunner>(runner));
+    if (co.set_runner(runner_obj, &details::coroutine_runner_delegate<runner_type>::invoke,
+                      &details::coroutine_runner_delegate<runner_type>::destroy) < 0) {
+      runner_obj->~runner_type();
+      return false;
+    }
+
+    return true;
+  }
+
+  // function and callback_type, empty runner can be set later
+  template <class TRunner>
+  static bool emplace_runner(this_type &co, TRunner &&runner, size_t, std::false_type) LIBCOPP_MACRO_NOEXCEPT {
+    co.set_runner(callback_type(std::forward<TRunner>(runner)));
+    return true;
+  }
+
+  // Allocators which can allocate a group of stacks at once, such as stack_allocator_arena
+  template <typename TA>
+  static inline auto allocate_stacks(TA &alloc, stack_context *ctxs, size_t count, size_t size,
+                                     int) LIBCOPP_MACRO_NOEXCEPT -> decltype(alloc.allocate_batch(ctxs, count, size)) {
+    return alloc.allocate_batch(ctxs, count, size);
+  }
+
+  template <typename TA>
+  static inline size_t allocate_stacks(TA &alloc, stack_context *ctxs, size_t count, size_t size,
+                                       long) LIBCOPP_MACRO_NOEXCEPT {
+    for (size_t i = 0; i < count; ++i) {
+      alloc.allocate(ctxs[i], size);
+      if (nullptr == ctxs[i].sp) {
+        return i;
+      }
+    }
+
+    return count;
+  }
+
  private:
   friend void intrusive_ptr_add_ref(this_type *p) {
     if (p == nullptr) {
@@ -186,15 +415,11 @@ class coroutine_context_container : public coroutine_context {
   }
 
  private:
-  allocator_type alloc_; /** stack allocator **/
-#if defined(LIBCOPP_DISABLE_ATOMIC_LOCK) && LIBCOPP_DISABLE_ATOMIC_LOCK
-  LIBCOPP_COPP_NAMESPACE_ID::util::lock::atomic_int_type<
-      LIBCOPP_COPP_NAMESPACE_ID::util::lock::unsafe_int_type<size_t> >
-      ref_count_; /** status **/
-#else
-  LIBCOPP_COPP_NAMESPACE_ID::util::lock::atomic_int_type<size_t> ref_count_; /** status **/
-#endif
+  allocator_type alloc_;                                             /** stack allocator **/
+  typename thread_policy_type::template int_type<size_t> ref_count_; /** reference count **/
 };
 
 using coroutine_context_default = coroutine_context_container<allocator::default_statck_allocator>;
+using coroutine_context_single_thread_default =
+    coroutine_context_container<allocator::default_statck_allocator, coroutine_thread_policy_single_thread>;
 LIBCOPP_COPP_NAMESPACE_END
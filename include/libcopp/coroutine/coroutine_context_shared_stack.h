@@ -0,0 +1,502 @@
+// Copyright 2023 owent
+
+#pragma once
+
+#include <libcopp/utils/config/libcopp_build_features.h>
+
+#include <libcopp/coroutine/coroutine_context.h>
+#include <libcopp/stack/stack_allocator.h>
+#include <libcopp/stack/stack_traits.h>
+#include <libcopp/utils/errno.h>
+
+// clang-format off
+#include <libcopp/utils/config/stl_include_prefix.h>  // NOLINT(build/include_order)
+// clang-format on
+#include <assert.h>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+// clang-format off
+#include <libcopp/utils/config/stl_include_suffix.h>  // NOLINT(build/include_order)
+// clang-format on
+
+LIBCOPP_COPP_NAMESPACE_BEGIN
+template <typename TALLOC>
+class coroutine_context_shared_stack;
+
+/**
+ * @brief a group of run stacks shared by coroutine_context_shared_stack
+ * @note It's not thread-safe, all coroutines of a group must be created, resumed and destroyed in the same thread.
+ */
+template <typename TALLOC>
+class LIBCOPP_COPP_API_HEAD_ONLY shared_stack_group {
+ public:
+  using allocator_type = TALLOC;
+  using this_type = shared_stack_group<allocator_type>;
+  using ptr_type = std::shared_ptr<this_type>;
+  using coroutine_type = coroutine_context_shared_stack<allocator_type>;
+
+  struct run_stack_t {
+    stack_context stack;
+    coroutine_type *owner; /** coroutine whose stack data is on this run stack now **/
+  };
+
+ private:
+  struct constructor_delegator {};
+
+ public:
+  /**
+   * @brief create a group and allocate all run stacks
+   * @param alloc stack allocator
+   * @param stack_number number of run stacks
+   * @param stack_size size of each run stack, 0 means stack_traits::default_size()
+   * @return group or empty pointer if any run stack can not be allocated
+   */
+  static ptr_type create(const allocator_type &alloc, size_t stack_number, size_t stack_size = 0) {
+    if (0 == stack_number) {
+      return ptr_type();
+    }
+
+    if (0 == stack_size) {
+      stack_size = stack_traits::default_size();
+    }
+
+    ptr_type ret = std::make_shared<this_type>(constructor_delegator(), alloc);
+    if (!ret) {
+      return ret;
+    }
+
+    ret->stack_size_ = stack_size;
+    ret->run_stacks_.resize(stack_number);
+    for (size_t i = 0; i < stack_number; ++i) {
+      ret->run_stacks_[i].owner = nullptr;
+      ret->alloc_.allocate(ret->run_stacks_[i].stack, stack_size);
+      if (nullptr == ret->run_stacks_[i].stack.sp) {
+        ret->run_stacks_.resize(i);
+        return ptr_type();
+      }
+    }
+
+    return ret;
+  }
+
+  static ptr_type create(size_t stack_number, size_t stack_size = 0) {
+    return create(allocator_type(), stack_number, stack_size);
+  }
+
+  shared_stack_group(constructor_delegator, const allocator_type &alloc)
+      : alloc_(alloc), stack_size_(0), next_index_(0) {}
+
+  ~shared_stack_group() {
+    for (size_t i = 0; i < run_stacks_.size(); ++i) {
+      // coroutines hold the group, so no coroutine can own the run stack now
+      assert(nullptr == run_stacks_[i].owner);
+      alloc_.deallocate(run_stacks_[i].stack);
+    }
+  }
+
+  inline size_t get_stack_number() const LIBCOPP_MACRO_NOEXCEPT { return run_stacks_.size(); }
+  inline size_t get_stack_size() const LIBCOPP_MACRO_NOEXCEPT { return stack_size_; }
+
+  inline const run_stack_t &get_run_stack(size_t idx) const LIBCOPP_MACRO_NOEXCEPT { return run_stacks_[idx]; }
+
+  /**
+   * @brief select run stack for a new coroutine, in round-robin order
+   */
+  run_stack_t *select_run_stack() LIBCOPP_MACRO_NOEXCEPT {
+    if (run_stacks_.empty()) {
+      return nullptr;
+    }
+
+    if (next_index_ >= run_stacks_.size()) {
+      next_index_ = 0;
+    }
+    return &run_stacks_[next_index_++];
+  }
+
+ private:
+  shared_stack_group(const shared_stack_group &) = delete;
+  shared_stack_group &operator=(const shared_stack_group &) = delete;
+
+ private:
+  allocator_type alloc_;
+  size_t stack_size_;
+  size_t next_index_;
+  std::vector<run_stack_t> run_stacks_;
+};
+
+/**
+ * @brief coroutine container which runs on a shared run stack
+ * Coroutines bound to the same run stack share it. When a coroutine is resumed and another suspended coroutine's data
+ * is on the run stack, the used part of that stack (from its saved fcontext to the top) is copied into a heap buffer
+ * of that coroutine, and this coroutine's saved data is copied back.
+ * So a parked coroutine only costs its object, private buffer and the used part of stack.
+ * @note Stack data is copied lazily, only when another coroutine takes the run stack. Addresses of local variables
+ *       are the same after resumed, but they must not be accessed by other coroutines when their owner is suspended.
+ * @note A coroutine can not be started or resumed by a coroutine running on the same run stack.
+ * @note It must be started and resumed by coroutine_context_shared_stack::start()/resume(), not by the base type.
+ */
+template <typename TALLOC>
+class coroutine_context_shared_stack : public coroutine_context {
+ public:
+  using coroutine_context_type = coroutine_context;
+  using base_type = coroutine_context;
+  using allocator_type = TALLOC;
+  using this_type = coroutine_context_shared_stack<allocator_type>;
+  using ptr_type = LIBCOPP_COPP_NAMESPACE_ID::util::intrusive_ptr<this_type>;
+  using callback_type = coroutine_context::callback_type;
+  using ontop_callback_type = coroutine_context::ontop_callback_type;
+  using group_type = shared_stack_group<allocator_type>;
+  using group_ptr_type = typename group_type::ptr_type;
+  using run_stack_type = typename group_type::run_stack_t;
+
+  // Compability with libcopp-1.x
+  using ptr_t = ptr_type;
+  using callback_t = callback_type;
+
+  COROUTINE_CONTEXT_BASE_USING_BASE(base_type)
+
+ private:
+  coroutine_context_shared_stack(const group_ptr_type &group, run_stack_type *run_stack) LIBCOPP_MACRO_NOEXCEPT
+      : group_(group),
+        run_stack_(run_stack),
+        saved_buffer_(nullptr),
+        saved_size_(0),
+        saved_capacity_(0),
+        running_(false),
+        ref_count_(0) {
+    mark_shared_stack();
+  }
+
+ public:
+  ~coroutine_context_shared_stack() {
+    if (nullptr != run_stack_ && this == run_stack_->owner) {
+      run_stack_->owner = nullptr;
+    }
+
+    if (nullptr != saved_buffer_) {
+      free(saved_buffer_);
+      saved_buffer_ = nullptr;
+    }
+  }
+
+  /**
+   * @brief create coroutine with specify runner on a run stack of group
+   * @param runner runner
+   * @param group shared stack group
+   * @param private_buffer_size private buffer size
+   * @return coroutine or empty pointer
+   */
+  static ptr_type create(callback_type &&runner, const group_ptr_type &group,
+                         size_t private_buffer_size = 0) LIBCOPP_MACRO_NOEXCEPT {
+    return create_in_block(std::move(runner), group, private_buffer_size, 0, nullptr);
+  }
+
+  /**
+   * @brief create coroutine with functor runner on a run stack of group
+   * @note runner is placed in the same heap block of this object instead of std::function
+   * @param runner functor or lambda, size must not be greater than LIBCOPP_MACRO_COROUTINE_INLINE_RUNNER_SIZE
+   * @param group shared stack group
+   * @param private_buffer_size private buffer size
+   * @return coroutine or empty pointer
+   */
+  template <class TRunner,
+            class = typename std::enable_if<details::is_inline_runner<TRunner, callback_type>::value>::type>
+  static ptr_type create(TRunner &&runner, const group_ptr_type &group,
+                         size_t private_buffer_size = 0) LIBCOPP_MACRO_NOEXCEPT {
+    using runner_type = typename std::decay<TRunner>::type;
+    static_assert(sizeof(runner_type) <= LIBCOPP_MACRO_COROUTINE_INLINE_RUNNER_SIZE,
+                  "runner is too large to be placed in coroutine, pass it by pointer or std::function");
+    static_assert(alignof(runner_type) <= COROUTINE_CONTEXT_BASE_ALIGN_UNIT_SIZE,
+                  "alignment of runner is too large to be placed in coroutine");
+
+    void *runner_addr = nullptr;
+    ptr_type ret = create_in_block(callback_type(), group, private_buffer_size,
+                                   align_address_size(sizeof(runner_type)), &runner_addr);
+    if (!ret) {
+      return ret;
+    }
+
+    runner_type *runner_obj = new (runner_addr) runner_type(std::forward<TRunner>(runner));
+    if (ret->set_runner(runner_obj, &details::coroutine_runner_delegate<runner_type>::invoke,
+                        &details::coroutine_runner_delegate<runner_type>::destroy) < 0) {
+      runner_obj->~runner_type();
+      ret.reset();
+    }
+
+    return ret;
+  }
+
+  template <class TRunner>
+  static inline ptr_type create(TRunner *runner, const group_ptr_type &group,
+                                size_t private_buffer_size = 0) LIBCOPP_MACRO_NOEXCEPT {
+    if (nullptr == runner) {
+      return create(callback_type(), group, private_buffer_size);
+    }
+
+    return create([runner](void *private_data) { return (*runner)(private_data); }, group, private_buffer_size);
+  }
+
+  static inline ptr_type create(int (*fn)(void *), const group_ptr_type &group,
+                                size_t private_buffer_size = 0) LIBCOPP_MACRO_NOEXCEPT {
+    if (nullptr == fn) {
+      return create(callback_type(), group, private_buffer_size);
+    }
+
+    return create([fn](void *private_data) { return (*fn)(private_data); }, group, private_buffer_size);
+  }
+
+  /**
+   * @brief start coroutine, stack data of the current owner of run stack will be saved if necessary
+   * @param priv_data private data, will be passed to runner operator() or return to yield
+   * @return COPP_EC_SUCCESS or error code
+   */
+#if defined(LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR) && LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR
+  int start(void *priv_data = nullptr) {
+    std::exception_ptr eptr;
+    int ret = start(eptr, priv_data);
+    maybe_rethrow(eptr);
+    return ret;
+  }
+
+  int start(std::exception_ptr &unhandled, void *priv_data = nullptr) LIBCOPP_MACRO_NOEXCEPT {
+    int res = acquire_run_stack();
+    if (res < 0) {
+      return res;
+    }
+
+    running_ = true;
+    res = base_type::start(unhandled, priv_data);
+    running_ = false;
+    return res;
+  }
+#else
+  int start(void *priv_data = nullptr) {
+    int res = acquire_run_stack();
+    if (res < 0) {
+      return res;
+    }
+
+    running_ = true;
+    res = base_type::start(priv_data);
+    running_ = false;
+    return res;
+  }
+#endif
+
+  inline int resume(void *priv_data = nullptr) { return start(priv_data); }
+
+#if defined(LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR) && LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR
+  inline int resume(std::exception_ptr &unhandled, void *priv_data = nullptr) LIBCOPP_MACRO_NOEXCEPT {
+    return start(unhandled, priv_data);
+  }
+#endif
+
+#if defined(LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR) && LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR
+  int resume_with(ontop_callback_type fn, void *data = nullptr) {
+    std::exception_ptr eptr;
+    int ret = resume_with(eptr, fn, data);
+    maybe_rethrow(eptr);
+    return ret;
+  }
+
+  int resume_with(std::exception_ptr &unhandled, ontop_callback_type fn, void *data = nullptr) LIBCOPP_MACRO_NOEXCEPT {
+    int res = acquire_run_stack();
+    if (res < 0) {
+      return res;
+    }
+
+    running_ = true;
+    res = base_type::resume_with(unhandled, fn, data);
+    running_ = false;
+    return res;
+  }
+#else
+  int resume_with(ontop_callback_type fn, void *data = nullptr) {
+    int res = acquire_run_stack();
+    if (res < 0) {
+      return res;
+    }
+
+    running_ = true;
+    res = base_type::resume_with(fn, data);
+    running_ = false;
+    return res;
+  }
+#endif
+
+  inline const group_ptr_type &get_group() const LIBCOPP_MACRO_NOEXCEPT { return group_; }
+
+  /**
+   * @brief check if stack data of this coroutine is on the run stack now
+   */
+  inline bool is_on_run_stack() const LIBCOPP_MACRO_NOEXCEPT {
+    return nullptr != run_stack_ && this == run_stack_->owner;
+  }
+
+  /**
+   * @brief get size of stack data saved in heap buffer
+   */
+  inline size_t get_saved_size() const LIBCOPP_MACRO_NOEXCEPT { return saved_size_; }
+
+  /**
+   * @brief get capacity of heap buffer used to save stack data
+   */
+  inline size_t get_saved_capacity() const LIBCOPP_MACRO_NOEXCEPT { return saved_capacity_; }
+
+  inline size_t use_count() const LIBCOPP_MACRO_NOEXCEPT { return ref_count_.load(); }
+
+ private:
+  coroutine_context_shared_stack(const coroutine_context_shared_stack &) = delete;
+
+  int acquire_run_stack() LIBCOPP_MACRO_NOEXCEPT {
+    if (nullptr == run_stack_) {
+      return COPP_EC_NOT_INITED;
+    }
+
+    // base_type::start() will report errors of finished or running coroutine
+    if (running_ || is_finished()) {
+      return COPP_EC_SUCCESS;
+    }
+
+    this_type *owner = run_stack_->owner;
+    if (this == owner) {
+      return COPP_EC_SUCCESS;
+    }
+
+    if (nullptr != owner) {
+      // the owner is running below us on the same run stack, its frames can not be moved
+      if (owner->running_) {
+        return COPP_EC_ACCESS_VIOLATION;
+      }
+
+      if (!owner->is_finished()) {
+        int res = owner->save_stack();
+        if (res < 0) {
+          return res;
+        }
+      }
+      run_stack_->owner = nullptr;
+    }
+
+    if (nullptr == callee_) {
+      int res = make_callee_fcontext(run_stack_->stack);
+      if (res < 0) {
+        return res;
+      }
+    } else if (saved_size_ > 0) {
+      memcpy(reinterpret_cast<unsigned char *>(run_stack_->stack.sp) - saved_size_, saved_buffer_, saved_size_);
+      saved_size_ = 0;
+    }
+
+    run_stack_->owner = this;
+    return COPP_EC_SUCCESS;
+  }
+
+  int save_stack() LIBCOPP_MACRO_NOEXCEPT {
+    // callee_ is the saved fcontext of a suspended coroutine, which is the lowest address in use
+    unsigned char *stack_top = reinterpret_cast<unsigned char *>(run_stack_->stack.sp);
+    unsigned char *stack_used = reinterpret_cast<unsigned char *>(callee_);
+    assert(stack_used <= stack_top);
+    size_t used_size = static_cast<size_t>(stack_top - stack_used);
+    if (0 == used_size) {
+      saved_size_ = 0;
+      return COPP_EC_SUCCESS;
+    }
+
+    // keep buffer right-sized, but do not reallocate for small changes
+    if (used_size > saved_capacity_ || used_size * 2 < saved_capacity_) {
+      void *new_buffer = realloc(saved_buffer_, used_size);
+      if (nullptr == new_buffer) {
+        return COPP_EC_ALLOC_STACK_FAILED;
+      }
+      saved_buffer_ = new_buffer;
+      saved_capacity_ = used_size;
+    }
+
+    memcpy(saved_buffer_, stack_used, used_size);
+    saved_size_ = used_size;
+    return COPP_EC_SUCCESS;
+  }
+
+  // |this..PRIVATE DATA..RUNNER|, the object, private buffer and runner are placed in one heap block
+  static ptr_type create_in_block(callback_type &&runner, const group_ptr_type &group, size_t private_buffer_size,
+                                  size_t runner_size, void **runner_addr) LIBCOPP_MACRO_NOEXCEPT {
+    ptr_type ret;
+    if (!group) {
+      return ret;
+    }
+
+    run_stack_type *run_stack = group->select_run_stack();
+    if (nullptr == run_stack) {
+      return ret;
+    }
+
+    const size_t this_align_size = align_address_size(sizeof(this_type));
+    private_buffer_size = coroutine_context::align_private_data_size(private_buffer_size);
+
+    void *block = ::operator new(this_align_size + private_buffer_size + runner_size, std::nothrow);
+    if (nullptr == block) {
+      return ret;
+    }
+
+    ret.reset(new (block) this_type(group, run_stack));
+    void *priv_data = private_buffer_size > 0 ? reinterpret_cast<unsigned char *>(block) + this_align_size : nullptr;
+    if (ret->init_detached(std::move(runner), priv_data, private_buffer_size) < 0) {
+      ret.reset();
+      return ret;
+    }
+
+    if (nullptr != runner_addr) {
+      *runner_addr = reinterpret_cast<unsigned char *>(block) + this_align_size + private_buffer_size;
+    }
+    return ret;
+  }
+
+ private:
+  friend void intrusive_ptr_add_ref(this_type *p) {
+    if (p == nullptr) {
+      return;
+    }
+
+    ++p->ref_count_;
+  }
+
+  friend void intrusive_ptr_release(this_type *p) {
+    if (p == nullptr) {
+      return;
+    }
+
+    size_t left = --p->ref_count_;
+    if (0 == left) {
+      // keep group alive until the object is destroyed
+      group_ptr_type group = p->group_;
+
+      p->~coroutine_context_shared_stack();
+      ::operator delete(reinterpret_cast<void *>(p));
+    }
+  }
+
+ private:
+  group_ptr_type group_;
+  run_stack_type *run_stack_;
+  void *saved_buffer_;
+  size_t saved_size_;
+  size_t saved_capacity_;
+  bool running_;
+#if defined(LIBCOPP_DISABLE_ATOMIC_LOCK) && LIBCOPP_DISABLE_ATOMIC_LOCK
+  LIBCOPP_COPP_NAMESPACE_ID::util::lock::atomic_int_type<
+      LIBCOPP_COPP_NAMESPACE_ID::util::lock::unsafe_int_type<size_t> >
+      ref_count_; /** reference count **/
+#else
+  LIBCOPP_COPP_NAMESPACE_ID::util::lock::atomic_int_type<size_t> ref_count_; /** reference count **/
+#endif
+};
+
+using coroutine_context_shared_stack_default = coroutine_context_shared_stack<allocator::default_statck_allocator>;
+LIBCOPP_COPP_NAMESPACE_END
@@ -0,0 +1,496 @@
+// Copyright 2023 owent
+
+#pragma once
+
+#include <libcopp/utils/config/libcopp_build_features.h>
+
+#include <libcopp/coroutine/coroutine_context_container.h>
+#include <libcopp/stack/stack_allocator.h>
+
+// clang-format off
+#include <libcopp/utils/config/stl_include_prefix.h>  // NOLINT(build/include_order)
+// clang-format on
+#include <assert.h>
+#include <cstddef>
+#include <iterator>
+#include <new>
+#include <type_traits>
+#include <utility>
+// clang-format off
+#include <libcopp/utils/config/stl_include_suffix.h>  // NOLINT(build/include_order)
+// clang-format on
+
+LIBCOPP_COPP_NAMESPACE_BEGIN
+template <class T, class TALLOC = allocator::default_statck_allocator>
+class pull_coroutine;
+
+template <class T, class TALLOC = allocator::default_statck_allocator>
+class push_coroutine;
+
+namespace details {
+#if defined(LIBCOPP_MACRO_ENABLE_EXCEPTION) && LIBCOPP_MACRO_ENABLE_EXCEPTION
+/**
+ * @brief thrown by push or pull on the callee side after the caller side is closed, to unwind the coroutine stack
+ * @note The runner catches it, do not swallow it in catch(...) without rethrowing.
+ */
+struct LIBCOPP_COPP_API_HEAD_ONLY pull_push_forced_unwind {};
+#endif
+
+/**
+ * @brief value slot in the private buffer of pull_coroutine and push_coroutine
+ */
+template <class T>
+struct LIBCOPP_COPP_API_HEAD_ONLY pull_push_slot {
+  alignas(T) unsigned char storage[sizeof(T)];
+  bool has_value;
+  bool started; /** set when the function of coroutine is called **/
+  bool closed;  /** set by the caller side when it's destroyed before the coroutine finished **/
+
+  UTIL_FORCEINLINE T *get() LIBCOPP_MACRO_NOEXCEPT { return reinterpret_cast<T *>(storage); }
+
+  template <class U>
+  inline void emplace(U &&value) {
+    reset();
+    new (reinterpret_cast<void *>(storage)) T(std::forward<U>(value));
+    has_value = true;
+  }
+
+  inline void reset() LIBCOPP_MACRO_NOEXCEPT {
+    if (has_value) {
+      has_value = false;
+      get()->~T();
+    }
+  }
+};
+
+/**
+ * @brief shared part of pull_coroutine and push_coroutine
+ * The caller side owns the coroutine and switches into it by resume(), the callee side is only a view on the coroutine
+ * stack and switches back by yield(). Values are moved through the slot, so nothing is allocated except the stack.
+ */
+template <class T, class TALLOC>
+class LIBCOPP_COPP_API_HEAD_ONLY pull_push_coroutine_base {
+ public:
+  using value_type = T;
+  using allocator_type = TALLOC;
+  using coroutine_type = coroutine_context_container<allocator_type>;
+  using coroutine_ptr_type = typename coroutine_type::ptr_type;
+  using slot_type = pull_push_slot<value_type>;
+
+  static_assert(!std::is_reference<value_type>::value, "pull_coroutine and push_coroutine can not transfer references");
+  static_assert(alignof(slot_type) <= COROUTINE_CONTEXT_BASE_ALIGN_UNIT_SIZE,
+                "alignment of value is too large to be placed in the private buffer");
+
+  /**
+   * @brief get coroutine, it's empty for the callee side or if the coroutine can not be created
+   */
+  inline const coroutine_ptr_type &get_coroutine() const LIBCOPP_MACRO_NOEXCEPT { return co_; }
+
+#if defined(LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR) && LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR
+  /**
+   * @brief caller side, wake up the started coroutine with closed slot so it can quit, then release it
+   * @param unhandled set exception_ptr of unhandled exception raised by the coroutine when it quits
+   * @note The push or pull in the coroutine returns false at first. Any later push or pull throws
+   *       pull_push_forced_unwind, so objects on the coroutine stack are destroyed before it's released.
+   */
+  void close(std::exception_ptr &unhandled) LIBCOPP_MACRO_NOEXCEPT {
+    if (!co_) {
+      return;
+    }
+
+    slot_->reset();
+    if (slot_->started && !co_->is_finished()) {
+      slot_->closed = true;
+      co_->resume(unhandled);
+      slot_->reset();
+    }
+
+    release();
+  }
+
+  /**
+   * @brief caller side, the same as close(std::exception_ptr&) but rethrow unhandled exception of the coroutine
+   * @note The destructor calls close(std::exception_ptr&) and drops the exception, call this first to catch it.
+   */
+  void close() {
+    std::exception_ptr eptr;
+    close(eptr);
+    coroutine_type::maybe_rethrow(eptr);
+  }
+#else
+  /**
+   * @brief caller side, wake up the started coroutine with closed slot so it can quit, then release it
+   * @note The push or pull in the coroutine returns false at first. Without exception, any later push or pull switches
+   *       back at once and the coroutine is released without unwinding, objects on its stack are not destroyed.
+   */
+  void close() {
+    if (!co_) {
+      return;
+    }
+
+    slot_->reset();
+    if (slot_->started && !co_->is_finished()) {
+      slot_->closed = true;
+      co_->resume();
+      slot_->reset();
+    }
+
+    release();
+  }
+#endif
+
+ protected:
+  pull_push_coroutine_base() LIBCOPP_MACRO_NOEXCEPT : ctx_(nullptr), slot_(nullptr) {}
+
+  // callee side, created on the coroutine stack by the runner
+  pull_push_coroutine_base(coroutine_context *ctx, slot_type *slot) LIBCOPP_MACRO_NOEXCEPT : ctx_(ctx), slot_(slot) {}
+
+  pull_push_coroutine_base(pull_push_coroutine_base &&other) LIBCOPP_MACRO_NOEXCEPT
+      : co_(std::move(other.co_)),
+        ctx_(other.ctx_),
+        slot_(other.slot_) {
+    other.ctx_ = nullptr;
+    other.slot_ = nullptr;
+  }
+
+  ~pull_push_coroutine_base() {
+#if defined(LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR) && LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR
+    std::exception_ptr eptr;
+    close(eptr);
+#else
+    close();
+#endif
+  }
+
+  void swap(pull_push_coroutine_base &other) LIBCOPP_MACRO_NOEXCEPT {
+    using std::swap;
+    swap(co_, other.co_);
+    swap(ctx_, other.ctx_);
+    swap(slot_, other.slot_);
+  }
+
+  template <class TRunner>
+  bool create(TRunner &&runner, allocator_type &alloc, size_t stack_size) LIBCOPP_MACRO_NOEXCEPT {
+    co_ = coroutine_type::create(std::forward<TRunner>(runner), alloc, stack_size, sizeof(slot_type));
+    if (!co_) {
+      return false;
+    }
+
+    ctx_ = co_.get();
+    slot_ = new (co_->get_private_buffer()) slot_type();
+    slot_->has_value = false;
+    slot_->started = false;
+    slot_->closed = false;
+    return true;
+  }
+
+  UTIL_FORCEINLINE bool is_caller() const LIBCOPP_MACRO_NOEXCEPT { return !!co_; }
+
+  // caller side, switch into the coroutine and destroy the value left in slot if it finished
+  void resume() {
+    if (!co_ || co_->is_finished()) {
+      return;
+    }
+
+#if defined(LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR) && LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR
+    std::exception_ptr eptr;
+    co_->resume(eptr);
+    if (co_->is_finished()) {
+      slot_->reset();
+    }
+    coroutine_type::maybe_rethrow(eptr);
+#else
+    co_->resume();
+    if (co_->is_finished()) {
+      slot_->reset();
+    }
+#endif
+  }
+
+  // callee side, switch back to the caller
+  UTIL_FORCEINLINE void yield() LIBCOPP_MACRO_NOEXCEPT { ctx_->yield(); }
+
+  // callee side, push or pull after the caller side is closed, unwind the coroutine stack if exception is enabled
+  void yield_closed() {
+#if defined(LIBCOPP_MACRO_ENABLE_EXCEPTION) && LIBCOPP_MACRO_ENABLE_EXCEPTION
+    throw pull_push_forced_unwind();
+#else
+    // never return to a loop which does not check it
+    yield();
+#endif
+  }
+
+  void release() LIBCOPP_MACRO_NOEXCEPT {
+    slot_->~slot_type();
+    co_.reset();
+    ctx_ = nullptr;
+    slot_ = nullptr;
+  }
+
+  template <class TFn, class TCallee>
+  struct runner_type {
+    TFn fn;
+
+    int operator()(void *) {
+      coroutine_context *self = this_coroutine::get_coroutine();
+      slot_type *slot = reinterpret_cast<slot_type *>(self->get_private_buffer());
+      slot->started = true;
+      TCallee callee(self, slot);
+#if defined(LIBCOPP_MACRO_ENABLE_EXCEPTION) && LIBCOPP_MACRO_ENABLE_EXCEPTION
+      try {
+        fn(callee);
+      } catch (const pull_push_forced_unwind &) {
+      }
+#else
+      fn(callee);
+#endif
+      return 0;
+    }
+  };
+
+ private:
+  pull_push_coroutine_base(const pull_push_coroutine_base &) = delete;
+  pull_push_coroutine_base &operator=(const pull_push_coroutine_base &) = delete;
+
+ protected:
+  coroutine_ptr_type co_; /** coroutine, only the caller side holds it **/
+  coroutine_context *ctx_;
+  slot_type *slot_; /** slot in the private buffer of coroutine **/
+};
+}  // namespace details
+
+/**
+ * @brief stackful coroutine which produces values of T for the caller
+ * The caller side is created with fn(push_coroutine<T>&) and it runs until the first value is pushed. The caller
+ * reads the value by get() and pulls the next one by operator(), or just uses range-for.
+ * The callee side is passed to the function of push_coroutine, it pulls values pushed by the caller.
+ * @note Values are moved through a slot in the private buffer of coroutine, nothing is allocated except the stack.
+ * @note If the caller side is closed or destroyed before the coroutine finished, the coroutine is resumed once and the
+ *       push in it returns with a false push_coroutine, the function should quit then. Any later push throws
+ *       details::pull_push_forced_unwind to unwind the coroutine stack (or just switches back without exception).
+ * @note fn is placed on the coroutine stack, its size must not be greater than
+ *       LIBCOPP_MACRO_COROUTINE_INLINE_RUNNER_SIZE.
+ */
+template <class T, class TALLOC>
+class LIBCOPP_COPP_API_HEAD_ONLY pull_coroutine : public details::pull_push_coroutine_base<T, TALLOC> {
+ public:
+  using base_type = details::pull_push_coroutine_base<T, TALLOC>;
+  using value_type = typename base_type::value_type;
+  using allocator_type = typename base_type::allocator_type;
+  using slot_type = typename base_type::slot_type;
+  using push_type = push_coroutine<T, TALLOC>;
+
+  /**
+   * @brief input iterator, it's equal to end() after the last value
+   */
+  class iterator {
+   public:
+    using iterator_category = std::input_iterator_tag;
+    using value_type = typename pull_coroutine::value_type;
+    using difference_type = std::ptrdiff_t;
+    using pointer = value_type *;
+    using reference = value_type &;
+
+    iterator() LIBCOPP_MACRO_NOEXCEPT : owner_(nullptr) {}
+    explicit iterator(pull_coroutine *owner) LIBCOPP_MACRO_NOEXCEPT : owner_(owner && *owner ? owner : nullptr) {}
+
+    inline reference operator*() const LIBCOPP_MACRO_NOEXCEPT { return owner_->get(); }
+    inline pointer operator->() const LIBCOPP_MACRO_NOEXCEPT { return &owner_->get(); }
+
+    iterator &operator++() {
+      (*owner_)();
+      if (!*owner_) {
+        owner_ = nullptr;
+      }
+      return *this;
+    }
+
+    inline void operator++(int) { ++(*this); }
+
+    friend inline bool operator==(const iterator &l, const iterator &r) LIBCOPP_MACRO_NOEXCEPT {
+      return l.owner_ == r.owner_;
+    }
+    friend inline bool operator!=(const iterator &l, const iterator &r) LIBCOPP_MACRO_NOEXCEPT {
+      return l.owner_ != r.owner_;
+    }
+
+   private:
+    pull_coroutine *owner_;
+  };
+
+ public:
+  pull_coroutine() LIBCOPP_MACRO_NOEXCEPT {}
+
+  /**
+   * @brief create coroutine and run fn until it pushes the first value or returns
+   * @param fn function or functor called as fn(push_coroutine<T> &)
+   * @param alloc stack allocator
+   * @param stack_size stack size, 0 means stack_traits::default_size()
+   * @note Check operator bool or get_coroutine() for whether it's created.
+   */
+  template <class TFn>
+  pull_coroutine(TFn &&fn, allocator_type &alloc, size_t stack_size = 0) {
+    using runner_type = typename base_type::template runner_type<typename std::decay<TFn>::type, push_type>;
+    if (base_type::create(runner_type{std::forward<TFn>(fn)}, alloc, stack_size)) {
+      base_type::resume();
+    }
+  }
+
+  template <class TFn, class = typename std::enable_if<
+                           !std::is_same<typename std::decay<TFn>::type, pull_coroutine>::value>::type>
+  explicit pull_coroutine(TFn &&fn, size_t stack_size = 0) {
+    allocator_type alloc;
+    using runner_type = typename base_type::template runner_type<typename std::decay<TFn>::type, push_type>;
+    if (base_type::create(runner_type{std::forward<TFn>(fn)}, alloc, stack_size)) {
+      base_type::resume();
+    }
+  }
+
+  pull_coroutine(pull_coroutine &&other) LIBCOPP_MACRO_NOEXCEPT : base_type(std::move(other)) {}
+
+  pull_coroutine &operator=(pull_coroutine &&other) LIBCOPP_MACRO_NOEXCEPT {
+    pull_coroutine tmp(std::move(other));
+    base_type::swap(tmp);
+    return *this;
+  }
+
+  /**
+   * @brief if there is a value to get
+   */
+  explicit operator bool() const LIBCOPP_MACRO_NOEXCEPT { return nullptr != this->slot_ && this->slot_->has_value; }
+
+  /**
+   * @brief get current value, operator bool must be true
+   */
+  inline value_type &get() const LIBCOPP_MACRO_NOEXCEPT {
+    assert(this->slot_ && this->slot_->has_value);
+    return *this->slot_->get();
+  }
+
+  /**
+   * @brief drop current value and pull the next one
+   * @note The caller side resumes the coroutine, the callee side yields to the caller of push_coroutine, or to the
+   *       closer if the caller side is destroyed.
+   */
+  pull_coroutine &operator()() {
+    if (nullptr == this->slot_) {
+      return *this;
+    }
+
+    this->slot_->reset();
+    if (base_type::is_caller()) {
+      base_type::resume();
+    } else if (this->slot_->closed) {
+      base_type::yield_closed();
+    } else {
+      base_type::yield();
+    }
+    return *this;
+  }
+
+  inline iterator begin() LIBCOPP_MACRO_NOEXCEPT { return iterator(this); }
+  inline iterator end() LIBCOPP_MACRO_NOEXCEPT { return iterator(); }
+
+ private:
+  friend class details::pull_push_coroutine_base<T, TALLOC>;
+
+  pull_coroutine(coroutine_context *ctx, slot_type *slot) LIBCOPP_MACRO_NOEXCEPT : base_type(ctx, slot) {}
+};
+
+/**
+ * @brief stackful coroutine which consumes values of T pushed by the caller
+ * The caller side is created with fn(pull_coroutine<T>&), fn is not called until the first value is pushed by
+ * operator(). The callee side is passed to the function of pull_coroutine, it pushes values to the caller.
+ * @note Values are moved through a slot in the private buffer of coroutine, nothing is allocated except the stack.
+ * @note If the caller side is closed or destroyed before the coroutine finished, the coroutine is resumed once and the
+ *       pull in it returns with a false pull_coroutine, the function should quit then. Any later pull throws
+ *       details::pull_push_forced_unwind to unwind the coroutine stack (or just switches back without exception).
+ * @note fn is placed on the coroutine stack, its size must not be greater than
+ *       LIBCOPP_MACRO_COROUTINE_INLINE_RUNNER_SIZE.
+ */
+template <class T, class TALLOC>
+class LIBCOPP_COPP_API_HEAD_ONLY push_coroutine : public details::pull_push_coroutine_base<T, TALLOC> {
+ public:
+  using base_type = details::pull_push_coroutine_base<T, TALLOC>;
+  using value_type = typename base_type::value_type;
+  using allocator_type = typename base_type::allocator_type;
+  using slot_type = typename base_type::slot_type;
+  using pull_type = pull_coroutine<T, TALLOC>;
+
+ public:
+  push_coroutine() LIBCOPP_MACRO_NOEXCEPT {}
+
+  /**
+   * @brief create coroutine, fn is called when the first value is pushed
+   * @param fn function or functor called as fn(pull_coroutine<T> &)
+   * @param alloc stack allocator
+   * @param stack_size stack size, 0 means stack_traits::default_size()
+   * @note Check operator bool or get_coroutine() for whether it's created.
+   */
+  template <class TFn>
+  push_coroutine(TFn &&fn, allocator_type &alloc, size_t stack_size = 0) {
+    using runner_type = typename base_type::template runner_type<typename std::decay<TFn>::type, pull_type>;
+    base_type::create(runner_type{std::forward<TFn>(fn)}, alloc, stack_size);
+  }
+
+  template <class TFn, class = typename std::enable_if<
+                           !std::is_same<typename std::decay<TFn>::type, push_coroutine>::value>::type>
+  explicit push_coroutine(TFn &&fn, size_t stack_size = 0) {
+    allocator_type alloc;
+    using runner_type = typename base_type::template runner_type<typename std::decay<TFn>::type, pull_type>;
+    base_type::create(runner_type{std::forward<TFn>(fn)}, alloc, stack_size);
+  }
+
+  push_coroutine(push_coroutine &&other) LIBCOPP_MACRO_NOEXCEPT : base_type(std::move(other)) {}
+
+  push_coroutine &operator=(push_coroutine &&other) LIBCOPP_MACRO_NOEXCEPT {
+    push_coroutine tmp(std::move(other));
+    base_type::swap(tmp);
+    return *this;
+  }
+
+  /**
+   * @brief if values can be pushed
+   * @note The caller side is false after the coroutine finished, the callee side is false after the caller side is
+   *       destroyed.
+   */
+  explicit operator bool() const LIBCOPP_MACRO_NOEXCEPT {
+    if (nullptr == this->slot_) {
+      return false;
+    }
+
+    if (base_type::is_caller()) {
+      return !this->co_->is_finished();
+    }
+    return !this->slot_->closed;
+  }
+
+  /**
+   * @brief push a value
+   * @note The caller side resumes the coroutine, the callee side yields to the caller of pull_coroutine, or to the
+   *       closer without the value if the caller side is destroyed.
+   */
+  template <class U>
+  push_coroutine &operator()(U &&value) {
+    if (!*this) {
+      if (nullptr != this->slot_ && !base_type::is_caller()) {
+        base_type::yield_closed();
+      }
+      return *this;
+    }
+
+    this->slot_->emplace(std::forward<U>(value));
+    if (base_type::is_caller()) {
+      base_type::resume();
+    } else {
+      base_type::yield();
+    }
+    return *this;
+  }
+
+ private:
+  friend class details::pull_push_coroutine_base<T, TALLOC>;
+
+  push_coroutine(coroutine_context *ctx, slot_type *slot) LIBCOPP_MACRO_NOEXCEPT : base_type(ctx, slot) {}
+};
+LIBCOPP_COPP_NAMESPACE_END
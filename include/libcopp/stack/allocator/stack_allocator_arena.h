@@ -0,0 +1,173 @@
+// Copyright 2023 owent
+
+#pragma once
+
+#include <libcopp/utils/config/libcopp_build_features.h>
+
+#include <libcopp/utils/features.h>
+#include <libcopp/utils/lock_holder.h>
+#include <libcopp/utils/spin_lock.h>
+
+// clang-format off
+#include <libcopp/utils/config/stl_include_prefix.h>  // NOLINT(build/include_order)
+// clang-format on
+#include <stdint.h>
+#include <cstddef>
+#include <memory>
+#include <vector>
+// clang-format off
+#include <libcopp/utils/config/stl_include_suffix.h>  // NOLINT(build/include_order)
+// clang-format on
+
+#ifdef COPP_HAS_ABI_HEADERS
+#  include COPP_ABI_PREFIX
+#endif
+
+LIBCOPP_COPP_NAMESPACE_BEGIN
+struct stack_context;
+
+namespace allocator {
+
+/**
+ * @brief stack arena
+ * this arena reserves one large region by mmap and carves it into fixed-size stacks, free stacks are tracked by a
+ * bitmap. So creating and destroying a stack do not need any system call.
+ * @note Guard pages are disabled by default, so the whole arena is kept in one VMA and millions of stacks do not hit
+ *       [vm.max_map_count]. The tradeoff is that a stack overflow silently corrupts the stack below it instead of
+ *       crashing. When guard page is enabled, all guard pages are protected once when the arena is created, but every
+ *       guard page splits the region into two more VMAs.
+ */
+class LIBCOPP_COPP_API stack_arena {
+ public:
+  using ptr_type = std::shared_ptr<stack_arena>;
+
+ private:
+  struct constructor_delegator {};
+
+  stack_arena() = delete;
+  stack_arena(const stack_arena &) = delete;
+  stack_arena &operator=(const stack_arena &) = delete;
+
+ public:
+  /**
+   * create a stack arena
+   * @param stack_size stack size of every stack, will be rounded to page size
+   * @param stack_number max stack number
+   * @param guard_page protect a page at the bottom of every stack, it costs two VMAs per stack
+   * @return arena pointer, or empty pointer if failed to reserve memory
+   */
+  static ptr_type create(std::size_t stack_size, std::size_t stack_number, bool guard_page = false);
+
+  stack_arena(constructor_delegator, void *start_ptr, std::size_t stack_size, std::size_t stack_number,
+              bool guard_page) LIBCOPP_MACRO_NOEXCEPT;
+  ~stack_arena();
+
+  /**
+   * allocate a stack from arena [standard function]
+   * @param ctx stack context
+   * @param size stack size, must be less or equal than get_stack_size(), or ctx.sp will be set to nullptr
+   */
+  void allocate(stack_context &ctx, std::size_t size) LIBCOPP_MACRO_NOEXCEPT;
+
+  /**
+   * allocate a group of stacks from arena, the lock is taken only once
+   * @param ctxs stack contexts to receive stacks
+   * @param count number of stacks
+   * @param size stack size, must be less or equal than get_stack_size()
+   * @return number of allocated stacks, ctxs[0, return value) are available
+   */
+  std::size_t allocate_batch(stack_context *ctxs, std::size_t count, std::size_t size) LIBCOPP_MACRO_NOEXCEPT;
+
+  /**
+   * give back a stack to arena [standard function]
+   * @param ctx stack context
+   */
+  void deallocate(stack_context &ctx) LIBCOPP_MACRO_NOEXCEPT;
+
+  /**
+   * @brief check if a stack is allocated from this arena
+   */
+  bool contains(const stack_context &ctx) const LIBCOPP_MACRO_NOEXCEPT;
+
+  /**
+   * @brief usable stack size, not including guard page
+   */
+  inline std::size_t get_stack_size() const LIBCOPP_MACRO_NOEXCEPT { return stack_size_; }
+  inline std::size_t get_stack_number() const LIBCOPP_MACRO_NOEXCEPT { return stack_number_; }
+  inline std::size_t get_used_stack_number() const LIBCOPP_MACRO_NOEXCEPT { return used_stack_number_; }
+  inline bool has_guard_page() const LIBCOPP_MACRO_NOEXCEPT { return guard_page_; }
+
+ private:
+  std::size_t get_slot_size() const LIBCOPP_MACRO_NOEXCEPT;
+
+  // action_lock_ must be held and there must be at least one free slot
+  std::size_t pop_free_slot() LIBCOPP_MACRO_NOEXCEPT;
+
+  void assign_slot(stack_context &ctx, std::size_t slot_index) const LIBCOPP_MACRO_NOEXCEPT;
+
+ private:
+  void *start_ptr_;
+  std::size_t stack_size_;
+  std::size_t stack_number_;
+  std::size_t used_stack_number_;
+  std::size_t search_hint_;       /** index of bitmap word to start searching free slots **/
+  std::vector<uint64_t> bitmap_;  /** bit 1 means the slot is free **/
+  bool guard_page_;
+
+#if !defined(LIBCOPP_DISABLE_ATOMIC_LOCK) || !(LIBCOPP_DISABLE_ATOMIC_LOCK)
+  LIBCOPP_COPP_NAMESPACE_ID::util::lock::spin_lock action_lock_;
+#endif
+};
+
+/**
+ * @brief memory allocator
+ * this allocator will take stacks from a shared stack_arena
+ */
+class LIBCOPP_COPP_API stack_allocator_arena {
+ public:
+  using arena_type = stack_arena;
+
+ public:
+  stack_allocator_arena() LIBCOPP_MACRO_NOEXCEPT;
+  stack_allocator_arena(const std::shared_ptr<arena_type> &arena) LIBCOPP_MACRO_NOEXCEPT;
+  ~stack_allocator_arena();
+
+  /**
+   * specify arena allocated from
+   * @param arena stack arena
+   * @note must be called before allocate operation
+   */
+  void attach(const std::shared_ptr<arena_type> &arena) LIBCOPP_MACRO_NOEXCEPT;
+
+  /**
+   * allocate memory and attach to stack context [standard function]
+   * @param ctx stack context
+   * @param size stack size
+   * @note size must less or equal than stack size of arena
+   */
+  void allocate(stack_context &ctx, std::size_t size) LIBCOPP_MACRO_NOEXCEPT;
+
+  /**
+   * allocate a group of stacks
+   * @param ctxs stack contexts to receive stacks
+   * @param count number of stacks
+   * @param size stack size
+   * @return number of allocated stacks, ctxs[0, return value) are available
+   */
+  std::size_t allocate_batch(stack_context *ctxs, std::size_t count, std::size_t size) LIBCOPP_MACRO_NOEXCEPT;
+
+  /**
+   * deallocate memory from stack context [standard function]
+   * @param ctx stack context
+   */
+  void deallocate(stack_context &ctx) LIBCOPP_MACRO_NOEXCEPT;
+
+ private:
+  std::shared_ptr<arena_type> arena_;
+};
+}  // namespace allocator
+LIBCOPP_COPP_NAMESPACE_END
+
+#ifdef COPP_HAS_ABI_HEADERS
+#  include COPP_ABI_SUFFIX
+#endif
@@ -47,13 +47,13 @@ class LIBCOPP_COPP_API_HEAD_ONLY stack_allocator_pool {
   /**
    * allocate memory and attach to stack context [standard function]
    * @param ctx stack context
-   * @param size ignored
+   * @param size stack size, it's ignored if pool only has allocate(stack_context&)
    * @note size must less or equal than attached
    */
-  void allocate(stack_context &ctx, std::size_t) LIBCOPP_MACRO_NOEXCEPT {
+  void allocate(stack_context &ctx, std::size_t size) LIBCOPP_MACRO_NOEXCEPT {
     assert(pool_);
     if (pool_) {
-      pool_->allocate(ctx);
+      pool_allocate(*pool_, ctx, size, 0);
     }
   }
 
@@ -68,6 +68,19 @@ class LIBCOPP_COPP_API_HEAD_ONLY stack_allocator_pool {
     }
   }
 
+ private:
+  // Pools with size classes accept size, such as stack_size_class_pool
+  template <typename TP>
+  static inline auto pool_allocate(TP &pool, stack_context &ctx, std::size_t size, int) LIBCOPP_MACRO_NOEXCEPT
+      -> decltype(pool.allocate(ctx, size), void()) {
+    pool.allocate(ctx, size);
+  }
+
+  template <typename TP>
+  static inline void pool_allocate(TP &pool, stack_context &ctx, std::size_t, long) LIBCOPP_MACRO_NOEXCEPT {
+    pool.allocate(ctx);
+  }
+
  private:
   std::shared_ptr<pool_type> pool_;
 };
@@ -42,6 +42,14 @@ class LIBCOPP_COPP_API stack_allocator_posix {
    * @param ctx stack context
    */
   void deallocate(stack_context &) LIBCOPP_MACRO_NOEXCEPT;
+
+  /**
+   * return physical pages of a unused stack to system, but keep the mapping and guard page
+   * @param ctx stack context
+   * @param keep_size bytes at the top of stack which will be kept resident
+   * @note The content of trimmed pages will be lost, they will be zero-filled on next access.
+   */
+  void trim(stack_context &ctx, std::size_t keep_size) LIBCOPP_MACRO_NOEXCEPT;
 };
 }  // namespace allocator
 LIBCOPP_COPP_NAMESPACE_END
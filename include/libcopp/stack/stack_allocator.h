@@ -15,6 +15,7 @@
 #endif
 
 #ifdef LIBCOPP_MACRO_SYS_POSIX
+#  include "allocator/stack_allocator_arena.h"
 #  include "allocator/stack_allocator_posix.h"
 LIBCOPP_COPP_NAMESPACE_BEGIN
 namespace allocator {
@@ -19,6 +19,12 @@ struct LIBCOPP_COPP_API stack_context {
   size_t size; /** @brief stack size **/
   void *sp;    /** @brief stack end pointer **/
 
+  /**
+   * @brief set by stack_watermark::paint(), kept here because the stack may be overwritten
+   * @note It changes the layout of stack_context, code built with older headers must be rebuilt.
+   */
+  bool watermark_painted;
+
 #ifdef LIBCOPP_MACRO_USE_SEGMENTED_STACKS
   using segments_context_t = void *[COPP_MACRO_SEGMENTED_STACK_NUMBER];
   segments_context_t segments_ctx; /** @brief gcc split segment stack data **/
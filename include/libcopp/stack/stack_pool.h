@@ -4,20 +4,27 @@
 
 #include <libcopp/utils/config/libcopp_build_features.h>
 
+#include <libcopp/utils/atomic_int_type.h>
 #include <libcopp/utils/features.h>
 #include <libcopp/utils/lock_holder.h>
 #include <libcopp/utils/spin_lock.h>
 
 #include <libcopp/stack/stack_context.h>
 #include <libcopp/stack/stack_traits.h>
+#include <libcopp/stack/stack_watermark.h>
 
 // clang-format off
 #include <libcopp/utils/config/stl_include_prefix.h>  // NOLINT(build/include_order)
 // clang-format on
 #include <assert.h>
+#include <cstdint>
 #include <cstring>
-#include <list>
 #include <memory>
+#include <new>
+#include <utility>
+#if !defined(COPP_MACRO_THREAD_LOCAL)
+#  include <thread>
+#endif
 // clang-format off
 #include <libcopp/utils/config/stl_include_suffix.h>  // NOLINT(build/include_order)
 // clang-format on
@@ -33,11 +40,15 @@ class LIBCOPP_COPP_API_HEAD_ONLY stack_pool {
   using allocator_t = allocator_type;
   using ptr_t = ptr_type;
 
+  using watermark_stat_t = stack_watermark::stat_type;
+
   struct limit_t {
     size_t used_stack_number;
     size_t used_stack_size;
     size_t free_stack_number;
     size_t free_stack_size;
+    size_t trimmed_stack_number; /** trimmed stacks are also counted in free_stack_number **/
+    size_t trimmed_stack_size;   /** trimmed stacks are also counted in free_stack_size **/
   };
 
   struct configure_t {
@@ -48,27 +59,88 @@ class LIBCOPP_COPP_API_HEAD_ONLY stack_pool {
     size_t max_stack_size;
     size_t min_stack_number;
     size_t min_stack_size;
+    size_t magazine_number;
+    size_t magazine_size;
+    size_t gc_trim_keep_size;
+    size_t watermark_sample_rate;
+    int watermark_mode;
     bool auto_gc;
+    bool gc_trim;
   };
 
  private:
   struct constructor_delegator {};
 
+  /**
+   * @brief node of free list, it's placed at the top of a cached stack, so pooled stacks need no extra memory
+   */
+  struct free_node_t {
+    stack_context ctx;
+    free_node_t *next;
+  };
+
+  /**
+   * @brief per-thread FILO stack cache in front of the shared free list
+   * @note stacks in magazines are counted as used in limits_, get_limit() will move them back to free
+   */
+  struct alignas(64) magazine_t {
+#if !defined(LIBCOPP_DISABLE_ATOMIC_LOCK) || !(LIBCOPP_DISABLE_ATOMIC_LOCK)
+    LIBCOPP_COPP_NAMESPACE_ID::util::lock::spin_lock action_lock;
+#endif
+    free_node_t *head;
+    size_t stack_number;
+    size_t stack_size;
+
+    magazine_t() : head(nullptr), stack_number(0), stack_size(0) {}
+  };
+
   stack_pool() = delete;
   stack_pool(const stack_pool &) = delete;
 
  public:
   static ptr_type create() { return std::make_shared<stack_pool>(constructor_delegator()); }
 
-  stack_pool(constructor_delegator) {
+  stack_pool(constructor_delegator) : free_list_head_(nullptr), trimmed_list_head_(nullptr), magazines_(nullptr) {
     memset(&limits_, 0, sizeof(limits_));
     memset(&conf_, 0, sizeof(conf_));
+    memset(&watermark_stat_, 0, sizeof(watermark_stat_));
     conf_.stack_size = LIBCOPP_COPP_NAMESPACE_ID::stack_traits::default_size();
     conf_.auto_gc = true;
+    publish_stack_size();
   }
-  ~stack_pool() { clear(); }
+  ~stack_pool() {
+    clear();
+    if (nullptr != magazines_) {
+      delete[] magazines_;
+    }
+  }
+
+  /**
+   * @brief get global used/free stack number and size, stacks cached by magazines are counted as free
+   */
+  limit_t get_limit() const {
+    limit_t ret;
+    {
+#if !defined(LIBCOPP_DISABLE_ATOMIC_LOCK) || !(LIBCOPP_DISABLE_ATOMIC_LOCK)
+      LIBCOPP_COPP_NAMESPACE_ID::util::lock::lock_holder<LIBCOPP_COPP_NAMESPACE_ID::util::lock::spin_lock> lock_guard(
+          action_lock_);
+#endif
+      ret = limits_;
+    }
 
-  inline const limit_t &get_limit() const { return limits_; }
+    for (size_t i = 0; nullptr != magazines_ && i < conf_.magazine_number; ++i) {
+      magazine_t &mag = magazines_[i];
+#if !defined(LIBCOPP_DISABLE_ATOMIC_LOCK) || !(LIBCOPP_DISABLE_ATOMIC_LOCK)
+      LIBCOPP_COPP_NAMESPACE_ID::util::lock::lock_holder<LIBCOPP_COPP_NAMESPACE_ID::util::lock::spin_lock> lock_guard(
+          mag.action_lock);
+#endif
+      ret.used_stack_number = ret.used_stack_number >= mag.stack_number ? ret.used_stack_number - mag.stack_number : 0;
+      ret.used_stack_size = ret.used_stack_size >= mag.stack_size ? ret.used_stack_size - mag.stack_size : 0;
+      ret.free_stack_number += mag.stack_number;
+      ret.free_stack_size += mag.stack_size;
+    }
+    return ret;
+  }
 
   // configure
   inline allocator_type &get_origin_allocator() LIBCOPP_MACRO_NOEXCEPT { return alloc_; }
@@ -85,7 +157,35 @@ class LIBCOPP_COPP_API_HEAD_ONLY stack_pool {
       clear();
     }
 
-    return conf_.stack_size = sz;
+#if !defined(LIBCOPP_DISABLE_ATOMIC_LOCK) || !(LIBCOPP_DISABLE_ATOMIC_LOCK)
+    LIBCOPP_COPP_NAMESPACE_ID::util::lock::lock_holder<LIBCOPP_COPP_NAMESPACE_ID::util::lock::spin_lock> lock_guard(
+        action_lock_);
+#endif
+    conf_.stack_size = sz;
+    publish_stack_size();
+    return sz;
+  }
+
+  /**
+   * @brief change stack size of new allocations without releasing cached stacks
+   * @note Cached stacks which are smaller than the new size will be released when they are popped, and stacks of the
+   *       old size will be released when they are returned. So the pool switches to the new size gradually.
+   * @return the real stack size
+   */
+  size_t update_stack_size(size_t sz) LIBCOPP_MACRO_NOEXCEPT {
+    if (sz <= LIBCOPP_COPP_NAMESPACE_ID::stack_traits::minimum_size()) {
+      sz = LIBCOPP_COPP_NAMESPACE_ID::stack_traits::minimum_size();
+    } else {
+      sz = LIBCOPP_COPP_NAMESPACE_ID::stack_traits::round_to_page_size(sz);
+    }
+
+#if !defined(LIBCOPP_DISABLE_ATOMIC_LOCK) || !(LIBCOPP_DISABLE_ATOMIC_LOCK)
+    LIBCOPP_COPP_NAMESPACE_ID::util::lock::lock_holder<LIBCOPP_COPP_NAMESPACE_ID::util::lock::spin_lock> lock_guard(
+        action_lock_);
+#endif
+    conf_.stack_size = sz;
+    publish_stack_size();
+    return sz;
   }
   size_t get_stack_size() const { return conf_.stack_size; }
   size_t get_stack_size_offset() const { return conf_.stack_offset; }
@@ -106,6 +206,91 @@ class LIBCOPP_COPP_API_HEAD_ONLY stack_pool {
   inline void set_gc_once_number(size_t v) LIBCOPP_MACRO_NOEXCEPT { conf_.gc_number = v; }
   inline size_t get_gc_once_number() const LIBCOPP_MACRO_NOEXCEPT { return conf_.gc_number; }
 
+  /**
+   * @brief set whether gc() trims stacks instead of releasing them
+   * @note Trimmed stacks keep their address space and guard page, but their physical pages are returned to system.
+   *       It only works when allocator_type has trim(stack_context&, size_t), such as stack_allocator_posix, or gc()
+   *       will still release stacks.
+   *       Trimmed stacks are released by gc() at last, when untrimmed free stacks need no gc but all free stacks are
+   *       still more than used.
+   */
+  inline void set_gc_trim(bool v) LIBCOPP_MACRO_NOEXCEPT { conf_.gc_trim = v; }
+  inline bool is_gc_trim() const LIBCOPP_MACRO_NOEXCEPT { return conf_.gc_trim; }
+
+  /**
+   * @brief set how many bytes at the top of a trimmed stack are kept resident
+   * @note The top of a cached stack holds the free list node, so at least one page is always kept.
+   */
+  inline void set_gc_trim_keep_size(size_t sz) LIBCOPP_MACRO_NOEXCEPT { conf_.gc_trim_keep_size = sz; }
+  inline size_t get_gc_trim_keep_size() const LIBCOPP_MACRO_NOEXCEPT { return conf_.gc_trim_keep_size; }
+
+  /**
+   * @brief set number of per-thread stack caches(magazines), 0 to disable them
+   * @note Threads are numbered by the order they first touch any stack_pool with the same TAlloc (or by the hash of
+   *       thread id without thread_local), and use the magazine of (number % n). So threads which only use other pools
+   *       also take numbers, it's better to be greater or equal to the number of threads which use pools of this type.
+   * @note This function is not thread-safe, it should be called before any allocate(). All stacks in the old
+   *       magazines will be released.
+   */
+  void set_magazine_number(size_t n) {
+    if (n == conf_.magazine_number && (0 == n || nullptr != magazines_)) {
+      return;
+    }
+
+    clear();
+    if (nullptr != magazines_) {
+      delete[] magazines_;
+      magazines_ = nullptr;
+    }
+
+    conf_.magazine_number = n;
+    if (n > 0) {
+      magazines_ = new magazine_t[n];
+    }
+  }
+  inline size_t get_magazine_number() const LIBCOPP_MACRO_NOEXCEPT { return conf_.magazine_number; }
+
+  /**
+   * @brief set max number of stacks cached in one magazine, 0 to disable magazines
+   * @note A magazine exchanges half of this number of stacks with the shared free list once.
+   */
+  inline void set_magazine_size(size_t sz) LIBCOPP_MACRO_NOEXCEPT { conf_.magazine_size = sz; }
+  inline size_t get_magazine_size() const LIBCOPP_MACRO_NOEXCEPT { return conf_.magazine_size; }
+
+  /**
+   * @brief set how to measure the high-water mark of released stacks
+   * @param mode stack_watermark::mode_type::type, EN_SWM_NONE to disable it
+   * @note EN_SWM_PAINT writes the whole stack when it's allocated, use set_stack_watermark_sample_rate() to reduce the
+   *       cost in production.
+   */
+  inline void set_stack_watermark_mode(int mode) LIBCOPP_MACRO_NOEXCEPT { conf_.watermark_mode = mode; }
+  inline int get_stack_watermark_mode() const LIBCOPP_MACRO_NOEXCEPT { return conf_.watermark_mode; }
+
+  /**
+   * @brief only paint one of every N allocated stacks in EN_SWM_PAINT mode, 0 or 1 to paint all stacks
+   */
+  inline void set_stack_watermark_sample_rate(size_t n) LIBCOPP_MACRO_NOEXCEPT { conf_.watermark_sample_rate = n; }
+  inline size_t get_stack_watermark_sample_rate() const LIBCOPP_MACRO_NOEXCEPT { return conf_.watermark_sample_rate; }
+
+  /**
+   * @brief get histogram of the high-water marks of released stacks
+   */
+  watermark_stat_t get_stack_watermark_stat() const {
+#if !defined(LIBCOPP_DISABLE_ATOMIC_LOCK) || !(LIBCOPP_DISABLE_ATOMIC_LOCK)
+    LIBCOPP_COPP_NAMESPACE_ID::util::lock::lock_holder<LIBCOPP_COPP_NAMESPACE_ID::util::lock::spin_lock> lock_guard(
+        watermark_lock_);
+#endif
+    return watermark_stat_;
+  }
+
+  void reset_stack_watermark_stat() {
+#if !defined(LIBCOPP_DISABLE_ATOMIC_LOCK) || !(LIBCOPP_DISABLE_ATOMIC_LOCK)
+    LIBCOPP_COPP_NAMESPACE_ID::util::lock::lock_holder<LIBCOPP_COPP_NAMESPACE_ID::util::lock::spin_lock> lock_guard(
+        watermark_lock_);
+#endif
+    memset(&watermark_stat_, 0, sizeof(watermark_stat_));
+  }
+
   // actions
 
   /**
@@ -115,6 +300,182 @@ class LIBCOPP_COPP_API_HEAD_ONLY stack_pool {
    * @note size must less or equal than attached
    */
   void allocate(stack_context &ctx) LIBCOPP_MACRO_NOEXCEPT {
+    allocate_stack(ctx);
+
+    if (stack_watermark::mode_type::EN_SWM_PAINT == conf_.watermark_mode && nullptr != ctx.sp) {
+      paint_stack_watermark(ctx);
+    } else {
+      // cached stacks may be painted when the watermark mode is changed
+      ctx.watermark_painted = false;
+    }
+  }
+
+  /**
+   * deallocate memory from stack context [standard function]
+   * @param ctx stack context
+   */
+  void deallocate(stack_context &ctx) LIBCOPP_MACRO_NOEXCEPT {
+    assert(ctx.sp && ctx.size > 0);
+    if (stack_watermark::mode_type::EN_SWM_NONE != conf_.watermark_mode && nullptr != ctx.sp) {
+      record_stack_watermark(ctx);
+    }
+
+    deallocate_stack(ctx);
+  }
+
+  size_t gc() {
+    size_t ret = 0;
+    // trimmed stacks cost no physical memory, gc untrimmed stacks first if untrimmed free stacks is greater than used
+    size_t untrimmed_free_number = limits_.free_stack_number - limits_.trimmed_stack_number;
+    size_t untrimmed_free_size = limits_.free_stack_size - limits_.trimmed_stack_size;
+    if (limits_.used_stack_size >= untrimmed_free_size && limits_.used_stack_number >= untrimmed_free_number) {
+      return gc_trimmed_stacks();
+    }
+
+    // gc when stack is too large
+    if (0 != conf_.min_stack_size || 0 != conf_.min_stack_number) {
+      bool min_stack_size =
+          conf_.min_stack_size == 0 || limits_.used_stack_size + untrimmed_free_size <= conf_.min_stack_size;
+      bool min_stack_number = conf_.min_stack_number == 0 ||
+                              untrimmed_free_number + limits_.used_stack_number <= conf_.min_stack_number;
+      if (min_stack_size && min_stack_number) {
+        return gc_trimmed_stacks();
+      }
+    }
+
+#if !defined(LIBCOPP_DISABLE_ATOMIC_LOCK) || !(LIBCOPP_DISABLE_ATOMIC_LOCK)
+    LIBCOPP_COPP_NAMESPACE_ID::util::lock::lock_holder<LIBCOPP_COPP_NAMESPACE_ID::util::lock::spin_lock> lock_guard(
+        action_lock_);
+#endif
+
+    untrimmed_free_number = limits_.free_stack_number - limits_.trimmed_stack_number;
+    untrimmed_free_size = limits_.free_stack_size - limits_.trimmed_stack_size;
+    size_t keep_size = untrimmed_free_size >> 1;
+    size_t keep_number = untrimmed_free_number >> 1;
+    size_t left_gc = conf_.gc_number;
+
+    // Stacks on the front of free list are the most recently used ones, we keep them and release the oldest ones from
+    // the tail. So we walk from the head to find the last node to keep, and then detach all nodes after it.
+    // Stacks of the old size may be still in free list after update_stack_size(), so every node is counted by its own
+    // size.
+    size_t keep_free_number = 0;
+    {
+      size_t keep_free_size = 0;
+      for (free_node_t *node = free_list_head_; nullptr != node && keep_free_number < keep_number;
+           node = node->next) {
+        if (keep_free_size + node->ctx.size > keep_size) {
+          break;
+        }
+        ++keep_free_number;
+        keep_free_size += node->ctx.size;
+      }
+    }
+    size_t release_number = untrimmed_free_number - keep_free_number;
+    if (0 != left_gc && release_number > left_gc) {
+      release_number = left_gc;
+      keep_free_number = untrimmed_free_number - release_number;
+    }
+
+    free_node_t *release_head = nullptr;
+    if (0 == keep_free_number) {
+      release_head = free_list_head_;
+      free_list_head_ = nullptr;
+    } else if (release_number > 0) {
+      free_node_t *last_keep = free_list_head_;
+      for (size_t i = keep_free_number; last_keep != nullptr && i > 1; --i) {
+        last_keep = last_keep->next;
+      }
+
+      if (nullptr != last_keep) {
+        release_head = last_keep->next;
+        last_keep->next = nullptr;
+      }
+    }
+
+    size_t trim_keep_size = conf_.gc_trim_keep_size;
+    if (trim_keep_size < sizeof(free_node_t)) {
+      trim_keep_size = sizeof(free_node_t);
+    }
+    while (nullptr != release_head) {
+      free_node_t *node = release_head;
+      release_head = node->next;
+      ++ret;
+
+      // keep the mapping and return physical pages to system
+      if (conf_.gc_trim && trim_stack(alloc_, node->ctx, trim_keep_size, 0)) {
+        node->next = trimmed_list_head_;
+        trimmed_list_head_ = node;
+        ++limits_.trimmed_stack_number;
+        limits_.trimmed_stack_size += node->ctx.size;
+        continue;
+      }
+
+      COPP_LIKELY_IF (limits_.free_stack_number > 0) {
+        --limits_.free_stack_number;
+      }
+
+      COPP_LIKELY_IF (limits_.free_stack_size >= node->ctx.size) {
+        limits_.free_stack_size -= node->ctx.size;
+      } else {
+        limits_.free_stack_size = 0;
+      }
+
+      stack_context release_ctx = std::move(node->ctx);
+      node->~free_node_t();
+      alloc_.deallocate(release_ctx);
+    }
+
+    if (nullptr == free_list_head_ && nullptr == trimmed_list_head_) {
+      limits_.free_stack_size = 0;
+      limits_.free_stack_number = 0;
+    }
+
+    LIBCOPP_UTIL_LOCK_ATOMIC_THREAD_FENCE(LIBCOPP_COPP_NAMESPACE_ID::util::lock::memory_order_release);
+
+    return ret;
+  }
+
+  void clear() {
+    // return all stacks in magazines to the shared free list first
+    for (size_t i = 0; nullptr != magazines_ && i < conf_.magazine_number; ++i) {
+      flush_magazine(magazines_[i], 0);
+    }
+
+#if !defined(LIBCOPP_DISABLE_ATOMIC_LOCK) || !(LIBCOPP_DISABLE_ATOMIC_LOCK)
+    LIBCOPP_COPP_NAMESPACE_ID::util::lock::lock_holder<LIBCOPP_COPP_NAMESPACE_ID::util::lock::spin_lock> lock_guard(
+        action_lock_);
+#endif
+
+    limits_.free_stack_size = 0;
+    limits_.free_stack_number = 0;
+    limits_.trimmed_stack_size = 0;
+    limits_.trimmed_stack_number = 0;
+
+    free_node_t *lists[2] = {free_list_head_, trimmed_list_head_};
+    free_list_head_ = nullptr;
+    trimmed_list_head_ = nullptr;
+    for (size_t i = 0; i < sizeof(lists) / sizeof(lists[0]); ++i) {
+      while (nullptr != lists[i]) {
+        free_node_t *node = lists[i];
+        lists[i] = node->next;
+
+        stack_context release_ctx = std::move(node->ctx);
+        node->~free_node_t();
+        alloc_.deallocate(release_ctx);
+      }
+    }
+
+    LIBCOPP_UTIL_LOCK_ATOMIC_THREAD_FENCE(LIBCOPP_COPP_NAMESPACE_ID::util::lock::memory_order_release);
+  }
+
+ private:
+  void allocate_stack(stack_context &ctx) LIBCOPP_MACRO_NOEXCEPT {
+    if (nullptr != magazines_ && 0 != conf_.magazine_size) {
+      COPP_LIKELY_IF (allocate_from_magazine(get_current_magazine(), ctx)) {
+        return;
+      }
+    }
+
 #if !defined(LIBCOPP_DISABLE_ATOMIC_LOCK) || !(LIBCOPP_DISABLE_ATOMIC_LOCK)
     LIBCOPP_COPP_NAMESPACE_ID::util::lock::lock_holder<LIBCOPP_COPP_NAMESPACE_ID::util::lock::spin_lock> lock_guard(
         action_lock_);
@@ -133,35 +494,23 @@ class LIBCOPP_COPP_API_HEAD_ONLY stack_pool {
     }
 
     // get from pool, in order to max reuse cache, we use FILO to allocate stack
-    if (!free_list_.empty()) {
-      typename std::list<stack_context>::reverse_iterator iter = free_list_.rbegin();
-      assert(iter != free_list_.rend());
+    if (nullptr != free_list_head_ || nullptr != trimmed_list_head_) {
+      free_node_t *node = pop_free_node();
 
-      // free limit
-      COPP_LIKELY_IF (limits_.free_stack_number > 0) {
-        --limits_.free_stack_number;
-      } else {
-        limits_.free_stack_number = free_list_.size() - 1;
-      }
-
-      COPP_LIKELY_IF (limits_.free_stack_size >= (*iter).size) {
-        limits_.free_stack_size -= (*iter).size;
-      } else {
-        limits_.free_stack_size = 0;
-      }
-
-      // make sure the stack must be greater or equal than configure after reset
-      COPP_LIKELY_IF (iter->size >= conf_.stack_size) {
-        ctx = *iter;
-        free_list_.pop_back();
+      // make sure the stack must be greater or equal than configure after reset, ctx.size contains the guard page
+      COPP_LIKELY_IF (node->ctx.size >= conf_.stack_size + conf_.stack_offset) {
+        ctx = std::move(node->ctx);
+        node->~free_node_t();
 
         // used limit
         ++limits_.used_stack_number;
         limits_.used_stack_size += ctx.size;
         return;
       } else {
-        // just pop cache
-        free_list_.pop_back();
+        // just drop cache
+        stack_context drop_ctx = std::move(node->ctx);
+        node->~free_node_t();
+        alloc_.deallocate(drop_ctx);
       }
     }
 
@@ -172,16 +521,20 @@ class LIBCOPP_COPP_API_HEAD_ONLY stack_pool {
       ++limits_.used_stack_number;
       limits_.used_stack_size += ctx.size;
 
-      conf_.stack_offset = ctx.size - conf_.stack_size;
+      if (conf_.stack_offset != ctx.size - conf_.stack_size) {
+        conf_.stack_offset = ctx.size - conf_.stack_size;
+        publish_stack_size();
+      }
     }
   }
 
-  /**
-   * deallocate memory from stack context [standard function]
-   * @param ctx stack context
-   */
-  void deallocate(stack_context &ctx) LIBCOPP_MACRO_NOEXCEPT {
-    assert(ctx.sp && ctx.size > 0);
+  void deallocate_stack(stack_context &ctx) LIBCOPP_MACRO_NOEXCEPT {
+    if (nullptr != magazines_ && 0 != conf_.magazine_size) {
+      COPP_LIKELY_IF (deallocate_to_magazine(get_current_magazine(), ctx)) {
+        return;
+      }
+    }
+
     do {
 #if !defined(LIBCOPP_DISABLE_ATOMIC_LOCK) || !(LIBCOPP_DISABLE_ATOMIC_LOCK)
       LIBCOPP_COPP_NAMESPACE_ID::util::lock::lock_holder<LIBCOPP_COPP_NAMESPACE_ID::util::lock::spin_lock> lock_guard(
@@ -204,17 +557,13 @@ class LIBCOPP_COPP_API_HEAD_ONLY stack_pool {
       }
 
       // check size
-      if (ctx.size != conf_.stack_size + conf_.stack_offset) {
+      if (ctx.size != conf_.stack_size + conf_.stack_offset || nullptr == get_free_node_address(ctx)) {
         alloc_.deallocate(ctx);
         break;
       }
 
       // push to free list
-      free_list_.push_back(ctx);
-
-      // limits
-      ++limits_.free_stack_number;
-      limits_.free_stack_size += ctx.size;
+      push_free_node(make_free_node(ctx));
     } while (false);
 
     // check GC
@@ -223,17 +572,89 @@ class LIBCOPP_COPP_API_HEAD_ONLY stack_pool {
     }
   }
 
-  size_t gc() {
+  void paint_stack_watermark(stack_context &ctx) LIBCOPP_MACRO_NOEXCEPT {
+    if (conf_.watermark_sample_rate > 1 && 0 != (watermark_sample_counter_++) % conf_.watermark_sample_rate) {
+      // stacks may be painted by last allocation, remove the mark so the stale pattern will not be measured
+      stack_watermark::unpaint(ctx);
+      return;
+    }
+
+    stack_watermark::paint(ctx);
+  }
+
+  void record_stack_watermark(const stack_context &ctx) LIBCOPP_MACRO_NOEXCEPT {
+    size_t used_size;
+    if (stack_watermark::mode_type::EN_SWM_RESIDENT == conf_.watermark_mode) {
+      used_size = stack_watermark::measure_resident(ctx);
+    } else {
+      used_size = stack_watermark::measure(ctx);
+    }
+
+    if (0 == used_size) {
+      return;
+    }
+
+#if !defined(LIBCOPP_DISABLE_ATOMIC_LOCK) || !(LIBCOPP_DISABLE_ATOMIC_LOCK)
+    LIBCOPP_COPP_NAMESPACE_ID::util::lock::lock_holder<LIBCOPP_COPP_NAMESPACE_ID::util::lock::spin_lock> lock_guard(
+        watermark_lock_);
+#endif
+    stack_watermark::add_sample(watermark_stat_, used_size);
+  }
+
+  /**
+   * @brief get address to store free node of a stack
+   * @param ctx stack context
+   * @return address of free node, or nullptr if the stack is too small
+   */
+  static free_node_t *get_free_node_address(const stack_context &ctx) LIBCOPP_MACRO_NOEXCEPT {
+    constexpr const size_t align_mask = alignof(free_node_t) - 1;
+    if (nullptr == ctx.sp || ctx.size < sizeof(free_node_t) + align_mask) {
+      return nullptr;
+    }
+
+    // stack down, the node is placed at the top of the stack
+    uintptr_t addr = reinterpret_cast<uintptr_t>(ctx.sp) - sizeof(free_node_t);
+    addr &= ~static_cast<uintptr_t>(align_mask);
+    return reinterpret_cast<free_node_t *>(addr);
+  }
+
+  static free_node_t *make_free_node(const stack_context &ctx) LIBCOPP_MACRO_NOEXCEPT {
+    // ctx may be stored in the stack buffer, copy it before placement new
+    stack_context copy_ctx = ctx;
+    free_node_t *node = new (reinterpret_cast<void *>(get_free_node_address(copy_ctx))) free_node_t();
+    node->ctx = std::move(copy_ctx);
+    node->next = nullptr;
+    return node;
+  }
+
+  void push_free_node(free_node_t *node) LIBCOPP_MACRO_NOEXCEPT {
+    node->next = free_list_head_;
+    free_list_head_ = node;
+
+    // limits
+    ++limits_.free_stack_number;
+    limits_.free_stack_size += node->ctx.size;
+  }
+
+  /**
+   * @brief release the oldest half of trimmed stacks
+   * @note It's called by gc() when untrimmed free stacks need no gc, so trimmed stacks are released at last, and only
+   *       when all free stacks are still more than used.
+   * @return released stack number
+   */
+  size_t gc_trimmed_stacks() LIBCOPP_MACRO_NOEXCEPT {
     size_t ret = 0;
-    // gc only if free stacks is greater than used
+    if (0 == limits_.trimmed_stack_number) {
+      return ret;
+    }
+
     if (limits_.used_stack_size >= limits_.free_stack_size && limits_.used_stack_number >= limits_.free_stack_number) {
       return ret;
     }
 
-    // gc when stack is too large
     if (0 != conf_.min_stack_size || 0 != conf_.min_stack_number) {
-      bool min_stack_size =
-          conf_.min_stack_size == 0 || limits_.used_stack_size + limits_.free_stack_size <= conf_.min_stack_size;
+      bool min_stack_size = conf_.min_stack_size == 0 ||
+                            limits_.used_stack_size + limits_.free_stack_size <= conf_.min_stack_size;
       bool min_stack_number = conf_.min_stack_number == 0 ||
                               limits_.free_stack_number + limits_.used_stack_number <= conf_.min_stack_number;
       if (min_stack_size && min_stack_number) {
@@ -246,63 +667,320 @@ class LIBCOPP_COPP_API_HEAD_ONLY stack_pool {
         action_lock_);
 #endif
 
-    size_t keep_size = limits_.free_stack_size >> 1;
-    size_t keep_number = limits_.free_stack_number >> 1;
-    size_t left_gc = conf_.gc_number;
-    while (limits_.free_stack_size > keep_size || limits_.free_stack_number > keep_number) {
-      if (free_list_.empty()) {
-        limits_.free_stack_size = 0;
-        limits_.free_stack_number = 0;
-        break;
+    // trimmed list is also FILO, the oldest trimmed stacks are on the tail
+    size_t release_number = limits_.trimmed_stack_number - (limits_.trimmed_stack_number >> 1);
+    if (0 != conf_.gc_number && release_number > conf_.gc_number) {
+      release_number = conf_.gc_number;
+    }
+
+    free_node_t *release_head = nullptr;
+    if (release_number >= limits_.trimmed_stack_number) {
+      release_head = trimmed_list_head_;
+      trimmed_list_head_ = nullptr;
+    } else if (release_number > 0) {
+      free_node_t *last_keep = trimmed_list_head_;
+      for (size_t i = limits_.trimmed_stack_number - release_number; last_keep != nullptr && i > 1; --i) {
+        last_keep = last_keep->next;
       }
 
-      typename std::list<stack_context>::iterator iter = free_list_.begin();
-      assert(iter != free_list_.end());
+      if (nullptr != last_keep) {
+        release_head = last_keep->next;
+        last_keep->next = nullptr;
+      }
+    }
+
+    while (nullptr != release_head) {
+      free_node_t *node = release_head;
+      release_head = node->next;
+      ++ret;
+
+      COPP_LIKELY_IF (limits_.trimmed_stack_number > 0) {
+        --limits_.trimmed_stack_number;
+      }
+      COPP_LIKELY_IF (limits_.trimmed_stack_size >= node->ctx.size) {
+        limits_.trimmed_stack_size -= node->ctx.size;
+      } else {
+        limits_.trimmed_stack_size = 0;
+      }
 
       COPP_LIKELY_IF (limits_.free_stack_number > 0) {
         --limits_.free_stack_number;
+      }
+      COPP_LIKELY_IF (limits_.free_stack_size >= node->ctx.size) {
+        limits_.free_stack_size -= node->ctx.size;
       } else {
-        limits_.free_stack_number = free_list_.size() - 1;
+        limits_.free_stack_size = 0;
       }
 
-      COPP_LIKELY_IF (limits_.free_stack_size >= (*iter).size) {
-        limits_.free_stack_size -= (*iter).size;
+      stack_context release_ctx = std::move(node->ctx);
+      node->~free_node_t();
+      alloc_.deallocate(release_ctx);
+    }
+
+    if (nullptr == trimmed_list_head_) {
+      limits_.trimmed_stack_size = 0;
+      limits_.trimmed_stack_number = 0;
+    }
+
+    if (nullptr == free_list_head_ && nullptr == trimmed_list_head_) {
+      limits_.free_stack_size = 0;
+      limits_.free_stack_number = 0;
+    }
+
+    LIBCOPP_UTIL_LOCK_ATOMIC_THREAD_FENCE(LIBCOPP_COPP_NAMESPACE_ID::util::lock::memory_order_release);
+
+    return ret;
+  }
+
+  free_node_t *pop_free_node() LIBCOPP_MACRO_NOEXCEPT {
+    free_node_t *node;
+    // prefer stacks which are still resident
+    COPP_LIKELY_IF (nullptr != free_list_head_) {
+      node = free_list_head_;
+      free_list_head_ = node->next;
+    } else {
+      node = trimmed_list_head_;
+      assert(node);
+      trimmed_list_head_ = node->next;
+
+      COPP_LIKELY_IF (limits_.trimmed_stack_number > 0) {
+        --limits_.trimmed_stack_number;
+      }
+      COPP_LIKELY_IF (limits_.trimmed_stack_size >= node->ctx.size) {
+        limits_.trimmed_stack_size -= node->ctx.size;
       } else {
-        limits_.free_stack_size = 0;
+        limits_.trimmed_stack_size = 0;
       }
+    }
 
-      alloc_.deallocate(*iter);
-      free_list_.pop_front();
-      ++ret;
+    // free limit
+    COPP_LIKELY_IF (limits_.free_stack_number > 0) {
+      --limits_.free_stack_number;
+    }
 
-      // gc max stacks once
-      if (0 != left_gc) {
-        --left_gc;
-        if (0 == left_gc) {
-          break;
+    COPP_LIKELY_IF (limits_.free_stack_size >= node->ctx.size) {
+      limits_.free_stack_size -= node->ctx.size;
+    } else {
+      limits_.free_stack_size = 0;
+    }
+
+    if (nullptr == free_list_head_ && nullptr == trimmed_list_head_) {
+      limits_.free_stack_size = 0;
+      limits_.free_stack_number = 0;
+      limits_.trimmed_stack_size = 0;
+      limits_.trimmed_stack_number = 0;
+    }
+    return node;
+  }
+
+  // Only allocators with trim(stack_context&, size_t) can trim stacks, such as stack_allocator_posix
+  template <typename TA>
+  static inline auto trim_stack(TA &alloc, stack_context &ctx, size_t keep_size, int) LIBCOPP_MACRO_NOEXCEPT
+      -> decltype(alloc.trim(ctx, keep_size), bool()) {
+    alloc.trim(ctx, keep_size);
+    return true;
+  }
+
+  template <typename TA>
+  static inline bool trim_stack(TA &, stack_context &, size_t, long) LIBCOPP_MACRO_NOEXCEPT {
+    return false;
+  }
+
+  static size_t get_magazine_thread_index() LIBCOPP_MACRO_NOEXCEPT {
+    static LIBCOPP_COPP_NAMESPACE_ID::util::lock::atomic_int_type<size_t> thread_index_allocator;
+#if defined(COPP_MACRO_THREAD_LOCAL)
+    static COPP_MACRO_THREAD_LOCAL size_t thread_index = 0;
+    if (0 == thread_index) {
+      thread_index = ++thread_index_allocator;
+    }
+    return thread_index - 1;
+#else
+    return std::hash<std::thread::id>()(std::this_thread::get_id());
+#endif
+  }
+
+  inline magazine_t &get_current_magazine() LIBCOPP_MACRO_NOEXCEPT {
+    return magazines_[get_magazine_thread_index() % conf_.magazine_number];
+  }
+
+  /**
+   * @brief publish the stack size for the magazine path, which does not hold action_lock_
+   * @note must be called with action_lock_ held (or before the pool is shared)
+   */
+  void publish_stack_size() LIBCOPP_MACRO_NOEXCEPT {
+    magazine_full_stack_size_.store(conf_.stack_size + conf_.stack_offset,
+                                    LIBCOPP_COPP_NAMESPACE_ID::util::lock::memory_order_release);
+  }
+
+  bool allocate_from_magazine(magazine_t &mag, stack_context &ctx) LIBCOPP_MACRO_NOEXCEPT {
+    size_t min_stack_size =
+        magazine_full_stack_size_.load(LIBCOPP_COPP_NAMESPACE_ID::util::lock::memory_order_acquire);
+#if !defined(LIBCOPP_DISABLE_ATOMIC_LOCK) || !(LIBCOPP_DISABLE_ATOMIC_LOCK)
+    LIBCOPP_COPP_NAMESPACE_ID::util::lock::lock_holder<LIBCOPP_COPP_NAMESPACE_ID::util::lock::spin_lock> lock_guard(
+        mag.action_lock);
+#endif
+    if (nullptr == mag.head) {
+      refill_magazine(mag);
+    }
+
+    while (nullptr != mag.head) {
+      free_node_t *node = mag.head;
+      mag.head = node->next;
+      --mag.stack_number;
+      mag.stack_size = mag.stack_size >= node->ctx.size ? mag.stack_size - node->ctx.size : 0;
+
+      // stacks in magazine are already counted as used, ctx.size contains the guard page
+      COPP_LIKELY_IF (node->ctx.size >= min_stack_size) {
+        ctx = std::move(node->ctx);
+        node->~free_node_t();
+        return true;
+      }
+
+      // just drop cache
+      stack_context drop_ctx = std::move(node->ctx);
+      node->~free_node_t();
+      {
+#if !defined(LIBCOPP_DISABLE_ATOMIC_LOCK) || !(LIBCOPP_DISABLE_ATOMIC_LOCK)
+        LIBCOPP_COPP_NAMESPACE_ID::util::lock::lock_holder<LIBCOPP_COPP_NAMESPACE_ID::util::lock::spin_lock>
+            shared_lock_guard(action_lock_);
+#endif
+        COPP_LIKELY_IF (limits_.used_stack_number > 0) {
+          --limits_.used_stack_number;
         }
+        limits_.used_stack_size = limits_.used_stack_size >= drop_ctx.size ? limits_.used_stack_size - drop_ctx.size : 0;
       }
+      alloc_.deallocate(drop_ctx);
     }
 
-    LIBCOPP_UTIL_LOCK_ATOMIC_THREAD_FENCE(LIBCOPP_COPP_NAMESPACE_ID::util::lock::memory_order_release);
+    return false;
+  }
 
-    return ret;
+  bool deallocate_to_magazine(magazine_t &mag, stack_context &ctx) LIBCOPP_MACRO_NOEXCEPT {
+    if (ctx.sp == nullptr || 0 == ctx.size) {
+      return false;
+    }
+
+    if (ctx.size != magazine_full_stack_size_.load(LIBCOPP_COPP_NAMESPACE_ID::util::lock::memory_order_acquire) ||
+        nullptr == get_free_node_address(ctx)) {
+      return false;
+    }
+
+    bool need_flush;
+    {
+#if !defined(LIBCOPP_DISABLE_ATOMIC_LOCK) || !(LIBCOPP_DISABLE_ATOMIC_LOCK)
+      LIBCOPP_COPP_NAMESPACE_ID::util::lock::lock_holder<LIBCOPP_COPP_NAMESPACE_ID::util::lock::spin_lock> lock_guard(
+          mag.action_lock);
+#endif
+      free_node_t *node = make_free_node(ctx);
+      node->next = mag.head;
+      mag.head = node;
+      ++mag.stack_number;
+      mag.stack_size += node->ctx.size;
+      need_flush = mag.stack_number > conf_.magazine_size;
+    }
+
+    if (need_flush) {
+      flush_magazine(mag, get_magazine_batch_size());
+
+      if (conf_.auto_gc) {
+        gc();
+      }
+    }
+
+    return true;
   }
 
-  void clear() {
+  inline size_t get_magazine_batch_size() const LIBCOPP_MACRO_NOEXCEPT {
+    return conf_.magazine_size > 1 ? (conf_.magazine_size >> 1) : 1;
+  }
+
+  /**
+   * @brief move a batch of stacks from shared free list into magazine, mag.action_lock must be locked
+   */
+  void refill_magazine(magazine_t &mag) LIBCOPP_MACRO_NOEXCEPT {
 #if !defined(LIBCOPP_DISABLE_ATOMIC_LOCK) || !(LIBCOPP_DISABLE_ATOMIC_LOCK)
     LIBCOPP_COPP_NAMESPACE_ID::util::lock::lock_holder<LIBCOPP_COPP_NAMESPACE_ID::util::lock::spin_lock> lock_guard(
         action_lock_);
 #endif
+    free_node_t *tail = nullptr;
+    for (size_t left = get_magazine_batch_size();
+         left > 0 && (nullptr != free_list_head_ || nullptr != trimmed_list_head_); --left) {
+      free_node_t *node = pop_free_node();
 
-    limits_.free_stack_size = 0;
-    limits_.free_stack_number = 0;
+      // used limit
+      ++limits_.used_stack_number;
+      limits_.used_stack_size += node->ctx.size;
 
-    for (typename std::list<stack_context>::iterator iter = free_list_.begin(); iter != free_list_.end(); ++iter) {
-      alloc_.deallocate(*iter);
+      // keep FILO order of the shared free list
+      node->next = nullptr;
+      if (nullptr == tail) {
+        mag.head = node;
+      } else {
+        tail->next = node;
+      }
+      tail = node;
+
+      ++mag.stack_number;
+      mag.stack_size += node->ctx.size;
     }
+  }
 
-    LIBCOPP_UTIL_LOCK_ATOMIC_THREAD_FENCE(LIBCOPP_COPP_NAMESPACE_ID::util::lock::memory_order_release);
+  /**
+   * @brief move stacks from magazine back to shared free list, the most recently used keep_number stacks are kept
+   */
+  void flush_magazine(magazine_t &mag, size_t keep_number) LIBCOPP_MACRO_NOEXCEPT {
+    free_node_t *flush_head = nullptr;
+    free_node_t *flush_tail = nullptr;
+    size_t flush_number = 0;
+    size_t flush_size = 0;
+    {
+#if !defined(LIBCOPP_DISABLE_ATOMIC_LOCK) || !(LIBCOPP_DISABLE_ATOMIC_LOCK)
+      LIBCOPP_COPP_NAMESPACE_ID::util::lock::lock_holder<LIBCOPP_COPP_NAMESPACE_ID::util::lock::spin_lock> lock_guard(
+          mag.action_lock);
+#endif
+      if (mag.stack_number <= keep_number) {
+        return;
+      }
+
+      if (0 == keep_number) {
+        flush_head = mag.head;
+        mag.head = nullptr;
+      } else {
+        free_node_t *last_keep = mag.head;
+        for (size_t i = keep_number; nullptr != last_keep && i > 1; --i) {
+          last_keep = last_keep->next;
+        }
+        if (nullptr != last_keep) {
+          flush_head = last_keep->next;
+          last_keep->next = nullptr;
+        }
+      }
+
+      for (free_node_t *node = flush_head; nullptr != node; node = node->next) {
+        flush_tail = node;
+        ++flush_number;
+        flush_size += node->ctx.size;
+      }
+      mag.stack_number = mag.stack_number >= flush_number ? mag.stack_number - flush_number : 0;
+      mag.stack_size = mag.stack_size >= flush_size ? mag.stack_size - flush_size : 0;
+    }
+
+    if (nullptr == flush_head) {
+      return;
+    }
+
+#if !defined(LIBCOPP_DISABLE_ATOMIC_LOCK) || !(LIBCOPP_DISABLE_ATOMIC_LOCK)
+    LIBCOPP_COPP_NAMESPACE_ID::util::lock::lock_holder<LIBCOPP_COPP_NAMESPACE_ID::util::lock::spin_lock> lock_guard(
+        action_lock_);
+#endif
+    limits_.used_stack_number = limits_.used_stack_number >= flush_number ? limits_.used_stack_number - flush_number : 0;
+    limits_.used_stack_size = limits_.used_stack_size >= flush_size ? limits_.used_stack_size - flush_size : 0;
+
+    // stacks in magazine are hotter than the shared ones, put them on the front
+    flush_tail->next = free_list_head_;
+    free_list_head_ = flush_head;
+    limits_.free_stack_number += flush_number;
+    limits_.free_stack_size += flush_size;
   }
 
  private:
@@ -310,8 +988,19 @@ class LIBCOPP_COPP_API_HEAD_ONLY stack_pool {
   configure_t conf_;
   allocator_type alloc_;
 #if !defined(LIBCOPP_DISABLE_ATOMIC_LOCK) || !(LIBCOPP_DISABLE_ATOMIC_LOCK)
-  LIBCOPP_COPP_NAMESPACE_ID::util::lock::spin_lock action_lock_;
+  mutable LIBCOPP_COPP_NAMESPACE_ID::util::lock::spin_lock action_lock_;
+#endif
+  free_node_t *free_list_head_;    /** intrusive FILO free list, nodes are stored in the cached stacks **/
+  free_node_t *trimmed_list_head_; /** cached stacks whose physical pages are returned to system by gc() **/
+  magazine_t *magazines_;          /** per-thread stack caches **/
+
+  // snapshot of conf_.stack_size + conf_.stack_offset for the magazine path
+  LIBCOPP_COPP_NAMESPACE_ID::util::lock::atomic_int_type<size_t> magazine_full_stack_size_;
+
+  watermark_stat_t watermark_stat_;
+  LIBCOPP_COPP_NAMESPACE_ID::util::lock::atomic_int_type<size_t> watermark_sample_counter_;
+#if !defined(LIBCOPP_DISABLE_ATOMIC_LOCK) || !(LIBCOPP_DISABLE_ATOMIC_LOCK)
+  mutable LIBCOPP_COPP_NAMESPACE_ID::util::lock::spin_lock watermark_lock_;
 #endif
-  std::list<stack_context> free_list_;
 };
 LIBCOPP_COPP_NAMESPACE_END
@@ -0,0 +1,256 @@
+// Copyright 2023 owent
+
+#pragma once
+
+#include <libcopp/utils/config/libcopp_build_features.h>
+
+#include <libcopp/utils/features.h>
+
+#include <libcopp/stack/stack_context.h>
+#include <libcopp/stack/stack_pool.h>
+#include <libcopp/stack/stack_traits.h>
+
+// clang-format off
+#include <libcopp/utils/config/stl_include_prefix.h>  // NOLINT(build/include_order)
+// clang-format on
+#include <assert.h>
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <vector>
+// clang-format off
+#include <libcopp/utils/config/stl_include_suffix.h>  // NOLINT(build/include_order)
+// clang-format on
+
+LIBCOPP_COPP_NAMESPACE_BEGIN
+/**
+ * @brief stack pool with multiple size classes
+ * Every size class is a stack_pool with its own limits and GC, a request of N bytes is served by the smallest size
+ * class which is greater or equal than N. Requests bigger than the largest size class are served by the origin
+ * allocator directly and will not be cached.
+ */
+template <typename TAlloc>
+class LIBCOPP_COPP_API_HEAD_ONLY stack_size_class_pool {
+ public:
+  using allocator_type = TAlloc;
+  using class_pool_type = stack_pool<TAlloc>;
+  using class_pool_ptr_type = typename class_pool_type::ptr_type;
+  using ptr_type = std::shared_ptr<stack_size_class_pool<TAlloc> >;
+  using limit_t = typename class_pool_type::limit_t;
+  using watermark_stat_t = typename class_pool_type::watermark_stat_t;
+
+ private:
+  struct constructor_delegator {};
+
+  stack_size_class_pool() = delete;
+  stack_size_class_pool(const stack_size_class_pool &) = delete;
+
+ public:
+  static ptr_type create() { return std::make_shared<stack_size_class_pool>(constructor_delegator()); }
+
+  stack_size_class_pool(constructor_delegator) {}
+  ~stack_size_class_pool() { clear(); }
+
+  /**
+   * @brief set size classes, all cached stacks in old size classes will be released
+   * @param class_sizes stack size of every size class, will be rounded to page size, sorted and deduplicated
+   * @note This function is not thread-safe, it should be called before any allocate().
+   */
+  void set_size_classes(const std::vector<size_t> &class_sizes) {
+    std::vector<size_t> sizes;
+    sizes.reserve(class_sizes.size());
+    for (size_t i = 0; i < class_sizes.size(); ++i) {
+      if (0 == class_sizes[i]) {
+        continue;
+      }
+
+      if (class_sizes[i] <= LIBCOPP_COPP_NAMESPACE_ID::stack_traits::minimum_size()) {
+        sizes.push_back(LIBCOPP_COPP_NAMESPACE_ID::stack_traits::minimum_size());
+      } else {
+        sizes.push_back(LIBCOPP_COPP_NAMESPACE_ID::stack_traits::round_to_page_size(class_sizes[i]));
+      }
+    }
+    std::sort(sizes.begin(), sizes.end());
+    sizes.erase(std::unique(sizes.begin(), sizes.end()), sizes.end());
+
+    clear();
+    class_sizes_.clear();
+    class_pools_.clear();
+
+    class_sizes_.reserve(sizes.size());
+    class_pools_.reserve(sizes.size());
+    for (size_t i = 0; i < sizes.size(); ++i) {
+      class_pool_ptr_type pool = class_pool_type::create();
+      if (!pool) {
+        continue;
+      }
+      class_sizes_.push_back(pool->set_stack_size(sizes[i]));
+      class_pools_.push_back(pool);
+    }
+  }
+
+  /**
+   * @brief set power-of-two size classes, min_size, 2*min_size, 4*min_size, ..., until greater or equal to max_size
+   * @param min_size stack size of the smallest size class
+   * @param max_size stack size of the largest size class
+   * @note This function is not thread-safe, it should be called before any allocate().
+   */
+  void set_power_of_two_size_classes(size_t min_size, size_t max_size) {
+    std::vector<size_t> sizes;
+    if (min_size < LIBCOPP_COPP_NAMESPACE_ID::stack_traits::minimum_size()) {
+      min_size = LIBCOPP_COPP_NAMESPACE_ID::stack_traits::minimum_size();
+    }
+
+    for (size_t sz = min_size; sz > 0; sz <<= 1) {
+      sizes.push_back(sz);
+      if (sz >= max_size) {
+        break;
+      }
+    }
+
+    set_size_classes(sizes);
+  }
+
+  inline size_t get_size_class_number() const LIBCOPP_MACRO_NOEXCEPT { return class_pools_.size(); }
+
+  /**
+   * @brief get the stack_pool of a size class, it can be used to set per-class limits and GC options
+   * @param idx index of size class, size classes are sorted by stack size
+   * @return stack pool of this size class or empty pointer
+   */
+  inline class_pool_ptr_type get_size_class(size_t idx) const LIBCOPP_MACRO_NOEXCEPT {
+    if (idx >= class_pools_.size()) {
+      return class_pool_ptr_type();
+    }
+
+    return class_pools_[idx];
+  }
+
+  /**
+   * @brief find the smallest size class which can hold a stack of size bytes
+   * @param size stack size
+   * @return index of size class or get_size_class_number() if not found
+   */
+  inline size_t find_size_class(size_t size) const LIBCOPP_MACRO_NOEXCEPT {
+    return static_cast<size_t>(std::lower_bound(class_sizes_.begin(), class_sizes_.end(), size) -
+                               class_sizes_.begin());
+  }
+
+  inline allocator_type &get_origin_allocator() LIBCOPP_MACRO_NOEXCEPT { return alloc_; }
+  inline const allocator_type &get_origin_allocator() const LIBCOPP_MACRO_NOEXCEPT { return alloc_; }
+
+  /**
+   * @brief get used/free stack number and size of all size classes
+   * @note stacks which are bigger than the largest size class are not counted
+   */
+  limit_t get_limit() const {
+    limit_t ret;
+    memset(&ret, 0, sizeof(ret));
+    for (size_t i = 0; i < class_pools_.size(); ++i) {
+      limit_t class_limit = class_pools_[i]->get_limit();
+      ret.used_stack_number += class_limit.used_stack_number;
+      ret.used_stack_size += class_limit.used_stack_size;
+      ret.free_stack_number += class_limit.free_stack_number;
+      ret.free_stack_size += class_limit.free_stack_size;
+      ret.trimmed_stack_number += class_limit.trimmed_stack_number;
+      ret.trimmed_stack_size += class_limit.trimmed_stack_size;
+    }
+    return ret;
+  }
+
+  /**
+   * @brief get histogram of the high-water marks of all size classes
+   * @note the watermark mode of every size class should be set by get_size_class(idx)
+   */
+  watermark_stat_t get_stack_watermark_stat() const {
+    watermark_stat_t ret;
+    memset(&ret, 0, sizeof(ret));
+    for (size_t i = 0; i < class_pools_.size(); ++i) {
+      stack_watermark::merge(ret, class_pools_[i]->get_stack_watermark_stat());
+    }
+    return ret;
+  }
+
+  // actions
+
+  /**
+   * allocate memory and attach to stack context [standard function]
+   * @param ctx stack context
+   * @param size stack size, the smallest size class which can hold it will be used
+   */
+  void allocate(stack_context &ctx, size_t size) LIBCOPP_MACRO_NOEXCEPT {
+    if (0 == size) {
+      size = LIBCOPP_COPP_NAMESPACE_ID::stack_traits::default_size();
+    }
+
+    size_t idx = find_size_class(size);
+    COPP_LIKELY_IF (idx < class_pools_.size()) {
+      class_pools_[idx]->allocate(ctx);
+      return;
+    }
+
+    // too large for all size classes
+    alloc_.allocate(ctx, size);
+  }
+
+  /**
+   * allocate memory with default stack size and attach to stack context [standard function]
+   * @param ctx stack context
+   */
+  inline void allocate(stack_context &ctx) LIBCOPP_MACRO_NOEXCEPT { allocate(ctx, 0); }
+
+  /**
+   * deallocate memory from stack context [standard function]
+   * @param ctx stack context
+   */
+  void deallocate(stack_context &ctx) LIBCOPP_MACRO_NOEXCEPT {
+    assert(ctx.sp && ctx.size > 0);
+
+    // the real size of a stack may be a little bigger than the size class, because of guard pages and etc. So it may
+    // be equal to or greater than a bigger size class, smaller size classes must be checked first.
+    size_t idx = find_size_class(ctx.size);
+    for (size_t i = idx; i > 0; --i) {
+      size_t real_size = class_pools_[i - 1]->get_stack_size() + class_pools_[i - 1]->get_stack_size_offset();
+      COPP_LIKELY_IF (real_size == ctx.size) {
+        class_pools_[i - 1]->deallocate(ctx);
+        return;
+      }
+
+      if (real_size < ctx.size) {
+        break;
+      }
+    }
+
+    if (idx < class_pools_.size() &&
+        class_pools_[idx]->get_stack_size() + class_pools_[idx]->get_stack_size_offset() == ctx.size) {
+      class_pools_[idx]->deallocate(ctx);
+      return;
+    }
+
+    alloc_.deallocate(ctx);
+  }
+
+  /**
+   * @brief run GC of all size classes
+   * @return released stack number
+   */
+  size_t gc() {
+    size_t ret = 0;
+    for (size_t i = 0; i < class_pools_.size(); ++i) {
+      ret += class_pools_[i]->gc();
+    }
+    return ret;
+  }
+
+  void clear() {
+    for (size_t i = 0; i < class_pools_.size(); ++i) {
+      class_pools_[i]->clear();
+    }
+  }
+
+ private:
+  std::vector<size_t> class_sizes_;
+  std::vector<class_pool_ptr_type> class_pools_;
+  allocator_type alloc_;
+};
+LIBCOPP_COPP_NAMESPACE_END
@@ -0,0 +1,154 @@
+// Copyright 2023 owent
+
+#pragma once
+
+#include <libcopp/utils/config/libcopp_build_features.h>
+
+#include <libcopp/utils/features.h>
+
+#include <libcopp/stack/stack_traits.h>
+#include <libcopp/stack/stack_watermark.h>
+
+// clang-format off
+#include <libcopp/utils/config/stl_include_prefix.h>  // NOLINT(build/include_order)
+// clang-format on
+#include <memory>
+// clang-format off
+#include <libcopp/utils/config/stl_include_suffix.h>  // NOLINT(build/include_order)
+// clang-format on
+
+LIBCOPP_COPP_NAMESPACE_BEGIN
+/**
+ * @brief recommend stack size of a stack pool by the observed high-water marks
+ * The pool should enable watermark by stack_pool::set_stack_watermark_mode(). recommend() only reports the new size,
+ * and apply() must be called explicitly to use it, so it can be reviewed before rollout.
+ * @note recommended size = min(upper bound of percentile bucket, max used size) + safety margin, and then limited by
+ *       [min_stack_size, max_stack_size]
+ */
+template <typename TPool>
+class LIBCOPP_COPP_API_HEAD_ONLY stack_size_policy {
+ public:
+  using pool_type = TPool;
+  using pool_ptr_type = std::shared_ptr<pool_type>;
+  using watermark_stat_t = stack_watermark::stat_type;
+
+  struct configure_t {
+    double percentile;
+    size_t safety_margin;
+    size_t min_stack_size;
+    size_t max_stack_size;
+    size_t min_sample_number;
+  };
+
+ public:
+  explicit stack_size_policy(const pool_ptr_type &pool) : pool_(pool) {
+    conf_.percentile = 0.999;
+    conf_.safety_margin = 16 * 1024;
+    conf_.min_stack_size = 0;
+    conf_.max_stack_size = 0;
+    conf_.min_sample_number = 1000;
+  }
+
+  inline const pool_ptr_type &get_pool() const LIBCOPP_MACRO_NOEXCEPT { return pool_; }
+
+  /**
+   * @brief set percentile of samples which should fit in the recommended size, 0.999 by default
+   */
+  inline void set_percentile(double v) LIBCOPP_MACRO_NOEXCEPT { conf_.percentile = v; }
+  inline double get_percentile() const LIBCOPP_MACRO_NOEXCEPT { return conf_.percentile; }
+
+  /**
+   * @brief set bytes added to the observed usage, 16KB by default
+   */
+  inline void set_safety_margin(size_t sz) LIBCOPP_MACRO_NOEXCEPT { conf_.safety_margin = sz; }
+  inline size_t get_safety_margin() const LIBCOPP_MACRO_NOEXCEPT { return conf_.safety_margin; }
+
+  inline void set_min_stack_size(size_t sz) LIBCOPP_MACRO_NOEXCEPT { conf_.min_stack_size = sz; }
+  inline size_t get_min_stack_size() const LIBCOPP_MACRO_NOEXCEPT { return conf_.min_stack_size; }
+  inline void set_max_stack_size(size_t sz) LIBCOPP_MACRO_NOEXCEPT { conf_.max_stack_size = sz; }
+  inline size_t get_max_stack_size() const LIBCOPP_MACRO_NOEXCEPT { return conf_.max_stack_size; }
+
+  /**
+   * @brief set how many samples are required before recommending, 1000 by default
+   */
+  inline void set_min_sample_number(size_t n) LIBCOPP_MACRO_NOEXCEPT { conf_.min_sample_number = n; }
+  inline size_t get_min_sample_number() const LIBCOPP_MACRO_NOEXCEPT { return conf_.min_sample_number; }
+
+  /**
+   * @brief get recommended stack size by the watermark stat of pool
+   * @return recommended stack size, or 0 if there is not enough samples
+   */
+  size_t recommend() const {
+    if (!pool_) {
+      return 0;
+    }
+
+    return recommend(pool_->get_stack_watermark_stat());
+  }
+
+  /**
+   * @brief get recommended stack size by a watermark stat
+   * @return recommended stack size, or 0 if there is not enough samples
+   */
+  size_t recommend(const watermark_stat_t &stat) const LIBCOPP_MACRO_NOEXCEPT {
+    if (0 == stat.sample_number || stat.sample_number < conf_.min_sample_number) {
+      return 0;
+    }
+
+    double percentile = conf_.percentile;
+    if (percentile > 1.0) {
+      percentile = 1.0;
+    }
+    size_t expect_number = static_cast<size_t>(static_cast<double>(stat.sample_number) * percentile + 0.5);
+    if (expect_number > stat.sample_number) {
+      expect_number = stat.sample_number;
+    }
+
+    size_t used_size = stat.max_used_size;
+    size_t counted = 0;
+    for (size_t i = 0; i < watermark_stat_t::HISTOGRAM_SIZE; ++i) {
+      counted += stat.histogram[i];
+      if (counted >= expect_number) {
+        size_t upper_bound = stack_watermark::get_histogram_upper_bound(i);
+        if (upper_bound < used_size) {
+          used_size = upper_bound;
+        }
+        break;
+      }
+    }
+
+    size_t ret = used_size + conf_.safety_margin;
+    if (0 != conf_.min_stack_size && ret < conf_.min_stack_size) {
+      ret = conf_.min_stack_size;
+    }
+    if (0 != conf_.max_stack_size && ret > conf_.max_stack_size) {
+      ret = conf_.max_stack_size;
+    }
+
+    if (ret <= LIBCOPP_COPP_NAMESPACE_ID::stack_traits::minimum_size()) {
+      return LIBCOPP_COPP_NAMESPACE_ID::stack_traits::minimum_size();
+    }
+    return LIBCOPP_COPP_NAMESPACE_ID::stack_traits::round_to_page_size(ret);
+  }
+
+  /**
+   * @brief apply the recommended stack size to pool and reset its watermark stat
+   * @note Cached stacks are not released at once, the pool switches to the new size gradually.
+   * @return the new stack size, or 0 if there is not enough samples
+   */
+  size_t apply() {
+    size_t sz = recommend();
+    if (0 == sz) {
+      return 0;
+    }
+
+    sz = pool_->update_stack_size(sz);
+    pool_->reset_stack_watermark_stat();
+    return sz;
+  }
+
+ private:
+  pool_ptr_type pool_;
+  configure_t conf_;
+};
+LIBCOPP_COPP_NAMESPACE_END
@@ -0,0 +1,112 @@
+// Copyright 2023 owent
+
+#pragma once
+
+#include <libcopp/utils/config/libcopp_build_features.h>
+
+#include <libcopp/utils/features.h>
+
+#include <libcopp/stack/stack_context.h>
+
+// clang-format off
+#include <libcopp/utils/config/stl_include_prefix.h>  // NOLINT(build/include_order)
+// clang-format on
+#include <cstddef>
+// clang-format off
+#include <libcopp/utils/config/stl_include_suffix.h>  // NOLINT(build/include_order)
+// clang-format on
+
+#ifdef COPP_HAS_ABI_HEADERS
+#  include COPP_ABI_PREFIX
+#endif
+
+LIBCOPP_COPP_NAMESPACE_BEGIN
+/**
+ * @brief measure the high-water mark of stacks
+ * The lowest page of a stack is always skipped because it may be a guard page, so the max measurable size is
+ * ctx.size - stack_traits::page_size().
+ */
+struct stack_watermark {
+  struct LIBCOPP_COPP_API mode_type {
+    enum type {
+      EN_SWM_NONE = 0,      //!< disabled
+      EN_SWM_PAINT = 1,     //!< paint stacks when allocated and scan the pattern when released, it's accurate
+      EN_SWM_RESIDENT = 2,  //!< check resident pages by mincore when released, page granularity and posix only
+    };
+  };
+
+  /**
+   * @brief histogram of stack high-water marks
+   * bucket 0 counts usage less or equal than 1KB, bucket N counts usage in (2^(N-1)KB, 2^N KB], the last bucket also
+   * counts all larger usage.
+   */
+  struct LIBCOPP_COPP_API stat_type {
+    enum { HISTOGRAM_SIZE = 24 };
+
+    size_t sample_number;
+    size_t max_used_size;
+    size_t histogram[HISTOGRAM_SIZE];
+  };
+
+  /**
+   * @brief fill the stack with paint pattern
+   * @param ctx stack context
+   * @param keep_size bytes at the top of stack which will not be painted
+   * @note All pages of the stack will be touched and become resident. The painted state is recorded in
+   *       ctx.watermark_painted instead of the stack, so any value written to the bottom mark is seen as clobbered.
+   */
+  static LIBCOPP_COPP_API void paint(stack_context &ctx, size_t keep_size = 0) LIBCOPP_MACRO_NOEXCEPT;
+
+  /**
+   * @brief clear the painted state of a stack, so stale pattern will not be measured again
+   * @param ctx stack context
+   * @note Only ctx.watermark_painted is cleared, the stack memory is not touched.
+   */
+  static LIBCOPP_COPP_API void unpaint(stack_context &ctx) LIBCOPP_MACRO_NOEXCEPT;
+
+  /**
+   * @brief check if the stack is painted and the bottom mark is not overwritten
+   * @param ctx stack context
+   */
+  static LIBCOPP_COPP_API bool is_painted(const stack_context &ctx) LIBCOPP_MACRO_NOEXCEPT;
+
+  /**
+   * @brief scan the paint pattern from the bottom of stack
+   * @param ctx stack context
+   * @return used bytes from ctx.sp, 0 if the stack is not painted, or ctx.size if the stack is painted but the mark at
+   *         the bottom is overwritten, which means the whole stack is used
+   */
+  static LIBCOPP_COPP_API size_t measure(const stack_context &ctx) LIBCOPP_MACRO_NOEXCEPT;
+
+  /**
+   * @brief measure used size by resident pages
+   * @param ctx stack context
+   * @return bytes from ctx.sp to the lowest resident page, or 0 if not supported
+   * @note Pages of a reused stack keep resident, so it's the max usage since the stack is allocated or trimmed.
+   */
+  static LIBCOPP_COPP_API size_t measure_resident(const stack_context &ctx) LIBCOPP_MACRO_NOEXCEPT;
+
+  /**
+   * @brief add a sample into stat
+   * @param stat stat
+   * @param used_size used bytes of stack, 0 will be ignored
+   */
+  static LIBCOPP_COPP_API void add_sample(stat_type &stat, size_t used_size) LIBCOPP_MACRO_NOEXCEPT;
+
+  /**
+   * @brief merge samples of another stat
+   */
+  static LIBCOPP_COPP_API void merge(stat_type &stat, const stat_type &other) LIBCOPP_MACRO_NOEXCEPT;
+
+  static LIBCOPP_COPP_API size_t get_histogram_index(size_t used_size) LIBCOPP_MACRO_NOEXCEPT;
+
+  /**
+   * @brief get max used size of a histogram bucket
+   */
+  static LIBCOPP_COPP_API size_t get_histogram_upper_bound(size_t idx) LIBCOPP_MACRO_NOEXCEPT;
+};
+LIBCOPP_COPP_NAMESPACE_END
+
+#ifdef COPP_HAS_ABI_HEADERS
+#  include COPP_ABI_SUFFIX
+#endif
@@ -40,5 +40,6 @@ enum copp_error_code {
   COPP_EC_TASK_NOT_IN_ACTION = -3004,               //!< COPP_EC_TASK_NOT_IN_ACTION
   COPP_EC_TASK_ALREADY_IN_ANOTHER_MANAGER = -3005,  //!< COPP_EC_TASK_ALREADY_IN_ANOTHER_MANAGER
   COPP_EC_TASK_IS_KILLED = -3006,                   //!< COPP_EC_TASK_IS_KILLED
+  COPP_EC_TASK_IS_AWAITING = -3007,                 //!< COPP_EC_TASK_IS_AWAITING
 };
 LIBCOPP_COPP_NAMESPACE_END
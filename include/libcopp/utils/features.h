@@ -119,6 +119,24 @@
 
 // ---------------- branch prediction information ----------------
 
+// ================ prefetch ================
+#ifndef COPP_MACRO_CACHE_LINE_SIZE
+#  define COPP_MACRO_CACHE_LINE_SIZE 64
+#endif
+
+// prefetch for writing, into all levels of cache
+#if !defined(COPP_PREFETCH) && (defined(__clang__) || defined(__GNUC__))
+#  define COPP_PREFETCH(addr) __builtin_prefetch((addr), 1, 3)
+#endif
+#if !defined(COPP_PREFETCH) && defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+#  include <xmmintrin.h>
+#  define COPP_PREFETCH(addr) _mm_prefetch(reinterpret_cast<const char *>(addr), _MM_HINT_T0)
+#endif
+#ifndef COPP_PREFETCH
+#  define COPP_PREFETCH(addr)
+#endif
+// ---------------- prefetch ----------------
+
 #if !defined(COPP_NORETURN_ATTR) && defined(__has_cpp_attribute)
 #  if __has_cpp_attribute(noreturn)
 #    define COPP_NORETURN_ATTR [[noreturn]]
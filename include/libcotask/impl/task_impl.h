@@ -4,6 +4,7 @@
 
 #include <libcopp/utils/config/libcopp_build_features.h>
 
+#include <libcopp/coroutine/coroutine_context_base.h>
 #include <libcopp/utils/atomic_int_type.h>
 
 #include <libcopp/utils/uint64_id_allocator.h>
@@ -19,6 +20,7 @@
 #include <stdint.h>
 #include <list>
 #include <memory>
+#include <utility>
 // clang-format off
 #include <libcopp/utils/config/stl_include_suffix.h>  // NOLINT(build/include_order)
 // clang-format on
@@ -37,6 +39,46 @@ enum EN_TASK_STATUS {
 
 namespace impl {
 
+#if defined(LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR) && LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR
+/**
+ * @brief collect unhandled exceptions of tasks
+ * Exceptions are appended into the list given by caller. If there is no list, only the first one is kept inline, so
+ * APIs which just rethrow the first unhandled exception need not create a list.
+ */
+class UTIL_SYMBOL_VISIBLE task_exception_sink {
+ public:
+  task_exception_sink() LIBCOPP_MACRO_NOEXCEPT : output_(nullptr) {}
+  explicit task_exception_sink(std::list<std::exception_ptr> &output) LIBCOPP_MACRO_NOEXCEPT : output_(&output) {}
+
+  UTIL_FORCEINLINE void push(std::exception_ptr &&eptr) {
+    if (nullptr != output_) {
+      output_->emplace_back(std::move(eptr));
+    } else if (!first_) {
+      first_ = std::move(eptr);
+    }
+  }
+
+  /**
+   * @brief rethrow the first unhandled exception which is kept inline
+   */
+  UTIL_FORCEINLINE void maybe_rethrow() {
+    COPP_UNLIKELY_IF (first_) {
+      std::exception_ptr eptr;
+      std::swap(eptr, first_);
+      std::rethrow_exception(eptr);
+    }
+  }
+
+ private:
+  task_exception_sink(const task_exception_sink &) = delete;
+  task_exception_sink &operator=(const task_exception_sink &) = delete;
+
+ private:
+  std::list<std::exception_ptr> *output_;
+  std::exception_ptr first_;
+};
+#endif
+
 class UTIL_SYMBOL_VISIBLE task_impl {
  public:
   using id_type = LIBCOPP_COPP_NAMESPACE_ID::util::uint64_id_allocator::value_type;
@@ -121,7 +163,19 @@ class UTIL_SYMBOL_VISIBLE task_impl {
    * get current running task
    * @return current running task or empty pointer
    */
+#if defined(LIBCOPP_MACRO_ENABLE_INLINE_THIS_COROUTINE) && LIBCOPP_MACRO_ENABLE_INLINE_THIS_COROUTINE
+  UTIL_FORCEINLINE static task_impl *this_task() {
+    LIBCOPP_COPP_NAMESPACE_ID::coroutine_context_base *this_co =
+        LIBCOPP_COPP_NAMESPACE_ID::detail::gt_current_coroutine;
+    if (nullptr == this_co || false == this_co->check_flags(ext_coroutine_flag_t::EN_ECFT_COTASK)) {
+      return nullptr;
+    }
+
+    return *reinterpret_cast<task_impl **>(this_co->get_private_buffer());
+  }
+#else
   static LIBCOPP_COTASK_API task_impl *this_task();
+#endif
 
   /**
    * @brief get raw action pointer
@@ -138,7 +192,7 @@ class UTIL_SYMBOL_VISIBLE task_impl {
   LIBCOPP_COTASK_API bool _cas_status(EN_TASK_STATUS &expected, EN_TASK_STATUS desired);
 
 #if defined(LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR) && LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR
-  LIBCOPP_COTASK_API int _notify_finished(std::list<std::exception_ptr> &unhandled, void *priv_data);
+  LIBCOPP_COTASK_API int _notify_finished(task_exception_sink &unhandled, void *priv_data);
 #else
   LIBCOPP_COTASK_API int _notify_finished(void *priv_data);
 #endif
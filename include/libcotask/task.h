@@ -10,6 +10,7 @@
 
 #include <libcopp/stack/stack_traits.h>
 #include <libcopp/utils/errno.h>
+#include <libcopp/utils/gsl/span.h>
 #include <libcotask/task_macros.h>
 #include <libcotask/this_task.h>
 
@@ -75,7 +76,8 @@ class LIBCOPP_COTASK_API_HEAD_ONLY task : public impl::task_impl {
 #if defined(LIBCOTASK_MACRO_AUTO_CLEANUP_MANAGER) && LIBCOTASK_MACRO_AUTO_CLEANUP_MANAGER
         ,
         binding_manager_ptr_(nullptr),
-        binding_manager_fn_(nullptr)
+        binding_manager_fn_(nullptr),
+        binding_manager_key_(0)
 #endif
   {
   }
@@ -320,7 +322,7 @@ class LIBCOPP_COTASK_API_HEAD_ONLY task : public impl::task_impl {
    * @note please not to make tasks refer to each other. [it will lead to memory leak]
    * @note [don't do that] ptr_type a = ..., b = ...; a.await_task(b); b.await_task(a);
    * @param wait_task which stack to wait for
-   * @note we will loop wait and ignore any resume(...) call
+   * @note this task is parked until wait_task finished, resume(...) calls return COPP_EC_TASK_IS_AWAITING
    * @return 0 or error code
    */
   inline int await_task(ptr_type wait_task) {
@@ -337,29 +339,7 @@ class LIBCOPP_COTASK_API_HEAD_ONLY task : public impl::task_impl {
       return LIBCOPP_COPP_NAMESPACE_ID::COPP_EC_TASK_IS_EXITING;
     }
 
-    if (is_exiting()) {
-      return LIBCOPP_COPP_NAMESPACE_ID::COPP_EC_TASK_IS_EXITING;
-    }
-
-    if (this_task() != this) {
-      return LIBCOPP_COPP_NAMESPACE_ID::COPP_EC_TASK_NOT_IN_ACTION;
-    }
-
-    // add to next list failed
-    if (wait_task->next(ptr_type(this)).get() != this) {
-      return LIBCOPP_COPP_NAMESPACE_ID::COPP_EC_TASK_ADD_NEXT_FAILED;
-    }
-
-    int ret = 0;
-    while (!(wait_task->is_exiting() || wait_task->is_completed())) {
-      if (is_exiting()) {
-        return LIBCOPP_COPP_NAMESPACE_ID::COPP_EC_TASK_IS_EXITING;
-      }
-
-      ret = yield();
-    }
-
-    return ret;
+    return await_tasks(LIBCOPP_COPP_NAMESPACE_ID::gsl::span<ptr_type>(&wait_task, 1), false);
   }
 
   template <typename TTask>
@@ -367,6 +347,31 @@ class LIBCOPP_COTASK_API_HEAD_ONLY task : public impl::task_impl {
     return await_task(ptr_type(wait_task));
   }
 
+  /**
+   * @brief park this task until all tasks in wait_tasks finished
+   * @note It's woken up once by the last finished task, resume(...) calls return COPP_EC_TASK_IS_AWAITING before that.
+   * @param wait_tasks tasks to wait for, tasks which are already exiting or completed are skipped
+   * @return 0 or error code
+   */
+  inline int await_all(LIBCOPP_COPP_NAMESPACE_ID::gsl::span<ptr_type> wait_tasks) {
+    return await_tasks(wait_tasks, false);
+  }
+
+  /**
+   * @brief park this task until any task in wait_tasks finished
+   * @note It's woken up once by the first finished task, resume(...) calls return COPP_EC_TASK_IS_AWAITING before that.
+   * @param wait_tasks tasks to wait for, return immediately if any of them is already exiting or completed
+   * @return 0 or error code
+   */
+  inline int await_any(LIBCOPP_COPP_NAMESPACE_ID::gsl::span<ptr_type> wait_tasks) {
+    return await_tasks(wait_tasks, true);
+  }
+
+  /**
+   * @brief if this task is parked by await_task(), await_all() or await_any()
+   */
+  inline bool is_awaiting() const LIBCOPP_MACRO_NOEXCEPT { return 0 != await_pending_.load(); }
+
   /**
    * @brief add task to run when task finished
    * @note please not to make tasks refer to each other. [it will lead to memory leak]
@@ -418,10 +423,10 @@ class LIBCOPP_COTASK_API_HEAD_ONLY task : public impl::task_impl {
       kill(EN_TS_TIMEOUT);
     } else if (status <= EN_TS_CREATED) {
 #if defined(LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR) && LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR
-      std::list<std::exception_ptr> eptrs;
+      impl::task_exception_sink eptrs;
       active_next_tasks(eptrs);
       // next tasks
-      maybe_rethrow(eptrs);
+      eptrs.maybe_rethrow();
 #else
       active_next_tasks();
 #endif
@@ -444,13 +449,23 @@ class LIBCOPP_COTASK_API_HEAD_ONLY task : public impl::task_impl {
 
 #if defined(LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR) && LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR
   int start(void *priv_data, EN_TASK_STATUS expected_status = EN_TS_CREATED) override {
-    std::list<std::exception_ptr> eptrs;
+    impl::task_exception_sink eptrs;
     int ret = start(eptrs, priv_data, expected_status);
-    maybe_rethrow(eptrs);
+    eptrs.maybe_rethrow();
     return ret;
   }
 
+  // Overloads with impl::task_exception_sink are the customization points, all other overloads forward to them.
+  // Subclasses which overrode the std::list overloads must override the sink overloads instead, the std::list
+  // overloads are final so old overrides fail to compile rather than being bypassed.
   virtual int start(std::list<std::exception_ptr> &unhandled, void *priv_data,
+                    EN_TASK_STATUS expected_status = EN_TS_CREATED) LIBCOPP_MACRO_NOEXCEPT final {
+    impl::task_exception_sink sink(unhandled);
+    return start(sink, priv_data, expected_status);
+  }
+
+  // APIs which rethrow exceptions use a sink without list, only the first unhandled exception is kept inline
+  virtual int start(impl::task_exception_sink &unhandled, void *priv_data,
                     EN_TASK_STATUS expected_status = EN_TS_CREATED) LIBCOPP_MACRO_NOEXCEPT {
 #else
   int start(void *priv_data, EN_TASK_STATUS expected_status = EN_TS_CREATED) override {
@@ -459,6 +474,20 @@ class LIBCOPP_COTASK_API_HEAD_ONLY task : public impl::task_impl {
       return LIBCOPP_COPP_NAMESPACE_ID::COPP_EC_NOT_INITED;
     }
 
+    // parked by await_*(), only the last notification of awaited tasks can wake it up
+    COPP_UNLIKELY_IF (0 != await_pending_.load()) {
+      if (priv_data != get_await_notify_token()) {
+        return LIBCOPP_COPP_NAMESPACE_ID::COPP_EC_TASK_IS_AWAITING;
+      }
+
+      if (!consume_await_notification()) {
+        return LIBCOPP_COPP_NAMESPACE_ID::COPP_EC_SUCCESS;
+      }
+    } else COPP_UNLIKELY_IF (priv_data == get_await_notify_token()) {
+      // notification after woken up, by await_any() or an exiting task
+      return LIBCOPP_COPP_NAMESPACE_ID::COPP_EC_SUCCESS;
+    }
+
     EN_TASK_STATUS from_status = expected_status;
 
     do {
@@ -482,7 +511,7 @@ class LIBCOPP_COTASK_API_HEAD_ONLY task : public impl::task_impl {
     std::exception_ptr eptr;
     int ret = coroutine_obj_->start(eptr, priv_data);
     if (eptr) {
-      unhandled.emplace_back(std::move(eptr));
+      unhandled.push(std::move(eptr));
     }
 #else
     int ret = coroutine_obj_->start(priv_data);
@@ -526,10 +555,19 @@ class LIBCOPP_COTASK_API_HEAD_ONLY task : public impl::task_impl {
 
 #if defined(LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR) && LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR
   int resume(void *priv_data, EN_TASK_STATUS expected_status = EN_TS_WAITING) override {
-    return start(priv_data, expected_status);
+    impl::task_exception_sink eptrs;
+    int ret = resume(eptrs, priv_data, expected_status);
+    eptrs.maybe_rethrow();
+    return ret;
   }
 
   virtual int resume(std::list<std::exception_ptr> &unhandled, void *priv_data,
+                     EN_TASK_STATUS expected_status = EN_TS_WAITING) LIBCOPP_MACRO_NOEXCEPT final {
+    impl::task_exception_sink sink(unhandled);
+    return resume(sink, priv_data, expected_status);
+  }
+
+  virtual int resume(impl::task_exception_sink &unhandled, void *priv_data,
                      EN_TASK_STATUS expected_status = EN_TS_WAITING) LIBCOPP_MACRO_NOEXCEPT {
     return start(unhandled, priv_data, expected_status);
   }
@@ -539,6 +577,80 @@ class LIBCOPP_COTASK_API_HEAD_ONLY task : public impl::task_impl {
   }
 #endif
 
+  /**
+   * @brief resume tasks one by one, for round-robin schedulers
+   * @note Task, coroutine and saved frame of the following tasks are prefetched while the current one is running.
+   *       Empty pointers, invalid and finished tasks are skipped without switching into them.
+   * @param tasks tasks to resume
+   * @param priv_data private data, will be passed to runner operator() or return to yield of every task
+   * @return number of tasks which are resumed successfully
+   */
+#if defined(LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR) && LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR
+  static size_t resume_batch(LIBCOPP_COPP_NAMESPACE_ID::gsl::span<ptr_type> tasks, void *priv_data = nullptr) {
+    impl::task_exception_sink eptrs;
+    size_t ret = resume_batch(eptrs, tasks, priv_data);
+    eptrs.maybe_rethrow();
+    return ret;
+  }
+
+  static size_t resume_batch(std::list<std::exception_ptr> &unhandled,
+                             LIBCOPP_COPP_NAMESPACE_ID::gsl::span<ptr_type> tasks,
+                             void *priv_data = nullptr) LIBCOPP_MACRO_NOEXCEPT {
+    impl::task_exception_sink sink(unhandled);
+    return resume_batch(sink, tasks, priv_data);
+  }
+
+  static size_t resume_batch(impl::task_exception_sink &unhandled, LIBCOPP_COPP_NAMESPACE_ID::gsl::span<ptr_type> tasks,
+                             void *priv_data = nullptr) LIBCOPP_MACRO_NOEXCEPT {
+#else
+  static size_t resume_batch(LIBCOPP_COPP_NAMESPACE_ID::gsl::span<ptr_type> tasks, void *priv_data = nullptr) {
+#endif
+    size_t ret = 0;
+    const size_t count = tasks.size();
+    for (size_t i = 0; i < count && i < 3; ++i) {
+      prefetch_object(tasks[i].get(), sizeof(self_type));
+    }
+    for (size_t i = 0; i < count && i < 2; ++i) {
+      if (tasks[i]) {
+        prefetch_object(tasks[i]->coroutine_obj_.get(), sizeof(coroutine_type));
+      }
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+      // task of [i + 3] -> coroutine of [i + 2] -> frame of [i + 1], every step reads what is prefetched before
+      if (i + 3 < count) {
+        prefetch_object(tasks[i + 3].get(), sizeof(self_type));
+      }
+      if (i + 2 < count && tasks[i + 2]) {
+        prefetch_object(tasks[i + 2]->coroutine_obj_.get(), sizeof(coroutine_type));
+      }
+      if (i + 1 < count && tasks[i + 1] && tasks[i + 1]->coroutine_obj_) {
+        prefetch_callee_frame(*tasks[i + 1]->coroutine_obj_, 0);
+      }
+
+      self_type *task_inst = tasks[i].get();
+      COPP_UNLIKELY_IF (nullptr == task_inst) {
+        continue;
+      }
+
+      EN_TASK_STATUS status = task_inst->get_status();
+      COPP_UNLIKELY_IF (status <= EN_TS_INVALID || status >= EN_TS_DONE) {
+        continue;
+      }
+
+#if defined(LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR) && LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR
+      int res = task_inst->resume(unhandled, priv_data, EN_TS_WAITING);
+#else
+      int res = task_inst->resume(priv_data, EN_TS_WAITING);
+#endif
+      if (res >= 0) {
+        ++ret;
+      }
+    }
+
+    return ret;
+  }
+
   int yield(void **priv_data) override {
     if (!coroutine_obj_) {
       return LIBCOPP_COPP_NAMESPACE_ID::COPP_EC_NOT_INITED;
@@ -549,13 +661,18 @@ class LIBCOPP_COTASK_API_HEAD_ONLY task : public impl::task_impl {
 
 #if defined(LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR) && LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR
   int cancel(void *priv_data) override {
-    std::list<std::exception_ptr> eptrs;
+    impl::task_exception_sink eptrs;
     int ret = cancel(eptrs, priv_data);
-    maybe_rethrow(eptrs);
+    eptrs.maybe_rethrow();
     return ret;
   }
 
-  virtual int cancel(std::list<std::exception_ptr> &unhandled, void *priv_data) LIBCOPP_MACRO_NOEXCEPT {
+  virtual int cancel(std::list<std::exception_ptr> &unhandled, void *priv_data) LIBCOPP_MACRO_NOEXCEPT final {
+    impl::task_exception_sink sink(unhandled);
+    return cancel(sink, priv_data);
+  }
+
+  virtual int cancel(impl::task_exception_sink &unhandled, void *priv_data) LIBCOPP_MACRO_NOEXCEPT {
 #else
   int cancel(void *priv_data) override {
 #endif
@@ -582,13 +699,19 @@ class LIBCOPP_COTASK_API_HEAD_ONLY task : public impl::task_impl {
 
 #if defined(LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR) && LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR
   int kill(enum EN_TASK_STATUS status, void *priv_data) override {
-    std::list<std::exception_ptr> eptrs;
+    impl::task_exception_sink eptrs;
     int ret = kill(eptrs, status, priv_data);
-    maybe_rethrow(eptrs);
+    eptrs.maybe_rethrow();
     return ret;
   }
 
   virtual int kill(std::list<std::exception_ptr> &unhandled, enum EN_TASK_STATUS status,
+                   void *priv_data) LIBCOPP_MACRO_NOEXCEPT final {
+    impl::task_exception_sink sink(unhandled);
+    return kill(sink, status, priv_data);
+  }
+
+  virtual int kill(impl::task_exception_sink &unhandled, enum EN_TASK_STATUS status,
                    void *priv_data) LIBCOPP_MACRO_NOEXCEPT {
 #else
   int kill(enum EN_TASK_STATUS status, void *priv_data) override {
@@ -671,32 +794,146 @@ class LIBCOPP_COTASK_API_HEAD_ONLY task : public impl::task_impl {
  private:
   task(const task &) = delete;
 
+  UTIL_FORCEINLINE static void prefetch_object(const void *addr, size_t size) LIBCOPP_MACRO_NOEXCEPT {
+    if (nullptr == addr) {
+      return;
+    }
+
+    for (size_t offset = 0; offset < size; offset += COPP_MACRO_CACHE_LINE_SIZE) {
+      COPP_PREFETCH(reinterpret_cast<const unsigned char *>(addr) + offset);
+    }
+  }
+
+  // coroutine_context and the containers based on it save the frame on callee stack, fibers do not
+  template <class TCO>
+  UTIL_FORCEINLINE static auto prefetch_callee_frame(const TCO &co, int) LIBCOPP_MACRO_NOEXCEPT
+      -> decltype(co.prefetch_callee_frame()) {
+    co.prefetch_callee_frame();
+  }
+
+  template <class TCO>
+  UTIL_FORCEINLINE static void prefetch_callee_frame(const TCO &, long) LIBCOPP_MACRO_NOEXCEPT {}
+
+  // address of await_pending_ is passed as priv_data of start() to tell notifications from other resumes
+  UTIL_FORCEINLINE void *get_await_notify_token() LIBCOPP_MACRO_NOEXCEPT {
+    return reinterpret_cast<void *>(&await_pending_);
+  }
+
+  // return true if it's the notification which should wake up this task
+  bool consume_await_notification() LIBCOPP_MACRO_NOEXCEPT {
+    size_t pending = await_pending_.load();
+    while (pending > 0) {
+      if (await_pending_.compare_exchange_weak(pending, pending - 1)) {
+        return 1 == pending;
+      }
+    }
+
+    return false;
+  }
+
+  int await_tasks(LIBCOPP_COPP_NAMESPACE_ID::gsl::span<ptr_type> wait_tasks, bool wait_any) {
+    if (is_exiting()) {
+      return LIBCOPP_COPP_NAMESPACE_ID::COPP_EC_TASK_IS_EXITING;
+    }
+
+    if (this_task() != this) {
+      return LIBCOPP_COPP_NAMESPACE_ID::COPP_EC_TASK_NOT_IN_ACTION;
+    }
+
+    size_t running_count = 0;
+    for (size_t i = 0; i < wait_tasks.size(); ++i) {
+      if (!wait_tasks[i]) {
+        return LIBCOPP_COPP_NAMESPACE_ID::COPP_EC_ARGS_ERROR;
+      }
+
+      if (this == wait_tasks[i].get()) {
+        return LIBCOPP_COPP_NAMESPACE_ID::COPP_EC_TASK_CAN_NOT_WAIT_SELF;
+      }
+
+      if (!wait_tasks[i]->is_exiting() && !wait_tasks[i]->is_completed()) {
+        ++running_count;
+      }
+    }
+
+    if (0 == running_count || (wait_any && running_count < wait_tasks.size())) {
+      return LIBCOPP_COPP_NAMESPACE_ID::COPP_EC_SUCCESS;
+    }
+
+    // finished tasks resume this task by the token, only the last one needed really switches to it
+    // Tasks may finish after they are counted, so every task is counted first and those which will not notify this
+    // task are consumed later.
+    await_pending_.store(wait_any ? 1 : wait_tasks.size());
+    void *token = get_await_notify_token();
+    size_t finished_count = 0;
+    for (size_t i = 0; i < wait_tasks.size(); ++i) {
+      if (wait_tasks[i]->is_exiting() || wait_tasks[i]->is_completed()) {
+        ++finished_count;
+        continue;
+      }
+
+#if !defined(LIBCOPP_DISABLE_ATOMIC_LOCK) || !(LIBCOPP_DISABLE_ATOMIC_LOCK)
+      LIBCOPP_COPP_NAMESPACE_ID::util::lock::lock_holder<LIBCOPP_COPP_NAMESPACE_ID::util::lock::spin_lock> lock_guard(
+          wait_tasks[i]->inner_action_lock_);
+#endif
+      // next tasks of a finishing task are taken with this lock, check again here or the notification may be lost
+      if (wait_tasks[i]->is_exiting() || wait_tasks[i]->is_completed()) {
+        ++finished_count;
+        continue;
+      }
+      wait_tasks[i]->next_list_.member_list_.push_back(std::make_pair(ptr_type(this), token));
+    }
+
+    // tasks which are already finished will not notify this task, count them as done now
+    for (size_t i = 0; i < finished_count; ++i) {
+      consume_await_notification();
+    }
+
+    int ret = 0;
+    while (0 != await_pending_.load()) {
+      if (is_exiting()) {
+        ret = LIBCOPP_COPP_NAMESPACE_ID::COPP_EC_TASK_IS_EXITING;
+        break;
+      }
+
+      ret = yield();
+    }
+
+    // remove notifications which are not triggered, they hold this task
+    await_pending_.store(0);
+    for (size_t i = 0; i < wait_tasks.size(); ++i) {
+#if !defined(LIBCOPP_DISABLE_ATOMIC_LOCK) || !(LIBCOPP_DISABLE_ATOMIC_LOCK)
+      LIBCOPP_COPP_NAMESPACE_ID::util::lock::lock_holder<LIBCOPP_COPP_NAMESPACE_ID::util::lock::spin_lock> lock_guard(
+          wait_tasks[i]->inner_action_lock_);
+#endif
+      std::list<std::pair<ptr_type, void *> > &member_list = wait_tasks[i]->next_list_.member_list_;
+      for (typename std::list<std::pair<ptr_type, void *> >::iterator iter = member_list.begin();
+           iter != member_list.end();) {
+        if (iter->first.get() == this && iter->second == token) {
+          iter = member_list.erase(iter);
+        } else {
+          ++iter;
+        }
+      }
+    }
+
+    return ret;
+  }
+
+  // the temporary list is only created when there are next tasks, some STL implementations allocate even it's empty
 #if defined(LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR) && LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR
-  void active_next_tasks(std::list<std::exception_ptr> &unhandled) LIBCOPP_MACRO_NOEXCEPT {
+  void run_next_tasks(impl::task_exception_sink &unhandled) LIBCOPP_MACRO_NOEXCEPT {
 #else
-  void active_next_tasks() {
+  void run_next_tasks() {
 #endif
     std::list<std::pair<ptr_type, void *> > next_list;
-#if defined(LIBCOTASK_MACRO_AUTO_CLEANUP_MANAGER) && LIBCOTASK_MACRO_AUTO_CLEANUP_MANAGER
-    void *manager_ptr;
-    void (*manager_fn)(void *, self_type &);
-#endif
-    // first, lock and swap container
     {
 #if !defined(LIBCOPP_DISABLE_ATOMIC_LOCK) || !(LIBCOPP_DISABLE_ATOMIC_LOCK)
       LIBCOPP_COPP_NAMESPACE_ID::util::lock::lock_holder<LIBCOPP_COPP_NAMESPACE_ID::util::lock::spin_lock> lock_guard(
           inner_action_lock_);
 #endif
       next_list.swap(next_list_.member_list_);
-#if defined(LIBCOTASK_MACRO_AUTO_CLEANUP_MANAGER) && LIBCOTASK_MACRO_AUTO_CLEANUP_MANAGER
-      manager_ptr = binding_manager_ptr_;
-      manager_fn = binding_manager_fn_;
-      binding_manager_ptr_ = nullptr;
-      binding_manager_fn_ = nullptr;
-#endif
     }
 
-    // then, do all the pending tasks
     for (typename std::list<std::pair<ptr_type, void *> >::iterator iter = next_list.begin(); iter != next_list.end();
          ++iter) {
       if (!iter->first || EN_TS_INVALID == iter->first->get_status()) {
@@ -715,6 +952,41 @@ class LIBCOPP_COTASK_API_HEAD_ONLY task : public impl::task_impl {
       } else {
         iter->first->resume(iter->second);
       }
+#endif
+    }
+  }
+
+#if defined(LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR) && LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR
+  void active_next_tasks(impl::task_exception_sink &unhandled) LIBCOPP_MACRO_NOEXCEPT {
+#else
+  void active_next_tasks() {
+#endif
+    bool has_next_tasks;
+#if defined(LIBCOTASK_MACRO_AUTO_CLEANUP_MANAGER) && LIBCOTASK_MACRO_AUTO_CLEANUP_MANAGER
+    void *manager_ptr;
+    void (*manager_fn)(void *, self_type &);
+#endif
+    // first, lock and check container
+    {
+#if !defined(LIBCOPP_DISABLE_ATOMIC_LOCK) || !(LIBCOPP_DISABLE_ATOMIC_LOCK)
+      LIBCOPP_COPP_NAMESPACE_ID::util::lock::lock_holder<LIBCOPP_COPP_NAMESPACE_ID::util::lock::spin_lock> lock_guard(
+          inner_action_lock_);
+#endif
+      has_next_tasks = !next_list_.member_list_.empty();
+#if defined(LIBCOTASK_MACRO_AUTO_CLEANUP_MANAGER) && LIBCOTASK_MACRO_AUTO_CLEANUP_MANAGER
+      manager_ptr = binding_manager_ptr_;
+      manager_fn = binding_manager_fn_;
+      binding_manager_ptr_ = nullptr;
+      binding_manager_fn_ = nullptr;
+#endif
+    }
+
+    // then, do all the pending tasks
+    if (has_next_tasks) {
+#if defined(LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR) && LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR
+      run_next_tasks(unhandled);
+#else
+      run_next_tasks();
 #endif
     }
 
@@ -732,10 +1004,12 @@ class LIBCOPP_COTASK_API_HEAD_ONLY task : public impl::task_impl {
 
   int _notify_finished(
 #if defined(LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR) && LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR
-      std::list<std::exception_ptr> &unhandled,
+      impl::task_exception_sink &unhandled,
 #endif
       void *priv_data) LIBCOPP_MACRO_NOEXCEPT {
     // first, make sure coroutine finished.
+    // The status and priv_data are already set before here, and the coroutine must still run to the end of its
+    // runner, so resume_with() can not save any switch and plain resume() is used.
     if (coroutine_obj_ && false == coroutine_obj_->is_finished()) {
       // make sure this task will not be destroyed when running
       while (false == coroutine_obj_->is_finished()) {
@@ -743,7 +1017,7 @@ class LIBCOPP_COTASK_API_HEAD_ONLY task : public impl::task_impl {
         std::exception_ptr eptr;
         coroutine_obj_->resume(eptr, priv_data);
         if (eptr) {
-          unhandled.emplace_back(std::move(eptr));
+          unhandled.push(std::move(eptr));
         }
 #else
         coroutine_obj_->resume(priv_data);
@@ -801,9 +1075,10 @@ class LIBCOPP_COTASK_API_HEAD_ONLY task : public impl::task_impl {
  public:
   class LIBCOPP_COTASK_API_HEAD_ONLY task_manager_helper {
    private:
-    template <class>
+    template <class, class, class>
     friend class LIBCOPP_COTASK_API_HEAD_ONLY task_manager;
-    static bool setup_task_manager(self_type &task_inst, void *manager_ptr, void (*fn)(void *, self_type &)) {
+    static bool setup_task_manager(self_type &task_inst, void *manager_ptr, void (*fn)(void *, self_type &),
+                                   id_type manager_key) {
 #  if !defined(LIBCOPP_DISABLE_ATOMIC_LOCK) || !(LIBCOPP_DISABLE_ATOMIC_LOCK)
       LIBCOPP_COPP_NAMESPACE_ID::util::lock::lock_holder<LIBCOPP_COPP_NAMESPACE_ID::util::lock::spin_lock> lock_guard(
           task_inst.inner_action_lock_);
@@ -814,9 +1089,12 @@ class LIBCOPP_COTASK_API_HEAD_ONLY task : public impl::task_impl {
 
       task_inst.binding_manager_ptr_ = manager_ptr;
       task_inst.binding_manager_fn_ = fn;
+      task_inst.binding_manager_key_ = manager_key;
       return true;
     }
 
+    static id_type get_task_manager_key(const self_type &task_inst) { return task_inst.binding_manager_key_; }
+
     static bool cleanup_task_manager(self_type &task_inst, void *manager_ptr) {
 #  if !defined(LIBCOPP_DISABLE_ATOMIC_LOCK) || !(LIBCOPP_DISABLE_ATOMIC_LOCK)
       LIBCOPP_COPP_NAMESPACE_ID::util::lock::lock_holder<LIBCOPP_COPP_NAMESPACE_ID::util::lock::spin_lock> lock_guard(
@@ -922,6 +1200,15 @@ class LIBCOPP_COTASK_API_HEAD_ONLY task : public impl::task_impl {
   // ============== action information ==============
   void (*action_destroy_fn_)(void *);
 
+  // ============== await information ==============
+#if !defined(LIBCOPP_DISABLE_ATOMIC_LOCK) || !(LIBCOPP_DISABLE_ATOMIC_LOCK)
+  LIBCOPP_COPP_NAMESPACE_ID::util::lock::atomic_int_type<size_t> await_pending_; /** notifications to wake up **/
+#else
+  LIBCOPP_COPP_NAMESPACE_ID::util::lock::atomic_int_type<
+      LIBCOPP_COPP_NAMESPACE_ID::util::lock::unsafe_int_type<size_t> >
+      await_pending_; /** notifications to wake up **/
+#endif
+
 #if !defined(LIBCOPP_DISABLE_ATOMIC_LOCK) || !(LIBCOPP_DISABLE_ATOMIC_LOCK)
   LIBCOPP_COPP_NAMESPACE_ID::util::lock::atomic_int_type<size_t> ref_count_; /** ref_count **/
   LIBCOPP_COPP_NAMESPACE_ID::util::lock::spin_lock inner_action_lock_;
@@ -935,6 +1222,8 @@ class LIBCOPP_COTASK_API_HEAD_ONLY task : public impl::task_impl {
 #if defined(LIBCOTASK_MACRO_AUTO_CLEANUP_MANAGER) && LIBCOTASK_MACRO_AUTO_CLEANUP_MANAGER
   void *binding_manager_ptr_;
   void (*binding_manager_fn_)(void *, self_type &);
+  // id used by the binding manager, it may be different from get_id()
+  id_type binding_manager_key_;
 #endif
 
 #if defined(LIBCOPP_MACRO_ENABLE_STD_COROUTINE) && LIBCOPP_MACRO_ENABLE_STD_COROUTINE
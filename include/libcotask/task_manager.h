@@ -13,9 +13,11 @@
 #include <stdint.h>
 #include <algorithm>
 #include <ctime>
+#include <limits>
 #include <list>
 #include <set>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 #ifdef __cpp_impl_three_way_comparison
@@ -29,141 +31,65 @@
 #include <libcopp/utils/config/stl_include_suffix.h>  // NOLINT(build/include_order)
 // clang-format on
 
+#include "libcopp/utils/gsl/span.h"
 #include "libcotask/task.h"
+#include "libcotask/task_manager_container.h"
+#include "libcotask/task_manager_timer.h"
 #include "libcotask/task_promise.h"
 
 LIBCOPP_COTASK_NAMESPACE_BEGIN
 
 namespace detail {
-struct LIBCOPP_COTASK_API_HEAD_ONLY tickspec_t {
-  time_t tv_sec; /* Seconds.  */
-  int tv_nsec;   /* Nanoseconds.  */
-
-  inline friend bool operator==(const tickspec_t &l, const tickspec_t &r) {
-    return l.tv_sec == r.tv_sec && l.tv_nsec == r.tv_nsec;
-  }
-
-#ifdef __cpp_impl_three_way_comparison
-  inline friend std::strong_ordering operator<=>(const tickspec_t &l, const tickspec_t &r) {
-    return (l.tv_sec != r.tv_sec) ? l.tv_sec <=> r.tv_sec : l.tv_nsec <=> r.tv_nsec;
-  }
-#else
-  inline friend bool operator!=(const tickspec_t &l, const tickspec_t &r) {
-    return l.tv_sec != r.tv_sec || l.tv_nsec != r.tv_nsec;
-  }
-
-  inline friend bool operator<(const tickspec_t &l, const tickspec_t &r) {
-    return (l.tv_sec != r.tv_sec) ? l.tv_sec < r.tv_sec : l.tv_nsec < r.tv_nsec;
-  }
-
-  inline friend bool operator<=(const tickspec_t &l, const tickspec_t &r) {
-    return (l.tv_sec != r.tv_sec) ? l.tv_sec <= r.tv_sec : l.tv_nsec <= r.tv_nsec;
-  }
-
-  inline friend bool operator>(const tickspec_t &l, const tickspec_t &r) {
-    return (l.tv_sec != r.tv_sec) ? l.tv_sec > r.tv_sec : l.tv_nsec > r.tv_nsec;
-  }
-
-  inline friend bool operator>=(const tickspec_t &l, const tickspec_t &r) {
-    return (l.tv_sec != r.tv_sec) ? l.tv_sec >= r.tv_sec : l.tv_nsec >= r.tv_nsec;
-  }
-#endif
-};
-
-template <class TTASK_ID_TYPE>
-struct LIBCOPP_COTASK_API_HEAD_ONLY task_timer_node {
-  tickspec_t expired_time;
-  TTASK_ID_TYPE task_id;
-
-  inline friend bool operator==(const task_timer_node &l, const task_timer_node &r) {
-    return l.expired_time == r.expired_time && l.task_id == r.task_id;
-  }
-
-#ifdef __cpp_impl_three_way_comparison
-  inline friend std::strong_ordering operator<=>(const task_timer_node &l, const task_timer_node &r) {
-    if (l.expired_time != r.expired_time) {
-      return l.expired_time <=> r.expired_time;
-    }
-
-    return l.task_id <=> r.task_id;
-  }
-#else
-  inline friend bool operator!=(const task_timer_node &l, const task_timer_node &r) {
-    return l.expired_time != r.expired_time || l.task_id != r.task_id;
-  }
-
-  inline friend bool operator<(const task_timer_node &l, const task_timer_node &r) {
-    if (l.expired_time != r.expired_time) {
-      return l.expired_time < r.expired_time;
-    }
-
-    return l.task_id < r.task_id;
-  }
-
-  inline friend bool operator<=(const task_timer_node &l, const task_timer_node &r) {
-    if (l.expired_time != r.expired_time) {
-      return l.expired_time <= r.expired_time;
-    }
-
-    return l.task_id <= r.task_id;
-  }
-
-  inline friend bool operator>(const task_timer_node &l, const task_timer_node &r) {
-    if (l.expired_time != r.expired_time) {
-      return l.expired_time > r.expired_time;
-    }
-
-    return l.task_id > r.task_id;
-  }
-
-  inline friend bool operator>=(const task_timer_node &l, const task_timer_node &r) {
-    if (l.expired_time != r.expired_time) {
-      return l.expired_time >= r.expired_time;
-    }
-
-    return l.task_id >= r.task_id;
-  }
-#endif
-};
-
-template <class TTask>
+template <class TTask, class TTIMER = task_timer_set<typename TTask::id_type>>
 struct LIBCOPP_COTASK_API_HEAD_ONLY task_manager_node;
 
-template <class TCO_MACRO>
-struct LIBCOPP_COTASK_API_HEAD_ONLY task_manager_node<task<TCO_MACRO>> {
+template <class TCO_MACRO, class TTIMER>
+struct LIBCOPP_COTASK_API_HEAD_ONLY task_manager_node<task<TCO_MACRO>, TTIMER> {
   using task_ptr_type = typename task<TCO_MACRO>::ptr_type;
 
   task_ptr_type task_;
-  typename std::set<task_timer_node<typename task<TCO_MACRO>::id_type>>::iterator timer_node;
+  typename TTIMER::handle_type timer_node;
 };
 
 #if defined(LIBCOPP_MACRO_ENABLE_STD_COROUTINE) && LIBCOPP_MACRO_ENABLE_STD_COROUTINE
-template <class TVALUE, class TPRIVATE_DATA, class TERROR_TRANSFORM>
-struct LIBCOPP_COTASK_API_HEAD_ONLY task_manager_node<task_future<TVALUE, TPRIVATE_DATA, TERROR_TRANSFORM>> {
+template <class TVALUE, class TPRIVATE_DATA, class TERROR_TRANSFORM, class TTIMER>
+struct LIBCOPP_COTASK_API_HEAD_ONLY task_manager_node<task_future<TVALUE, TPRIVATE_DATA, TERROR_TRANSFORM>, TTIMER> {
   using task_type = task_future<TVALUE, TPRIVATE_DATA, TERROR_TRANSFORM>;
 
   task_type task_;
-  typename std::set<task_timer_node<typename task_type::id_type>>::iterator timer_node;
+  typename TTIMER::handle_type timer_node;
 };
 #endif
 
 }  // namespace detail
 
-template <typename TTask>
+/**
+ * @brief task manager
+ * @note TTIMER is the timer backend, task_timer_set(default) or task_timer_wheel
+ * @note TCONTAINER is the container selector, task_container_unordered_map(default) or task_container_slot_map
+ */
+template <typename TTask, typename TTIMER = task_timer_set<typename TTask::id_type>,
+          typename TCONTAINER = task_container_unordered_map>
 class LIBCOPP_COTASK_API_HEAD_ONLY task_manager;
 
 /**
  * @brief task manager for stackful coroutine task
  */
-template <typename TCO_MACRO>
-class LIBCOPP_COTASK_API_HEAD_ONLY task_manager<task<TCO_MACRO>> {
+template <typename TCO_MACRO, typename TTIMER, typename TCONTAINER>
+class LIBCOPP_COTASK_API_HEAD_ONLY task_manager<task<TCO_MACRO>, TTIMER, TCONTAINER> {
  public:
   using task_type = task<TCO_MACRO>;
-  using container_type = std::unordered_map<typename task_type::id_type, detail::task_manager_node<task_type>>;
+  using timer_type = TTIMER;
+  using node_type = detail::task_manager_node<task_type, timer_type>;
+  using container_type = typename TCONTAINER::template container_type<typename task_type::id_type, node_type>;
   using id_type = typename task_type::id_type;
   using task_ptr_type = typename task_type::ptr_type;
-  using self_type = task_manager<task_type>;
+  using self_type = task_manager<task_type, timer_type, TCONTAINER>;
   using ptr_type = std::shared_ptr<self_type>;
+  // task id and private data of start_batch(...), resume_batch(...) and kill_batch(...)
+  using batch_item_type = std::pair<id_type, void *>;
+  // batch APIs resolve tasks on the stack in chunks of this size
+  enum { BATCH_CHUNK_SIZE = 64 };
 
   struct flag_type {
     enum type {
@@ -183,20 +109,26 @@ class LIBCOPP_COTASK_API_HEAD_ONLY task_manager<task<TCO_MACRO>> {
   using flag_t = flag_type;
 
  private:
+  // flags are read by producers without action_lock_
+#if defined(LIBCOPP_DISABLE_ATOMIC_LOCK) && LIBCOPP_DISABLE_ATOMIC_LOCK
+  using flags_holder_type =
+      LIBCOPP_COPP_NAMESPACE_ID::util::lock::atomic_int_type<LIBCOPP_COPP_NAMESPACE_ID::util::lock::unsafe_int_type<int> >;
+#else
+  using flags_holder_type = LIBCOPP_COPP_NAMESPACE_ID::util::lock::atomic_int_type<int>;
+#endif
+
   struct flag_guard_type {
-    int *data_;
+    flags_holder_type *data_;
     typename flag_type::type flag_;
-    inline flag_guard_type(int *flags, typename flag_type::type v) : data_(flags), flag_(v) {
-      if (nullptr == data_ || (*data_ & flag_)) {
+    inline flag_guard_type(flags_holder_type *flags, typename flag_type::type v) : data_(flags), flag_(v) {
+      if (nullptr == data_ || (data_->fetch_or(flag_) & flag_)) {
         flag_ = flag_type::EN_TM_NONE;
         data_ = nullptr;
-      } else {
-        (*data_) |= flag_;
       }
     }
     inline ~flag_guard_type() {
       if (*this) {
-        (*data_) &= ~flag_;
+        data_->fetch_and(~static_cast<int>(flag_));
       }
     }
 
@@ -204,7 +136,7 @@ class LIBCOPP_COTASK_API_HEAD_ONLY task_manager<task<TCO_MACRO>> {
   };
 
  public:
-  task_manager() : flags_(0) {
+  task_manager() : pending_expire_count_(0), flags_(0) {
     last_tick_time_.tv_sec = 0;
     last_tick_time_.tv_nsec = 0;
   }
@@ -235,9 +167,10 @@ class LIBCOPP_COTASK_API_HEAD_ONLY task_manager<task<TCO_MACRO>> {
 
       tasks_.clear();
       task_timeout_timer_.clear();
-      flags_ = 0;
+      flags_.store(0);
       last_tick_time_.tv_sec = 0;
       last_tick_time_.tv_nsec = 0;
+      pending_expire_count_ = 0;
     }
 
     // then, kill all tasks
@@ -257,6 +190,7 @@ class LIBCOPP_COTASK_API_HEAD_ONLY task_manager<task<TCO_MACRO>> {
   /**
    * @brief add task to manager
    *        please make the task has method of get_id() and will return a unique id
+   *        it's disabled when task_container_slot_map is used, because the key is allocated by container
    *
    * @param task task to be inserted
    * @param timeout_sec timeout in second ( unix time stamp recommanded )
@@ -268,6 +202,22 @@ class LIBCOPP_COTASK_API_HEAD_ONLY task_manager<task<TCO_MACRO>> {
    * @see tick
    */
   int add_task(const task_ptr_type &task, time_t timeout_sec, int timeout_nsec) {
+    static_assert(!TCONTAINER::allocate_task_id::value,
+                  "task key is allocated by container, use add_task(task, timeout_sec, timeout_nsec, &task_id)");
+    return add_task(task, timeout_sec, timeout_nsec, nullptr);
+  }
+
+  /**
+   * @brief add task to manager
+   *
+   * @param task task to be inserted
+   * @param timeout_sec timeout in second ( unix time stamp recommanded )
+   * @param timeout_nsec timeout in nanosecond ( must be in the range 0-999999999 )
+   * @param task_id where to store the id used to access the task in this manager, it's task->get_id() unless
+   *        task_container_slot_map is used
+   * @return 0 or error code
+   */
+  int add_task(const task_ptr_type &task, time_t timeout_sec, int timeout_nsec, id_type *task_id) {
     if (!task) {
       assert(task);
       return LIBCOPP_COPP_NAMESPACE_ID::COPP_EC_ARGS_ERROR;
@@ -282,8 +232,7 @@ class LIBCOPP_COTASK_API_HEAD_ONLY task_manager<task<TCO_MACRO>> {
     }
 
     // try to cast type
-    using pair_type = typename container_type::value_type;
-    detail::task_manager_node<task_type> task_node;
+    node_type task_node;
     task_node.task_ = task;
     task_node.timer_node = task_timeout_timer_.end();
 
@@ -298,41 +247,49 @@ class LIBCOPP_COTASK_API_HEAD_ONLY task_manager<task<TCO_MACRO>> {
         action_lock_};
 #endif
 
-    id_type task_id = task->get_id();
-    if (tasks_.end() != tasks_.find(task_id)) {
+    // try to insert to container
+    std::pair<typename container_type::iterator, bool> res = tasks_.emplace(task->get_id(), task_node);
+    if (false == res.second) {
+      if (tasks_.end() == res.first) {
+        return LIBCOPP_COPP_NAMESPACE_ID::COPP_EC_EXTERNAL_INSERT_FAILED;
+      }
       return LIBCOPP_COPP_NAMESPACE_ID::COPP_EC_ALREADY_EXIST;
     }
 
+    // the id may be allocated by container
+    id_type manager_task_id = res.first->first;
+
 #if defined(LIBCOTASK_MACRO_AUTO_CLEANUP_MANAGER) && LIBCOTASK_MACRO_AUTO_CLEANUP_MANAGER
     using task_manager_helper = typename task_type::task_manager_helper;
-    if (!task_manager_helper::setup_task_manager(*task, reinterpret_cast<void *>(this), &task_cleanup_callback)) {
+    if (!task_manager_helper::setup_task_manager(*task, reinterpret_cast<void *>(this), &task_cleanup_callback,
+                                                 manager_task_id)) {
+      tasks_.erase(res.first);
       return LIBCOPP_COPP_NAMESPACE_ID::COPP_EC_TASK_ALREADY_IN_ANOTHER_MANAGER;
     }
 #endif
 
-    // try to insert to container
-    std::pair<typename container_type::iterator, bool> res = tasks_.insert(pair_type(task_id, task_node));
-    if (false == res.second) {
-#if defined(LIBCOTASK_MACRO_AUTO_CLEANUP_MANAGER) && LIBCOTASK_MACRO_AUTO_CLEANUP_MANAGER
-      task_manager_helper::cleanup_task_manager(*task, reinterpret_cast<void *>(this));
-#endif
-      return LIBCOPP_COPP_NAMESPACE_ID::COPP_EC_EXTERNAL_INSERT_FAILED;
-    }
-
     // add timeout controller
-    set_timeout_timer(res.first->second, timeout_sec, timeout_nsec);
+    set_timeout_timer(manager_task_id, res.first->second, timeout_sec, timeout_nsec);
+    if (nullptr != task_id) {
+      *task_id = manager_task_id;
+    }
     return LIBCOPP_COPP_NAMESPACE_ID::COPP_EC_SUCCESS;
   }
 
   /**
    * @brief add task to manager
    *        please make the task has method of get_id() and will return a unique id
+   *        it's disabled when task_container_slot_map is used, because the key is allocated by container
    *
    * @param task task to be inserted
    * @return 0 or error code
    *
    */
-  int add_task(const task_ptr_type &task) { return add_task(task, 0, 0); }
+  int add_task(const task_ptr_type &task) {
+    static_assert(!TCONTAINER::allocate_task_id::value,
+                  "task key is allocated by container, use add_task(task, timeout_sec, timeout_nsec, &task_id)");
+    return add_task(task, 0, 0, nullptr);
+  }
 
   /**
    * @brief set or update task timeout
@@ -363,7 +320,7 @@ class LIBCOPP_COTASK_API_HEAD_ONLY task_manager<task<TCO_MACRO>> {
       iter_type iter = tasks_.find(id);
       if (tasks_.end() == iter) return LIBCOPP_COPP_NAMESPACE_ID::COPP_EC_NOT_FOUND;
 
-      set_timeout_timer(iter->second, timeout_sec, timeout_nsec);
+      set_timeout_timer(id, iter->second, timeout_sec, timeout_nsec);
     }
 
     return LIBCOPP_COPP_NAMESPACE_ID::COPP_EC_SUCCESS;
@@ -461,13 +418,18 @@ class LIBCOPP_COTASK_API_HEAD_ONLY task_manager<task<TCO_MACRO>> {
   // int scheduling_loop();
 #if defined(LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR) && LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR
   int start(id_type id, void *priv_data = nullptr) {
-    std::list<std::exception_ptr> eptrs;
+    impl::task_exception_sink eptrs;
     int ret = start(id, eptrs, priv_data);
-    task_type::maybe_rethrow(eptrs);
+    eptrs.maybe_rethrow();
     return ret;
   }
 
   int start(id_type id, std::list<std::exception_ptr> &unhandled, void *priv_data = nullptr) LIBCOPP_MACRO_NOEXCEPT {
+    impl::task_exception_sink sink(unhandled);
+    return start(id, sink, priv_data);
+  }
+
+  int start(id_type id, impl::task_exception_sink &unhandled, void *priv_data = nullptr) LIBCOPP_MACRO_NOEXCEPT {
 #else
   int start(id_type id, void *priv_data = nullptr) {
 #endif
@@ -510,13 +472,18 @@ class LIBCOPP_COTASK_API_HEAD_ONLY task_manager<task<TCO_MACRO>> {
 
 #if defined(LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR) && LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR
   int resume(id_type id, void *priv_data = nullptr) {
-    std::list<std::exception_ptr> eptrs;
+    impl::task_exception_sink eptrs;
     int ret = resume(id, eptrs, priv_data);
-    task_type::maybe_rethrow(eptrs);
+    eptrs.maybe_rethrow();
     return ret;
   }
 
   int resume(id_type id, std::list<std::exception_ptr> &unhandled, void *priv_data = nullptr) LIBCOPP_MACRO_NOEXCEPT {
+    impl::task_exception_sink sink(unhandled);
+    return resume(id, sink, priv_data);
+  }
+
+  int resume(id_type id, impl::task_exception_sink &unhandled, void *priv_data = nullptr) LIBCOPP_MACRO_NOEXCEPT {
 #else
   int resume(id_type id, void *priv_data = nullptr) {
 #endif
@@ -559,13 +526,18 @@ class LIBCOPP_COTASK_API_HEAD_ONLY task_manager<task<TCO_MACRO>> {
 
 #if defined(LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR) && LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR
   int cancel(id_type id, void *priv_data = nullptr) {
-    std::list<std::exception_ptr> eptrs;
+    impl::task_exception_sink eptrs;
     int ret = cancel(id, eptrs, priv_data);
-    task_type::maybe_rethrow(eptrs);
+    eptrs.maybe_rethrow();
     return ret;
   }
 
   int cancel(id_type id, std::list<std::exception_ptr> &unhandled, void *priv_data = nullptr) LIBCOPP_MACRO_NOEXCEPT {
+    impl::task_exception_sink sink(unhandled);
+    return cancel(id, sink, priv_data);
+  }
+
+  int cancel(id_type id, impl::task_exception_sink &unhandled, void *priv_data = nullptr) LIBCOPP_MACRO_NOEXCEPT {
 #else
   int cancel(id_type id, void *priv_data = nullptr) {
 #endif
@@ -611,14 +583,20 @@ class LIBCOPP_COTASK_API_HEAD_ONLY task_manager<task<TCO_MACRO>> {
 
 #if defined(LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR) && LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR
   int kill(id_type id, enum EN_TASK_STATUS status, void *priv_data = nullptr) {
-    std::list<std::exception_ptr> eptrs;
+    impl::task_exception_sink eptrs;
     int ret = kill(id, eptrs, status, priv_data);
-    task_type::maybe_rethrow(eptrs);
+    eptrs.maybe_rethrow();
     return ret;
   }
 
   int kill(id_type id, std::list<std::exception_ptr> &unhandled, enum EN_TASK_STATUS status,
            void *priv_data = nullptr) LIBCOPP_MACRO_NOEXCEPT {
+    impl::task_exception_sink sink(unhandled);
+    return kill(id, sink, status, priv_data);
+  }
+
+  int kill(id_type id, impl::task_exception_sink &unhandled, enum EN_TASK_STATUS status,
+           void *priv_data = nullptr) LIBCOPP_MACRO_NOEXCEPT {
 #else
   int kill(id_type id, enum EN_TASK_STATUS status, void *priv_data = nullptr) {
 #endif
@@ -664,6 +642,166 @@ class LIBCOPP_COTASK_API_HEAD_ONLY task_manager<task<TCO_MACRO>> {
 
   int kill(id_type id, void *priv_data = nullptr) { return kill(id, EN_TS_KILLED, priv_data); }
 
+  /**
+   * @brief start tasks by id, the lock is taken once for every BATCH_CHUNK_SIZE ids
+   * @param items task ids and private data passed to start
+   * @param results error code of every item, it will be ignored if it's shorter than items
+   * @return number of tasks which are started successfully
+   */
+#if defined(LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR) && LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR
+  size_t start_batch(LIBCOPP_COPP_NAMESPACE_ID::gsl::span<const batch_item_type> items,
+                     LIBCOPP_COPP_NAMESPACE_ID::gsl::span<int> results = LIBCOPP_COPP_NAMESPACE_ID::gsl::span<int>()) {
+    impl::task_exception_sink eptrs;
+    size_t ret = start_batch(eptrs, items, results);
+    eptrs.maybe_rethrow();
+    return ret;
+  }
+
+  size_t start_batch(
+      std::list<std::exception_ptr> &unhandled, LIBCOPP_COPP_NAMESPACE_ID::gsl::span<const batch_item_type> items,
+      LIBCOPP_COPP_NAMESPACE_ID::gsl::span<int> results = LIBCOPP_COPP_NAMESPACE_ID::gsl::span<int>()) {
+    impl::task_exception_sink sink(unhandled);
+    return start_batch(sink, items, results);
+  }
+
+  size_t start_batch(impl::task_exception_sink &unhandled,
+                     LIBCOPP_COPP_NAMESPACE_ID::gsl::span<const batch_item_type> items,
+                     LIBCOPP_COPP_NAMESPACE_ID::gsl::span<int> results = LIBCOPP_COPP_NAMESPACE_ID::gsl::span<int>()) {
+#else
+  size_t start_batch(LIBCOPP_COPP_NAMESPACE_ID::gsl::span<const batch_item_type> items,
+                     LIBCOPP_COPP_NAMESPACE_ID::gsl::span<int> results = LIBCOPP_COPP_NAMESPACE_ID::gsl::span<int>()) {
+#endif
+    return dispatch_batch(
+        items, results, false, [&](size_t begin, LIBCOPP_COPP_NAMESPACE_ID::gsl::span<task_ptr_type> task_insts) {
+          size_t ret = 0;
+          for (size_t i = 0; i < task_insts.size(); ++i) {
+            if (!task_insts[i]) {
+              continue;
+            }
+
+#if defined(LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR) && LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR
+            int res = task_insts[i]->start(unhandled, items[begin + i].second);
+#else
+            int res = task_insts[i]->start(items[begin + i].second);
+#endif
+            set_batch_result(results, begin + i, res);
+            if (res >= 0) {
+              ++ret;
+            }
+          }
+          return ret;
+        });
+  }
+
+  /**
+   * @brief resume tasks by id, the lock is taken once for every BATCH_CHUNK_SIZE ids
+   * @param items task ids and private data passed to resume
+   * @param results error code of every item, it will be ignored if it's shorter than items
+   * @return number of tasks which are resumed successfully
+   */
+#if defined(LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR) && LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR
+  size_t resume_batch(LIBCOPP_COPP_NAMESPACE_ID::gsl::span<const batch_item_type> items,
+                      LIBCOPP_COPP_NAMESPACE_ID::gsl::span<int> results = LIBCOPP_COPP_NAMESPACE_ID::gsl::span<int>()) {
+    impl::task_exception_sink eptrs;
+    size_t ret = resume_batch(eptrs, items, results);
+    eptrs.maybe_rethrow();
+    return ret;
+  }
+
+  size_t resume_batch(
+      std::list<std::exception_ptr> &unhandled, LIBCOPP_COPP_NAMESPACE_ID::gsl::span<const batch_item_type> items,
+      LIBCOPP_COPP_NAMESPACE_ID::gsl::span<int> results = LIBCOPP_COPP_NAMESPACE_ID::gsl::span<int>()) {
+    impl::task_exception_sink sink(unhandled);
+    return resume_batch(sink, items, results);
+  }
+
+  size_t resume_batch(impl::task_exception_sink &unhandled,
+                      LIBCOPP_COPP_NAMESPACE_ID::gsl::span<const batch_item_type> items,
+                      LIBCOPP_COPP_NAMESPACE_ID::gsl::span<int> results = LIBCOPP_COPP_NAMESPACE_ID::gsl::span<int>()) {
+#else
+  size_t resume_batch(LIBCOPP_COPP_NAMESPACE_ID::gsl::span<const batch_item_type> items,
+                      LIBCOPP_COPP_NAMESPACE_ID::gsl::span<int> results = LIBCOPP_COPP_NAMESPACE_ID::gsl::span<int>()) {
+#endif
+    return dispatch_batch(
+        items, results, false, [&](size_t begin, LIBCOPP_COPP_NAMESPACE_ID::gsl::span<task_ptr_type> task_insts) {
+          size_t ret = 0;
+          for (size_t i = 0; i < task_insts.size(); ++i) {
+            if (!task_insts[i]) {
+              continue;
+            }
+
+#if defined(LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR) && LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR
+            int res = task_insts[i]->resume(unhandled, items[begin + i].second);
+#else
+            int res = task_insts[i]->resume(items[begin + i].second);
+#endif
+            set_batch_result(results, begin + i, res);
+            if (res >= 0) {
+              ++ret;
+            }
+          }
+          return ret;
+        });
+  }
+
+  /**
+   * @brief kill tasks by id, the lock is taken once for every BATCH_CHUNK_SIZE ids
+   * @param items task ids and private data passed to kill
+   * @param status status of killed tasks
+   * @param results error code of every item, it will be ignored if it's shorter than items
+   * @return number of tasks which are killed successfully
+   */
+#if defined(LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR) && LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR
+  size_t kill_batch(LIBCOPP_COPP_NAMESPACE_ID::gsl::span<const batch_item_type> items, enum EN_TASK_STATUS status,
+                    LIBCOPP_COPP_NAMESPACE_ID::gsl::span<int> results = LIBCOPP_COPP_NAMESPACE_ID::gsl::span<int>()) {
+    impl::task_exception_sink eptrs;
+    size_t ret = kill_batch(eptrs, items, status, results);
+    eptrs.maybe_rethrow();
+    return ret;
+  }
+
+  size_t kill_batch(std::list<std::exception_ptr> &unhandled,
+                    LIBCOPP_COPP_NAMESPACE_ID::gsl::span<const batch_item_type> items, enum EN_TASK_STATUS status,
+                    LIBCOPP_COPP_NAMESPACE_ID::gsl::span<int> results = LIBCOPP_COPP_NAMESPACE_ID::gsl::span<int>()) {
+    impl::task_exception_sink sink(unhandled);
+    return kill_batch(sink, items, status, results);
+  }
+
+  size_t kill_batch(impl::task_exception_sink &unhandled,
+                    LIBCOPP_COPP_NAMESPACE_ID::gsl::span<const batch_item_type> items, enum EN_TASK_STATUS status,
+                    LIBCOPP_COPP_NAMESPACE_ID::gsl::span<int> results = LIBCOPP_COPP_NAMESPACE_ID::gsl::span<int>()) {
+#else
+  size_t kill_batch(LIBCOPP_COPP_NAMESPACE_ID::gsl::span<const batch_item_type> items, enum EN_TASK_STATUS status,
+                    LIBCOPP_COPP_NAMESPACE_ID::gsl::span<int> results = LIBCOPP_COPP_NAMESPACE_ID::gsl::span<int>()) {
+#endif
+    // unlock and then run kill
+    return dispatch_batch(
+        items, results, true, [&](size_t begin, LIBCOPP_COPP_NAMESPACE_ID::gsl::span<task_ptr_type> task_insts) {
+          size_t ret = 0;
+          for (size_t i = 0; i < task_insts.size(); ++i) {
+            if (!task_insts[i]) {
+              continue;
+            }
+
+#if defined(LIBCOTASK_MACRO_AUTO_CLEANUP_MANAGER) && LIBCOTASK_MACRO_AUTO_CLEANUP_MANAGER
+            using task_manager_helper = typename task_type::task_manager_helper;
+            // already cleanup, there is no need to cleanup again
+            task_manager_helper::cleanup_task_manager(*task_insts[i], reinterpret_cast<void *>(this));
+#endif
+#if defined(LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR) && LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR
+            int res = task_insts[i]->kill(unhandled, status, items[begin + i].second);
+#else
+            int res = task_insts[i]->kill(status, items[begin + i].second);
+#endif
+            set_batch_result(results, begin + i, res);
+            if (res >= 0) {
+              ++ret;
+            }
+          }
+          return ret;
+        });
+  }
+
   /**
    * @brief active tick event and deal with clock
    * @param sec current time in second ( unix time stamp recommanded )
@@ -672,15 +810,40 @@ class LIBCOPP_COTASK_API_HEAD_ONLY task_manager<task<TCO_MACRO>> {
    *
    * @note timeout tasks will be removed here
    */
-  int tick(time_t sec, int nsec = 0) {
+  int tick(time_t sec, int nsec = 0) { return tick(sec, nsec, (std::numeric_limits<size_t>::max)(), nullptr); }
+
+  /**
+   * @brief active tick event and deal with clock, at most max_expire timeout tasks will be removed
+   * @param sec current time in second ( unix time stamp recommanded )
+   * @param nsec current time in nanosecond ( must be in the range 0-999999999 )
+   * @param max_expire max number of timeout tasks to remove in this call
+   * @param pending_expire_count where to store the number of timeout tasks carried over to next tick
+   * @param expired_count where to store the number of timeout checkpoints taken from max_expire in this call
+   * @return 0 or error code
+   *
+   * @note the carried over tasks will be removed by next tick, even if the time is not changed
+   */
+  int tick(time_t sec, int nsec, size_t max_expire, size_t *pending_expire_count = nullptr,
+           size_t *expired_count = nullptr) {
+    if (nullptr != pending_expire_count) {
+      *pending_expire_count = pending_expire_count_;
+    }
+    if (nullptr != expired_count) {
+      *expired_count = 0;
+    }
+
     detail::tickspec_t now_tick_time;
-    // time can not be back
+    // time can not be back, but timeout tasks carried over by last tick should still be removed
     if (sec < last_tick_time_.tv_sec || (sec == last_tick_time_.tv_sec && nsec <= last_tick_time_.tv_nsec)) {
-      return 0;
-    }
+      if (0 == pending_expire_count_) {
+        return 0;
+      }
 
-    now_tick_time.tv_sec = sec;
-    now_tick_time.tv_nsec = nsec;
+      now_tick_time = last_tick_time_;
+    } else {
+      now_tick_time.tv_sec = sec;
+      now_tick_time.tv_nsec = nsec;
+    }
 
     // we will ignore tick when in a recursive call
     flag_guard_type tick_flag(&flags_, flag_type::EN_TM_IN_TICK);
@@ -700,35 +863,35 @@ class LIBCOPP_COTASK_API_HEAD_ONLY task_manager<task<TCO_MACRO>> {
           action_lock_};
 #endif
 
-      std::set<detail::task_timer_node<id_type>> real_checkpoints;
-      for (typename std::set<detail::task_timer_node<id_type>>::iterator iter = task_timeout_timer_.begin();
-           task_timeout_timer_.end() != iter; ++iter) {
-        detail::task_timer_node<id_type> new_checkpoint = (*iter);
-        new_checkpoint.expired_time.tv_sec += sec;
-        new_checkpoint.expired_time.tv_nsec += nsec;
-        real_checkpoints.insert(new_checkpoint);
-      }
-
-      task_timeout_timer_.swap(real_checkpoints);
-      for (typename std::set<detail::task_timer_node<id_type>>::iterator iter = task_timeout_timer_.begin();
-           task_timeout_timer_.end() != iter; ++iter) {
-        const typename std::set<detail::task_timer_node<id_type>>::value_type &checkpoint = *iter;
+      task_timeout_timer_.rebase(now_tick_time, [this](id_type task_id, typename timer_type::handle_type handle) {
         using co_iter_type = typename container_type::iterator;
-        co_iter_type  co_iter = tasks_.find(checkpoint.task_id);
+        co_iter_type co_iter = tasks_.find(task_id);
 
         if (tasks_.end() != co_iter) {
-          co_iter->second.timer_node = iter;
+          co_iter->second.timer_node = handle;
         }
-      }
+      });
       last_tick_time_ = now_tick_time;
       return LIBCOPP_COPP_NAMESPACE_ID::COPP_EC_SUCCESS;
     }
 
 #if defined(LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR) && LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR
-    std::list<std::exception_ptr> eptrs;
+    impl::task_exception_sink eptrs;
+#endif
+    // turn the timer to now and collect all expired checkpoints
+    {
+      // hold lock
+#if !defined(LIBCOPP_DISABLE_ATOMIC_LOCK) || !(LIBCOPP_DISABLE_ATOMIC_LOCK)
+      LIBCOPP_COPP_NAMESPACE_ID::util::lock::lock_holder<LIBCOPP_COPP_NAMESPACE_ID::util::lock::spin_lock> lock_guard{
+          action_lock_};
 #endif
+
+      task_timeout_timer_.advance(now_tick_time);
+    }
+
     // remove timeout tasks
-    while (false == task_timeout_timer_.empty()) {
+    size_t expired_number = 0;
+    while (true) {
       task_ptr_type task_inst;
 
       {
@@ -738,23 +901,30 @@ class LIBCOPP_COTASK_API_HEAD_ONLY task_manager<task<TCO_MACRO>> {
             action_lock_};
 #endif
 
-        const typename std::set<detail::task_timer_node<id_type>>::value_type &timer_node =
-            *task_timeout_timer_.begin();
+        // the rest timeout tasks are carried over to next tick
+        if (expired_number >= max_expire) {
+          pending_expire_count_ = task_timeout_timer_.count_expired(now_tick_time);
+          break;
+        }
+
+        id_type task_id;
         // all tasks those expired time less than now are timeout
-        if (now_tick_time <= timer_node.expired_time) {
+        if (!task_timeout_timer_.pop_expired(now_tick_time, task_id)) {
+          pending_expire_count_ = 0;
           break;
         }
+        ++expired_number;
 
-        // check expire time(may be changed)
         using iter_type = typename container_type::iterator;
 
-        iter_type iter = tasks_.find(timer_node.task_id);
+        iter_type iter = tasks_.find(task_id);
 
         if (tasks_.end() != iter) {
           // task may be removed before
           task_inst = std::move(iter->second.task_);
 
-          remove_timeout_timer(iter->second);
+          // the checkpoint is already removed
+          iter->second.timer_node = task_timeout_timer_.end();
           tasks_.erase(iter);  // remove from container
         }
       }
@@ -774,10 +944,23 @@ class LIBCOPP_COTASK_API_HEAD_ONLY task_manager<task<TCO_MACRO>> {
       }
     }
 
-    last_tick_time_ = now_tick_time;
+    {
+      // producers read last_tick_time_ in set_timeout_timer(...) with lock
+#if !defined(LIBCOPP_DISABLE_ATOMIC_LOCK) || !(LIBCOPP_DISABLE_ATOMIC_LOCK)
+      LIBCOPP_COPP_NAMESPACE_ID::util::lock::lock_holder<LIBCOPP_COPP_NAMESPACE_ID::util::lock::spin_lock> lock_guard{
+          action_lock_};
+#endif
+      last_tick_time_ = now_tick_time;
+    }
+    if (nullptr != pending_expire_count) {
+      *pending_expire_count = pending_expire_count_;
+    }
+    if (nullptr != expired_count) {
+      *expired_count = expired_number;
+    }
 
 #if defined(LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR) && LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR
-    task_type::maybe_rethrow(eptrs);
+    eptrs.maybe_rethrow();
 #endif
     return LIBCOPP_COPP_NAMESPACE_ID::COPP_EC_SUCCESS;
   }
@@ -788,6 +971,18 @@ class LIBCOPP_COTASK_API_HEAD_ONLY task_manager<task<TCO_MACRO>> {
    */
   size_t get_tick_checkpoint_size() const LIBCOPP_MACRO_NOEXCEPT { return task_timeout_timer_.size(); }
 
+  /**
+   * @brief check if there are timeout tasks carried over by last tick
+   * @return true if the next tick will remove carried over timeout tasks even if the time is not changed
+   */
+  bool has_pending_expire() const LIBCOPP_MACRO_NOEXCEPT { return 0 != pending_expire_count_; }
+
+  /**
+   * @brief get the number of timeout tasks carried over by last tick
+   * @return number of timeout tasks which will be removed by next tick, even if the time is not changed
+   */
+  size_t get_pending_expire_count() const LIBCOPP_MACRO_NOEXCEPT { return pending_expire_count_; }
+
   /**
    * @brief get task number in this manager
    * @return task number
@@ -810,12 +1005,12 @@ class LIBCOPP_COTASK_API_HEAD_ONLY task_manager<task<TCO_MACRO>> {
    * @brief get all task checkpoints, this api is just used for provide information to users
    * @return task checkpoints
    */
-  inline const std::set<detail::task_timer_node<id_type>> &get_checkpoints() const LIBCOPP_MACRO_NOEXCEPT {
-    return task_timeout_timer_;
+  inline typename timer_type::checkpoints_result_type get_checkpoints() const {
+    return task_timeout_timer_.get_checkpoints();
   }
 
  private:
-  void set_timeout_timer(detail::task_manager_node<task_type> &node, time_t timeout_sec, int timeout_nsec) {
+  void set_timeout_timer(id_type task_id, node_type &node, time_t timeout_sec, int timeout_nsec) {
     remove_timeout_timer(node);
 
     if (timeout_sec <= 0 && timeout_nsec <= 0) {
@@ -827,18 +1022,157 @@ class LIBCOPP_COTASK_API_HEAD_ONLY task_manager<task<TCO_MACRO>> {
     }
 
     detail::task_timer_node<id_type> timer_node;
-    timer_node.task_id = node.task_->get_id();
-    timer_node.expired_time.tv_sec = last_tick_time_.tv_sec + timeout_sec;
-    timer_node.expired_time.tv_nsec = last_tick_time_.tv_nsec + timeout_nsec;
+    timer_node.task_id = task_id;
+    timer_node.expired_time = detail::make_tickspec(last_tick_time_.tv_sec + timeout_sec,
+                                                    static_cast<int64_t>(last_tick_time_.tv_nsec) + timeout_nsec);
+
+    node.timer_node = task_timeout_timer_.insert(timer_node);
+  }
+
+  UTIL_FORCEINLINE static void set_batch_result(LIBCOPP_COPP_NAMESPACE_ID::gsl::span<int> results, size_t index,
+                                               int res) LIBCOPP_MACRO_NOEXCEPT {
+    if (index < results.size()) {
+      results[index] = res;
+    }
+  }
+
+  /**
+   * @brief resolve tasks of a batch in chunks of BATCH_CHUNK_SIZE on the stack, and then call fn for every chunk
+   * @param erase remove resolved tasks from manager, or else remove finished tasks after fn
+   * @param fn size_t(size_t begin, gsl::span<task_ptr_type> task_insts), task_insts[i] is the task of items[begin + i]
+   * @note Nothing is allocated here, and the lock is taken once for every chunk.
+   */
+  template <class TFN>
+  size_t dispatch_batch(LIBCOPP_COPP_NAMESPACE_ID::gsl::span<const batch_item_type> items,
+                        LIBCOPP_COPP_NAMESPACE_ID::gsl::span<int> results, bool erase, TFN &&fn) {
+    task_ptr_type task_insts[BATCH_CHUNK_SIZE];
+    size_t ret = 0;
+    for (size_t begin = 0; begin < items.size(); begin += BATCH_CHUNK_SIZE) {
+      size_t count = items.size() - begin;
+      if (count > BATCH_CHUNK_SIZE) {
+        count = BATCH_CHUNK_SIZE;
+      }
+
+      LIBCOPP_COPP_NAMESPACE_ID::gsl::span<const batch_item_type> chunk_items(items.data() + begin, count);
+      LIBCOPP_COPP_NAMESPACE_ID::gsl::span<task_ptr_type> chunk_tasks(task_insts, count);
+      LIBCOPP_COPP_NAMESPACE_ID::gsl::span<int> chunk_results;
+      if (begin < results.size()) {
+        chunk_results = LIBCOPP_COPP_NAMESPACE_ID::gsl::span<int>(results.data() + begin,
+                                                                  (std::min)(count, results.size() - begin));
+      }
+
+      if (!resolve_batch(chunk_items, chunk_results, chunk_tasks, erase)) {
+        for (size_t i = begin; i < items.size(); ++i) {
+          set_batch_result(results, i, LIBCOPP_COPP_NAMESPACE_ID::COPP_EC_IN_RESET);
+        }
+        break;
+      }
+
+      ret += fn(begin, chunk_tasks);
+      if (!erase) {
+        remove_finished_batch(chunk_items, chunk_tasks);
+      }
+
+      // release tasks of this chunk before the next one
+      for (size_t i = 0; i < count; ++i) {
+        task_insts[i].reset();
+      }
+    }
+
+    return ret;
+  }
+
+  /**
+   * @brief resolve all tasks of a chunk with one lock
+   * @param out tasks of every item, the task is empty and the result is set to COPP_EC_NOT_FOUND if not found
+   * @param erase remove resolved tasks from manager
+   * @return false if this manager is resetting
+   */
+  bool resolve_batch(LIBCOPP_COPP_NAMESPACE_ID::gsl::span<const batch_item_type> items,
+                     LIBCOPP_COPP_NAMESPACE_ID::gsl::span<int> results,
+                     LIBCOPP_COPP_NAMESPACE_ID::gsl::span<task_ptr_type> out, bool erase) {
+    if (flags_ & flag_type::EN_TM_IN_RESET) {
+      return false;
+    }
 
-    std::pair<typename std::set<detail::task_timer_node<id_type>>::iterator, bool> res =
-        task_timeout_timer_.insert(timer_node);
-    if (res.second) {
-      node.timer_node = res.first;
+#if !defined(LIBCOPP_DISABLE_ATOMIC_LOCK) || !(LIBCOPP_DISABLE_ATOMIC_LOCK)
+    LIBCOPP_COPP_NAMESPACE_ID::util::lock::lock_holder<LIBCOPP_COPP_NAMESPACE_ID::util::lock::spin_lock> lock_guard{
+        action_lock_};
+#endif
+
+    using iter_type = typename container_type::iterator;
+    for (size_t i = 0; i < items.size(); ++i) {
+      iter_type iter = tasks_.find(items[i].first);
+      if (tasks_.end() == iter || !iter->second.task_) {
+        set_batch_result(results, i, LIBCOPP_COPP_NAMESPACE_ID::COPP_EC_NOT_FOUND);
+        continue;
+      }
+
+      if (erase) {
+        out[i] = std::move(iter->second.task_);
+        remove_timeout_timer(iter->second);
+        tasks_.erase(iter);
+      } else {
+        out[i] = iter->second.task_;
+      }
     }
+
+    return true;
   }
 
-  void remove_timeout_timer(detail::task_manager_node<task_type> &node) {
+  /**
+   * @brief remove finished tasks of a batch with one lock
+   */
+  void remove_finished_batch(LIBCOPP_COPP_NAMESPACE_ID::gsl::span<const batch_item_type> items,
+                             LIBCOPP_COPP_NAMESPACE_ID::gsl::span<task_ptr_type> task_insts) {
+    size_t finished_count = 0;
+    for (size_t i = 0; i < task_insts.size(); ++i) {
+      if (task_insts[i] && task_insts[i]->get_status() >= EN_TS_DONE) {
+        ++finished_count;
+      } else {
+        task_insts[i].reset();
+      }
+    }
+
+    if (0 == finished_count) {
+      return;
+    }
+
+    {
+#if !defined(LIBCOPP_DISABLE_ATOMIC_LOCK) || !(LIBCOPP_DISABLE_ATOMIC_LOCK)
+      LIBCOPP_COPP_NAMESPACE_ID::util::lock::lock_holder<LIBCOPP_COPP_NAMESPACE_ID::util::lock::spin_lock> lock_guard{
+          action_lock_};
+#endif
+
+      using iter_type = typename container_type::iterator;
+      for (size_t i = 0; i < task_insts.size(); ++i) {
+        if (!task_insts[i]) {
+          continue;
+        }
+
+        // task may be removed or replaced when running
+        iter_type iter = tasks_.find(items[i].first);
+        if (tasks_.end() == iter || iter->second.task_ != task_insts[i]) {
+          task_insts[i].reset();
+          continue;
+        }
+
+        remove_timeout_timer(iter->second);
+        tasks_.erase(iter);
+      }
+    }
+
+#if defined(LIBCOTASK_MACRO_AUTO_CLEANUP_MANAGER) && LIBCOTASK_MACRO_AUTO_CLEANUP_MANAGER
+    using task_manager_helper = typename task_type::task_manager_helper;
+    for (size_t i = 0; i < task_insts.size(); ++i) {
+      if (task_insts[i]) {
+        task_manager_helper::cleanup_task_manager(*task_insts[i], reinterpret_cast<void *>(this));
+      }
+    }
+#endif
+  }
+
+  void remove_timeout_timer(node_type &node) {
     if (node.timer_node != task_timeout_timer_.end()) {
       task_timeout_timer_.erase(node.timer_node);
       node.timer_node = task_timeout_timer_.end();
@@ -851,34 +1185,45 @@ class LIBCOPP_COTASK_API_HEAD_ONLY task_manager<task<TCO_MACRO>> {
       return;
     }
 
-    reinterpret_cast<self_type *>(self_ptr)->remove_task(task_inst.get_id(), &task_inst);
+    using task_manager_helper = typename task_type::task_manager_helper;
+    reinterpret_cast<self_type *>(self_ptr)->remove_task(task_manager_helper::get_task_manager_key(task_inst),
+                                                         &task_inst);
   }
 #endif
 
  private:
   container_type tasks_;
   detail::tickspec_t last_tick_time_;
-  std::set<detail::task_timer_node<id_type>> task_timeout_timer_;
+  timer_type task_timeout_timer_;
+  // number of timeout tasks carried over by tick(sec, nsec, max_expire)
+  size_t pending_expire_count_;
 
 #if !defined(LIBCOPP_DISABLE_ATOMIC_LOCK) || !(LIBCOPP_DISABLE_ATOMIC_LOCK)
   LIBCOPP_COPP_NAMESPACE_ID::util::lock::spin_lock action_lock_;
 #endif
-  int flags_;
+  flags_holder_type flags_;
 };
 
 #if defined(LIBCOPP_MACRO_ENABLE_STD_COROUTINE) && LIBCOPP_MACRO_ENABLE_STD_COROUTINE
 /**
  * @brief task manager for C++20 coroutine task
  */
-template <class TVALUE, class TPRIVATE_DATA, class TERROR_TRANSFORM>
-class LIBCOPP_COTASK_API_HEAD_ONLY task_manager<task_future<TVALUE, TPRIVATE_DATA, TERROR_TRANSFORM>> {
+template <class TVALUE, class TPRIVATE_DATA, class TERROR_TRANSFORM, class TTIMER, class TCONTAINER>
+class LIBCOPP_COTASK_API_HEAD_ONLY
+    task_manager<task_future<TVALUE, TPRIVATE_DATA, TERROR_TRANSFORM>, TTIMER, TCONTAINER> {
  public:
   using task_type = task_future<TVALUE, TPRIVATE_DATA, TERROR_TRANSFORM>;
-  using container_type = std::unordered_map<typename task_type::id_type, detail::task_manager_node<task_type>>;
+  using timer_type = TTIMER;
+  using node_type = detail::task_manager_node<task_type, timer_type>;
+  using container_type = typename TCONTAINER::template container_type<typename task_type::id_type, node_type>;
   using id_type = typename task_type::id_type;
   using task_status_type = typename task_type::task_status_type;
-  using self_type = task_manager<task_type>;
+  using self_type = task_manager<task_type, timer_type, TCONTAINER>;
   using ptr_type = std::shared_ptr<self_type>;
+  // task id of start_batch(...) and kill_batch(...)
+  using batch_item_type = id_type;
+  // batch APIs resolve tasks on the stack in chunks of this size
+  enum { BATCH_CHUNK_SIZE = 64 };
 
   enum class flag_type : uint32_t{
       kNone = 0,
@@ -887,20 +1232,26 @@ class LIBCOPP_COTASK_API_HEAD_ONLY task_manager<task_future<TVALUE, TPRIVATE_DAT
   };
 
  private:
+  // flags are read by producers without action_lock_
+#  if defined(LIBCOPP_DISABLE_ATOMIC_LOCK) && LIBCOPP_DISABLE_ATOMIC_LOCK
+  using flags_holder_type = LIBCOPP_COPP_NAMESPACE_ID::util::lock::atomic_int_type<
+      LIBCOPP_COPP_NAMESPACE_ID::util::lock::unsafe_int_type<uint32_t> >;
+#  else
+  using flags_holder_type = LIBCOPP_COPP_NAMESPACE_ID::util::lock::atomic_int_type<uint32_t>;
+#  endif
+
   struct flag_guard_type {
-    uint32_t *data_;
+    flags_holder_type *data_;
     flag_type flag_;
-    inline flag_guard_type(uint32_t *flags, flag_type v) : data_(flags), flag_(v) {
-      if (nullptr == data_ || (*data_ & static_cast<uint32_t>(flag_))) {
+    inline flag_guard_type(flags_holder_type *flags, flag_type v) : data_(flags), flag_(v) {
+      if (nullptr == data_ || (data_->fetch_or(static_cast<uint32_t>(flag_)) & static_cast<uint32_t>(flag_))) {
         flag_ = flag_type::kNone;
         data_ = nullptr;
-      } else {
-        (*data_) |= static_cast<uint32_t>(flag_);
       }
     }
     inline ~flag_guard_type() {
       if (*this) {
-        (*data_) &= ~static_cast<uint32_t>(flag_);
+        data_->fetch_and(~static_cast<uint32_t>(flag_));
       }
     }
 
@@ -908,7 +1259,7 @@ class LIBCOPP_COTASK_API_HEAD_ONLY task_manager<task_future<TVALUE, TPRIVATE_DAT
   };
 
  public:
-  task_manager() : flags_(0) {
+  task_manager() : pending_expire_count_(0), flags_(0) {
     last_tick_time_.tv_sec = 0;
     last_tick_time_.tv_nsec = 0;
   }
@@ -939,9 +1290,10 @@ class LIBCOPP_COTASK_API_HEAD_ONLY task_manager<task_future<TVALUE, TPRIVATE_DAT
 
       tasks_.clear();
       task_timeout_timer_.clear();
-      flags_ = 0;
+      flags_.store(0);
       last_tick_time_.tv_sec = 0;
       last_tick_time_.tv_nsec = 0;
+      pending_expire_count_ = 0;
     }
 
     // then, kill all tasks
@@ -967,6 +1319,7 @@ class LIBCOPP_COTASK_API_HEAD_ONLY task_manager<task_future<TVALUE, TPRIVATE_DAT
   /**
    * @brief add task to manager
    *        please make the task has method of get_id() and will return a unique id
+   *        it's disabled when task_container_slot_map is used, because the key is allocated by container
    *
    * @param task task to be inserted
    * @param timeout_sec timeout in second ( unix time stamp recommanded )
@@ -978,6 +1331,22 @@ class LIBCOPP_COTASK_API_HEAD_ONLY task_manager<task_future<TVALUE, TPRIVATE_DAT
    * @see tick
    */
   int add_task(const task_type &task, time_t timeout_sec, int timeout_nsec) noexcept {
+    static_assert(!TCONTAINER::allocate_task_id::value,
+                  "task key is allocated by container, use add_task(task, timeout_sec, timeout_nsec, &task_id)");
+    return add_task(task, timeout_sec, timeout_nsec, nullptr);
+  }
+
+  /**
+   * @brief add task to manager
+   *
+   * @param task task to be inserted
+   * @param timeout_sec timeout in second ( unix time stamp recommanded )
+   * @param timeout_nsec timeout in nanosecond ( must be in the range 0-999999999 )
+   * @param task_id where to store the id used to access the task in this manager, it's task.get_id() unless
+   *        task_container_slot_map is used
+   * @return 0 or error code
+   */
+  int add_task(const task_type &task, time_t timeout_sec, int timeout_nsec, id_type *task_id) noexcept {
     if (flags_ & static_cast<uint32_t>(flag_type::kTimerReset)) {
       return LIBCOPP_COPP_NAMESPACE_ID::COPP_EC_IN_RESET;
     }
@@ -987,8 +1356,7 @@ class LIBCOPP_COTASK_API_HEAD_ONLY task_manager<task_future<TVALUE, TPRIVATE_DAT
     }
 
     // try to cast type
-    using pair_type = typename container_type::value_type;
-    detail::task_manager_node<task_type> task_node;
+    node_type task_node;
     task_node.task_ = task;
     task_node.timer_node = task_timeout_timer_.end();
 
@@ -998,42 +1366,49 @@ class LIBCOPP_COTASK_API_HEAD_ONLY task_manager<task_future<TVALUE, TPRIVATE_DAT
         action_lock_};
 #  endif
 
-    id_type task_id = task.get_id();
-    if (tasks_.end() != tasks_.find(task_id)) {
+    // try to insert to container
+    std::pair<typename container_type::iterator, bool> res = tasks_.emplace(task.get_id(), task_node);
+    if (false == res.second) {
+      if (tasks_.end() == res.first) {
+        return LIBCOPP_COPP_NAMESPACE_ID::COPP_EC_EXTERNAL_INSERT_FAILED;
+      }
       return LIBCOPP_COPP_NAMESPACE_ID::COPP_EC_ALREADY_EXIST;
     }
 
+    // the id may be allocated by container
+    id_type manager_task_id = res.first->first;
+
 #  if defined(LIBCOTASK_MACRO_AUTO_CLEANUP_MANAGER) && LIBCOTASK_MACRO_AUTO_CLEANUP_MANAGER
     using task_manager_helper = typename task_type::task_manager_helper;
     if (!task_manager_helper::setup_task_manager(*task.get_context(), reinterpret_cast<void *>(this),
-                                                 &task_cleanup_callback)) {
+                                                 &task_cleanup_callback, manager_task_id)) {
+      tasks_.erase(res.first);
       return LIBCOPP_COPP_NAMESPACE_ID::COPP_EC_TASK_ALREADY_IN_ANOTHER_MANAGER;
     }
 #  endif
 
-    // try to insert to container
-    std::pair<typename container_type::iterator, bool> res = tasks_.insert(pair_type(task_id, task_node));
-    if (false == res.second) {
-#  if defined(LIBCOTASK_MACRO_AUTO_CLEANUP_MANAGER) && LIBCOTASK_MACRO_AUTO_CLEANUP_MANAGER
-      task_manager_helper::cleanup_task_manager(*task.get_context(), reinterpret_cast<void *>(this));
-#  endif
-      return LIBCOPP_COPP_NAMESPACE_ID::COPP_EC_EXTERNAL_INSERT_FAILED;
-    }
-
     // add timeout controller
-    set_timeout_timer(res.first->second, timeout_sec, timeout_nsec);
+    set_timeout_timer(manager_task_id, res.first->second, timeout_sec, timeout_nsec);
+    if (nullptr != task_id) {
+      *task_id = manager_task_id;
+    }
     return LIBCOPP_COPP_NAMESPACE_ID::COPP_EC_SUCCESS;
   }
 
   /**
    * @brief add task to manager
    *        please make the task has method of get_id() and will return a unique id
+   *        it's disabled when task_container_slot_map is used, because the key is allocated by container
    *
    * @param task task to be inserted
    * @return 0 or error code
    *
    */
-  int add_task(const task_type &task) noexcept { return add_task(task, 0, 0); }
+  int add_task(const task_type &task) noexcept {
+    static_assert(!TCONTAINER::allocate_task_id::value,
+                  "task key is allocated by container, use add_task(task, timeout_sec, timeout_nsec, &task_id)");
+    return add_task(task, 0, 0, nullptr);
+  }
 
   /**
    * @brief set or update task timeout
@@ -1064,7 +1439,7 @@ class LIBCOPP_COTASK_API_HEAD_ONLY task_manager<task_future<TVALUE, TPRIVATE_DAT
       iter_type iter = tasks_.find(id);
       if (tasks_.end() == iter) return LIBCOPP_COPP_NAMESPACE_ID::COPP_EC_NOT_FOUND;
 
-      set_timeout_timer(iter->second, timeout_sec, timeout_nsec);
+      set_timeout_timer(id, iter->second, timeout_sec, timeout_nsec);
     }
 
     return LIBCOPP_COPP_NAMESPACE_ID::COPP_EC_SUCCESS;
@@ -1272,6 +1647,61 @@ class LIBCOPP_COTASK_API_HEAD_ONLY task_manager<task_future<TVALUE, TPRIVATE_DAT
 
   int kill(id_type id) { return kill(id, task_status_type::kKilled); }
 
+  /**
+   * @brief start tasks by id, the lock is taken once for every BATCH_CHUNK_SIZE ids
+   * @param items task ids
+   * @param results error code of every item, it will be ignored if it's shorter than items
+   * @return number of tasks which are started successfully
+   */
+  size_t start_batch(LIBCOPP_COPP_NAMESPACE_ID::gsl::span<const batch_item_type> items,
+                     LIBCOPP_COPP_NAMESPACE_ID::gsl::span<int> results = LIBCOPP_COPP_NAMESPACE_ID::gsl::span<int>()) {
+    return dispatch_batch(
+        items, results, false, [&](size_t begin, LIBCOPP_COPP_NAMESPACE_ID::gsl::span<task_type> task_insts) {
+          size_t ret = 0;
+          for (size_t i = 0; i < task_insts.size(); ++i) {
+            if (!task_insts[i].get_context()) {
+              continue;
+            }
+
+            task_insts[i].start();
+            set_batch_result(results, begin + i, LIBCOPP_COPP_NAMESPACE_ID::COPP_EC_SUCCESS);
+            ++ret;
+          }
+          return ret;
+        });
+  }
+
+  /**
+   * @brief kill tasks by id, the lock is taken once for every BATCH_CHUNK_SIZE ids
+   * @param items task ids
+   * @param target_status status of killed tasks
+   * @param results error code of every item, it will be ignored if it's shorter than items
+   * @return number of tasks which are killed successfully
+   */
+  size_t kill_batch(LIBCOPP_COPP_NAMESPACE_ID::gsl::span<const batch_item_type> items, task_status_type target_status,
+                    LIBCOPP_COPP_NAMESPACE_ID::gsl::span<int> results = LIBCOPP_COPP_NAMESPACE_ID::gsl::span<int>()) {
+    // unlock and then run kill
+    return dispatch_batch(
+        items, results, true, [&](size_t begin, LIBCOPP_COPP_NAMESPACE_ID::gsl::span<task_type> task_insts) {
+          size_t ret = 0;
+          for (size_t i = 0; i < task_insts.size(); ++i) {
+            if (!task_insts[i].get_context()) {
+              continue;
+            }
+
+#  if defined(LIBCOTASK_MACRO_AUTO_CLEANUP_MANAGER) && LIBCOTASK_MACRO_AUTO_CLEANUP_MANAGER
+            using task_manager_helper = typename task_type::task_manager_helper;
+            // already cleanup, there is no need to cleanup again
+            task_manager_helper::cleanup_task_manager(*task_insts[i].get_context(), reinterpret_cast<void *>(this));
+#  endif
+            task_insts[i].kill(target_status);
+            set_batch_result(results, begin + i, LIBCOPP_COPP_NAMESPACE_ID::COPP_EC_SUCCESS);
+            ++ret;
+          }
+          return ret;
+        });
+  }
+
   /**
    * @brief active tick event and deal with clock
    * @param sec current time in second ( unix time stamp recommanded )
@@ -1280,15 +1710,40 @@ class LIBCOPP_COTASK_API_HEAD_ONLY task_manager<task_future<TVALUE, TPRIVATE_DAT
    *
    * @note timeout tasks will be removed here
    */
-  int tick(time_t sec, int nsec = 0) {
+  int tick(time_t sec, int nsec = 0) { return tick(sec, nsec, (std::numeric_limits<size_t>::max)(), nullptr); }
+
+  /**
+   * @brief active tick event and deal with clock, at most max_expire timeout tasks will be removed
+   * @param sec current time in second ( unix time stamp recommanded )
+   * @param nsec current time in nanosecond ( must be in the range 0-999999999 )
+   * @param max_expire max number of timeout tasks to remove in this call
+   * @param pending_expire_count where to store the number of timeout tasks carried over to next tick
+   * @param expired_count where to store the number of timeout checkpoints taken from max_expire in this call
+   * @return 0 or error code
+   *
+   * @note the carried over tasks will be removed by next tick, even if the time is not changed
+   */
+  int tick(time_t sec, int nsec, size_t max_expire, size_t *pending_expire_count = nullptr,
+           size_t *expired_count = nullptr) {
+    if (nullptr != pending_expire_count) {
+      *pending_expire_count = pending_expire_count_;
+    }
+    if (nullptr != expired_count) {
+      *expired_count = 0;
+    }
+
     detail::tickspec_t now_tick_time;
-    // time can not be back
+    // time can not be back, but timeout tasks carried over by last tick should still be removed
     if (sec < last_tick_time_.tv_sec || (sec == last_tick_time_.tv_sec && nsec <= last_tick_time_.tv_nsec)) {
-      return 0;
-    }
+      if (0 == pending_expire_count_) {
+        return 0;
+      }
 
-    now_tick_time.tv_sec = sec;
-    now_tick_time.tv_nsec = nsec;
+      now_tick_time = last_tick_time_;
+    } else {
+      now_tick_time.tv_sec = sec;
+      now_tick_time.tv_nsec = nsec;
+    }
 
     // we will ignore tick when in a recursive call
     flag_guard_type tick_flag(&flags_, flag_type::kTimerTick);
@@ -1308,32 +1763,32 @@ class LIBCOPP_COTASK_API_HEAD_ONLY task_manager<task_future<TVALUE, TPRIVATE_DAT
           action_lock_};
 #  endif
 
-      std::set<detail::task_timer_node<id_type>> real_checkpoints;
-      for (typename std::set<detail::task_timer_node<id_type>>::iterator iter = task_timeout_timer_.begin();
-           task_timeout_timer_.end() != iter; ++iter) {
-        detail::task_timer_node<id_type> new_checkpoint = (*iter);
-        new_checkpoint.expired_time.tv_sec += sec;
-        new_checkpoint.expired_time.tv_nsec += nsec;
-        real_checkpoints.insert(new_checkpoint);
-      }
-
-      task_timeout_timer_.swap(real_checkpoints);
-      for (typename std::set<detail::task_timer_node<id_type>>::iterator iter = task_timeout_timer_.begin();
-           task_timeout_timer_.end() != iter; ++iter) {
-        const typename std::set<detail::task_timer_node<id_type>>::value_type &checkpoint = *iter;
+      task_timeout_timer_.rebase(now_tick_time, [this](id_type task_id, typename timer_type::handle_type handle) {
         using co_iter_type = typename container_type::iterator;
-        co_iter_type  co_iter = tasks_.find(checkpoint.task_id);
+        co_iter_type co_iter = tasks_.find(task_id);
 
         if (tasks_.end() != co_iter) {
-          co_iter->second.timer_node = iter;
+          co_iter->second.timer_node = handle;
         }
-      }
+      });
       last_tick_time_ = now_tick_time;
       return LIBCOPP_COPP_NAMESPACE_ID::COPP_EC_SUCCESS;
     }
 
+    // turn the timer to now and collect all expired checkpoints
+    {
+      // hold lock
+#  if !defined(LIBCOPP_DISABLE_ATOMIC_LOCK) || !(LIBCOPP_DISABLE_ATOMIC_LOCK)
+      LIBCOPP_COPP_NAMESPACE_ID::util::lock::lock_holder<LIBCOPP_COPP_NAMESPACE_ID::util::lock::spin_lock> lock_guard{
+          action_lock_};
+#  endif
+
+      task_timeout_timer_.advance(now_tick_time);
+    }
+
     // remove timeout tasks
-    while (false == task_timeout_timer_.empty()) {
+    size_t expired_number = 0;
+    while (true) {
       task_type task_inst;
 
       {
@@ -1343,25 +1798,34 @@ class LIBCOPP_COTASK_API_HEAD_ONLY task_manager<task_future<TVALUE, TPRIVATE_DAT
             action_lock_};
 #  endif
 
-        const typename std::set<detail::task_timer_node<id_type>>::value_type &timer_node =
-            *task_timeout_timer_.begin();
+        // the rest timeout tasks are carried over to next tick
+        if (expired_number >= max_expire) {
+          pending_expire_count_ = task_timeout_timer_.count_expired(now_tick_time);
+          break;
+        }
+
+        id_type task_id;
         // all tasks those expired time less than now are timeout
-        if (now_tick_time <= timer_node.expired_time) {
+        if (!task_timeout_timer_.pop_expired(now_tick_time, task_id)) {
+          pending_expire_count_ = 0;
           break;
         }
+        ++expired_number;
 
-        // check expire time(may be changed)
         using iter_type = typename container_type::iterator;
 
-        iter_type iter = tasks_.find(timer_node.task_id);
-
-        if (tasks_.end() != iter) {
-          // task may be removed before
-          task_inst = std::move(iter->second.task_);
+        iter_type iter = tasks_.find(task_id);
 
-          remove_timeout_timer(iter->second);
-          tasks_.erase(iter);  // remove from container
+        // task may be removed before, an empty task_future has no context to check or kill
+        if (tasks_.end() == iter) {
+          continue;
         }
+
+        task_inst = std::move(iter->second.task_);
+
+        // the checkpoint is already removed
+        iter->second.timer_node = task_timeout_timer_.end();
+        tasks_.erase(iter);  // remove from container
       }
 
       // task call can not be used when lock is on
@@ -1375,7 +1839,20 @@ class LIBCOPP_COTASK_API_HEAD_ONLY task_manager<task_future<TVALUE, TPRIVATE_DAT
       }
     }
 
-    last_tick_time_ = now_tick_time;
+    {
+      // producers read last_tick_time_ in set_timeout_timer(...) with lock
+#  if !defined(LIBCOPP_DISABLE_ATOMIC_LOCK) || !(LIBCOPP_DISABLE_ATOMIC_LOCK)
+      LIBCOPP_COPP_NAMESPACE_ID::util::lock::lock_holder<LIBCOPP_COPP_NAMESPACE_ID::util::lock::spin_lock> lock_guard{
+          action_lock_};
+#  endif
+      last_tick_time_ = now_tick_time;
+    }
+    if (nullptr != pending_expire_count) {
+      *pending_expire_count = pending_expire_count_;
+    }
+    if (nullptr != expired_count) {
+      *expired_count = expired_number;
+    }
     return LIBCOPP_COPP_NAMESPACE_ID::COPP_EC_SUCCESS;
   }
 
@@ -1385,6 +1862,18 @@ class LIBCOPP_COTASK_API_HEAD_ONLY task_manager<task_future<TVALUE, TPRIVATE_DAT
    */
   size_t get_tick_checkpoint_size() const LIBCOPP_MACRO_NOEXCEPT { return task_timeout_timer_.size(); }
 
+  /**
+   * @brief check if there are timeout tasks carried over by last tick
+   * @return true if the next tick will remove carried over timeout tasks even if the time is not changed
+   */
+  bool has_pending_expire() const LIBCOPP_MACRO_NOEXCEPT { return 0 != pending_expire_count_; }
+
+  /**
+   * @brief get the number of timeout tasks carried over by last tick
+   * @return number of timeout tasks which will be removed by next tick, even if the time is not changed
+   */
+  size_t get_pending_expire_count() const LIBCOPP_MACRO_NOEXCEPT { return pending_expire_count_; }
+
   /**
    * @brief get task number in this manager
    * @return task number
@@ -1407,12 +1896,12 @@ class LIBCOPP_COTASK_API_HEAD_ONLY task_manager<task_future<TVALUE, TPRIVATE_DAT
    * @brief get all task checkpoints, this api is just used for provide information to users
    * @return task checkpoints
    */
-  inline const std::set<detail::task_timer_node<id_type>> &get_checkpoints() const LIBCOPP_MACRO_NOEXCEPT {
-    return task_timeout_timer_;
+  inline typename timer_type::checkpoints_result_type get_checkpoints() const {
+    return task_timeout_timer_.get_checkpoints();
   }
 
  private:
-  void set_timeout_timer(detail::task_manager_node<task_type> &node, time_t timeout_sec, int timeout_nsec) {
+  void set_timeout_timer(id_type task_id, node_type &node, time_t timeout_sec, int timeout_nsec) {
     remove_timeout_timer(node);
 
     if (timeout_sec <= 0 && timeout_nsec <= 0) {
@@ -1424,18 +1913,157 @@ class LIBCOPP_COTASK_API_HEAD_ONLY task_manager<task_future<TVALUE, TPRIVATE_DAT
     }
 
     detail::task_timer_node<id_type> timer_node;
-    timer_node.task_id = node.task_.get_id();
-    timer_node.expired_time.tv_sec = last_tick_time_.tv_sec + timeout_sec;
-    timer_node.expired_time.tv_nsec = last_tick_time_.tv_nsec + timeout_nsec;
+    timer_node.task_id = task_id;
+    timer_node.expired_time = detail::make_tickspec(last_tick_time_.tv_sec + timeout_sec,
+                                                    static_cast<int64_t>(last_tick_time_.tv_nsec) + timeout_nsec);
+
+    node.timer_node = task_timeout_timer_.insert(timer_node);
+  }
+
+  UTIL_FORCEINLINE static void set_batch_result(LIBCOPP_COPP_NAMESPACE_ID::gsl::span<int> results, size_t index,
+                                               int res) noexcept {
+    if (index < results.size()) {
+      results[index] = res;
+    }
+  }
+
+  /**
+   * @brief resolve tasks of a batch in chunks of BATCH_CHUNK_SIZE on the stack, and then call fn for every chunk
+   * @param erase remove resolved tasks from manager, or else remove finished tasks after fn
+   * @param fn size_t(size_t begin, gsl::span<task_type> task_insts), task_insts[i] is the task of items[begin + i]
+   * @note Nothing is allocated here, and the lock is taken once for every chunk.
+   */
+  template <class TFN>
+  size_t dispatch_batch(LIBCOPP_COPP_NAMESPACE_ID::gsl::span<const batch_item_type> items,
+                        LIBCOPP_COPP_NAMESPACE_ID::gsl::span<int> results, bool erase, TFN &&fn) {
+    task_type task_insts[BATCH_CHUNK_SIZE];
+    size_t ret = 0;
+    for (size_t begin = 0; begin < items.size(); begin += BATCH_CHUNK_SIZE) {
+      size_t count = items.size() - begin;
+      if (count > BATCH_CHUNK_SIZE) {
+        count = BATCH_CHUNK_SIZE;
+      }
+
+      LIBCOPP_COPP_NAMESPACE_ID::gsl::span<const batch_item_type> chunk_items(items.data() + begin, count);
+      LIBCOPP_COPP_NAMESPACE_ID::gsl::span<task_type> chunk_tasks(task_insts, count);
+      LIBCOPP_COPP_NAMESPACE_ID::gsl::span<int> chunk_results;
+      if (begin < results.size()) {
+        chunk_results = LIBCOPP_COPP_NAMESPACE_ID::gsl::span<int>(results.data() + begin,
+                                                                  (std::min)(count, results.size() - begin));
+      }
+
+      if (!resolve_batch(chunk_items, chunk_results, chunk_tasks, erase)) {
+        for (size_t i = begin; i < items.size(); ++i) {
+          set_batch_result(results, i, LIBCOPP_COPP_NAMESPACE_ID::COPP_EC_IN_RESET);
+        }
+        break;
+      }
+
+      ret += fn(begin, chunk_tasks);
+      if (!erase) {
+        remove_finished_batch(chunk_items, chunk_tasks);
+      }
+
+      // release tasks of this chunk before the next one
+      for (size_t i = 0; i < count; ++i) {
+        task_insts[i] = task_type();
+      }
+    }
+
+    return ret;
+  }
+
+  /**
+   * @brief resolve all tasks of a chunk with one lock
+   * @param out tasks of every item, the task is empty and the result is set to COPP_EC_NOT_FOUND if not found
+   * @param erase remove resolved tasks from manager
+   * @return false if this manager is resetting
+   */
+  bool resolve_batch(LIBCOPP_COPP_NAMESPACE_ID::gsl::span<const batch_item_type> items,
+                     LIBCOPP_COPP_NAMESPACE_ID::gsl::span<int> results,
+                     LIBCOPP_COPP_NAMESPACE_ID::gsl::span<task_type> out, bool erase) {
+    if (flags_ & static_cast<uint32_t>(flag_type::kTimerReset)) {
+      return false;
+    }
+
+#  if !defined(LIBCOPP_DISABLE_ATOMIC_LOCK) || !(LIBCOPP_DISABLE_ATOMIC_LOCK)
+    LIBCOPP_COPP_NAMESPACE_ID::util::lock::lock_holder<LIBCOPP_COPP_NAMESPACE_ID::util::lock::spin_lock> lock_guard{
+        action_lock_};
+#  endif
+
+    using iter_type = typename container_type::iterator;
+    for (size_t i = 0; i < items.size(); ++i) {
+      iter_type iter = tasks_.find(items[i]);
+      if (tasks_.end() == iter || !iter->second.task_.get_context()) {
+        set_batch_result(results, i, LIBCOPP_COPP_NAMESPACE_ID::COPP_EC_NOT_FOUND);
+        continue;
+      }
 
-    std::pair<typename std::set<detail::task_timer_node<id_type>>::iterator, bool> res =
-        task_timeout_timer_.insert(timer_node);
-    if (res.second) {
-      node.timer_node = res.first;
+      if (erase) {
+        out[i] = std::move(iter->second.task_);
+        remove_timeout_timer(iter->second);
+        tasks_.erase(iter);
+      } else {
+        out[i] = iter->second.task_;
+      }
     }
+
+    return true;
   }
 
-  void remove_timeout_timer(detail::task_manager_node<task_type> &node) {
+  /**
+   * @brief remove finished tasks of a batch with one lock
+   */
+  void remove_finished_batch(LIBCOPP_COPP_NAMESPACE_ID::gsl::span<const batch_item_type> items,
+                             LIBCOPP_COPP_NAMESPACE_ID::gsl::span<task_type> task_insts) {
+    size_t finished_count = 0;
+    for (size_t i = 0; i < task_insts.size(); ++i) {
+      if (task_insts[i].get_context() && task_insts[i].is_exiting()) {
+        ++finished_count;
+      } else {
+        task_insts[i] = task_type();
+      }
+    }
+
+    if (0 == finished_count) {
+      return;
+    }
+
+    {
+#  if !defined(LIBCOPP_DISABLE_ATOMIC_LOCK) || !(LIBCOPP_DISABLE_ATOMIC_LOCK)
+      LIBCOPP_COPP_NAMESPACE_ID::util::lock::lock_holder<LIBCOPP_COPP_NAMESPACE_ID::util::lock::spin_lock> lock_guard{
+          action_lock_};
+#  endif
+
+      using iter_type = typename container_type::iterator;
+      for (size_t i = 0; i < task_insts.size(); ++i) {
+        if (!task_insts[i].get_context()) {
+          continue;
+        }
+
+        // task may be removed or replaced when running
+        iter_type iter = tasks_.find(items[i]);
+        if (tasks_.end() == iter || iter->second.task_.get_context() != task_insts[i].get_context()) {
+          task_insts[i] = task_type();
+          continue;
+        }
+
+        remove_timeout_timer(iter->second);
+        tasks_.erase(iter);
+      }
+    }
+
+#  if defined(LIBCOTASK_MACRO_AUTO_CLEANUP_MANAGER) && LIBCOTASK_MACRO_AUTO_CLEANUP_MANAGER
+    using task_manager_helper = typename task_type::task_manager_helper;
+    for (size_t i = 0; i < task_insts.size(); ++i) {
+      if (task_insts[i].get_context()) {
+        task_manager_helper::cleanup_task_manager(*task_insts[i].get_context(), reinterpret_cast<void *>(this));
+      }
+    }
+#  endif
+  }
+
+  void remove_timeout_timer(node_type &node) {
     if (node.timer_node != task_timeout_timer_.end()) {
       task_timeout_timer_.erase(node.timer_node);
       node.timer_node = task_timeout_timer_.end();
@@ -1448,19 +2076,23 @@ class LIBCOPP_COTASK_API_HEAD_ONLY task_manager<task_future<TVALUE, TPRIVATE_DAT
       return;
     }
 
-    reinterpret_cast<self_type *>(self_ptr)->remove_task(task_inst.get_id(), &task_inst);
+    using task_manager_helper = typename task_type::task_manager_helper;
+    reinterpret_cast<self_type *>(self_ptr)->remove_task(task_manager_helper::get_task_manager_key(task_inst),
+                                                         &task_inst);
   }
 #  endif
 
  private:
   container_type tasks_;
   detail::tickspec_t last_tick_time_;
-  std::set<detail::task_timer_node<id_type>> task_timeout_timer_;
+  timer_type task_timeout_timer_;
+  // number of timeout tasks carried over by tick(sec, nsec, max_expire)
+  size_t pending_expire_count_;
 
 #  if !defined(LIBCOPP_DISABLE_ATOMIC_LOCK) || !(LIBCOPP_DISABLE_ATOMIC_LOCK)
   LIBCOPP_COPP_NAMESPACE_ID::util::lock::spin_lock action_lock_;
 #  endif
-  uint32_t flags_;
+  flags_holder_type flags_;
 };
 #endif
 
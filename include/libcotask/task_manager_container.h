@@ -0,0 +1,187 @@
+// Copyright 2023 owent
+
+#pragma once
+
+#include <libcopp/utils/config/libcopp_build_features.h>
+
+// clang-format off
+#include <libcopp/utils/config/stl_include_prefix.h>  // NOLINT(build/include_order)
+// clang-format on
+#include <stdint.h>
+#include <cstddef>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+// clang-format off
+#include <libcopp/utils/config/stl_include_suffix.h>  // NOLINT(build/include_order)
+// clang-format on
+
+LIBCOPP_COTASK_NAMESPACE_BEGIN
+
+/**
+ * @brief dense slot map, the key is allocated by the container and encodes slot index(low 32 bits) and
+ *        generation(high 32 bits)
+ * @note find(...) is a array index with a generation check, values are stored continuously and iterators are
+ *       invalidated by emplace(...) and erase(...)
+ */
+template <class TKEY, class TVALUE>
+class LIBCOPP_COTASK_API_HEAD_ONLY task_slot_map {
+ public:
+  using key_type = TKEY;
+  using mapped_type = TVALUE;
+  using value_type = std::pair<key_type, mapped_type>;
+  using size_type = size_t;
+  using iterator = typename std::vector<value_type>::iterator;
+  using const_iterator = typename std::vector<value_type>::const_iterator;
+
+  static_assert(sizeof(key_type) >= sizeof(uint64_t), "key of task_slot_map must has at least 64 bits");
+
+ private:
+  struct slot_type {
+    uint32_t generation;
+    // index in values_ if used, or next free slot if not used
+    uint32_t index;
+  };
+
+  UTIL_FORCEINLINE static uint32_t npos() LIBCOPP_MACRO_NOEXCEPT { return static_cast<uint32_t>(-1); }
+
+ public:
+  task_slot_map() : free_head_(npos()) {}
+
+  UTIL_FORCEINLINE iterator begin() LIBCOPP_MACRO_NOEXCEPT { return values_.begin(); }
+  UTIL_FORCEINLINE iterator end() LIBCOPP_MACRO_NOEXCEPT { return values_.end(); }
+  UTIL_FORCEINLINE const_iterator begin() const LIBCOPP_MACRO_NOEXCEPT { return values_.begin(); }
+  UTIL_FORCEINLINE const_iterator end() const LIBCOPP_MACRO_NOEXCEPT { return values_.end(); }
+
+  UTIL_FORCEINLINE size_type size() const LIBCOPP_MACRO_NOEXCEPT { return values_.size(); }
+  UTIL_FORCEINLINE bool empty() const LIBCOPP_MACRO_NOEXCEPT { return values_.empty(); }
+
+  void reserve(size_type n) {
+    values_.reserve(n);
+    slots_.reserve(n);
+  }
+
+  /**
+   * @brief insert a value with a new key
+   * @note the key argument is ignored, it's only used to keep the same API as std::unordered_map.
+   *       get the allocated key from iterator->first.
+   * @return the iterator of inserted value and true, or end() and false if there is no slot left
+   */
+  template <class TARG>
+  std::pair<iterator, bool> emplace(const key_type &, TARG &&value) {
+    uint32_t slot_index;
+    if (npos() != free_head_) {
+      slot_index = free_head_;
+      free_head_ = slots_[slot_index].index;
+    } else {
+      if (slots_.size() >= static_cast<size_t>(npos())) {
+        return std::pair<iterator, bool>(values_.end(), false);
+      }
+
+      slot_index = static_cast<uint32_t>(slots_.size());
+      slot_type slot;
+      slot.generation = 1;
+      slot.index = npos();
+      slots_.push_back(slot);
+    }
+
+    slot_type &slot = slots_[slot_index];
+    slot.index = static_cast<uint32_t>(values_.size());
+    values_.push_back(value_type(make_key(slot_index, slot.generation), std::forward<TARG>(value)));
+    return std::pair<iterator, bool>(values_.end() - 1, true);
+  }
+
+  iterator find(const key_type &key) LIBCOPP_MACRO_NOEXCEPT {
+    uint32_t slot_index = static_cast<uint32_t>(static_cast<uint64_t>(key));
+    if (slot_index >= slots_.size()) {
+      return values_.end();
+    }
+
+    // stale keys are rejected by generation, the key check also rejects keys pointing to a free slot
+    const slot_type &slot = slots_[slot_index];
+    if (slot.generation != static_cast<uint32_t>(static_cast<uint64_t>(key) >> 32) || slot.index >= values_.size() ||
+        values_[slot.index].first != key) {
+      return values_.end();
+    }
+
+    return values_.begin() + static_cast<ptrdiff_t>(slot.index);
+  }
+
+  const_iterator find(const key_type &key) const LIBCOPP_MACRO_NOEXCEPT {
+    return const_cast<task_slot_map *>(this)->find(key);
+  }
+
+  /**
+   * @brief erase a value, the last value will be moved into its position
+   */
+  void erase(iterator iter) {
+    uint32_t slot_index = static_cast<uint32_t>(static_cast<uint64_t>(iter->first));
+    size_t index = static_cast<size_t>(iter - values_.begin());
+    if (index + 1 != values_.size()) {
+      *iter = std::move(values_.back());
+      slots_[static_cast<uint32_t>(static_cast<uint64_t>(iter->first))].index = static_cast<uint32_t>(index);
+    }
+    values_.pop_back();
+
+    // bump generation so old keys will never be found again, and 0 is never used as a key
+    slot_type &slot = slots_[slot_index];
+    if (0 == ++slot.generation) {
+      slot.generation = 1;
+    }
+    slot.index = free_head_;
+    free_head_ = slot_index;
+  }
+
+  size_type erase(const key_type &key) {
+    iterator iter = find(key);
+    if (iter == values_.end()) {
+      return 0;
+    }
+
+    erase(iter);
+    return 1;
+  }
+
+  void clear() {
+    values_.clear();
+    slots_.clear();
+    free_head_ = npos();
+  }
+
+ private:
+  UTIL_FORCEINLINE static key_type make_key(uint32_t slot_index, uint32_t generation) LIBCOPP_MACRO_NOEXCEPT {
+    return static_cast<key_type>((static_cast<uint64_t>(generation) << 32) | slot_index);
+  }
+
+ private:
+  std::vector<value_type> values_;
+  std::vector<slot_type> slots_;
+  uint32_t free_head_;
+};
+
+/**
+ * @brief container selector of task_manager, tasks are indexed by task id in std::unordered_map(default)
+ */
+struct LIBCOPP_COTASK_API_HEAD_ONLY task_container_unordered_map {
+  // tasks are indexed by task->get_id()
+  using allocate_task_id = std::false_type;
+
+  template <class TKEY, class TVALUE>
+  using container_type = std::unordered_map<TKEY, TVALUE>;
+};
+
+/**
+ * @brief container selector of task_manager, tasks are stored in task_slot_map
+ * @note task_manager allocate a new id for every added task instead of using task's id,
+ *       use add_task(task, timeout_sec, timeout_nsec, &task_id) to get it.
+ */
+struct LIBCOPP_COTASK_API_HEAD_ONLY task_container_slot_map {
+  // the key of task is allocated by container, add_task(...) without task_id are disabled
+  using allocate_task_id = std::true_type;
+
+  template <class TKEY, class TVALUE>
+  using container_type = task_slot_map<TKEY, TVALUE>;
+};
+
+LIBCOPP_COTASK_NAMESPACE_END
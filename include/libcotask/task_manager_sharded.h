@@ -0,0 +1,468 @@
+// Copyright 2023 owent
+
+#pragma once
+
+#include <libcopp/utils/config/libcopp_build_features.h>
+
+// clang-format off
+#include <libcopp/utils/config/stl_include_prefix.h>  // NOLINT(build/include_order)
+// clang-format on
+#include <stdint.h>
+#include <cstddef>
+#include <ctime>
+#include <exception>
+#include <limits>
+#include <memory>
+#include <utility>
+// clang-format off
+#include <libcopp/utils/config/stl_include_suffix.h>  // NOLINT(build/include_order)
+// clang-format on
+
+#include "libcopp/utils/atomic_int_type.h"
+#include "libcopp/utils/errno.h"
+#include "libcopp/utils/features.h"
+#include "libcotask/task_manager.h"
+
+LIBCOPP_COTASK_NAMESPACE_BEGIN
+
+/**
+ * @brief task manager partitioned by task id
+ * @note every shard is a task_manager with it's own container, timer and lock, so producers on different threads
+ *       contend only when their tasks fall into the same shard.
+ * @note tasks are routed by task id(get_id()), so the task container is always task_container_unordered_map.
+ * @note TSHARD_COUNT must be a power of 2, ids allocated by uint64_id_allocator are sequential in the low bits, so
+ *       they are spread over all shards evenly.
+ * @note the task APIs of task_manager are forwarded to shards, but get_container() and get_checkpoints() are not
+ *       provided because every shard has it's own container and timer, use get_shard(i).get_container() and
+ *       get_shard(i).get_checkpoints() instead.
+ */
+template <typename TTask, size_t TSHARD_COUNT = 16, typename TTIMER = task_timer_set<typename TTask::id_type>>
+class LIBCOPP_COTASK_API_HEAD_ONLY task_manager_sharded {
+ public:
+  using task_type = TTask;
+  using timer_type = TTIMER;
+  using shard_type = task_manager<task_type, timer_type>;
+  using id_type = typename shard_type::id_type;
+  using batch_item_type = typename shard_type::batch_item_type;
+  using self_type = task_manager_sharded<task_type, TSHARD_COUNT, timer_type>;
+  using ptr_type = std::shared_ptr<self_type>;
+
+  static_assert(TSHARD_COUNT > 0 && 0 == (TSHARD_COUNT & (TSHARD_COUNT - 1)), "TSHARD_COUNT must be a power of 2");
+  static constexpr const size_t shard_count = TSHARD_COUNT;
+
+ private:
+  // keep locks of shards in different cache lines
+  struct alignas(COPP_MACRO_CACHE_LINE_SIZE) shard_holder_type {
+    shard_type manager;
+  };
+
+  task_manager_sharded(const task_manager_sharded &) = delete;
+  task_manager_sharded &operator=(const task_manager_sharded &) = delete;
+
+ public:
+  task_manager_sharded() : next_tick_shard_(0) {}
+
+  /**
+   * @brief create a new sharded task manager
+   * @return smart pointer of task manager
+   */
+  static ptr_type create() { return std::make_shared<self_type>(); }
+
+  /**
+   * @brief reset all shards and kill all tasks
+   */
+  void reset() {
+    for (size_t i = 0; i < shard_count; ++i) {
+      shards_[i].manager.reset();
+    }
+  }
+
+  /**
+   * @brief get the shard index of a task id
+   * @param id task id
+   * @return shard index
+   */
+  UTIL_FORCEINLINE static size_t get_shard_index(id_type id) LIBCOPP_MACRO_NOEXCEPT {
+    return static_cast<size_t>(static_cast<uint64_t>(id) & static_cast<uint64_t>(shard_count - 1));
+  }
+
+  UTIL_FORCEINLINE shard_type &get_shard(size_t index) LIBCOPP_MACRO_NOEXCEPT { return shards_[index].manager; }
+  UTIL_FORCEINLINE const shard_type &get_shard(size_t index) const LIBCOPP_MACRO_NOEXCEPT {
+    return shards_[index].manager;
+  }
+
+  /**
+   * @brief add task to manager, see task_manager::add_task(...)
+   * @param task task to be inserted
+   * @param args timeout_sec and timeout_nsec, or nothing
+   * @return 0 or error code
+   */
+  template <class TTASK_ARG, class... TARGS>
+  int add_task(const TTASK_ARG &task, TARGS &&...args) {
+    return get_shard(get_shard_index(get_task_id(task))).add_task(task, std::forward<TARGS>(args)...);
+  }
+
+  /**
+   * @brief set or update task timeout, see task_manager::set_timeout(...)
+   * @return 0 or error code
+   */
+  int set_timeout(id_type id, time_t timeout_sec, int timeout_nsec) {
+    return get_shard(get_shard_index(id)).set_timeout(id, timeout_sec, timeout_nsec);
+  }
+
+  /**
+   * @brief remove task in this manager, see task_manager::remove_task(...)
+   * @return 0 or error code
+   */
+  template <class... TARGS>
+  int remove_task(id_type id, TARGS &&...args) {
+    return get_shard(get_shard_index(id)).remove_task(id, std::forward<TARGS>(args)...);
+  }
+
+  /**
+   * @brief find task by id, see task_manager::find_task(...)
+   */
+  auto find_task(id_type id) -> decltype(std::declval<shard_type &>().find_task(id)) {
+    return get_shard(get_shard_index(id)).find_task(id);
+  }
+
+  /**
+   * @brief start task, see task_manager::start(...)
+   * @return 0 or error code
+   */
+  template <class... TARGS>
+  int start(id_type id, TARGS &&...args) {
+    return get_shard(get_shard_index(id)).start(id, std::forward<TARGS>(args)...);
+  }
+
+  /**
+   * @brief resume task, see task_manager::resume(...)
+   * @return 0 or error code
+   */
+  template <class... TARGS>
+  int resume(id_type id, TARGS &&...args) {
+    return get_shard(get_shard_index(id)).resume(id, std::forward<TARGS>(args)...);
+  }
+
+  /**
+   * @brief cancel task, see task_manager::cancel(...)
+   * @return 0 or error code
+   */
+  template <class... TARGS>
+  int cancel(id_type id, TARGS &&...args) {
+    return get_shard(get_shard_index(id)).cancel(id, std::forward<TARGS>(args)...);
+  }
+
+  /**
+   * @brief kill task, see task_manager::kill(...)
+   * @return 0 or error code
+   */
+  template <class... TARGS>
+  int kill(id_type id, TARGS &&...args) {
+    return get_shard(get_shard_index(id)).kill(id, std::forward<TARGS>(args)...);
+  }
+
+  /**
+   * @brief start tasks by id, items are grouped by shard and every shard is locked once, see
+   *        task_manager::start_batch(...)
+   * @return number of tasks which are started successfully
+   */
+  size_t start_batch(LIBCOPP_COPP_NAMESPACE_ID::gsl::span<const batch_item_type> items,
+                     LIBCOPP_COPP_NAMESPACE_ID::gsl::span<int> results = LIBCOPP_COPP_NAMESPACE_ID::gsl::span<int>()) {
+    return dispatch_batch(items, results,
+                          [](shard_type &shard, LIBCOPP_COPP_NAMESPACE_ID::gsl::span<const batch_item_type> shard_items,
+                             LIBCOPP_COPP_NAMESPACE_ID::gsl::span<int> shard_results) {
+                            return shard.start_batch(shard_items, shard_results);
+                          });
+  }
+
+  /**
+   * @brief resume tasks by id, items are grouped by shard and every shard is locked once, see
+   *        task_manager::resume_batch(...)
+   * @return number of tasks which are resumed successfully
+   */
+  size_t resume_batch(LIBCOPP_COPP_NAMESPACE_ID::gsl::span<const batch_item_type> items,
+                      LIBCOPP_COPP_NAMESPACE_ID::gsl::span<int> results = LIBCOPP_COPP_NAMESPACE_ID::gsl::span<int>()) {
+    return dispatch_batch(items, results,
+                          [](shard_type &shard, LIBCOPP_COPP_NAMESPACE_ID::gsl::span<const batch_item_type> shard_items,
+                             LIBCOPP_COPP_NAMESPACE_ID::gsl::span<int> shard_results) {
+                            return shard.resume_batch(shard_items, shard_results);
+                          });
+  }
+
+  /**
+   * @brief kill tasks by id, items are grouped by shard and every shard is locked once, see
+   *        task_manager::kill_batch(...)
+   * @return number of tasks which are killed successfully
+   */
+  template <class TSTATUS>
+  size_t kill_batch(LIBCOPP_COPP_NAMESPACE_ID::gsl::span<const batch_item_type> items, TSTATUS status,
+                    LIBCOPP_COPP_NAMESPACE_ID::gsl::span<int> results = LIBCOPP_COPP_NAMESPACE_ID::gsl::span<int>()) {
+    return dispatch_batch(items, results,
+                          [status](shard_type &shard,
+                                   LIBCOPP_COPP_NAMESPACE_ID::gsl::span<const batch_item_type> shard_items,
+                                   LIBCOPP_COPP_NAMESPACE_ID::gsl::span<int> shard_results) {
+                            return shard.kill_batch(shard_items, status, shard_results);
+                          });
+  }
+
+  /**
+   * @brief active tick event of all shards
+   * @param sec current time in second ( unix time stamp recommanded )
+   * @param nsec current time in nanosecond ( must be in the range 0-999999999 )
+   * @return 0 or the last error code of shards
+   *
+   * @note shards are ticked one by one, other shards are not locked when one shard is ticking
+   * @note if a killed task throws in one shard, the other shards are still ticked and then the first exception is
+   *       rethrown
+   */
+  int tick(time_t sec, int nsec = 0) {
+    int ret = LIBCOPP_COPP_NAMESPACE_ID::COPP_EC_SUCCESS;
+#if defined(LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR) && LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR
+    std::exception_ptr first_exception;
+#endif
+    for (size_t i = 0; i < shard_count; ++i) {
+#if defined(LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR) && LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR
+      int res = tick_shard(shards_[i].manager, first_exception, sec, nsec, (std::numeric_limits<size_t>::max)(),
+                           nullptr, nullptr);
+#else
+      int res = shards_[i].manager.tick(sec, nsec);
+#endif
+      if (res < 0) {
+        ret = res;
+      }
+    }
+
+#if defined(LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR) && LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR
+    if (first_exception) {
+      std::rethrow_exception(first_exception);
+    }
+#endif
+    return ret;
+  }
+
+  /**
+   * @brief active tick event of all shards, at most max_expire timeout tasks will be removed
+   * @param sec current time in second ( unix time stamp recommanded )
+   * @param nsec current time in nanosecond ( must be in the range 0-999999999 )
+   * @param max_expire max number of timeout tasks to remove in this call, shared by all shards
+   * @param pending_expire_count where to store the number of timeout tasks carried over to next tick by all shards
+   * @param expired_count where to store the number of timeout checkpoints taken from max_expire in this call
+   * @return 0 or the last error code of shards
+   *
+   * @note the first shard to tick is rotated, so shards at the end will not starve when the budget is exhausted
+   * @note if a killed task throws in one shard, the other shards are still ticked and the counters are still stored,
+   *       and then the first exception is rethrown
+   */
+  int tick(time_t sec, int nsec, size_t max_expire, size_t *pending_expire_count = nullptr,
+           size_t *expired_count = nullptr) {
+    int ret = LIBCOPP_COPP_NAMESPACE_ID::COPP_EC_SUCCESS;
+    size_t total_pending = 0;
+    size_t total_expired = 0;
+    // shard_count is a power of 2, so the wrapped counter still rotates over all shards
+    size_t start_index = next_tick_shard_.fetch_add(1) & (shard_count - 1);
+#if defined(LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR) && LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR
+    std::exception_ptr first_exception;
+#endif
+
+    for (size_t i = 0; i < shard_count; ++i) {
+      shard_type &shard = shards_[(start_index + i) & (shard_count - 1)].manager;
+      size_t pending = 0;
+      size_t expired = 0;
+#if defined(LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR) && LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR
+      int res = tick_shard(shard, first_exception, sec, nsec, max_expire, &pending, &expired);
+#else
+      int res = shard.tick(sec, nsec, max_expire, &pending, &expired);
+#endif
+      if (res < 0) {
+        ret = res;
+      }
+
+      // shards report what they really removed, tasks added by kill callbacks or other threads are not counted
+      max_expire = expired >= max_expire ? 0 : max_expire - expired;
+      total_expired += expired;
+      total_pending += pending;
+    }
+
+    if (nullptr != pending_expire_count) {
+      *pending_expire_count = total_pending;
+    }
+    if (nullptr != expired_count) {
+      *expired_count = total_expired;
+    }
+
+#if defined(LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR) && LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR
+    if (first_exception) {
+      std::rethrow_exception(first_exception);
+    }
+#endif
+    return ret;
+  }
+
+  /**
+   * @brief check if there are timeout tasks carried over by last tick of any shard
+   * @return true if the next tick will remove carried over timeout tasks even if the time is not changed
+   */
+  bool has_pending_expire() const LIBCOPP_MACRO_NOEXCEPT {
+    for (size_t i = 0; i < shard_count; ++i) {
+      if (shards_[i].manager.has_pending_expire()) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /**
+   * @brief get the number of timeout tasks carried over by last tick of all shards
+   * @return number of timeout tasks which will be removed by next ticks, even if the time is not changed
+   */
+  size_t get_pending_expire_count() const LIBCOPP_MACRO_NOEXCEPT {
+    size_t ret = 0;
+    for (size_t i = 0; i < shard_count; ++i) {
+      ret += shards_[i].manager.get_pending_expire_count();
+    }
+    return ret;
+  }
+
+  /**
+   * @brief get timeout checkpoint number of all shards
+   * @return checkpoint number
+   */
+  size_t get_tick_checkpoint_size() const LIBCOPP_MACRO_NOEXCEPT {
+    size_t ret = 0;
+    for (size_t i = 0; i < shard_count; ++i) {
+      ret += shards_[i].manager.get_tick_checkpoint_size();
+    }
+    return ret;
+  }
+
+  /**
+   * @brief get task number of all shards
+   * @return task number
+   */
+  size_t get_task_size() const LIBCOPP_MACRO_NOEXCEPT {
+    size_t ret = 0;
+    for (size_t i = 0; i < shard_count; ++i) {
+      ret += shards_[i].manager.get_task_size();
+    }
+    return ret;
+  }
+
+  /**
+   * @brief get last tick time
+   * @return last tick time
+   */
+  detail::tickspec_t get_last_tick_time() const LIBCOPP_MACRO_NOEXCEPT {
+    return shards_[0].manager.get_last_tick_time();
+  }
+
+ private:
+  UTIL_FORCEINLINE static id_type get_batch_item_id(const std::pair<id_type, void *> &item) LIBCOPP_MACRO_NOEXCEPT {
+    return item.first;
+  }
+
+  UTIL_FORCEINLINE static id_type get_batch_item_id(const id_type &item) LIBCOPP_MACRO_NOEXCEPT { return item; }
+
+#if defined(LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR) && LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR
+  /**
+   * @brief tick one shard and keep the first exception, so the caller can tick the rest shards before rethrowing it
+   * @note the shard stores pending_expire_count and expired_count before rethrowing
+   */
+  static int tick_shard(shard_type &shard, std::exception_ptr &first_exception, time_t sec, int nsec,
+                        size_t max_expire, size_t *pending_expire_count, size_t *expired_count) {
+#  if defined(LIBCOPP_MACRO_ENABLE_EXCEPTION) && LIBCOPP_MACRO_ENABLE_EXCEPTION
+    try {
+      return shard.tick(sec, nsec, max_expire, pending_expire_count, expired_count);
+    } catch (...) {
+      if (!first_exception) {
+        first_exception = std::current_exception();
+      }
+    }
+    return LIBCOPP_COPP_NAMESPACE_ID::COPP_EC_SUCCESS;
+#  else
+    (void)first_exception;
+    return shard.tick(sec, nsec, max_expire, pending_expire_count, expired_count);
+#  endif
+  }
+#endif
+
+  /**
+   * @brief group items by shard with counting sort, and then call fn once for every shard
+   * @note Items are grouped in chunks of shard_type::BATCH_CHUNK_SIZE on the stack, so nothing is allocated.
+   */
+  template <class TFN>
+  size_t dispatch_batch(LIBCOPP_COPP_NAMESPACE_ID::gsl::span<const batch_item_type> items,
+                        LIBCOPP_COPP_NAMESPACE_ID::gsl::span<int> results, TFN &&fn) {
+    size_t shard_indexes[shard_type::BATCH_CHUNK_SIZE];
+    // origin_indexes[sorted index] = index in items
+    size_t origin_indexes[shard_type::BATCH_CHUNK_SIZE];
+    batch_item_type sorted_items[shard_type::BATCH_CHUNK_SIZE];
+    int sorted_results[shard_type::BATCH_CHUNK_SIZE];
+
+    size_t ret = 0;
+    for (size_t begin = 0; begin < items.size(); begin += shard_type::BATCH_CHUNK_SIZE) {
+      size_t count = items.size() - begin;
+      if (count > shard_type::BATCH_CHUNK_SIZE) {
+        count = shard_type::BATCH_CHUNK_SIZE;
+      }
+
+      size_t offsets[shard_count + 1] = {0};
+      for (size_t i = 0; i < count; ++i) {
+        shard_indexes[i] = get_shard_index(get_batch_item_id(items[begin + i]));
+        ++offsets[shard_indexes[i] + 1];
+      }
+      for (size_t i = 0; i < shard_count; ++i) {
+        offsets[i + 1] += offsets[i];
+      }
+
+      {
+        size_t next[shard_count];
+        for (size_t i = 0; i < shard_count; ++i) {
+          next[i] = offsets[i];
+        }
+        for (size_t i = 0; i < count; ++i) {
+          size_t sorted_index = next[shard_indexes[i]]++;
+          origin_indexes[sorted_index] = begin + i;
+          sorted_items[sorted_index] = items[begin + i];
+          sorted_results[sorted_index] = LIBCOPP_COPP_NAMESPACE_ID::COPP_EC_SUCCESS;
+        }
+      }
+
+      for (size_t i = 0; i < shard_count; ++i) {
+        if (offsets[i] == offsets[i + 1]) {
+          continue;
+        }
+
+        ret += fn(shards_[i].manager,
+                  LIBCOPP_COPP_NAMESPACE_ID::gsl::span<const batch_item_type>(sorted_items + offsets[i],
+                                                                              offsets[i + 1] - offsets[i]),
+                  LIBCOPP_COPP_NAMESPACE_ID::gsl::span<int>(sorted_results + offsets[i], offsets[i + 1] - offsets[i]));
+      }
+
+      for (size_t i = 0; i < count; ++i) {
+        if (origin_indexes[i] < results.size()) {
+          results[origin_indexes[i]] = sorted_results[i];
+        }
+      }
+    }
+
+    return ret;
+  }
+
+  template <class TARG>
+  UTIL_FORCEINLINE static auto get_task_id(const TARG &task) -> decltype(task->get_id()) {
+    // null task will be rejected by task_manager::add_task(...)
+    return task ? task->get_id() : 0;
+  }
+
+  template <class TARG>
+  UTIL_FORCEINLINE static auto get_task_id(const TARG &task) -> decltype(task.get_id()) {
+    return task.get_id();
+  }
+
+ private:
+  shard_holder_type shards_[TSHARD_COUNT];
+  LIBCOPP_COPP_NAMESPACE_ID::util::lock::atomic_int_type<size_t> next_tick_shard_; /** tick() may run on any thread **/
+};
+
+LIBCOPP_COTASK_NAMESPACE_END
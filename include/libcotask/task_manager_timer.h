@@ -0,0 +1,605 @@
+// Copyright 2023 owent
+
+#pragma once
+
+#include <libcopp/utils/config/libcopp_build_features.h>
+
+// clang-format off
+#include <libcopp/utils/config/stl_include_prefix.h>  // NOLINT(build/include_order)
+// clang-format on
+#include <stdint.h>
+#include <cstddef>
+#include <ctime>
+#include <set>
+#include <utility>
+#include <vector>
+
+#ifdef __cpp_impl_three_way_comparison
+#  include <compare>
+#endif
+// clang-format off
+#include <libcopp/utils/config/stl_include_suffix.h>  // NOLINT(build/include_order)
+// clang-format on
+
+LIBCOPP_COTASK_NAMESPACE_BEGIN
+
+namespace detail {
+struct LIBCOPP_COTASK_API_HEAD_ONLY tickspec_t {
+  time_t tv_sec; /* Seconds.  */
+  int tv_nsec;   /* Nanoseconds.  */
+
+  inline friend bool operator==(const tickspec_t &l, const tickspec_t &r) {
+    return l.tv_sec == r.tv_sec && l.tv_nsec == r.tv_nsec;
+  }
+
+#ifdef __cpp_impl_three_way_comparison
+  inline friend std::strong_ordering operator<=>(const tickspec_t &l, const tickspec_t &r) {
+    return (l.tv_sec != r.tv_sec) ? l.tv_sec <=> r.tv_sec : l.tv_nsec <=> r.tv_nsec;
+  }
+#else
+  inline friend bool operator!=(const tickspec_t &l, const tickspec_t &r) {
+    return l.tv_sec != r.tv_sec || l.tv_nsec != r.tv_nsec;
+  }
+
+  inline friend bool operator<(const tickspec_t &l, const tickspec_t &r) {
+    return (l.tv_sec != r.tv_sec) ? l.tv_sec < r.tv_sec : l.tv_nsec < r.tv_nsec;
+  }
+
+  inline friend bool operator<=(const tickspec_t &l, const tickspec_t &r) {
+    return (l.tv_sec != r.tv_sec) ? l.tv_sec <= r.tv_sec : l.tv_nsec <= r.tv_nsec;
+  }
+
+  inline friend bool operator>(const tickspec_t &l, const tickspec_t &r) {
+    return (l.tv_sec != r.tv_sec) ? l.tv_sec > r.tv_sec : l.tv_nsec > r.tv_nsec;
+  }
+
+  inline friend bool operator>=(const tickspec_t &l, const tickspec_t &r) {
+    return (l.tv_sec != r.tv_sec) ? l.tv_sec >= r.tv_sec : l.tv_nsec >= r.tv_nsec;
+  }
+#endif
+};
+
+/**
+ * @brief make a tickspec_t and carry nanoseconds into seconds, so tv_nsec is always in the range 0-999999999
+ * @param sec seconds
+ * @param nsec nanoseconds, may be negative or greater than a second
+ */
+inline tickspec_t make_tickspec(time_t sec, int64_t nsec) LIBCOPP_MACRO_NOEXCEPT {
+  tickspec_t ret;
+  ret.tv_sec = sec + static_cast<time_t>(nsec / 1000000000);
+  nsec %= 1000000000;
+  if (nsec < 0) {
+    --ret.tv_sec;
+    nsec += 1000000000;
+  }
+  ret.tv_nsec = static_cast<int>(nsec);
+  return ret;
+}
+
+template <class TTASK_ID_TYPE>
+struct LIBCOPP_COTASK_API_HEAD_ONLY task_timer_node {
+  tickspec_t expired_time;
+  TTASK_ID_TYPE task_id;
+
+  inline friend bool operator==(const task_timer_node &l, const task_timer_node &r) {
+    return l.expired_time == r.expired_time && l.task_id == r.task_id;
+  }
+
+#ifdef __cpp_impl_three_way_comparison
+  inline friend std::strong_ordering operator<=>(const task_timer_node &l, const task_timer_node &r) {
+    if (l.expired_time != r.expired_time) {
+      return l.expired_time <=> r.expired_time;
+    }
+
+    return l.task_id <=> r.task_id;
+  }
+#else
+  inline friend bool operator!=(const task_timer_node &l, const task_timer_node &r) {
+    return l.expired_time != r.expired_time || l.task_id != r.task_id;
+  }
+
+  inline friend bool operator<(const task_timer_node &l, const task_timer_node &r) {
+    if (l.expired_time != r.expired_time) {
+      return l.expired_time < r.expired_time;
+    }
+
+    return l.task_id < r.task_id;
+  }
+
+  inline friend bool operator<=(const task_timer_node &l, const task_timer_node &r) {
+    if (l.expired_time != r.expired_time) {
+      return l.expired_time <= r.expired_time;
+    }
+
+    return l.task_id <= r.task_id;
+  }
+
+  inline friend bool operator>(const task_timer_node &l, const task_timer_node &r) {
+    if (l.expired_time != r.expired_time) {
+      return l.expired_time > r.expired_time;
+    }
+
+    return l.task_id > r.task_id;
+  }
+
+  inline friend bool operator>=(const task_timer_node &l, const task_timer_node &r) {
+    if (l.expired_time != r.expired_time) {
+      return l.expired_time >= r.expired_time;
+    }
+
+    return l.task_id >= r.task_id;
+  }
+#endif
+};
+}  // namespace detail
+
+/**
+ * @brief timer backend of task_manager which keep all checkpoints in a std::set
+ * @note this is the default backend, add/update/remove costs O(log(n)) and a node allocation
+ */
+template <class TTASK_ID_TYPE>
+class LIBCOPP_COTASK_API_HEAD_ONLY task_timer_set {
+ public:
+  using id_type = TTASK_ID_TYPE;
+  using checkpoint_type = detail::task_timer_node<id_type>;
+  using checkpoints_type = std::set<checkpoint_type>;
+  using checkpoints_result_type = const checkpoints_type &;
+  using handle_type = typename checkpoints_type::iterator;
+
+ public:
+  inline handle_type end() LIBCOPP_MACRO_NOEXCEPT { return checkpoints_.end(); }
+
+  inline handle_type insert(const checkpoint_type &checkpoint) {
+    std::pair<handle_type, bool> res = checkpoints_.insert(checkpoint);
+    if (res.second) {
+      return res.first;
+    }
+
+    return checkpoints_.end();
+  }
+
+  inline void erase(handle_type handle) { checkpoints_.erase(handle); }
+
+  inline void clear() { checkpoints_.clear(); }
+
+  /**
+   * @brief move all checkpoints by the time of the first tick
+   * @param now time of the first tick
+   * @param update_handle called with (task id, new handle) for every moved checkpoint
+   */
+  template <class TFN>
+  void rebase(const detail::tickspec_t &now, TFN &&update_handle) {
+    checkpoints_type real_checkpoints;
+    for (typename checkpoints_type::iterator iter = checkpoints_.begin(); checkpoints_.end() != iter; ++iter) {
+      checkpoint_type new_checkpoint = (*iter);
+      new_checkpoint.expired_time =
+          detail::make_tickspec(new_checkpoint.expired_time.tv_sec + now.tv_sec,
+                                static_cast<int64_t>(new_checkpoint.expired_time.tv_nsec) + now.tv_nsec);
+      real_checkpoints.insert(new_checkpoint);
+    }
+
+    checkpoints_.swap(real_checkpoints);
+    for (typename checkpoints_type::iterator iter = checkpoints_.begin(); checkpoints_.end() != iter; ++iter) {
+      update_handle(iter->task_id, iter);
+    }
+  }
+
+  /**
+   * @brief prepare expired checkpoints before pop_expired(...), nothing to do for std::set
+   */
+  inline void advance(const detail::tickspec_t &) LIBCOPP_MACRO_NOEXCEPT {}
+
+  /**
+   * @brief pop the first checkpoint which is expired
+   * @param now current time
+   * @param task_id where to store the task id of the expired checkpoint
+   * @return true if a checkpoint is popped
+   */
+  bool pop_expired(const detail::tickspec_t &now, id_type &task_id) {
+    if (checkpoints_.empty()) {
+      return false;
+    }
+
+    typename checkpoints_type::iterator iter = checkpoints_.begin();
+    // all tasks those expired time less than now are timeout
+    if (now <= iter->expired_time) {
+      return false;
+    }
+
+    task_id = iter->task_id;
+    checkpoints_.erase(iter);
+    return true;
+  }
+
+  /**
+   * @brief check if there is any checkpoint which is expired but not popped yet
+   * @param now current time
+   * @return true if pop_expired(now, ...) will pop a checkpoint
+   */
+  bool has_expired(const detail::tickspec_t &now) const LIBCOPP_MACRO_NOEXCEPT {
+    return !checkpoints_.empty() && checkpoints_.begin()->expired_time < now;
+  }
+
+  /**
+   * @brief count checkpoints which are expired but not popped yet
+   * @param now current time
+   * @note it walks all expired checkpoints, so it's only called when tick(...) runs out of its budget
+   * @return number of checkpoints pop_expired(now, ...) will pop
+   */
+  size_t count_expired(const detail::tickspec_t &now) const LIBCOPP_MACRO_NOEXCEPT {
+    size_t ret = 0;
+    for (typename checkpoints_type::const_iterator iter = checkpoints_.begin();
+         checkpoints_.end() != iter && iter->expired_time < now; ++iter) {
+      ++ret;
+    }
+    return ret;
+  }
+
+  inline size_t size() const LIBCOPP_MACRO_NOEXCEPT { return checkpoints_.size(); }
+
+  inline bool empty() const LIBCOPP_MACRO_NOEXCEPT { return checkpoints_.empty(); }
+
+  inline checkpoints_result_type get_checkpoints() const LIBCOPP_MACRO_NOEXCEPT { return checkpoints_; }
+
+ private:
+  checkpoints_type checkpoints_;
+};
+
+/**
+ * @brief timer backend of task_manager which use a hierarchical timing wheel
+ * @note add/update/remove costs O(1) without allocation(entries are pooled), and tick costs amortized O(expired).
+ * @note timeouts are bucketed by TTICK_NANOSECONDS, but a task is still only expired when the tick time is greater
+ *       than its expired time. Tasks expired in the same tick are killed in tick order but not in expired time order.
+ * @note it's faster than task_timer_set only when timeouts are added or updated more often than they expire. Expiring
+ *       a checkpoint is slower, because it's cascaded through levels and moved into the expired list before popped.
+ *       sample_benchmark_task_timer measures about 98ns vs 84ns per expired checkpoint with 100K checkpoints, and
+ *       250ns vs 135ns with 1M checkpoints.
+ */
+template <class TTASK_ID_TYPE, uint64_t TTICK_NANOSECONDS = 1000000>
+class LIBCOPP_COTASK_API_HEAD_ONLY task_timer_wheel {
+ public:
+  using id_type = TTASK_ID_TYPE;
+  using checkpoint_type = detail::task_timer_node<id_type>;
+  using checkpoints_type = std::set<checkpoint_type>;
+  using checkpoints_result_type = checkpoints_type;
+  using handle_type = size_t;
+
+ private:
+  // 8 levels of 256 slots cover all 64-bit ticks, wide slots cascade timeouts of seconds less times
+  enum : size_t {
+    kSlotBits = 8,
+    kSlotSize = static_cast<size_t>(1) << kSlotBits,
+    kSlotMask = kSlotSize - 1,
+    kLevelCount = 8,
+    // checkpoints added before the first tick
+    kPendingList = kLevelCount * kSlotSize,
+    // checkpoints already expired but not popped
+    kExpiredList = kPendingList + 1,
+    kListCount = kExpiredList + 1,
+  };
+
+  static_assert(TTICK_NANOSECONDS > 0, "tick of timing wheel can not be 0");
+
+  struct entry_type {
+    checkpoint_type checkpoint;
+    uint64_t tick;
+    size_t prev;
+    size_t next;
+    size_t list;
+  };
+
+  struct list_type {
+    size_t head;
+    size_t tail;
+  };
+
+ public:
+  task_timer_wheel() { clear(); }
+
+  inline handle_type end() const LIBCOPP_MACRO_NOEXCEPT { return npos(); }
+
+  handle_type insert(const checkpoint_type &checkpoint) {
+    size_t index;
+    if (npos() != free_head_) {
+      index = free_head_;
+      free_head_ = entries_[index].next;
+    } else {
+      index = entries_.size();
+      entries_.push_back(entry_type());
+    }
+
+    entries_[index].checkpoint = checkpoint;
+    entries_[index].tick = to_tick(checkpoint.expired_time);
+    ++size_;
+    if (started_) {
+      link(index);
+    } else {
+      push_back(kPendingList, index);
+    }
+    return index;
+  }
+
+  void erase(handle_type handle) {
+    if (handle >= entries_.size() || npos() == entries_[handle].list) {
+      return;
+    }
+
+    unlink(handle);
+    release(handle);
+  }
+
+  void clear() {
+    entries_.clear();
+    free_head_ = npos();
+    for (size_t i = 0; i < kListCount; ++i) {
+      lists_[i].head = npos();
+      lists_[i].tail = npos();
+    }
+    for (size_t i = 0; i < kLevelCount; ++i) {
+      level_size_[i] = 0;
+    }
+    size_ = 0;
+    expired_size_ = 0;
+    current_tick_ = 0;
+    started_ = false;
+  }
+
+  /**
+   * @brief move all checkpoints by the time of the first tick and start the wheel
+   * @param now time of the first tick
+   * @note handles are stable here, so update_handle will never be called
+   */
+  template <class TFN>
+  void rebase(const detail::tickspec_t &now, TFN &&) {
+    current_tick_ = to_tick(now);
+    started_ = true;
+
+    size_t index = lists_[kPendingList].head;
+    lists_[kPendingList].head = npos();
+    lists_[kPendingList].tail = npos();
+    while (npos() != index) {
+      size_t next = entries_[index].next;
+      detail::tickspec_t &expired_time = entries_[index].checkpoint.expired_time;
+      expired_time = detail::make_tickspec(expired_time.tv_sec + now.tv_sec,
+                                           static_cast<int64_t>(expired_time.tv_nsec) + now.tv_nsec);
+      entries_[index].tick = to_tick(expired_time);
+      link(index);
+      index = next;
+    }
+  }
+
+  /**
+   * @brief turn the wheel to now and move all expired checkpoints into the expired list
+   * @param now current time
+   */
+  void advance(const detail::tickspec_t &now) {
+    if (!started_) {
+      return;
+    }
+
+    uint64_t now_tick = to_tick(now);
+    while (current_tick_ < now_tick) {
+      uint64_t next_tick;
+      if (level_size_[0] > 0) {
+        // all checkpoints in the slot of current tick are expired
+        expire_list(current_tick_ & kSlotMask, nullptr);
+        next_tick = current_tick_ + 1;
+      } else {
+        // skip to the next slot boundary of the first non-empty level
+        size_t level = 1;
+        while (level < kLevelCount && 0 == level_size_[level]) {
+          ++level;
+        }
+        if (level >= kLevelCount) {
+          current_tick_ = now_tick;
+          break;
+        }
+
+        uint64_t step = static_cast<uint64_t>(1) << (level * kSlotBits);
+        next_tick = (current_tick_ & ~(step - 1)) + step;
+      }
+
+      if (next_tick > now_tick) {
+        current_tick_ = now_tick;
+        break;
+      }
+
+      current_tick_ = next_tick;
+      cascade();
+    }
+
+    // checkpoints in the slot of now may be partly expired
+    expire_list(current_tick_ & kSlotMask, &now);
+  }
+
+  /**
+   * @brief pop a checkpoint which is moved into the expired list by advance(...)
+   * @param task_id where to store the task id of the expired checkpoint
+   * @return true if a checkpoint is popped
+   */
+  bool pop_expired(const detail::tickspec_t &, id_type &task_id) {
+    size_t index = lists_[kExpiredList].head;
+    if (npos() == index) {
+      return false;
+    }
+
+    task_id = entries_[index].checkpoint.task_id;
+    unlink(index);
+    release(index);
+    return true;
+  }
+
+  /**
+   * @brief check if there is any checkpoint which is moved into the expired list by advance(...) but not popped yet
+   * @return true if pop_expired(...) will pop a checkpoint
+   */
+  bool has_expired(const detail::tickspec_t &) const LIBCOPP_MACRO_NOEXCEPT {
+    return npos() != lists_[kExpiredList].head;
+  }
+
+  /**
+   * @brief count checkpoints which are moved into the expired list by advance(...) but not popped yet
+   * @return number of checkpoints pop_expired(...) will pop
+   */
+  inline size_t count_expired(const detail::tickspec_t &) const LIBCOPP_MACRO_NOEXCEPT { return expired_size_; }
+
+  inline size_t size() const LIBCOPP_MACRO_NOEXCEPT { return size_; }
+
+  inline bool empty() const LIBCOPP_MACRO_NOEXCEPT { return 0 == size_; }
+
+  /**
+   * @brief get a sorted copy of all checkpoints, this api is just used for provide information to users
+   * @return all checkpoints
+   */
+  checkpoints_result_type get_checkpoints() const {
+    checkpoints_type ret;
+    for (typename std::vector<entry_type>::const_iterator iter = entries_.begin(); iter != entries_.end(); ++iter) {
+      if (npos() != iter->list) {
+        ret.insert(iter->checkpoint);
+      }
+    }
+    return ret;
+  }
+
+ private:
+  static inline size_t npos() LIBCOPP_MACRO_NOEXCEPT { return static_cast<size_t>(-1); }
+
+  static inline uint64_t to_tick(const detail::tickspec_t &t) LIBCOPP_MACRO_NOEXCEPT {
+    if (t.tv_sec < 0) {
+      return 0;
+    }
+
+    uint64_t ret = static_cast<uint64_t>(t.tv_sec) * 1000000000;
+    if (t.tv_nsec > 0) {
+      ret += static_cast<uint64_t>(t.tv_nsec);
+    }
+    return ret / TTICK_NANOSECONDS;
+  }
+
+  void push_back(size_t list, size_t index) {
+    entry_type &entry = entries_[index];
+    entry.list = list;
+    entry.next = npos();
+    entry.prev = lists_[list].tail;
+    if (npos() == lists_[list].tail) {
+      lists_[list].head = index;
+    } else {
+      entries_[lists_[list].tail].next = index;
+    }
+    lists_[list].tail = index;
+
+    if (list < kPendingList) {
+      ++level_size_[list >> kSlotBits];
+    } else if (kExpiredList == list) {
+      ++expired_size_;
+    }
+  }
+
+  void unlink(size_t index) {
+    entry_type &entry = entries_[index];
+    list_type &list = lists_[entry.list];
+    if (npos() == entry.prev) {
+      list.head = entry.next;
+    } else {
+      entries_[entry.prev].next = entry.next;
+    }
+    if (npos() == entry.next) {
+      list.tail = entry.prev;
+    } else {
+      entries_[entry.next].prev = entry.prev;
+    }
+
+    if (entry.list < kPendingList) {
+      --level_size_[entry.list >> kSlotBits];
+    } else if (kExpiredList == entry.list) {
+      --expired_size_;
+    }
+    entry.list = npos();
+  }
+
+  void release(size_t index) {
+    entries_[index].next = free_head_;
+    free_head_ = index;
+    --size_;
+  }
+
+  // the level is decided by the highest different slot between expired tick and current tick
+  void link(size_t index) {
+    uint64_t tick = entries_[index].tick;
+    if (tick < current_tick_) {
+      tick = current_tick_;
+    }
+
+    uint64_t diff = tick ^ current_tick_;
+    size_t level = 0;
+    while (level + 1 < kLevelCount && 0 != (diff >> ((level + 1) * kSlotBits))) {
+      ++level;
+    }
+
+    push_back((level << kSlotBits) + static_cast<size_t>((tick >> (level * kSlotBits)) & kSlotMask), index);
+  }
+
+  // re-link checkpoints in higher levels after current tick reach their slot boundaries
+  void cascade() {
+    size_t level = 1;
+    while (level < kLevelCount && 0 == (current_tick_ & ((static_cast<uint64_t>(1) << (level * kSlotBits)) - 1))) {
+      ++level;
+    }
+
+    for (; level > 1; --level) {
+      size_t list = ((level - 1) << kSlotBits) +
+                    static_cast<size_t>((current_tick_ >> ((level - 1) * kSlotBits)) & kSlotMask);
+      size_t index = detach(list);
+      while (npos() != index) {
+        size_t next = entries_[index].next;
+        --level_size_[level - 1];
+        link(index);
+        index = next;
+      }
+    }
+  }
+
+  void expire_list(size_t list, const detail::tickspec_t *now) {
+    if (nullptr == now) {
+      size_t index = detach(list);
+      while (npos() != index) {
+        size_t next = entries_[index].next;
+        --level_size_[list >> kSlotBits];
+        push_back(kExpiredList, index);
+        index = next;
+      }
+      return;
+    }
+
+    size_t index = lists_[list].head;
+    while (npos() != index) {
+      size_t next = entries_[index].next;
+      if (entries_[index].checkpoint.expired_time < *now) {
+        unlink(index);
+        push_back(kExpiredList, index);
+      }
+      index = next;
+    }
+  }
+
+  // take all entries of a wheel list without unlinking them one by one,
+  // caller must update level_size_ and push them into other lists
+  size_t detach(size_t list) {
+    size_t ret = lists_[list].head;
+    lists_[list].head = npos();
+    lists_[list].tail = npos();
+    return ret;
+  }
+
+ private:
+  std::vector<entry_type> entries_;
+  size_t free_head_;
+  list_type lists_[kListCount];
+  size_t level_size_[kLevelCount];
+  size_t size_;
+  size_t expired_size_;
+  uint64_t current_tick_;
+  bool started_;
+};
+
+LIBCOPP_COTASK_NAMESPACE_END
@@ -77,7 +77,8 @@ class LIBCOPP_COTASK_API_HEAD_ONLY task_context_base {
 #  if defined(LIBCOTASK_MACRO_AUTO_CLEANUP_MANAGER) && LIBCOTASK_MACRO_AUTO_CLEANUP_MANAGER
         ,
         binding_manager_ptr_(nullptr),
-        binding_manager_fn_(nullptr)
+        binding_manager_fn_(nullptr),
+        binding_manager_key_(0)
 #  endif
   {
     id_allocator_type id_allocator;
@@ -218,19 +219,24 @@ class LIBCOPP_COTASK_API_HEAD_ONLY task_context_base {
  public:
   class LIBCOPP_COTASK_API_HEAD_ONLY task_manager_helper {
    private:
-    template <class>
+    template <class, class, class>
     friend class LIBCOPP_COTASK_API_HEAD_ONLY task_manager;
     static bool setup_task_manager(task_context_base<value_type>& context, void* manager_ptr,
-                                   void (*fn)(void*, task_context_base<value_type>&)) {
+                                   void (*fn)(void*, task_context_base<value_type>&), id_type manager_key) {
       if (context.binding_manager_ptr_ != nullptr) {
         return false;
       }
 
       context.binding_manager_ptr_ = manager_ptr;
       context.binding_manager_fn_ = fn;
+      context.binding_manager_key_ = manager_key;
       return true;
     }
 
+    static id_type get_task_manager_key(const task_context_base<value_type>& context) {
+      return context.binding_manager_key_;
+    }
+
     static bool cleanup_task_manager(task_context_base<value_type>& context, void* manager_ptr) {
       if (context.binding_manager_ptr_ != manager_ptr) {
         return false;
@@ -258,6 +264,8 @@ class LIBCOPP_COTASK_API_HEAD_ONLY task_context_base {
 #  if defined(LIBCOTASK_MACRO_AUTO_CLEANUP_MANAGER) && LIBCOTASK_MACRO_AUTO_CLEANUP_MANAGER
   void* binding_manager_ptr_;
   void (*binding_manager_fn_)(void*, task_context_base<value_type>&);
+  // id used by the binding manager, it may be different from get_id()
+  id_type binding_manager_key_;
 #  endif
 };
 
@@ -13,7 +13,11 @@ namespace this_task {
  * @brief get current running task
  * @return current running task or empty pointer when not in task
  */
+#if defined(LIBCOPP_MACRO_ENABLE_INLINE_THIS_COROUTINE) && LIBCOPP_MACRO_ENABLE_INLINE_THIS_COROUTINE
+UTIL_FORCEINLINE impl::task_impl *get_task() LIBCOPP_MACRO_NOEXCEPT { return impl::task_impl::this_task(); }
+#else
 LIBCOPP_COTASK_API impl::task_impl *get_task() LIBCOPP_MACRO_NOEXCEPT;
+#endif
 
 /**
  * @brief get current running task and try to convert type
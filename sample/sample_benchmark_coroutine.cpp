@@ -133,6 +133,35 @@ int main(int argc, char *argv[]) {
          max_coroutine_number, real_switch_times, static_cast<int>(end_time - begin_time),
          CALC_MS_CLOCK(end_clock - begin_clock), CALC_NS_AVG_CLOCK(end_clock - begin_clock, real_switch_times));
 
+  // reuse all coroutines and run them again by resume_batch(), the next coroutine is prefetched when switching
+  copp::coroutine_context **co_batch = new copp::coroutine_context *[max_coroutine_number];
+  for (int i = 0; i < max_coroutine_number; ++i) {
+    co_arr[i]->reset(my_runner);
+    co_arr[i]->start();
+    co_batch[i] = co_arr[i].get();
+  }
+
+  begin_time = time(nullptr);
+  begin_clock = CALC_CLOCK_NOW();
+
+  real_switch_times = static_cast<long long>(0);
+  while (true) {
+    size_t resumed = copp::coroutine_context::resume_batch(
+        copp::gsl::span<copp::coroutine_context *>(co_batch, static_cast<size_t>(max_coroutine_number)));
+    if (0 == resumed) {
+      break;
+    }
+    real_switch_times += static_cast<long long>(resumed);
+  }
+
+  end_time = time(nullptr);
+  end_clock = CALC_CLOCK_NOW();
+  printf("resume_batch %d coroutine contest %lld times, cost time: %d s, clock time: %d ms, avg: %lld ns\n",
+         max_coroutine_number, real_switch_times, static_cast<int>(end_time - begin_time),
+         CALC_MS_CLOCK(end_clock - begin_clock), CALC_NS_AVG_CLOCK(end_clock - begin_clock, real_switch_times));
+
+  delete[] co_batch;
+
   begin_time = end_time;
   begin_clock = end_clock;
 
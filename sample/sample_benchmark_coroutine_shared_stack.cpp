@@ -0,0 +1,232 @@
+/*
+ * sample_benchmark_coroutine_shared_stack.cpp
+ *
+ *  Released under the MIT license
+ */
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+
+// include manager header file
+#include <libcopp/coroutine/coroutine_context_container.h>
+#include <libcopp/coroutine/coroutine_context_shared_stack.h>
+#include <libcopp/stack/stack_allocator.h>
+#include <libcopp/stack/stack_pool.h>
+
+#if defined(PROJECT_LIBCOPP_SAMPLE_HAS_CHRONO) && PROJECT_LIBCOPP_SAMPLE_HAS_CHRONO
+#  include <chrono>
+#  define CALC_CLOCK_T std::chrono::system_clock::time_point
+#  define CALC_CLOCK_NOW() std::chrono::system_clock::now()
+#  define CALC_MS_CLOCK(x) static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(x).count())
+#  define CALC_NS_AVG_CLOCK(x, y) \
+    static_cast<long long>(std::chrono::duration_cast<std::chrono::nanoseconds>(x).count() / (y ? y : 1))
+#else
+#  define CALC_CLOCK_T clock_t
+#  define CALC_CLOCK_NOW() clock()
+#  define CALC_MS_CLOCK(x) static_cast<int>((x) / (CLOCKS_PER_SEC / 1000))
+#  define CALC_NS_AVG_CLOCK(x, y) (1000000LL * static_cast<long long>((x) / (CLOCKS_PER_SEC / 1000)) / (y ? y : 1))
+#endif
+
+// bytes of stacks held by coroutines now
+static long long g_allocated_stack_bytes = 0;
+
+// count stacks where they are allocated, RSS does not grow in later rounds because freed pages are reused
+template <typename TALLOC>
+class stack_allocator_counting : public TALLOC {
+ public:
+  using TALLOC::TALLOC;
+
+  void allocate(copp::stack_context &ctx, std::size_t size) LIBCOPP_MACRO_NOEXCEPT {
+    TALLOC::allocate(ctx, size);
+    g_allocated_stack_bytes += static_cast<long long>(ctx.size);
+  }
+
+  void deallocate(copp::stack_context &ctx) LIBCOPP_MACRO_NOEXCEPT {
+    g_allocated_stack_bytes -= static_cast<long long>(ctx.size);
+    TALLOC::deallocate(ctx);
+  }
+};
+
+typedef copp::stack_pool<copp::allocator::default_statck_allocator> stack_pool_t;
+typedef copp::coroutine_context_container<stack_allocator_counting<copp::allocator::default_statck_allocator> >
+    default_cotoutine_t;
+typedef copp::coroutine_context_container<
+    stack_allocator_counting<copp::allocator::stack_allocator_pool<stack_pool_t> > >
+    pool_cotoutine_t;
+typedef copp::coroutine_context_shared_stack_default shared_cotoutine_t;
+
+stack_pool_t::ptr_t global_stack_pool;
+shared_cotoutine_t::group_type::ptr_type global_shared_stack_group;
+
+int switch_count = 100;
+int MAX_COROUTINE_NUMBER = 100000;  // 协程数量
+size_t stack_size = 64 * 1024;
+size_t shared_stack_number = 1;
+
+// define a coroutine runner
+static int my_runner(void *) {
+  // use some stack like a real handler
+  volatile char buffer[256];
+  memset(const_cast<char *>(buffer), 0, sizeof(buffer));
+
+  int count = switch_count;  // 每个协程N次切换
+  copp::coroutine_context *self = copp::this_coroutine::get_coroutine();
+  while (count-- > 0) {
+    self->yield();
+    buffer[count & 0xFF] = static_cast<char>(count);
+  }
+
+  return 1;
+}
+
+static default_cotoutine_t::ptr_t create_coroutine(default_cotoutine_t *) {
+  return default_cotoutine_t::create(my_runner, stack_size);
+}
+
+static pool_cotoutine_t::ptr_t create_coroutine(pool_cotoutine_t *) {
+  pool_cotoutine_t::allocator_type alloc(global_stack_pool);
+  return pool_cotoutine_t::create(my_runner, alloc);
+}
+
+static shared_cotoutine_t::ptr_t create_coroutine(shared_cotoutine_t *) {
+  return shared_cotoutine_t::create(my_runner, global_shared_stack_group);
+}
+
+// coroutines with dedicated stack are placed on their stacks
+template <typename TCO>
+static long long get_allocated_bytes(TCO *, typename TCO::ptr_t *, int) {
+  return g_allocated_stack_bytes;
+}
+
+// coroutines with shared stack hold the object and the saved part of run stack, run stacks are not counted
+static long long get_allocated_bytes(shared_cotoutine_t *, shared_cotoutine_t::ptr_t *co_arr, int coroutine_number) {
+  long long ret = 0;
+  for (int i = 0; i < coroutine_number; ++i) {
+    ret += static_cast<long long>(sizeof(shared_cotoutine_t) + co_arr[i]->get_saved_capacity());
+  }
+  return ret;
+}
+
+template <typename TCO>
+static void benchmark_round(const char *name, int index) {
+  printf("### %s Round: %d ###\n", name, index);
+
+  int coroutine_number = MAX_COROUTINE_NUMBER;
+  time_t begin_time = time(nullptr);
+  CALC_CLOCK_T begin_clock = CALC_CLOCK_NOW();
+
+  // create coroutines
+  typename TCO::ptr_t *co_arr = new typename TCO::ptr_t[coroutine_number];
+  for (int i = 0; i < coroutine_number; ++i) {
+    co_arr[i] = create_coroutine(static_cast<TCO *>(nullptr));
+    if (!co_arr[i]) {
+      fprintf(stderr, "coroutine create failed, the real number is %d\n", i);
+      coroutine_number = i;
+      break;
+    }
+  }
+
+  time_t end_time = time(nullptr);
+  CALC_CLOCK_T end_clock = CALC_CLOCK_NOW();
+  printf("create %d coroutine, cost time: %d s, clock time: %d ms, avg: %lld ns\n", coroutine_number,
+         static_cast<int>(end_time - begin_time), CALC_MS_CLOCK(end_clock - begin_clock),
+         CALC_NS_AVG_CLOCK(end_clock - begin_clock, coroutine_number));
+
+  begin_time = end_time;
+  begin_clock = end_clock;
+
+  // start a coroutine
+  for (int i = 0; i < coroutine_number; ++i) {
+    co_arr[i]->start();
+  }
+
+  // all coroutines are parked now
+  long long parked_bytes = get_allocated_bytes(static_cast<TCO *>(nullptr), co_arr, coroutine_number);
+  printf("park %d coroutine, allocated: %lld KB, avg: %lld bytes\n", coroutine_number, parked_bytes / 1024,
+         parked_bytes / (coroutine_number ? coroutine_number : 1));
+
+  // yield & resume from runner
+  bool continue_flag = true;
+  long long real_switch_times = static_cast<long long>(0);
+
+  while (continue_flag) {
+    continue_flag = false;
+    for (int i = 0; i < coroutine_number; ++i) {
+      if (0 == co_arr[i]->resume()) {
+        continue_flag = true;
+        ++real_switch_times;
+      }
+    }
+  }
+
+  end_time = time(nullptr);
+  end_clock = CALC_CLOCK_NOW();
+  printf("switch %d coroutine contest %lld times, cost time: %d s, clock time: %d ms, avg: %lld ns\n",
+         coroutine_number, real_switch_times, static_cast<int>(end_time - begin_time),
+         CALC_MS_CLOCK(end_clock - begin_clock), CALC_NS_AVG_CLOCK(end_clock - begin_clock, real_switch_times));
+
+  begin_time = end_time;
+  begin_clock = end_clock;
+
+  delete[] co_arr;
+
+  end_time = time(nullptr);
+  end_clock = CALC_CLOCK_NOW();
+  printf("remove %d coroutine, cost time: %d s, clock time: %d ms, avg: %lld ns\n", coroutine_number,
+         static_cast<int>(end_time - begin_time), CALC_MS_CLOCK(end_clock - begin_clock),
+         CALC_NS_AVG_CLOCK(end_clock - begin_clock, coroutine_number));
+}
+
+int main(int argc, char *argv[]) {
+  puts("###################### context coroutine (shared stack vs dedicated stack) ###################");
+  printf("########## Cmd:");
+  for (int i = 0; i < argc; ++i) {
+    printf(" %s", argv[i]);
+  }
+  puts("");
+
+  if (argc > 1) {
+    MAX_COROUTINE_NUMBER = atoi(argv[1]);
+  }
+
+  if (argc > 2) {
+    switch_count = atoi(argv[2]);
+  }
+
+  if (argc > 3) {
+    stack_size = static_cast<size_t>(atoi(argv[3]) * 1024);
+  }
+
+  if (argc > 4) {
+    shared_stack_number = static_cast<size_t>(atoi(argv[4]));
+  }
+
+  for (int i = 1; i <= 3; ++i) {
+    benchmark_round<default_cotoutine_t>("coroutine_context_default", i);
+  }
+
+  global_stack_pool = stack_pool_t::create();
+  global_stack_pool->set_stack_size(stack_size);
+  for (int i = 1; i <= 3; ++i) {
+    benchmark_round<pool_cotoutine_t>("stack_pool", i);
+  }
+  global_stack_pool.reset();
+
+  global_shared_stack_group = shared_cotoutine_t::group_type::create(shared_stack_number, stack_size);
+  if (!global_shared_stack_group) {
+    fprintf(stderr, "create shared stack group failed\n");
+    return 1;
+  }
+  printf("shared stack group: %d run stack(s), %lld KB\n", static_cast<int>(shared_stack_number),
+         static_cast<long long>(shared_stack_number * global_shared_stack_group->get_stack_size() / 1024));
+  for (int i = 1; i <= 3; ++i) {
+    benchmark_round<shared_cotoutine_t>("shared_stack", i);
+  }
+  global_shared_stack_group.reset();
+
+  return 0;
+}
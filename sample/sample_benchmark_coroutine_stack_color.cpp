@@ -0,0 +1,130 @@
+/*
+ * sample_benchmark_coroutine_stack_color.cpp
+ *
+ *  Released under the MIT license
+ */
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+
+// include manager header file
+#include <libcopp/coroutine/coroutine_context_container.h>
+
+#if defined(PROJECT_LIBCOPP_SAMPLE_HAS_CHRONO) && PROJECT_LIBCOPP_SAMPLE_HAS_CHRONO
+#  include <chrono>
+#  define CALC_CLOCK_T std::chrono::system_clock::time_point
+#  define CALC_CLOCK_NOW() std::chrono::system_clock::now()
+#  define CALC_MS_CLOCK(x) static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(x).count())
+#  define CALC_NS_AVG_CLOCK(x, y) \
+    static_cast<long long>(std::chrono::duration_cast<std::chrono::nanoseconds>(x).count() / (y ? y : 1))
+#else
+#  define CALC_CLOCK_T clock_t
+#  define CALC_CLOCK_NOW() clock()
+#  define CALC_MS_CLOCK(x) static_cast<int>((x) / (CLOCKS_PER_SEC / 1000))
+#  define CALC_NS_AVG_CLOCK(x, y) (1000000LL * static_cast<long long>((x) / (CLOCKS_PER_SEC / 1000)) / (y ? y : 1))
+#endif
+
+// all stacks are allocated by mmap, so the top of every stack is page aligned
+typedef copp::coroutine_context_default my_cotoutine_t;
+
+int switch_count = 1000;
+int MAX_COROUTINE_NUMBER = 1024;  // 协程数量
+size_t stack_size = 16 * 1024;
+
+// define a coroutine runner
+static int my_runner(void *) {
+  // hot data of every coroutine: the coroutine object, private data and the frame at the stack top
+  copp::coroutine_context *self = copp::this_coroutine::get_coroutine();
+  size_t *counter = reinterpret_cast<size_t *>(self->get_private_buffer());
+  int count = switch_count;  // 每个协程N次切换
+  while (count-- > 0) {
+    ++(*counter);
+    self->yield();
+  }
+
+  return 1;
+}
+
+static void benchmark_round(int index, size_t color_count) {
+  copp::coroutine_context::set_stack_color_count(color_count);
+  printf("### Round: %d, stack color count: %d ###\n", index,
+         static_cast<int>(copp::coroutine_context::get_stack_color_count()));
+
+  my_cotoutine_t::ptr_t *co_arr = new my_cotoutine_t::ptr_t[MAX_COROUTINE_NUMBER];
+  int real_coroutine_number = MAX_COROUTINE_NUMBER;
+  for (int i = 0; i < MAX_COROUTINE_NUMBER; ++i) {
+    co_arr[i] = my_cotoutine_t::create(my_runner, stack_size, sizeof(size_t));
+    if (!co_arr[i]) {
+      fprintf(stderr, "coroutine create failed, the real number is %d\n", i);
+      real_coroutine_number = i;
+      break;
+    }
+    *reinterpret_cast<size_t *>(co_arr[i]->get_private_buffer()) = 0;
+  }
+
+  // start a coroutine
+  for (int i = 0; i < real_coroutine_number; ++i) {
+    co_arr[i]->start();
+  }
+
+  CALC_CLOCK_T begin_clock = CALC_CLOCK_NOW();
+
+  // yield & resume from runner, every coroutine is resumed once in a loop, so nothing keeps warm in cache
+  bool continue_flag = true;
+  long long real_switch_times = static_cast<long long>(0);
+
+  while (continue_flag) {
+    continue_flag = false;
+    for (int i = 0; i < real_coroutine_number; ++i) {
+      if (0 == co_arr[i]->resume()) {
+        continue_flag = true;
+        ++real_switch_times;
+      }
+    }
+  }
+
+  CALC_CLOCK_T end_clock = CALC_CLOCK_NOW();
+  printf("switch %d coroutine contest %lld times, clock time: %d ms, avg: %lld ns\n", real_coroutine_number,
+         real_switch_times, CALC_MS_CLOCK(end_clock - begin_clock),
+         CALC_NS_AVG_CLOCK(end_clock - begin_clock, real_switch_times));
+
+  delete[] co_arr;
+}
+
+int main(int argc, char *argv[]) {
+  puts("###################### context coroutine (stack color) ###################");
+  printf("########## Cmd:");
+  for (int i = 0; i < argc; ++i) {
+    printf(" %s", argv[i]);
+  }
+  puts("");
+
+  if (argc > 1) {
+    MAX_COROUTINE_NUMBER = atoi(argv[1]);
+  }
+
+  if (argc > 2) {
+    switch_count = atoi(argv[2]);
+  }
+
+  if (argc > 3) {
+    stack_size = static_cast<size_t>(atoi(argv[3]) * 1024);
+  }
+
+  size_t color_count = 16;
+  if (argc > 4) {
+    color_count = static_cast<size_t>(atoi(argv[4]));
+  }
+
+  // no color, then move the top of every stack by a different cache line
+  for (int i = 1; i <= 3; ++i) {
+    benchmark_round(i, 1);
+    benchmark_round(i, color_count);
+  }
+
+  return 0;
+}
@@ -13,6 +13,7 @@
 #include <cstdlib>
 #include <cstring>
 #include <ctime>
+#include <new>
 #include <vector>
 
 // include manager header file
@@ -36,6 +37,26 @@
 
 typedef cotask::task<> my_task_t;
 
+// count heap allocations when switching tasks
+size_t allocation_count = 0;
+bool allocation_count_enabled = false;
+
+void *operator new(std::size_t size) {
+  if (allocation_count_enabled) {
+    ++allocation_count;
+  }
+
+  void *ret = malloc(0 == size ? 1 : size);
+  if (nullptr == ret) {
+    throw std::bad_alloc();
+  }
+  return ret;
+}
+
+void operator delete(void *ptr) noexcept { free(ptr); }
+
+void operator delete(void *ptr, std::size_t) noexcept { free(ptr); }
+
 int switch_count = 100;
 int max_task_number = 100000;  // 协程Task数量
 std::vector<my_task_t::ptr_t> task_arr;
@@ -104,6 +125,9 @@ int main(int argc, char *argv[]) {
   begin_time = end_time;
   begin_clock = end_clock;
 
+  allocation_count = 0;
+  allocation_count_enabled = true;
+
   // start a task
   for (int i = 0; i < max_task_number; ++i) {
     task_arr[i]->start();
@@ -126,9 +150,11 @@ int main(int argc, char *argv[]) {
 
   end_time = time(nullptr);
   end_clock = CALC_CLOCK_NOW();
-  printf("switch %d tasks %lld times, cost time: %d s, clock time: %d ms, avg: %lld ns\n", max_task_number,
-         real_switch_times, static_cast<int>(end_time - begin_time), CALC_MS_CLOCK(end_clock - begin_clock),
-         CALC_NS_AVG_CLOCK(end_clock - begin_clock, real_switch_times));
+  allocation_count_enabled = false;
+  printf("switch %d tasks %lld times, cost time: %d s, clock time: %d ms, avg: %lld ns, heap allocations: %llu\n",
+         max_task_number, real_switch_times, static_cast<int>(end_time - begin_time),
+         CALC_MS_CLOCK(end_clock - begin_clock), CALC_NS_AVG_CLOCK(end_clock - begin_clock, real_switch_times),
+         static_cast<unsigned long long>(allocation_count));
 
   begin_time = end_time;
   begin_clock = end_clock;
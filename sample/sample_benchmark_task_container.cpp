@@ -0,0 +1,157 @@
+/*
+ * sample_benchmark_task_container.cpp
+ *
+ *  Released under the MIT license
+ */
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <unordered_map>
+#include <vector>
+
+// include manager header file
+#include <libcopp/utils/uint64_id_allocator.h>
+#include <libcotask/task_manager.h>
+
+#ifdef LIBCOTASK_MACRO_ENABLED
+
+#  if defined(PROJECT_LIBCOPP_SAMPLE_HAS_CHRONO) && PROJECT_LIBCOPP_SAMPLE_HAS_CHRONO
+#    include <chrono>
+#    define CALC_CLOCK_T std::chrono::system_clock::time_point
+#    define CALC_CLOCK_NOW() std::chrono::system_clock::now()
+#    define CALC_MS_CLOCK(x) static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(x).count())
+#    define CALC_NS_AVG_CLOCK(x, y) \
+      static_cast<long long>(std::chrono::duration_cast<std::chrono::nanoseconds>(x).count() / (y ? y : 1))
+#  else
+#    define CALC_CLOCK_T clock_t
+#    define CALC_CLOCK_NOW() clock()
+#    define CALC_MS_CLOCK(x) static_cast<int>((x) / (CLOCKS_PER_SEC / 1000))
+#    define CALC_NS_AVG_CLOCK(x, y) (1000000LL * static_cast<long long>((x) / (CLOCKS_PER_SEC / 1000)) / (y ? y : 1))
+#  endif
+
+int max_task_number = 1000000;  // 存活任务数量
+int lookup_count = 10;          // 每个任务的查找次数
+int churn_count = 1;            // 每个任务的删除+插入次数
+
+// same size as task_manager_node
+struct benchmark_node_type {
+  void *task;
+  void *timer_node;
+};
+
+static uint64_t random_seed = 20231018;
+static size_t next_random_index() {
+  random_seed = random_seed * 6364136223846793005ULL + 1442695040888963407ULL;
+  return static_cast<size_t>((random_seed >> 33) % static_cast<uint64_t>(max_task_number));
+}
+
+template <class TCONTAINER>
+static void run_benchmark(const char *name, bool use_task_id) {
+  using id_type = LIBCOPP_COPP_NAMESPACE_ID::util::uint64_id_allocator::value_type;
+  using container_type = typename TCONTAINER::template container_type<id_type, benchmark_node_type>;
+
+  container_type container;
+  std::vector<id_type> keys;
+  keys.resize(static_cast<size_t>(max_task_number), 0);
+  random_seed = 20231018;
+
+  benchmark_node_type node;
+  node.task = nullptr;
+  node.timer_node = nullptr;
+
+  time_t begin_time = time(nullptr);
+  CALC_CLOCK_T begin_clock = CALC_CLOCK_NOW();
+
+  // task_manager use task id as key of std::unordered_map
+  for (int i = 0; i < max_task_number; ++i) {
+    id_type task_id = use_task_id ? LIBCOPP_COPP_NAMESPACE_ID::util::uint64_id_allocator::allocate() : 0;
+    keys[static_cast<size_t>(i)] = container.emplace(task_id, node).first->first;
+  }
+
+  time_t end_time = time(nullptr);
+  CALC_CLOCK_T end_clock = CALC_CLOCK_NOW();
+  printf("[%s] insert %d tasks, cost time: %d s, clock time: %d ms, avg: %lld ns\n", name, max_task_number,
+         static_cast<int>(end_time - begin_time), CALC_MS_CLOCK(end_clock - begin_clock),
+         CALC_NS_AVG_CLOCK(end_clock - begin_clock, max_task_number));
+
+  begin_time = end_time;
+  begin_clock = end_clock;
+
+  // random lookup just like resume(id)
+  long long real_lookup_times = 0;
+  size_t found_count = 0;
+  for (int round = 0; round < lookup_count; ++round) {
+    for (int i = 0; i < max_task_number; ++i) {
+      if (container.end() != container.find(keys[next_random_index()])) {
+        ++found_count;
+      }
+      ++real_lookup_times;
+    }
+  }
+
+  end_time = time(nullptr);
+  end_clock = CALC_CLOCK_NOW();
+  printf("[%s] lookup %lld times(found %llu), cost time: %d s, clock time: %d ms, avg: %lld ns\n", name,
+         real_lookup_times, static_cast<unsigned long long>(found_count), static_cast<int>(end_time - begin_time),
+         CALC_MS_CLOCK(end_clock - begin_clock), CALC_NS_AVG_CLOCK(end_clock - begin_clock, real_lookup_times));
+
+  begin_time = end_time;
+  begin_clock = end_clock;
+
+  // erase a random task and add a new one, just like remove_task(id) and add_task(task)
+  long long real_churn_times = 0;
+  for (int round = 0; round < churn_count; ++round) {
+    for (int i = 0; i < max_task_number; ++i) {
+      size_t index = next_random_index();
+      container.erase(keys[index]);
+      id_type task_id = use_task_id ? LIBCOPP_COPP_NAMESPACE_ID::util::uint64_id_allocator::allocate() : 0;
+      keys[index] = container.emplace(task_id, node).first->first;
+      ++real_churn_times;
+    }
+  }
+
+  end_time = time(nullptr);
+  end_clock = CALC_CLOCK_NOW();
+  printf("[%s] erase and insert %lld times, cost time: %d s, clock time: %d ms, avg: %lld ns\n", name,
+         real_churn_times, static_cast<int>(end_time - begin_time), CALC_MS_CLOCK(end_clock - begin_clock),
+         CALC_NS_AVG_CLOCK(end_clock - begin_clock, real_churn_times));
+}
+
+int main(int argc, char *argv[]) {
+  puts("###################### task manager container ###################");
+  printf("########## Cmd:");
+  for (int i = 0; i < argc; ++i) {
+    printf(" %s", argv[i]);
+  }
+  puts("");
+
+  if (argc > 1) {
+    max_task_number = atoi(argv[1]);
+  }
+
+  if (argc > 2) {
+    lookup_count = atoi(argv[2]);
+  }
+
+  if (argc > 3) {
+    churn_count = atoi(argv[3]);
+  }
+
+  if (max_task_number <= 0) {
+    max_task_number = 1;
+  }
+
+  run_benchmark<cotask::task_container_unordered_map>("std::unordered_map", true);
+  run_benchmark<cotask::task_container_slot_map>("slot map", false);
+  return 0;
+}
+#else
+int main() {
+  puts("cotask disabled");
+  return 0;
+}
+#endif
@@ -0,0 +1,132 @@
+/*
+ * sample_benchmark_task_manager_batch.cpp
+ *
+ *  Released under the MIT license
+ */
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <vector>
+
+// include manager header file
+#include <libcotask/task.h>
+#include <libcotask/task_manager.h>
+
+#ifdef LIBCOTASK_MACRO_ENABLED
+
+#  if defined(PROJECT_LIBCOPP_SAMPLE_HAS_CHRONO) && PROJECT_LIBCOPP_SAMPLE_HAS_CHRONO
+#    include <chrono>
+#    define CALC_CLOCK_T std::chrono::system_clock::time_point
+#    define CALC_CLOCK_NOW() std::chrono::system_clock::now()
+#    define CALC_MS_CLOCK(x) static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(x).count())
+#    define CALC_NS_AVG_CLOCK(x, y) \
+      static_cast<long long>(std::chrono::duration_cast<std::chrono::nanoseconds>(x).count() / (y ? y : 1))
+#  else
+#    define CALC_CLOCK_T clock_t
+#    define CALC_CLOCK_NOW() clock()
+#    define CALC_MS_CLOCK(x) static_cast<int>((x) / (CLOCKS_PER_SEC / 1000))
+#    define CALC_NS_AVG_CLOCK(x, y) (1000000LL * static_cast<long long>((x) / (CLOCKS_PER_SEC / 1000)) / (y ? y : 1))
+#  endif
+
+using mgr_t = cotask::task_manager<cotask::task<> >;
+
+int max_task_number = 10000;  // 协程Task数量
+int switch_count = 100;       // 每个Task的切换次数
+int batch_size = 64;          // 每批次resume的Task数量
+
+struct yield_action {
+  int operator()(void *) {
+    int count = switch_count;
+    while (count-- > 0) {
+      cotask::this_task::get_task()->yield();
+    }
+    return 0;
+  }
+};
+
+static void run_benchmark(bool use_batch) {
+  mgr_t::ptr_t mgr = mgr_t::create();
+  std::vector<mgr_t::batch_item_type> items;
+  for (int i = 0; i < max_task_number; ++i) {
+    cotask::task<>::ptr_t task = cotask::task<>::create(yield_action(), 16 * 1024);
+    mgr->add_task(task);
+    items.push_back(mgr_t::batch_item_type(task->get_id(), nullptr));
+  }
+  mgr->start_batch(items);
+
+  std::vector<int> results;
+  results.resize(static_cast<size_t>(batch_size), 0);
+
+  time_t begin_time = time(nullptr);
+  CALC_CLOCK_T begin_clock = CALC_CLOCK_NOW();
+
+  // drain completions just like an event loop
+  long long real_switch_times = 0;
+  for (int round = 0; round < switch_count; ++round) {
+    for (size_t i = 0; i < items.size(); i += static_cast<size_t>(batch_size)) {
+      size_t count = items.size() - i;
+      if (count > static_cast<size_t>(batch_size)) {
+        count = static_cast<size_t>(batch_size);
+      }
+
+      if (use_batch) {
+        mgr->resume_batch(LIBCOPP_COPP_NAMESPACE_ID::gsl::span<const mgr_t::batch_item_type>(&items[i], count),
+                          LIBCOPP_COPP_NAMESPACE_ID::gsl::span<int>(results.data(), count));
+      } else {
+        for (size_t j = 0; j < count; ++j) {
+          results[j] = mgr->resume(items[i + j].first, items[i + j].second);
+        }
+      }
+      real_switch_times += static_cast<long long>(count);
+    }
+  }
+
+  time_t end_time = time(nullptr);
+  CALC_CLOCK_T end_clock = CALC_CLOCK_NOW();
+  printf("[%s] resume %d tasks %lld times(remain %d), cost time: %d s, clock time: %d ms, avg: %lld ns\n",
+         use_batch ? "resume_batch" : "resume", max_task_number, real_switch_times,
+         static_cast<int>(mgr->get_task_size()), static_cast<int>(end_time - begin_time),
+         CALC_MS_CLOCK(end_clock - begin_clock), CALC_NS_AVG_CLOCK(end_clock - begin_clock, real_switch_times));
+}
+
+int main(int argc, char *argv[]) {
+  puts("###################### task manager batch ###################");
+  printf("########## Cmd:");
+  for (int i = 0; i < argc; ++i) {
+    printf(" %s", argv[i]);
+  }
+  puts("");
+
+  if (argc > 1) {
+    max_task_number = atoi(argv[1]);
+  }
+
+  if (argc > 2) {
+    switch_count = atoi(argv[2]);
+  }
+
+  if (argc > 3) {
+    batch_size = atoi(argv[3]);
+  }
+
+  if (max_task_number <= 0) {
+    max_task_number = 1;
+  }
+  if (batch_size <= 0) {
+    batch_size = 1;
+  }
+
+  run_benchmark(false);
+  run_benchmark(true);
+  return 0;
+}
+#else
+int main() {
+  puts("cotask disabled");
+  return 0;
+}
+#endif
@@ -0,0 +1,124 @@
+/*
+ * sample_benchmark_task_manager_sharded.cpp
+ *
+ *  Released under the MIT license
+ */
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// include manager header file
+#include <libcotask/task.h>
+#include <libcotask/task_manager.h>
+#include <libcotask/task_manager_sharded.h>
+
+#ifdef LIBCOTASK_MACRO_ENABLED
+
+#  if defined(PROJECT_LIBCOPP_SAMPLE_HAS_CHRONO) && PROJECT_LIBCOPP_SAMPLE_HAS_CHRONO
+#    include <chrono>
+#    define CALC_CLOCK_T std::chrono::system_clock::time_point
+#    define CALC_CLOCK_NOW() std::chrono::system_clock::now()
+#    define CALC_MS_CLOCK(x) static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(x).count())
+#    define CALC_NS_AVG_CLOCK(x, y) \
+      static_cast<long long>(std::chrono::duration_cast<std::chrono::nanoseconds>(x).count() / (y ? y : 1))
+#  else
+#    define CALC_CLOCK_T clock_t
+#    define CALC_CLOCK_NOW() clock()
+#    define CALC_MS_CLOCK(x) static_cast<int>((x) / (CLOCKS_PER_SEC / 1000))
+#    define CALC_NS_AVG_CLOCK(x, y) (1000000LL * static_cast<long long>((x) / (CLOCKS_PER_SEC / 1000)) / (y ? y : 1))
+#  endif
+
+int task_number_per_thread = 64;  // 每个线程的任务数量
+int round_count = 20000;          // 每个线程的循环次数
+
+using task_ptr_type = cotask::task<>::ptr_t;
+
+// add_task + set_timeout + find_task + remove_task, just like a I/O thread delivering completions
+template <class TMGR>
+static void run_thread(TMGR *mgr, std::vector<task_ptr_type> *tasks) {
+  for (int round = 0; round < round_count; ++round) {
+    for (size_t i = 0; i < tasks->size(); ++i) {
+      const task_ptr_type &task = (*tasks)[i];
+      mgr->add_task(task, 3600, 0);
+      mgr->set_timeout(task->get_id(), 7200, 0);
+      if (!mgr->find_task(task->get_id())) {
+        abort();
+      }
+      mgr->remove_task(task->get_id());
+    }
+  }
+}
+
+template <class TMGR>
+static void run_benchmark(const char *name, int thread_number) {
+  typename TMGR::ptr_type mgr = TMGR::create();
+  mgr->tick(time(nullptr));
+
+  std::vector<std::vector<task_ptr_type> > tasks;
+  tasks.resize(static_cast<size_t>(thread_number));
+  for (int i = 0; i < thread_number; ++i) {
+    for (int j = 0; j < task_number_per_thread; ++j) {
+      tasks[static_cast<size_t>(i)].push_back(cotask::task<>::create([]() { return 0; }, 16 * 1024));
+    }
+  }
+
+  time_t begin_time = time(nullptr);
+  CALC_CLOCK_T begin_clock = CALC_CLOCK_NOW();
+
+  std::vector<std::unique_ptr<std::thread> > threads;
+  for (int i = 0; i < thread_number; ++i) {
+    threads.push_back(std::unique_ptr<std::thread>(
+        new std::thread(run_thread<TMGR>, mgr.get(), &tasks[static_cast<size_t>(i)])));
+  }
+  for (size_t i = 0; i < threads.size(); ++i) {
+    threads[i]->join();
+  }
+
+  time_t end_time = time(nullptr);
+  CALC_CLOCK_T end_clock = CALC_CLOCK_NOW();
+  long long real_op_times = 4LL * thread_number * task_number_per_thread * round_count;
+  printf("[%s] %d threads, %lld operations, cost time: %d s, clock time: %d ms, avg: %lld ns\n", name, thread_number,
+         real_op_times, static_cast<int>(end_time - begin_time), CALC_MS_CLOCK(end_clock - begin_clock),
+         CALC_NS_AVG_CLOCK(end_clock - begin_clock, real_op_times));
+}
+
+int main(int argc, char *argv[]) {
+  puts("###################### task manager sharded ###################");
+  printf("########## Cmd:");
+  for (int i = 0; i < argc; ++i) {
+    printf(" %s", argv[i]);
+  }
+  puts("");
+
+  if (argc > 1) {
+    task_number_per_thread = atoi(argv[1]);
+  }
+
+  if (argc > 2) {
+    round_count = atoi(argv[2]);
+  }
+
+  if (task_number_per_thread <= 0) {
+    task_number_per_thread = 1;
+  }
+
+  int thread_numbers[] = {1, 4, 16};
+  for (size_t i = 0; i < sizeof(thread_numbers) / sizeof(thread_numbers[0]); ++i) {
+    run_benchmark<cotask::task_manager<cotask::task<> > >("task_manager", thread_numbers[i]);
+    run_benchmark<cotask::task_manager_sharded<cotask::task<>, 16> >("task_manager_sharded", thread_numbers[i]);
+  }
+  return 0;
+}
+#else
+int main() {
+  puts("cotask disabled");
+  return 0;
+}
+#endif
@@ -0,0 +1,170 @@
+/*
+ * sample_benchmark_task_timer.cpp
+ *
+ *  Released under the MIT license
+ */
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <vector>
+
+// include manager header file
+#include <libcotask/task_manager.h>
+
+#ifdef LIBCOTASK_MACRO_ENABLED
+
+#  if defined(PROJECT_LIBCOPP_SAMPLE_HAS_CHRONO) && PROJECT_LIBCOPP_SAMPLE_HAS_CHRONO
+#    include <chrono>
+#    define CALC_CLOCK_T std::chrono::system_clock::time_point
+#    define CALC_CLOCK_NOW() std::chrono::system_clock::now()
+#    define CALC_MS_CLOCK(x) static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(x).count())
+#    define CALC_NS_AVG_CLOCK(x, y) \
+      static_cast<long long>(std::chrono::duration_cast<std::chrono::nanoseconds>(x).count() / (y ? y : 1))
+#  else
+#    define CALC_CLOCK_T clock_t
+#    define CALC_CLOCK_NOW() clock()
+#    define CALC_MS_CLOCK(x) static_cast<int>((x) / (CLOCKS_PER_SEC / 1000))
+#    define CALC_NS_AVG_CLOCK(x, y) (1000000LL * static_cast<long long>((x) / (CLOCKS_PER_SEC / 1000)) / (y ? y : 1))
+#  endif
+
+int max_checkpoint_number = 100000;  // 定时器数量
+int update_count = 10;               // 每个定时器的更新次数
+int tick_interval_ms = 16;           // tick间隔
+
+static uint64_t random_seed = 20231018;
+static int next_timeout_ms() {
+  random_seed = random_seed * 6364136223846793005ULL + 1442695040888963407ULL;
+  // timeout in 1-60s
+  return 1000 + static_cast<int>((random_seed >> 33) % 59000);
+}
+
+template <class TTIMER>
+static void run_benchmark(const char *name) {
+  using id_type = typename TTIMER::id_type;
+  using handle_type = typename TTIMER::handle_type;
+
+  TTIMER timer;
+  std::vector<handle_type> handles;
+  handles.resize(static_cast<size_t>(max_checkpoint_number), timer.end());
+  random_seed = 20231018;
+
+  cotask::detail::tickspec_t now;
+  now.tv_sec = 1700000000;
+  now.tv_nsec = 0;
+  timer.rebase(now, [](id_type, handle_type) {});
+
+  auto make_checkpoint = [&now](id_type task_id) {
+    int timeout_ms = next_timeout_ms();
+    cotask::detail::task_timer_node<id_type> ret;
+    ret.task_id = task_id;
+    ret.expired_time.tv_sec = now.tv_sec + timeout_ms / 1000;
+    ret.expired_time.tv_nsec = now.tv_nsec + (timeout_ms % 1000) * 1000000;
+    if (ret.expired_time.tv_nsec >= 1000000000) {
+      ++ret.expired_time.tv_sec;
+      ret.expired_time.tv_nsec -= 1000000000;
+    }
+    return ret;
+  };
+
+  time_t begin_time = time(nullptr);
+  CALC_CLOCK_T begin_clock = CALC_CLOCK_NOW();
+
+  for (int i = 0; i < max_checkpoint_number; ++i) {
+    handles[static_cast<size_t>(i)] = timer.insert(make_checkpoint(static_cast<id_type>(i)));
+  }
+
+  time_t end_time = time(nullptr);
+  CALC_CLOCK_T end_clock = CALC_CLOCK_NOW();
+  printf("[%s] add %d checkpoints, cost time: %d s, clock time: %d ms, avg: %lld ns\n", name, max_checkpoint_number,
+         static_cast<int>(end_time - begin_time), CALC_MS_CLOCK(end_clock - begin_clock),
+         CALC_NS_AVG_CLOCK(end_clock - begin_clock, max_checkpoint_number));
+
+  begin_time = end_time;
+  begin_clock = end_clock;
+
+  // update timeout just like set_timeout(...)
+  long long real_update_times = 0;
+  for (int round = 0; round < update_count; ++round) {
+    for (int i = 0; i < max_checkpoint_number; ++i) {
+      timer.erase(handles[static_cast<size_t>(i)]);
+      handles[static_cast<size_t>(i)] = timer.insert(make_checkpoint(static_cast<id_type>(i)));
+      ++real_update_times;
+    }
+  }
+
+  end_time = time(nullptr);
+  end_clock = CALC_CLOCK_NOW();
+  printf("[%s] update %d checkpoints %lld times, cost time: %d s, clock time: %d ms, avg: %lld ns\n", name,
+         max_checkpoint_number, real_update_times, static_cast<int>(end_time - begin_time),
+         CALC_MS_CLOCK(end_clock - begin_clock), CALC_NS_AVG_CLOCK(end_clock - begin_clock, real_update_times));
+
+  begin_time = end_time;
+  begin_clock = end_clock;
+
+  // tick until all checkpoints are expired
+  long long real_expired_times = 0;
+  long long real_tick_times = 0;
+  while (!timer.empty()) {
+    now.tv_nsec += tick_interval_ms * 1000000;
+    if (now.tv_nsec >= 1000000000) {
+      ++now.tv_sec;
+      now.tv_nsec -= 1000000000;
+    }
+
+    ++real_tick_times;
+    timer.advance(now);
+    id_type task_id;
+    while (timer.pop_expired(now, task_id)) {
+      handles[static_cast<size_t>(task_id)] = timer.end();
+      ++real_expired_times;
+    }
+  }
+
+  end_time = time(nullptr);
+  end_clock = CALC_CLOCK_NOW();
+  printf("[%s] expire %lld checkpoints in %lld ticks, cost time: %d s, clock time: %d ms, avg: %lld ns\n", name,
+         real_expired_times, real_tick_times, static_cast<int>(end_time - begin_time),
+         CALC_MS_CLOCK(end_clock - begin_clock), CALC_NS_AVG_CLOCK(end_clock - begin_clock, real_expired_times));
+}
+
+int main(int argc, char *argv[]) {
+  puts("###################### task manager timer ###################");
+  printf("########## Cmd:");
+  for (int i = 0; i < argc; ++i) {
+    printf(" %s", argv[i]);
+  }
+  puts("");
+
+  if (argc > 1) {
+    max_checkpoint_number = atoi(argv[1]);
+  }
+
+  if (argc > 2) {
+    update_count = atoi(argv[2]);
+  }
+
+  if (argc > 3) {
+    tick_interval_ms = atoi(argv[3]);
+  }
+
+  if (max_checkpoint_number <= 0) {
+    max_checkpoint_number = 1;
+  }
+  if (tick_interval_ms <= 0) {
+    tick_interval_ms = 1;
+  }
+
+  run_benchmark<cotask::task_timer_set<uint64_t> >("std::set");
+  run_benchmark<cotask::task_timer_wheel<uint64_t> >("timing wheel");
+  return 0;
+}
+#else
+int main() {
+  puts("cotask disabled");
+  return 0;
+}
+#endif
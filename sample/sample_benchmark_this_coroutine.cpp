@@ -0,0 +1,132 @@
+/*
+ * sample_benchmark_this_coroutine.cpp
+ *
+ *  Released under the MIT license
+ */
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+
+// include manager header file
+#include <libcopp/coroutine/coroutine_context_container.h>
+
+#ifdef LIBCOTASK_MACRO_ENABLED
+#  include <libcotask/this_task.h>
+#endif
+
+#if defined(PROJECT_LIBCOPP_SAMPLE_HAS_CHRONO) && PROJECT_LIBCOPP_SAMPLE_HAS_CHRONO
+#  include <chrono>
+#  define CALC_CLOCK_T std::chrono::system_clock::time_point
+#  define CALC_CLOCK_NOW() std::chrono::system_clock::now()
+#  define CALC_MS_CLOCK(x) static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(x).count())
+#  define CALC_NS_AVG_CLOCK(x, y) \
+    static_cast<long long>(std::chrono::duration_cast<std::chrono::nanoseconds>(x).count() / (y ? y : 1))
+#else
+#  define CALC_CLOCK_T clock_t
+#  define CALC_CLOCK_NOW() clock()
+#  define CALC_MS_CLOCK(x) static_cast<int>((x) / (CLOCKS_PER_SEC / 1000))
+#  define CALC_NS_AVG_CLOCK(x, y) (1000000LL * static_cast<long long>((x) / (CLOCKS_PER_SEC / 1000)) / (y ? y : 1))
+#endif
+
+// keep the lookup in loop, or compilers will read the thread local variable only once
+#if defined(__GNUC__) || defined(__clang__)
+#  define SAMPLE_COMPILER_BARRIER() __asm__ __volatile__("" ::: "memory")
+#elif defined(_MSC_VER)
+#  include <intrin.h>
+#  define SAMPLE_COMPILER_BARRIER() _ReadWriteBarrier()
+#else
+#  define SAMPLE_COMPILER_BARRIER()
+#endif
+
+int lookup_count = 10000000;
+int switch_count = 1000000;
+
+static void print_cost(const char *name, CALC_CLOCK_T begin_clock, CALC_CLOCK_T end_clock, long long times) {
+  printf("%s %lld times, clock time: %d ms, avg: %lld ns\n", name, times, CALC_MS_CLOCK(end_clock - begin_clock),
+         CALC_NS_AVG_CLOCK(end_clock - begin_clock, times));
+}
+
+static int lookup_runner(void *) {
+  uintptr_t checksum = 0;
+
+  CALC_CLOCK_T begin_clock = CALC_CLOCK_NOW();
+  for (int i = 0; i < lookup_count; ++i) {
+    checksum ^= reinterpret_cast<uintptr_t>(copp::this_coroutine::get_coroutine());
+    SAMPLE_COMPILER_BARRIER();
+  }
+  CALC_CLOCK_T end_clock = CALC_CLOCK_NOW();
+  print_cost("this_coroutine::get_coroutine()", begin_clock, end_clock, lookup_count);
+
+  // exported function, it's always an out-of-line call
+  begin_clock = CALC_CLOCK_NOW();
+  for (int i = 0; i < lookup_count; ++i) {
+    checksum ^= reinterpret_cast<uintptr_t>(copp::coroutine_context_base::get_this_coroutine_base());
+    SAMPLE_COMPILER_BARRIER();
+  }
+  end_clock = CALC_CLOCK_NOW();
+  print_cost("coroutine_context_base::get_this_coroutine_base()", begin_clock, end_clock, lookup_count);
+
+#ifdef LIBCOTASK_MACRO_ENABLED
+  begin_clock = CALC_CLOCK_NOW();
+  for (int i = 0; i < lookup_count; ++i) {
+    checksum ^= reinterpret_cast<uintptr_t>(cotask::this_task::get_task());
+    SAMPLE_COMPILER_BARRIER();
+  }
+  end_clock = CALC_CLOCK_NOW();
+  print_cost("cotask::this_task::get_task()", begin_clock, end_clock, lookup_count);
+#endif
+
+  return static_cast<int>(checksum & 0x01);
+}
+
+static int switch_runner(void *) {
+  copp::coroutine_context *self = copp::this_coroutine::get_coroutine();
+  int count = switch_count;
+  while (count-- > 0) {
+    self->yield();
+  }
+  return 0;
+}
+
+int main(int argc, char *argv[]) {
+  puts("###################### this_coroutine lookup ###################");
+  printf("########## Cmd:");
+  for (int i = 0; i < argc; ++i) {
+    printf(" %s", argv[i]);
+  }
+  puts("");
+
+  if (argc > 1) {
+    lookup_count = atoi(argv[1]);
+  }
+
+  if (argc > 2) {
+    switch_count = atoi(argv[2]);
+  }
+
+  printf("inline this_coroutine: %s\n", LIBCOPP_MACRO_ENABLE_INLINE_THIS_COROUTINE ? "on" : "off");
+
+  {
+    copp::coroutine_context_default::ptr_t co = copp::coroutine_context_default::create(lookup_runner);
+    co->start();
+  }
+
+  {
+    // every switch updates the current coroutine twice
+    copp::coroutine_context_default::ptr_t co = copp::coroutine_context_default::create(switch_runner);
+    CALC_CLOCK_T begin_clock = CALC_CLOCK_NOW();
+    co->start();
+    long long real_switch_times = 0;
+    while (0 == co->resume()) {
+      ++real_switch_times;
+    }
+    CALC_CLOCK_T end_clock = CALC_CLOCK_NOW();
+    print_cost("switch coroutine", begin_clock, end_clock, real_switch_times);
+  }
+
+  return 0;
+}
@@ -6,6 +6,7 @@
 #include <libcopp/utils/std/explicit_declare.h>
 
 #include <libcopp/coroutine/coroutine_context.h>
+#include <libcopp/stack/stack_watermark.h>
 
 // clang-format off
 #include <libcopp/utils/config/stl_include_prefix.h>  // NOLINT(build/include_order)
@@ -38,7 +39,9 @@ void __splitstack_block_signals_context(void *[COPP_MACRO_SEGMENTED_STACK_NUMBER
 LIBCOPP_COPP_NAMESPACE_BEGIN
 namespace detail {
 
-#if defined(LIBCOPP_LOCK_DISABLE_THIS_MT) && LIBCOPP_LOCK_DISABLE_THIS_MT
+#if defined(LIBCOPP_MACRO_ENABLE_INLINE_THIS_COROUTINE) && LIBCOPP_MACRO_ENABLE_INLINE_THIS_COROUTINE
+LIBCOPP_COPP_API LIBCOPP_MACRO_THIS_COROUTINE_TLS coroutine_context_base *gt_current_coroutine = nullptr;
+#elif defined(LIBCOPP_LOCK_DISABLE_THIS_MT) && LIBCOPP_LOCK_DISABLE_THIS_MT
 static coroutine_context_base *gt_current_coroutine = nullptr;
 #elif defined(COPP_MACRO_THREAD_LOCAL)
 static COPP_MACRO_THREAD_LOCAL coroutine_context_base *gt_current_coroutine = nullptr;
@@ -65,17 +68,29 @@ static inline coroutine_context_base *get_this_coroutine_context() {
   return reinterpret_cast<coroutine_context_base *>(pthread_getspecific(gt_coroutine_tls_key));
 #endif
 }
+
+// cache colors of coroutine stacks, @see coroutine_context::next_stack_color_offset()
+static LIBCOPP_COPP_NAMESPACE_ID::util::lock::atomic_int_type<size_t> g_stack_color_count(
+    LIBCOPP_MACRO_COROUTINE_STACK_COLOR_COUNT);
+static LIBCOPP_COPP_NAMESPACE_ID::util::lock::atomic_int_type<size_t> g_stack_color_index(0);
 }  // namespace detail
 
 LIBCOPP_COPP_API coroutine_context_base::coroutine_context_base() LIBCOPP_MACRO_NOEXCEPT
     : runner_ret_code_(0),
       flags_(0),
       runner_(nullptr),
+      runner_invoke_fn_(nullptr),
+      runner_destroy_fn_(nullptr),
+      runner_object_(nullptr),
       priv_data_(nullptr),
       private_buffer_size_(0),
       status_(status_type::EN_CRS_INVALID) {}
 
-LIBCOPP_COPP_API coroutine_context_base::~coroutine_context_base() {}
+LIBCOPP_COPP_API coroutine_context_base::~coroutine_context_base() {
+  if (nullptr != runner_destroy_fn_) {
+    (*runner_destroy_fn_)(runner_object_);
+  }
+}
 
 LIBCOPP_COPP_API bool coroutine_context_base::set_flags(int flags) LIBCOPP_MACRO_NOEXCEPT {
   if (flags & flag_type::EN_CFT_MASK) {
@@ -95,29 +110,43 @@ LIBCOPP_COPP_API bool coroutine_context_base::unset_flags(int flags) LIBCOPP_MAC
   return true;
 }
 
-LIBCOPP_COPP_API bool coroutine_context_base::check_flags(int flags) const LIBCOPP_MACRO_NOEXCEPT {
-  return 0 != (flags_ & flags);
-}
-
 LIBCOPP_COPP_API int coroutine_context_base::set_runner(callback_type &&runner) {
   if (!runner) {
     return COPP_EC_ARGS_ERROR;
   }
 
   int from_status = status_type::EN_CRS_INVALID;
-  if (false == status_.compare_exchange_strong(from_status, status_type::EN_CRS_READY,
-                                               LIBCOPP_COPP_NAMESPACE_ID::util::lock::memory_order_acq_rel,
-                                               LIBCOPP_COPP_NAMESPACE_ID::util::lock::memory_order_acquire)) {
+  if (false == compare_exchange_status(from_status, status_type::EN_CRS_READY)) {
     return COPP_EC_ALREADY_INITED;
   }
 
   runner_ = std::move(runner);
+  runner_invoke_fn_ = &details::coroutine_runner_delegate<callback_type>::invoke;
+  runner_destroy_fn_ = nullptr;
+  runner_object_ = &runner_;
+  return COPP_EC_SUCCESS;
+}
+
+LIBCOPP_COPP_API int coroutine_context_base::set_runner(void *runner, runner_invoke_fn_type invoke_fn,
+                                                        runner_destroy_fn_type destroy_fn) LIBCOPP_MACRO_NOEXCEPT {
+  if (nullptr == runner || nullptr == invoke_fn) {
+    return COPP_EC_ARGS_ERROR;
+  }
+
+  int from_status = status_type::EN_CRS_INVALID;
+  if (false == compare_exchange_status(from_status, status_type::EN_CRS_READY)) {
+    return COPP_EC_ALREADY_INITED;
+  }
+
+  runner_invoke_fn_ = invoke_fn;
+  runner_destroy_fn_ = destroy_fn;
+  runner_object_ = runner;
   return COPP_EC_SUCCESS;
 }
 
 LIBCOPP_COPP_API bool coroutine_context_base::is_finished() const LIBCOPP_MACRO_NOEXCEPT {
   // return !!(flags_ & flag_type::EN_CFT_FINISHED);
-  return status_.load(LIBCOPP_COPP_NAMESPACE_ID::util::lock::memory_order_acquire) >= status_type::EN_CRS_FINISHED;
+  return load_status() >= status_type::EN_CRS_FINISHED;
 }
 
 LIBCOPP_COPP_API coroutine_context_base *coroutine_context_base::get_this_coroutine_base() LIBCOPP_MACRO_NOEXCEPT {
@@ -144,6 +173,13 @@ struct libcopp_internal_api_set {
     }
   }
 
+  UTIL_FORCEINLINE static void set_exited_if_finished(coroutine_context *src) {
+    // if in finished status, change it to exited
+    if (nullptr != src && src->check_flags(coroutine_context::flag_type::EN_CFT_FINISHED)) {
+      src->store_status(coroutine_context::status_type::EN_CRS_EXITED);
+    }
+  }
+
 #ifdef LIBCOPP_MACRO_USE_SEGMENTED_STACKS
   UTIL_FORCEINLINE static void splitstack_swapcontext(EXPLICIT_UNUSED_ATTR stack_context &from_sctx,
                                                       EXPLICIT_UNUSED_ATTR stack_context &to_sctx,
@@ -161,6 +197,44 @@ struct libcopp_internal_api_set {
   }
 #endif
 
+  struct ontop_jump_data_t {
+    jump_src_data_t jump_data;  // must be the first member, the target coroutine reads it as jump_src_data_t
+    coroutine_context::ontop_callback_type fn;
+    void *fn_data;
+  };
+
+  /**
+   * @brief start or resume a coroutine
+   * @param co coroutine to jump into
+   * @param priv_data private data passed to co
+   * @param fn if it's not nullptr, call it on top of the stack of co, and its return value replaces priv_data
+   * @param fn_data data passed to fn
+   */
+  static int start_coroutine(coroutine_context &co, void *priv_data, coroutine_context::ontop_callback_type fn,
+                             void *fn_data) LIBCOPP_MACRO_NOEXCEPT;
+
+  /**
+   * @brief resume coroutines one by one, prefetch object of cos[i + 2] and saved frame of cos[i + 1] before cos[i]
+   * @param unhandled it's set by the first unhandled exception, the following ones are kept in their coroutines
+   */
+#if defined(LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR) && LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR
+  static size_t resume_batch(gsl::span<coroutine_context *> cos, void *priv_data,
+                             std::exception_ptr &unhandled) LIBCOPP_MACRO_NOEXCEPT;
+#else
+  static size_t resume_batch(gsl::span<coroutine_context *> cos, void *priv_data) LIBCOPP_MACRO_NOEXCEPT;
+#endif
+
+  static LIBCOPP_COPP_NAMESPACE_ID::fcontext::transfer_t coroutine_context_ontop_callback(
+      LIBCOPP_COPP_NAMESPACE_ID::fcontext::transfer_t src_ctx) {
+    // it runs on the stack of target coroutine, the returned transfer_t is received by the jump of target coroutine
+    ontop_jump_data_t *ontop_data = reinterpret_cast<ontop_jump_data_t *>(src_ctx.data);
+    coroutine_context *ins_ptr = ontop_data->jump_data.to_co;
+
+    detail::set_this_coroutine_context(ins_ptr);
+    ontop_data->jump_data.priv_data = (*ontop_data->fn)(ins_ptr, ontop_data->fn_data);
+    return src_ctx;
+  }
+
   static void coroutine_context_callback(LIBCOPP_COPP_NAMESPACE_ID::fcontext::transfer_t src_ctx) {
     assert(src_ctx.data);
     if (nullptr == src_ctx.data) {
@@ -179,8 +253,10 @@ struct libcopp_internal_api_set {
       // return; // clang-analyzer will report "Unreachable code"
     }
 
-    // update caller of to_co
-    ins_ptr->caller_ = src_ctx.fctx;
+    // update caller of to_co, switch_to() has already set it
+    if (!jump_src.keep_caller) {
+      ins_ptr->caller_ = src_ctx.fctx;
+    }
 
     // save from_co's fcontext and switch status
     if (nullptr != jump_src.from_co) {
@@ -215,10 +291,12 @@ struct libcopp_internal_api_set {
  * @param from_sctx jump from stack context(only used for save segment stack)
  * @param to_sctx jump to stack context(only used for set segment stack)
  * @param jump_transfer jump data
+ * @param ontop_fn if it is not nullptr, call it on top of the stack of to_fctx before jump back
  */
 static inline void jump_to(fcontext::fcontext_t &to_fctx, EXPLICIT_UNUSED_ATTR stack_context &from_sctx,
                            EXPLICIT_UNUSED_ATTR stack_context &to_sctx,
-                           libcopp_internal_api_set::jump_src_data_t &jump_transfer) LIBCOPP_MACRO_NOEXCEPT {
+                           libcopp_internal_api_set::jump_src_data_t &jump_transfer,
+                           fcontext::transfer_t (*ontop_fn)(fcontext::transfer_t) = nullptr) LIBCOPP_MACRO_NOEXCEPT {
   LIBCOPP_COPP_NAMESPACE_ID::fcontext::transfer_t res;
   libcopp_internal_api_set::jump_src_data_t *jump_src;
   // int from_status;
@@ -234,7 +312,11 @@ static inline void jump_to(fcontext::fcontext_t &to_fctx, EXPLICIT_UNUSED_ATTR s
   // B.callee_stack_, skip backup segments
   libcopp_internal_api_set::splitstack_swapcontext(from_sctx, to_sctx, jump_transfer);
 #endif
-  res = LIBCOPP_COPP_NAMESPACE_ID::fcontext::copp_jump_fcontext_v2(to_fctx, &jump_transfer);
+  if (nullptr == ontop_fn) {
+    res = LIBCOPP_COPP_NAMESPACE_ID::fcontext::copp_jump_fcontext_v2(to_fctx, &jump_transfer);
+  } else {
+    res = LIBCOPP_COPP_NAMESPACE_ID::fcontext::copp_ontop_fcontext_v2(to_fctx, &jump_transfer, ontop_fn);
+  }
   if (nullptr == res.data) {
     abort();
     return;
@@ -256,11 +338,17 @@ static inline void jump_to(fcontext::fcontext_t &to_fctx, EXPLICIT_UNUSED_ATTR s
    *
    */
 
-  // update caller of to_co if not jump from yield mode
-  libcopp_internal_api_set::set_caller(jump_src->to_co, res.fctx);
+  // update caller of to_co if not jump from yield mode or switch_to()
+  if (!jump_src->keep_caller) {
+    libcopp_internal_api_set::set_caller(jump_src->to_co, res.fctx);
+  }
 
   libcopp_internal_api_set::set_callee(jump_src->from_co, res.fctx);
 
+  // Move changing status to EN_CRS_EXITED is finished. It must be the coroutine which jumps back, because the target of
+  // switch_to() also returns to the caller of the coroutine which called switch_to()
+  libcopp_internal_api_set::set_exited_if_finished(jump_src->from_co);
+
   // private data
   jump_transfer.priv_data = jump_src->priv_data;
 
@@ -276,6 +364,8 @@ LIBCOPP_COPP_API coroutine_context::coroutine_context() LIBCOPP_MACRO_NOEXCEPT :
     ,
                                                                                  caller_stack_()
 #endif
+    ,
+                                                                                 callee_stack_offset_(0)
 {
 }
 
@@ -283,7 +373,8 @@ LIBCOPP_COPP_API coroutine_context::~coroutine_context() {}
 
 LIBCOPP_COPP_API int coroutine_context::create(coroutine_context *p, callback_type &&runner,
                                                const stack_context &callee_stack, size_t coroutine_size,
-                                               size_t private_buffer_size) LIBCOPP_MACRO_NOEXCEPT {
+                                               size_t private_buffer_size,
+                                               size_t color_offset) LIBCOPP_MACRO_NOEXCEPT {
   if (nullptr == p) {
     return COPP_EC_ARGS_ERROR;
   }
@@ -297,20 +388,24 @@ LIBCOPP_COPP_API int coroutine_context::create(coroutine_context *p, callback_ty
     return COPP_EC_ARGS_ERROR;
   }
 
-  size_t stack_offset = align_stack_size(private_buffer_size + coroutine_size);
+  if (0 != (color_offset & (sizeof(size_t) - 1))) {
+    return COPP_EC_ARGS_ERROR;
+  }
+
+  size_t stack_offset = align_stack_size(color_offset + private_buffer_size + coroutine_size);
   if (nullptr == callee_stack.sp || callee_stack.size <= stack_offset) {
     return COPP_EC_ARGS_ERROR;
   }
 
   // stack down
-  // |STACK BUFFER........COROUTINE..this..padding..PRIVATE DATA.....callee_stack.sp |
+  // |STACK BUFFER........COROUTINE..this..padding..PRIVATE DATA..COLOR..callee_stack.sp |
   // |------------------------------callee_stack.size -------------------------------|
   if (callee_stack.sp <= p || coroutine_size < sizeof(coroutine_context)) {
     return COPP_EC_ARGS_ERROR;
   }
 
   size_t this_offset = reinterpret_cast<unsigned char *>(callee_stack.sp) - reinterpret_cast<unsigned char *>(p);
-  if (this_offset < sizeof(coroutine_context) + private_buffer_size || this_offset > stack_offset) {
+  if (this_offset < sizeof(coroutine_context) + private_buffer_size + color_offset || this_offset > stack_offset) {
     return COPP_EC_ARGS_ERROR;
   }
 
@@ -321,9 +416,10 @@ LIBCOPP_COPP_API int coroutine_context::create(coroutine_context *p, callback_ty
     p->callee_stack_ = callee_stack;
   }
   p->private_buffer_size_ = private_buffer_size;
+  p->callee_stack_offset_ = stack_offset;
 
   // stack down, left enough private data
-  p->priv_data_ = reinterpret_cast<unsigned char *>(p->callee_stack_.sp) - p->private_buffer_size_;
+  p->priv_data_ = reinterpret_cast<unsigned char *>(p->callee_stack_.sp) - color_offset - p->private_buffer_size_;
   p->callee_ = fcontext::copp_make_fcontext_v2(reinterpret_cast<unsigned char *>(p->callee_stack_.sp) - stack_offset,
                                                p->callee_stack_.size - stack_offset,
                                                &libcopp_internal_api_set::coroutine_context_callback);
@@ -334,83 +430,256 @@ LIBCOPP_COPP_API int coroutine_context::create(coroutine_context *p, callback_ty
   return COPP_EC_SUCCESS;
 }
 
-#if defined(LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR) && LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR
-LIBCOPP_COPP_API int coroutine_context::start(void *priv_data) {
-  std::exception_ptr eptr;
-  int ret = start(eptr, priv_data);
-  maybe_rethrow(eptr);
-  return ret;
+LIBCOPP_COPP_API void coroutine_context::set_stack_color_count(size_t count) LIBCOPP_MACRO_NOEXCEPT {
+  detail::g_stack_color_count.store(count > 1 ? count : 1, LIBCOPP_COPP_NAMESPACE_ID::util::lock::memory_order_relaxed);
 }
 
-LIBCOPP_COPP_API int coroutine_context::start(std::exception_ptr &unhandled, void *priv_data) LIBCOPP_MACRO_NOEXCEPT {
-#else
-LIBCOPP_COPP_API int coroutine_context::start(void *priv_data) {
+LIBCOPP_COPP_API size_t coroutine_context::get_stack_color_count() LIBCOPP_MACRO_NOEXCEPT {
+  return detail::g_stack_color_count.load(LIBCOPP_COPP_NAMESPACE_ID::util::lock::memory_order_relaxed);
+}
+
+LIBCOPP_COPP_API size_t coroutine_context::next_stack_color_offset() LIBCOPP_MACRO_NOEXCEPT {
+  size_t count = detail::g_stack_color_count.load(LIBCOPP_COPP_NAMESPACE_ID::util::lock::memory_order_relaxed);
+  if (count <= 1) {
+    return 0;
+  }
+
+  // Only the distribution matters, so a relaxed counter shared by all threads is enough
+  size_t index = detail::g_stack_color_index.fetch_add(1, LIBCOPP_COPP_NAMESPACE_ID::util::lock::memory_order_relaxed);
+  return (index % count) * LIBCOPP_MACRO_COROUTINE_STACK_COLOR_UNIT;
+}
+
+LIBCOPP_COPP_API int coroutine_context::init_detached(callback_type &&runner, void *priv_data,
+                                                      size_t private_buffer_size) LIBCOPP_MACRO_NOEXCEPT {
+  if (0 != private_buffer_size && nullptr == priv_data) {
+    return COPP_EC_ARGS_ERROR;
+  }
+
+  // if runner is empty, we can set it later
+  set_runner(std::move(runner));
+
+  priv_data_ = priv_data;
+  private_buffer_size_ = private_buffer_size;
+  return COPP_EC_SUCCESS;
+}
+
+LIBCOPP_COPP_API int coroutine_context::make_callee_fcontext(const stack_context &callee_stack)
+    LIBCOPP_MACRO_NOEXCEPT {
+  if (nullptr == callee_stack.sp || 0 == callee_stack.size) {
+    return COPP_EC_ARGS_ERROR;
+  }
+
+  if (&callee_stack_ != &callee_stack) {
+    callee_stack_ = callee_stack;
+  }
+  callee_stack_offset_ = 0;
+
+  callee_ = fcontext::copp_make_fcontext_v2(callee_stack_.sp, callee_stack_.size,
+                                            &libcopp_internal_api_set::coroutine_context_callback);
+  if (nullptr == callee_) {
+    return COPP_EC_FCONTEXT_MAKE_FAILED;
+  }
+
+  return COPP_EC_SUCCESS;
+}
+
+LIBCOPP_COPP_API int coroutine_context::reset_callee(callback_type &&runner) LIBCOPP_MACRO_NOEXCEPT {
+  if (nullptr == callee_stack_.sp || callee_stack_.size <= callee_stack_offset_) {
+    return COPP_EC_NOT_INITED;
+  }
+
+  int from_status = status_type::EN_CRS_EXITED;
+  if (false == compare_exchange_status(from_status, status_type::EN_CRS_INVALID)) {
+    if (status_type::EN_CRS_INVALID == from_status) {
+      return COPP_EC_NOT_INITED;
+    }
+
+    // suspended or running, its frames are still on the stack
+    return COPP_EC_IS_RUNNING;
+  }
+
+  if (nullptr != runner_destroy_fn_) {
+    (*runner_destroy_fn_)(runner_object_);
+  }
+  runner_invoke_fn_ = nullptr;
+  runner_destroy_fn_ = nullptr;
+  runner_object_ = nullptr;
+  runner_ = nullptr;
+
+  runner_ret_code_ = 0;
+  flags_ &= ~flag_type::EN_CFT_FINISHED;
+#if defined(LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR) && LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR
+  unhandle_exception_ = std::exception_ptr();
 #endif
+
+  caller_ = nullptr;
+  callee_ = fcontext::copp_make_fcontext_v2(reinterpret_cast<unsigned char *>(callee_stack_.sp) - callee_stack_offset_,
+                                            callee_stack_.size - callee_stack_offset_,
+                                            &libcopp_internal_api_set::coroutine_context_callback);
   if (nullptr == callee_) {
+    return COPP_EC_FCONTEXT_MAKE_FAILED;
+  }
+
+  // if runner is empty, we can set it later
+  set_runner(std::move(runner));
+  return COPP_EC_SUCCESS;
+}
+
+int libcopp_internal_api_set::start_coroutine(coroutine_context &co, void *priv_data,
+                                              coroutine_context::ontop_callback_type fn,
+                                              void *fn_data) LIBCOPP_MACRO_NOEXCEPT {
+  if (nullptr == co.callee_) {
     return COPP_EC_NOT_INITED;
   }
 
 #if defined(LIBCOPP_MACRO_ENABLE_WIN_FIBER) && LIBCOPP_MACRO_ENABLE_WIN_FIBER
   {
     coroutine_context_base *this_ctx = detail::get_this_coroutine_context();
-    if (this_ctx && this_ctx->check_flags(flag_type::EN_CFT_IS_FIBER)) {
+    if (this_ctx && this_ctx->check_flags(coroutine_context::flag_type::EN_CFT_IS_FIBER)) {
       return LIBCOPP_COPP_NAMESPACE_ID::COPP_EC_CAN_NOT_USE_CROSS_FCONTEXT_AND_FIBER;
     }
   }
 #endif
 
-  int from_status = status_type::EN_CRS_READY;
+  int from_status = coroutine_context::status_type::EN_CRS_READY;
   do {
-    if (from_status < status_type::EN_CRS_READY) {
+    if (from_status < coroutine_context::status_type::EN_CRS_READY) {
       return COPP_EC_NOT_INITED;
     }
 
-    if (status_.compare_exchange_strong(from_status, status_type::EN_CRS_RUNNING,
-                                        LIBCOPP_COPP_NAMESPACE_ID::util::lock::memory_order_acq_rel,
-                                        LIBCOPP_COPP_NAMESPACE_ID::util::lock::memory_order_acquire)) {
+    if (co.compare_exchange_status(from_status, coroutine_context::status_type::EN_CRS_RUNNING)) {
       break;
     } else {
       // finished or stoped
-      if (from_status > status_type::EN_CRS_RUNNING) {
+      if (from_status > coroutine_context::status_type::EN_CRS_RUNNING) {
         return COPP_EC_NOT_READY;
       }
 
       // already running
-      if (status_type::EN_CRS_RUNNING == from_status) {
+      if (coroutine_context::status_type::EN_CRS_RUNNING == from_status) {
         return COPP_EC_IS_RUNNING;
       }
     }
   } while (true);
 
-  jump_src_data_t jump_data;
+  // the initial fcontext made by copp_make_fcontext_v2() can not run a function on top of it, so call fn before the
+  // first jump. caller_ is set when the coroutine is started.
+  if (nullptr != fn && nullptr == co.caller_) {
+    coroutine_context_base *prev_ctx = detail::get_this_coroutine_context();
+    detail::set_this_coroutine_context(&co);
+    priv_data = (*fn)(&co, fn_data);
+    detail::set_this_coroutine_context(prev_ctx);
+    fn = nullptr;
+  }
+
+  // ontop_data.fn and ontop_data.fn_data are only used when fn is not nullptr
+  ontop_jump_data_t ontop_data;
+  jump_src_data_t &jump_data = ontop_data.jump_data;
 #if defined(LIBCOPP_MACRO_ENABLE_WIN_FIBER) && LIBCOPP_MACRO_ENABLE_WIN_FIBER
   jump_data.from_co = LIBCOPP_COPP_NAMESPACE_ID::this_coroutine::get_coroutine();
 #else
   jump_data.from_co = static_cast<coroutine_context *>(detail::get_this_coroutine_context());
 #endif
-  jump_data.to_co = this;
+  jump_data.to_co = &co;
   jump_data.priv_data = priv_data;
+  jump_data.keep_caller = false;
+  ontop_data.fn = fn;
+  ontop_data.fn_data = fn_data;
 
+  fcontext::transfer_t (*ontop_fn)(fcontext::transfer_t) =
+      nullptr == fn ? nullptr : &libcopp_internal_api_set::coroutine_context_ontop_callback;
 #ifdef LIBCOPP_MACRO_USE_SEGMENTED_STACKS
-  jump_to(callee_, caller_stack_, callee_stack_, jump_data);
+  jump_to(co.callee_, co.caller_stack_, co.callee_stack_, jump_data, ontop_fn);
 #else
-  jump_to(callee_, callee_stack_, callee_stack_, jump_data);
+  jump_to(co.callee_, co.callee_stack_, co.callee_stack_, jump_data, ontop_fn);
 #endif
 
-  // Move changing status to EN_CRS_EXITED is finished
-  if (check_flags(flag_type::EN_CFT_FINISHED)) {
-    // if in finished status, change it to exited
-    status_.store(status_type::EN_CRS_EXITED, LIBCOPP_COPP_NAMESPACE_ID::util::lock::memory_order_release);
+  return COPP_EC_SUCCESS;
+}
+
+#if defined(LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR) && LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR
+size_t libcopp_internal_api_set::resume_batch(gsl::span<coroutine_context *> cos, void *priv_data,
+                                              std::exception_ptr &unhandled) LIBCOPP_MACRO_NOEXCEPT {
+#else
+size_t libcopp_internal_api_set::resume_batch(gsl::span<coroutine_context *> cos,
+                                              void *priv_data) LIBCOPP_MACRO_NOEXCEPT {
+#endif
+  size_t ret = 0;
+  const size_t count = cos.size();
+  if (count > 0 && nullptr != cos[0]) {
+    cos[0]->prefetch_context();
+  }
+  if (count > 1 && nullptr != cos[1]) {
+    cos[1]->prefetch_context();
+  }
+
+  for (size_t i = 0; i < count; ++i) {
+    // object of cos[i + 1] is prefetched by the last round, so reading its callee_ is cheap now
+    if (i + 2 < count && nullptr != cos[i + 2]) {
+      cos[i + 2]->prefetch_context();
+    }
+    if (i + 1 < count && nullptr != cos[i + 1]) {
+      cos[i + 1]->prefetch_callee_frame();
+    }
+
+    coroutine_context *co = cos[i];
+    COPP_UNLIKELY_IF (nullptr == co) {
+      continue;
+    }
+
+    // stack data of shared run stacks is restored only by coroutine_context_shared_stack::resume()
+    COPP_UNLIKELY_IF (co->check_flags(coroutine_context::flag_type::EN_CFT_SHARED_STACK)) {
+      continue;
+    }
+
+    // skip without jumping into it, unless there is an exception which is not taken yet
+    int status = co->load_status();
+    COPP_UNLIKELY_IF (status < coroutine_context::status_type::EN_CRS_READY ||
+                      status >= coroutine_context::status_type::EN_CRS_FINISHED) {
+#if defined(LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR) && LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR
+      COPP_UNLIKELY_IF (co->unhandle_exception_ && !unhandled) {
+        std::swap(unhandled, co->unhandle_exception_);
+      }
+#endif
+      continue;
+    }
+
+    if (COPP_EC_SUCCESS == start_coroutine(*co, priv_data, nullptr, nullptr)) {
+      ++ret;
+    }
+
+#if defined(LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR) && LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR
+    COPP_UNLIKELY_IF (co->unhandle_exception_ && !unhandled) {
+      std::swap(unhandled, co->unhandle_exception_);
+    }
+#endif
   }
 
+  return ret;
+}
+
 #if defined(LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR) && LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR
+LIBCOPP_COPP_API int coroutine_context::start(void *priv_data) {
+  std::exception_ptr eptr;
+  int ret = start(eptr, priv_data);
+  maybe_rethrow(eptr);
+  return ret;
+}
+
+LIBCOPP_COPP_API int coroutine_context::start(std::exception_ptr &unhandled, void *priv_data) LIBCOPP_MACRO_NOEXCEPT {
+  int ret = libcopp_internal_api_set::start_coroutine(*this, priv_data, nullptr, nullptr);
+
   COPP_UNLIKELY_IF (unhandle_exception_) {
     std::swap(unhandled, unhandle_exception_);
   }
-#endif
 
-  return COPP_EC_SUCCESS;
+  return ret;
+}
+#else
+LIBCOPP_COPP_API int coroutine_context::start(void *priv_data) {
+  return libcopp_internal_api_set::start_coroutine(*this, priv_data, nullptr, nullptr);
 }
+#endif
 
 LIBCOPP_COPP_API int coroutine_context::resume(void *priv_data) { return start(priv_data); }
 #if defined(LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR) && LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR
@@ -419,6 +688,57 @@ LIBCOPP_COPP_API int coroutine_context::resume(std::exception_ptr &unhandled, vo
 }
 #endif
 
+#if defined(LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR) && LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR
+LIBCOPP_COPP_API size_t coroutine_context::resume_batch(gsl::span<coroutine_context *> cos, void *priv_data) {
+  std::exception_ptr eptr;
+  size_t ret = libcopp_internal_api_set::resume_batch(cos, priv_data, eptr);
+  maybe_rethrow(eptr);
+  return ret;
+}
+
+LIBCOPP_COPP_API size_t coroutine_context::resume_batch(std::exception_ptr &unhandled,
+                                                        gsl::span<coroutine_context *> cos,
+                                                        void *priv_data) LIBCOPP_MACRO_NOEXCEPT {
+  return libcopp_internal_api_set::resume_batch(cos, priv_data, unhandled);
+}
+#else
+LIBCOPP_COPP_API size_t coroutine_context::resume_batch(gsl::span<coroutine_context *> cos, void *priv_data) {
+  return libcopp_internal_api_set::resume_batch(cos, priv_data);
+}
+#endif
+
+#if defined(LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR) && LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR
+LIBCOPP_COPP_API int coroutine_context::resume_with(ontop_callback_type fn, void *data) {
+  std::exception_ptr eptr;
+  int ret = resume_with(eptr, fn, data);
+  maybe_rethrow(eptr);
+  return ret;
+}
+
+LIBCOPP_COPP_API int coroutine_context::resume_with(std::exception_ptr &unhandled, ontop_callback_type fn,
+                                                    void *data) LIBCOPP_MACRO_NOEXCEPT {
+  if (nullptr == fn) {
+    return COPP_EC_ARGS_ERROR;
+  }
+
+  int ret = libcopp_internal_api_set::start_coroutine(*this, nullptr, fn, data);
+
+  COPP_UNLIKELY_IF (unhandle_exception_) {
+    std::swap(unhandled, unhandle_exception_);
+  }
+
+  return ret;
+}
+#else
+LIBCOPP_COPP_API int coroutine_context::resume_with(ontop_callback_type fn, void *data) {
+  if (nullptr == fn) {
+    return COPP_EC_ARGS_ERROR;
+  }
+
+  return libcopp_internal_api_set::start_coroutine(*this, nullptr, fn, data);
+}
+#endif
+
 LIBCOPP_COPP_API int coroutine_context::yield(void **priv_data) LIBCOPP_MACRO_NOEXCEPT {
   if (nullptr == callee_) {
     return COPP_EC_NOT_INITED;
@@ -429,9 +749,7 @@ LIBCOPP_COPP_API int coroutine_context::yield(void **priv_data) LIBCOPP_MACRO_NO
   if (check_flags(flag_type::EN_CFT_FINISHED)) {
     to_status = status_type::EN_CRS_FINISHED;
   }
-  if (false == status_.compare_exchange_strong(from_status, to_status,
-                                               LIBCOPP_COPP_NAMESPACE_ID::util::lock::memory_order_acq_rel,
-                                               LIBCOPP_COPP_NAMESPACE_ID::util::lock::memory_order_acquire)) {
+  if (false == compare_exchange_status(from_status, to_status)) {
     switch (from_status) {
       case status_type::EN_CRS_INVALID:
         return COPP_EC_NOT_INITED;
@@ -449,6 +767,7 @@ LIBCOPP_COPP_API int coroutine_context::yield(void **priv_data) LIBCOPP_MACRO_NO
   jump_src_data_t jump_data;
   jump_data.from_co = this;
   jump_data.to_co = nullptr;
+  jump_data.keep_caller = false;
 
 #ifdef LIBCOPP_MACRO_USE_SEGMENTED_STACKS
   jump_to(caller_, callee_stack_, caller_stack_, jump_data);
@@ -463,7 +782,89 @@ LIBCOPP_COPP_API int coroutine_context::yield(void **priv_data) LIBCOPP_MACRO_NO
   return COPP_EC_SUCCESS;
 }
 
+LIBCOPP_COPP_API int coroutine_context::switch_to(coroutine_context &next, void *priv_data) LIBCOPP_MACRO_NOEXCEPT {
+  if (&next == this) {
+    return COPP_EC_ARGS_ERROR;
+  }
+
+  // stack data of shared run stacks is restored only by coroutine_context_shared_stack::start()/resume()
+  if (next.check_flags(flag_type::EN_CFT_SHARED_STACK)) {
+    return COPP_EC_ARGS_ERROR;
+  }
+
+  if (nullptr == callee_ || nullptr == next.callee_) {
+    return COPP_EC_NOT_INITED;
+  }
+
+  // only the running coroutine can give its caller to next
+  if (static_cast<coroutine_context *>(detail::get_this_coroutine_context()) != this) {
+    return COPP_EC_NOT_RUNNING;
+  }
+
+  int from_status = status_type::EN_CRS_READY;
+  if (false == next.compare_exchange_status(from_status, status_type::EN_CRS_RUNNING)) {
+    if (from_status < status_type::EN_CRS_READY) {
+      return COPP_EC_NOT_INITED;
+    }
+
+    if (status_type::EN_CRS_RUNNING == from_status) {
+      return COPP_EC_IS_RUNNING;
+    }
+
+    return COPP_EC_NOT_READY;
+  }
+
+  from_status = status_type::EN_CRS_RUNNING;
+  if (false == compare_exchange_status(from_status, status_type::EN_CRS_READY)) {
+    next.store_status(status_type::EN_CRS_READY);
+    return COPP_EC_NOT_RUNNING;
+  }
+
+  // next returns to our caller when it yields or finishes
+  next.caller_ = caller_;
+#ifdef LIBCOPP_MACRO_USE_SEGMENTED_STACKS
+  next.caller_stack_ = caller_stack_;
+#endif
+
+  jump_src_data_t jump_data;
+  jump_data.from_co = this;
+  jump_data.to_co = &next;
+  jump_data.priv_data = priv_data;
+  jump_data.keep_caller = true;
+
+  jump_to(next.callee_, callee_stack_, next.callee_stack_, jump_data);
+
+  return COPP_EC_SUCCESS;
+}
+
+LIBCOPP_COPP_API int coroutine_context::paint_stack_watermark() LIBCOPP_MACRO_NOEXCEPT {
+  int status = load_status();
+  if (status_type::EN_CRS_RUNNING == status) {
+    return COPP_EC_IS_RUNNING;
+  }
+
+  if (status >= status_type::EN_CRS_FINISHED) {
+    return COPP_EC_ALREADY_FINISHED;
+  }
+
+  if (nullptr == callee_ || nullptr == callee_stack_.sp) {
+    return COPP_EC_NOT_INITED;
+  }
+
+  // callee_ is the lowest address in use, it's the initial fcontext before start() or the saved fcontext when the
+  // coroutine is suspended. All stack below it is unused.
+  size_t keep_size = static_cast<size_t>(reinterpret_cast<unsigned char *>(callee_stack_.sp) -
+                                         reinterpret_cast<unsigned char *>(callee_));
+  stack_watermark::paint(callee_stack_, keep_size);
+  return COPP_EC_SUCCESS;
+}
+
+LIBCOPP_COPP_API size_t coroutine_context::get_stack_watermark() const LIBCOPP_MACRO_NOEXCEPT {
+  return stack_watermark::measure(callee_stack_);
+}
+
 namespace this_coroutine {
+#if !(defined(LIBCOPP_MACRO_ENABLE_INLINE_THIS_COROUTINE) && LIBCOPP_MACRO_ENABLE_INLINE_THIS_COROUTINE)
 LIBCOPP_COPP_API coroutine_context *get_coroutine() LIBCOPP_MACRO_NOEXCEPT {
   coroutine_context_base *ret = detail::get_this_coroutine_context();
 #if defined(LIBCOPP_MACRO_ENABLE_WIN_FIBER) && LIBCOPP_MACRO_ENABLE_WIN_FIBER
@@ -473,6 +874,7 @@ LIBCOPP_COPP_API coroutine_context *get_coroutine() LIBCOPP_MACRO_NOEXCEPT {
 #endif
   return static_cast<coroutine_context *>(ret);
 }
+#endif
 
 LIBCOPP_COPP_API int yield(void **priv_data) LIBCOPP_MACRO_NOEXCEPT {
 #if defined(LIBCOPP_MACRO_ENABLE_WIN_FIBER) && LIBCOPP_MACRO_ENABLE_WIN_FIBER
@@ -271,9 +271,7 @@ LIBCOPP_COPP_API int coroutine_context_fiber::start(void *priv_data) {
       return COPP_EC_NOT_INITED;
     }
 
-    if (status_.compare_exchange_strong(from_status, status_type::EN_CRS_RUNNING,
-                                        LIBCOPP_COPP_NAMESPACE_ID::util::lock::memory_order_acq_rel,
-                                        LIBCOPP_COPP_NAMESPACE_ID::util::lock::memory_order_acquire)) {
+    if (compare_exchange_status(from_status, status_type::EN_CRS_RUNNING)) {
       break;
     } else {
       // finished or stoped
@@ -295,7 +293,7 @@ LIBCOPP_COPP_API int coroutine_context_fiber::start(void *priv_data) {
   // Move changing status to EN_CRS_EXITED is finished
   if (check_flags(flag_type::EN_CFT_FINISHED)) {
     // if in finished status, change it to exited
-    status_.store(status_type::EN_CRS_EXITED, LIBCOPP_COPP_NAMESPACE_ID::util::lock::memory_order_release);
+    store_status(status_type::EN_CRS_EXITED);
   }
 
 #  if defined(LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR) && LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR
@@ -325,9 +323,7 @@ LIBCOPP_COPP_API int coroutine_context_fiber::yield(void **priv_data) LIBCOPP_MA
   if (check_flags(flag_type::EN_CFT_FINISHED)) {
     to_status = status_type::EN_CRS_FINISHED;
   }
-  if (false == status_.compare_exchange_strong(from_status, to_status,
-                                               LIBCOPP_COPP_NAMESPACE_ID::util::lock::memory_order_acq_rel,
-                                               LIBCOPP_COPP_NAMESPACE_ID::util::lock::memory_order_acquire)) {
+  if (false == compare_exchange_status(from_status, to_status)) {
     switch (from_status) {
       case status_type::EN_CRS_INVALID:
         return COPP_EC_NOT_INITED;
@@ -0,0 +1,282 @@
+// Copyright 2023 owent
+
+#include <libcopp/utils/config/libcopp_build_features.h>
+
+#include <libcopp/stack/allocator/stack_allocator_arena.h>
+#include <libcopp/stack/stack_context.h>
+#include <libcopp/stack/stack_traits.h>
+
+#if defined(LIBCOPP_MACRO_USE_VALGRIND)
+#  include <valgrind/valgrind.h>
+#endif
+
+extern "C" {
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <unistd.h>
+}
+
+// clang-format off
+#include <libcopp/utils/config/stl_include_prefix.h>  // NOLINT(build/include_order)
+// clang-format on
+#include <assert.h>
+#include <algorithm>
+#include <limits>
+// clang-format off
+#include <libcopp/utils/config/stl_include_suffix.h>  // NOLINT(build/include_order)
+// clang-format on
+
+#ifdef COPP_HAS_ABI_HEADERS
+#  include COPP_ABI_PREFIX
+#endif
+
+LIBCOPP_COPP_NAMESPACE_BEGIN
+namespace allocator {
+
+namespace {
+static inline std::size_t stack_arena_count_trailing_zero(uint64_t v) LIBCOPP_MACRO_NOEXCEPT {
+  assert(0 != v);
+#if defined(__GNUC__) || defined(__clang__)
+  return static_cast<std::size_t>(__builtin_ctzll(v));
+#else
+  std::size_t ret = 0;
+  while (0 == (v & 0x01)) {
+    v >>= 1;
+    ++ret;
+  }
+  return ret;
+#endif
+}
+}  // namespace
+
+LIBCOPP_COPP_API stack_arena::ptr_type stack_arena::create(std::size_t stack_size, std::size_t stack_number,
+                                                           bool guard_page) {
+  if (0 == stack_number) {
+    return ptr_type();
+  }
+
+  stack_size = (std::max)(stack_size, stack_traits::minimum_size());
+  stack_size = (std::min)(stack_size, stack_traits::maximum_size());
+  stack_size = stack_traits::round_to_page_size(stack_size);
+
+  std::size_t slot_size = stack_size + (guard_page ? stack_traits::page_size() : 0);
+  if (stack_number > (std::numeric_limits<std::size_t>::max)() / slot_size) {
+    return ptr_type();
+  }
+
+  // Only reserve address space here, physical pages are allocated when stacks are used
+  void *start_ptr =
+#if defined(macintosh) || defined(__APPLE__) || defined(__APPLE_CC__)
+      ::mmap(0, slot_size * stack_number, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0);
+#elif defined(MAP_NORESERVE)
+      ::mmap(0, slot_size * stack_number, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+#else
+      ::mmap(0, slot_size * stack_number, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+#endif
+
+  if (!start_ptr || MAP_FAILED == start_ptr) {
+    return ptr_type();
+  }
+
+  // protect all guard pages at once, so allocate and deallocate need no system call
+  if (guard_page) {
+    for (std::size_t i = 0; i < stack_number; ++i) {
+      ::mprotect(static_cast<char *>(start_ptr) + i * slot_size, stack_traits::page_size(), PROT_NONE);
+    }
+  }
+
+  ptr_type ret =
+      std::make_shared<stack_arena>(constructor_delegator(), start_ptr, stack_size, stack_number, guard_page);
+  if (!ret) {
+    ::munmap(start_ptr, slot_size * stack_number);
+  }
+  return ret;
+}
+
+LIBCOPP_COPP_API stack_arena::stack_arena(constructor_delegator, void *start_ptr, std::size_t stack_size,
+                                          std::size_t stack_number, bool guard_page) LIBCOPP_MACRO_NOEXCEPT
+    : start_ptr_(start_ptr),
+      stack_size_(stack_size),
+      stack_number_(stack_number),
+      used_stack_number_(0),
+      search_hint_(0),
+      guard_page_(guard_page) {
+  bitmap_.resize((stack_number + 63) / 64, ~static_cast<uint64_t>(0));
+  if (0 != (stack_number & 63)) {
+    bitmap_.back() = (static_cast<uint64_t>(1) << (stack_number & 63)) - 1;
+  }
+}
+
+LIBCOPP_COPP_API stack_arena::~stack_arena() {
+  // all stacks are released together
+  assert(0 == used_stack_number_);
+  if (nullptr != start_ptr_) {
+    ::munmap(start_ptr_, get_slot_size() * stack_number_);
+  }
+}
+
+LIBCOPP_COPP_API void stack_arena::allocate(stack_context &ctx, std::size_t size) LIBCOPP_MACRO_NOEXCEPT {
+  if (size > stack_size_) {
+    ctx.sp = nullptr;
+    return;
+  }
+
+  std::size_t slot_index;
+  {
+#if !defined(LIBCOPP_DISABLE_ATOMIC_LOCK) || !(LIBCOPP_DISABLE_ATOMIC_LOCK)
+    LIBCOPP_COPP_NAMESPACE_ID::util::lock::lock_holder<LIBCOPP_COPP_NAMESPACE_ID::util::lock::spin_lock> lock_guard(
+        action_lock_);
+#endif
+
+    if (used_stack_number_ >= stack_number_) {
+      ctx.sp = nullptr;
+      return;
+    }
+
+    slot_index = pop_free_slot();
+  }
+
+  assign_slot(ctx, slot_index);
+}
+
+LIBCOPP_COPP_API std::size_t stack_arena::allocate_batch(stack_context *ctxs, std::size_t count,
+                                                         std::size_t size) LIBCOPP_MACRO_NOEXCEPT {
+  if (nullptr == ctxs || size > stack_size_) {
+    return 0;
+  }
+
+  std::size_t ret = 0;
+#if !defined(LIBCOPP_DISABLE_ATOMIC_LOCK) || !(LIBCOPP_DISABLE_ATOMIC_LOCK)
+  LIBCOPP_COPP_NAMESPACE_ID::util::lock::lock_holder<LIBCOPP_COPP_NAMESPACE_ID::util::lock::spin_lock> lock_guard(
+      action_lock_);
+#endif
+
+  for (; ret < count && used_stack_number_ < stack_number_; ++ret) {
+    assign_slot(ctxs[ret], pop_free_slot());
+  }
+  return ret;
+}
+
+LIBCOPP_COPP_API void stack_arena::deallocate(stack_context &ctx) LIBCOPP_MACRO_NOEXCEPT {
+  assert(contains(ctx));
+  if (!contains(ctx)) {
+    return;
+  }
+
+#if defined(LIBCOPP_MACRO_USE_VALGRIND)
+  VALGRIND_STACK_DEREGISTER(ctx.valgrind_stack_id);
+#endif
+
+  std::size_t slot_index =
+      static_cast<std::size_t>(static_cast<char *>(ctx.sp) - static_cast<char *>(start_ptr_)) / get_slot_size() - 1;
+  std::size_t word_index = slot_index / 64;
+  uint64_t mask = static_cast<uint64_t>(1) << (slot_index & 63);
+
+#if !defined(LIBCOPP_DISABLE_ATOMIC_LOCK) || !(LIBCOPP_DISABLE_ATOMIC_LOCK)
+  LIBCOPP_COPP_NAMESPACE_ID::util::lock::lock_holder<LIBCOPP_COPP_NAMESPACE_ID::util::lock::spin_lock> lock_guard(
+      action_lock_);
+#endif
+
+  assert(0 == (bitmap_[word_index] & mask));
+  if (0 != (bitmap_[word_index] & mask)) {
+    return;
+  }
+
+  bitmap_[word_index] |= mask;
+  --used_stack_number_;
+
+  // keep used slots compact at the low end of arena
+  if (word_index < search_hint_) {
+    search_hint_ = word_index;
+  }
+}
+
+LIBCOPP_COPP_API bool stack_arena::contains(const stack_context &ctx) const LIBCOPP_MACRO_NOEXCEPT {
+  if (nullptr == ctx.sp || ctx.size != get_slot_size()) {
+    return false;
+  }
+
+  const char *start_ptr = static_cast<const char *>(start_ptr_);
+  const char *sp = static_cast<const char *>(ctx.sp);
+  std::size_t slot_size = get_slot_size();
+  if (sp <= start_ptr || sp > start_ptr + slot_size * stack_number_) {
+    return false;
+  }
+
+  return 0 == static_cast<std::size_t>(sp - start_ptr) % slot_size;
+}
+
+LIBCOPP_COPP_API std::size_t stack_arena::get_slot_size() const LIBCOPP_MACRO_NOEXCEPT {
+  return stack_size_ + (guard_page_ ? stack_traits::page_size() : 0);
+}
+
+LIBCOPP_COPP_API std::size_t stack_arena::pop_free_slot() LIBCOPP_MACRO_NOEXCEPT {
+  // there must be at least one free slot, start from the last word which has free slot
+  std::size_t word_index = search_hint_;
+  while (0 == bitmap_[word_index]) {
+    if (++word_index >= bitmap_.size()) {
+      word_index = 0;
+    }
+  }
+
+  std::size_t bit_index = stack_arena_count_trailing_zero(bitmap_[word_index]);
+  bitmap_[word_index] &= ~(static_cast<uint64_t>(1) << bit_index);
+  search_hint_ = word_index;
+  ++used_stack_number_;
+
+  return word_index * 64 + bit_index;
+}
+
+LIBCOPP_COPP_API void stack_arena::assign_slot(stack_context &ctx, std::size_t slot_index) const
+    LIBCOPP_MACRO_NOEXCEPT {
+  std::size_t slot_size = get_slot_size();
+  ctx.size = slot_size;
+  ctx.sp = static_cast<char *>(start_ptr_) + slot_index * slot_size + slot_size;  // stack down
+
+#if defined(LIBCOPP_MACRO_USE_VALGRIND)
+  ctx.valgrind_stack_id = VALGRIND_STACK_REGISTER(ctx.sp, static_cast<char *>(ctx.sp) - ctx.size);
+#endif
+}
+
+LIBCOPP_COPP_API stack_allocator_arena::stack_allocator_arena() LIBCOPP_MACRO_NOEXCEPT {}
+
+LIBCOPP_COPP_API stack_allocator_arena::stack_allocator_arena(const std::shared_ptr<arena_type> &arena)
+    LIBCOPP_MACRO_NOEXCEPT : arena_(arena) {}
+
+LIBCOPP_COPP_API stack_allocator_arena::~stack_allocator_arena() {}
+
+LIBCOPP_COPP_API void stack_allocator_arena::attach(const std::shared_ptr<arena_type> &arena) LIBCOPP_MACRO_NOEXCEPT {
+  arena_ = arena;
+}
+
+LIBCOPP_COPP_API void stack_allocator_arena::allocate(stack_context &ctx, std::size_t size) LIBCOPP_MACRO_NOEXCEPT {
+  assert(arena_);
+  if (arena_) {
+    arena_->allocate(ctx, size);
+  } else {
+    ctx.sp = nullptr;
+  }
+}
+
+LIBCOPP_COPP_API std::size_t stack_allocator_arena::allocate_batch(stack_context *ctxs, std::size_t count,
+                                                                   std::size_t size) LIBCOPP_MACRO_NOEXCEPT {
+  assert(arena_);
+  if (arena_) {
+    return arena_->allocate_batch(ctxs, count, size);
+  }
+
+  return 0;
+}
+
+LIBCOPP_COPP_API void stack_allocator_arena::deallocate(stack_context &ctx) LIBCOPP_MACRO_NOEXCEPT {
+  assert(arena_);
+  if (arena_) {
+    arena_->deallocate(ctx);
+  }
+}
+}  // namespace allocator
+LIBCOPP_COPP_NAMESPACE_END
+
+#ifdef COPP_HAS_ABI_HEADERS
+#  include COPP_ABI_SUFFIX
+#endif
@@ -99,6 +99,28 @@ LIBCOPP_COPP_API void stack_allocator_posix::deallocate(stack_context &ctx) LIBC
   void *start_ptr = static_cast<char *>(ctx.sp) - ctx.size;
   ::munmap(start_ptr, ctx.size);
 }
+
+LIBCOPP_COPP_API void stack_allocator_posix::trim(stack_context &ctx, std::size_t keep_size) LIBCOPP_MACRO_NOEXCEPT {
+  assert(ctx.sp);
+  assert(stack_traits::page_size() < ctx.size);
+
+  // skip the protected page at the bottom and keep_size bytes at the top
+  char *start_ptr = static_cast<char *>(ctx.sp) - ctx.size + stack_traits::page_size();
+  char *end_ptr = static_cast<char *>(ctx.sp) - (std::min)(stack_traits::round_to_page_size(keep_size),
+                                                            ctx.size - stack_traits::page_size());
+  if (end_ptr <= start_ptr) {
+    return;
+  }
+
+  // MADV_DONTNEED drops RSS immediately on Linux, MADV_FREE is lazy and only reclaimed under memory pressure
+#if defined(__linux__) || !defined(MADV_FREE)
+  ::madvise(start_ptr, static_cast<std::size_t>(end_ptr - start_ptr), MADV_DONTNEED);
+#else
+  if (0 != ::madvise(start_ptr, static_cast<std::size_t>(end_ptr - start_ptr), MADV_FREE)) {
+    ::madvise(start_ptr, static_cast<std::size_t>(end_ptr - start_ptr), MADV_DONTNEED);
+  }
+#endif
+}
 }  // namespace allocator
 LIBCOPP_COPP_NAMESPACE_END
 
@@ -27,6 +27,7 @@ check_include_files("sys/resource.h;sys/time.h;unistd.h;sys/types.h;fcntl.h;sys/
 if(PROJECT_LIBCOPP_STACK_ALLOC_POSIX)
   echowithcolor(COLOR GREEN "-- stack allocator: enable posix allocator")
   list(APPEND COPP_SRC_LIST "${PROJECT_LIBCOPP_STACK_ALLOC_SRC_DIR}/stack_allocator_posix.cpp")
+  list(APPEND COPP_SRC_LIST "${PROJECT_LIBCOPP_STACK_ALLOC_SRC_DIR}/stack_allocator_arena.cpp")
   list(APPEND COPP_SRC_LIST "${PROJECT_LIBCOPP_STACK_CONTEXT_SRC_DIR}/stack_traits/stack_traits_posix.cpp")
   set(LIBCOPP_MACRO_SYS_POSIX 1)
 endif()
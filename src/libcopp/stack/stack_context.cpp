@@ -15,7 +15,8 @@
 LIBCOPP_COPP_NAMESPACE_BEGIN
 
 LIBCOPP_COPP_API stack_context::stack_context() LIBCOPP_MACRO_NOEXCEPT : size(0),
-                                                                         sp(nullptr)
+                                                                         sp(nullptr),
+                                                                         watermark_painted(false)
 #ifdef LIBCOPP_MACRO_USE_SEGMENTED_STACKS
     ,
                                                                          segments_ctx()
@@ -50,6 +51,7 @@ LIBCOPP_COPP_API stack_context &stack_context::operator=(stack_context &&other)
 LIBCOPP_COPP_API void stack_context::reset() LIBCOPP_MACRO_NOEXCEPT {
   size = 0;
   sp = nullptr;
+  watermark_painted = false;
 #ifdef LIBCOPP_MACRO_USE_SEGMENTED_STACKS
   memset(segments_ctx, 0, sizeof(segments_ctx));
 #endif
@@ -61,6 +63,7 @@ LIBCOPP_COPP_API void stack_context::reset() LIBCOPP_MACRO_NOEXCEPT {
 LIBCOPP_COPP_API void stack_context::copy_from(const stack_context &other) LIBCOPP_MACRO_NOEXCEPT {
   size = other.size;
   sp = other.sp;
+  watermark_painted = other.watermark_painted;
 #ifdef LIBCOPP_MACRO_USE_SEGMENTED_STACKS
   memcpy(segments_ctx, other.segments_ctx, sizeof(segments_ctx));
 #endif
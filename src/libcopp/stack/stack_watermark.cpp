@@ -0,0 +1,232 @@
+// Copyright 2023 owent
+
+#include <libcopp/utils/config/libcopp_build_features.h>
+
+#include <libcopp/stack/stack_traits.h>
+#include <libcopp/stack/stack_watermark.h>
+
+#if defined(LIBCOPP_MACRO_SYS_POSIX)
+extern "C" {
+#  include <sys/mman.h>
+#  include <unistd.h>
+}
+#endif
+
+// clang-format off
+#include <libcopp/utils/config/stl_include_prefix.h>  // NOLINT(build/include_order)
+// clang-format on
+#include <stdint.h>
+#include <cstring>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#  include <emmintrin.h>
+#  define LIBCOPP_STACK_WATERMARK_USE_SSE2 1
+#endif
+// clang-format off
+#include <libcopp/utils/config/stl_include_suffix.h>  // NOLINT(build/include_order)
+// clang-format on
+
+#ifdef COPP_HAS_ABI_HEADERS
+#  include COPP_ABI_PREFIX
+#endif
+
+LIBCOPP_COPP_NAMESPACE_BEGIN
+namespace {
+static constexpr const unsigned char stack_watermark_pattern = 0xA5;
+
+// bytes at the bottom of stack which are checked to know if the stack is painted
+static constexpr const size_t stack_watermark_mark_size = 16;
+
+static inline unsigned char *stack_watermark_get_bottom(const stack_context &ctx) LIBCOPP_MACRO_NOEXCEPT {
+  size_t page_size = stack_traits::page_size();
+  if (nullptr == ctx.sp || ctx.size <= page_size + stack_watermark_mark_size) {
+    return nullptr;
+  }
+
+  // skip the lowest page which may be a guard page
+  uintptr_t bottom = reinterpret_cast<uintptr_t>(ctx.sp) - ctx.size + page_size;
+  bottom = (bottom + stack_watermark_mark_size - 1) & ~static_cast<uintptr_t>(stack_watermark_mark_size - 1);
+  if (bottom + stack_watermark_mark_size >= reinterpret_cast<uintptr_t>(ctx.sp)) {
+    return nullptr;
+  }
+  return reinterpret_cast<unsigned char *>(bottom);
+}
+
+// find the first byte which is not the pattern in [begin, end)
+static inline const unsigned char *stack_watermark_scan(const unsigned char *begin,
+                                                        const unsigned char *end) LIBCOPP_MACRO_NOEXCEPT {
+#if defined(LIBCOPP_STACK_WATERMARK_USE_SSE2)
+  const __m128i pattern = _mm_set1_epi8(static_cast<char>(stack_watermark_pattern));
+  while (begin + 64 <= end) {
+    __m128i r0 = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(begin)), pattern);
+    __m128i r1 = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(begin + 16)), pattern);
+    __m128i r2 = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(begin + 32)), pattern);
+    __m128i r3 = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(begin + 48)), pattern);
+    __m128i r = _mm_and_si128(_mm_and_si128(r0, r1), _mm_and_si128(r2, r3));
+    if (0xFFFF != _mm_movemask_epi8(r)) {
+      break;
+    }
+    begin += 64;
+  }
+#else
+  // compare 8 bytes at a time, compilers can auto-vectorize this loop
+  uint64_t pattern;
+  memset(&pattern, stack_watermark_pattern, sizeof(pattern));
+  while (begin + 32 <= end) {
+    uint64_t v[4];
+    memcpy(v, begin, sizeof(v));
+    if (0 != ((v[0] ^ pattern) | (v[1] ^ pattern) | (v[2] ^ pattern) | (v[3] ^ pattern))) {
+      break;
+    }
+    begin += 32;
+  }
+#endif
+
+  while (begin < end && stack_watermark_pattern == *begin) {
+    ++begin;
+  }
+  return begin;
+}
+
+// check if the pattern of the bottom mark is not overwritten
+static inline bool stack_watermark_check_mark(const unsigned char *bottom) LIBCOPP_MACRO_NOEXCEPT {
+  return stack_watermark_scan(bottom, bottom + stack_watermark_mark_size) == bottom + stack_watermark_mark_size;
+}
+}  // namespace
+
+LIBCOPP_COPP_API void stack_watermark::paint(stack_context &ctx, size_t keep_size) LIBCOPP_MACRO_NOEXCEPT {
+  ctx.watermark_painted = false;
+  unsigned char *bottom = stack_watermark_get_bottom(ctx);
+  if (nullptr == bottom) {
+    return;
+  }
+
+  unsigned char *top = reinterpret_cast<unsigned char *>(ctx.sp);
+  if (keep_size >= static_cast<size_t>(top - bottom)) {
+    return;
+  }
+  top -= keep_size;
+
+  memset(bottom, stack_watermark_pattern, static_cast<size_t>(top - bottom));
+  ctx.watermark_painted = true;
+}
+
+LIBCOPP_COPP_API void stack_watermark::unpaint(stack_context &ctx) LIBCOPP_MACRO_NOEXCEPT {
+  ctx.watermark_painted = false;
+}
+
+LIBCOPP_COPP_API bool stack_watermark::is_painted(const stack_context &ctx) LIBCOPP_MACRO_NOEXCEPT {
+  if (!ctx.watermark_painted) {
+    return false;
+  }
+
+  const unsigned char *bottom = stack_watermark_get_bottom(ctx);
+  return nullptr != bottom && stack_watermark_check_mark(bottom);
+}
+
+LIBCOPP_COPP_API size_t stack_watermark::measure(const stack_context &ctx) LIBCOPP_MACRO_NOEXCEPT {
+  if (!ctx.watermark_painted) {
+    return 0;
+  }
+
+  const unsigned char *bottom = stack_watermark_get_bottom(ctx);
+  if (nullptr == bottom) {
+    return 0;
+  }
+
+  // any value at the bottom mark means the whole measurable stack is used, even zero, the usage may have already
+  // overflowed into the guard page
+  if (!stack_watermark_check_mark(bottom)) {
+    return ctx.size;
+  }
+
+  const unsigned char *top = reinterpret_cast<const unsigned char *>(ctx.sp);
+  const unsigned char *first_used = stack_watermark_scan(bottom, top);
+  return static_cast<size_t>(top - first_used);
+}
+
+LIBCOPP_COPP_API size_t stack_watermark::measure_resident(const stack_context &ctx) LIBCOPP_MACRO_NOEXCEPT {
+#if defined(LIBCOPP_MACRO_SYS_POSIX)
+  size_t page_size = stack_traits::page_size();
+  if (nullptr == ctx.sp || ctx.size <= page_size) {
+    return 0;
+  }
+
+  uintptr_t top = reinterpret_cast<uintptr_t>(ctx.sp);
+  uintptr_t bottom = top - ctx.size + page_size;
+  // mincore() requires page aligned address
+  bottom = (bottom + page_size - 1) & ~static_cast<uintptr_t>(page_size - 1);
+
+  // scan from bottom to top, the first resident page is the high-water mark
+  const size_t batch_pages = 64;
+#  if defined(__linux__)
+  unsigned char residents[batch_pages];
+#  else
+  char residents[batch_pages];
+#  endif
+  while (bottom < top) {
+    size_t pages = static_cast<size_t>(top - bottom + page_size - 1) / page_size;
+    if (pages > batch_pages) {
+      pages = batch_pages;
+    }
+
+    if (0 != ::mincore(reinterpret_cast<void *>(bottom), pages * page_size, residents)) {
+      return 0;
+    }
+
+    for (size_t i = 0; i < pages; ++i) {
+      if (residents[i] & 0x01) {
+        uintptr_t used_bottom = bottom + i * page_size;
+        return used_bottom >= top ? 0 : static_cast<size_t>(top - used_bottom);
+      }
+    }
+    bottom += pages * page_size;
+  }
+#else
+  (void)ctx;
+#endif
+  return 0;
+}
+
+LIBCOPP_COPP_API void stack_watermark::add_sample(stat_type &stat, size_t used_size) LIBCOPP_MACRO_NOEXCEPT {
+  if (0 == used_size) {
+    return;
+  }
+
+  ++stat.sample_number;
+  if (used_size > stat.max_used_size) {
+    stat.max_used_size = used_size;
+  }
+  ++stat.histogram[get_histogram_index(used_size)];
+}
+
+LIBCOPP_COPP_API void stack_watermark::merge(stat_type &stat, const stat_type &other) LIBCOPP_MACRO_NOEXCEPT {
+  stat.sample_number += other.sample_number;
+  if (other.max_used_size > stat.max_used_size) {
+    stat.max_used_size = other.max_used_size;
+  }
+  for (size_t i = 0; i < stat_type::HISTOGRAM_SIZE; ++i) {
+    stat.histogram[i] += other.histogram[i];
+  }
+}
+
+LIBCOPP_COPP_API size_t stack_watermark::get_histogram_index(size_t used_size) LIBCOPP_MACRO_NOEXCEPT {
+  size_t ret = 0;
+  size_t upper_bound = 1024;
+  while (used_size > upper_bound && ret + 1 < stat_type::HISTOGRAM_SIZE) {
+    upper_bound <<= 1;
+    ++ret;
+  }
+  return ret;
+}
+
+LIBCOPP_COPP_API size_t stack_watermark::get_histogram_upper_bound(size_t idx) LIBCOPP_MACRO_NOEXCEPT {
+  if (idx + 1 >= stat_type::HISTOGRAM_SIZE) {
+    return static_cast<size_t>(-1);
+  }
+  return static_cast<size_t>(1024) << idx;
+}
+LIBCOPP_COPP_NAMESPACE_END
+
+#ifdef COPP_HAS_ABI_HEADERS
+#  include COPP_ABI_SUFFIX
+#endif
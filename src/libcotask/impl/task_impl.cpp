@@ -48,6 +48,7 @@ LIBCOPP_COTASK_API bool task_impl::is_exiting() const LIBCOPP_MACRO_NOEXCEPT { r
 
 LIBCOPP_COTASK_API int task_impl::on_finished() { return 0; }
 
+#if !(defined(LIBCOPP_MACRO_ENABLE_INLINE_THIS_COROUTINE) && LIBCOPP_MACRO_ENABLE_INLINE_THIS_COROUTINE)
 LIBCOPP_COTASK_API task_impl *task_impl::this_task() {
   LIBCOPP_COPP_NAMESPACE_ID::coroutine_context_base *this_co =
       LIBCOPP_COPP_NAMESPACE_ID::coroutine_context_base::get_this_coroutine_base();
@@ -61,6 +62,7 @@ LIBCOPP_COTASK_API task_impl *task_impl::this_task() {
 
   return *reinterpret_cast<task_impl **>(this_co->get_private_buffer());
 }
+#endif
 
 LIBCOPP_COTASK_API void task_impl::_set_action(action_ptr_type action) { action_ = action; }
 
@@ -76,7 +78,7 @@ LIBCOPP_COTASK_API bool task_impl::_cas_status(EN_TASK_STATUS &expected, EN_TASK
 }
 
 #if defined(LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR) && LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR
-LIBCOPP_COTASK_API int task_impl::_notify_finished(std::list<std::exception_ptr> &unhandled, void *priv_data) {
+LIBCOPP_COTASK_API int task_impl::_notify_finished(task_exception_sink &unhandled, void *priv_data) {
 #else
 LIBCOPP_COTASK_API int task_impl::_notify_finished(void *priv_data) {
 #endif
@@ -90,7 +92,7 @@ LIBCOPP_COTASK_API int task_impl::_notify_finished(void *priv_data) {
 #if defined(LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR) && LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR
     return ret;
   } catch (...) {
-    unhandled.emplace_back(std::current_exception());
+    unhandled.push(std::current_exception());
     return LIBCOPP_COPP_NAMESPACE_ID::COPP_EC_HAS_UNHANDLE_EXCEPTION;
   }
 #else
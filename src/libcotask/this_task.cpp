@@ -6,6 +6,8 @@
 
 LIBCOPP_COTASK_NAMESPACE_BEGIN
 namespace this_task {
+#if !(defined(LIBCOPP_MACRO_ENABLE_INLINE_THIS_COROUTINE) && LIBCOPP_MACRO_ENABLE_INLINE_THIS_COROUTINE)
 LIBCOPP_COTASK_API impl::task_impl *get_task() LIBCOPP_MACRO_NOEXCEPT { return impl::task_impl::this_task(); }
+#endif
 }  // namespace this_task
 LIBCOPP_COTASK_NAMESPACE_END
@@ -5,6 +5,8 @@
 #include <cstdio>
 #include <cstring>
 #include <iostream>
+#include <stdexcept>
+#include <vector>
 
 #include "frame/test_macros.h"
 
@@ -217,6 +219,342 @@ CASE_TEST(coroutine, coroutine_context_create_failed) {
   delete[] stack_buff;
 }
 
+struct test_context_base_inline_runner {
+  int *destroy_times;
+  int values[32];
+
+  explicit test_context_base_inline_runner(int *d) : destroy_times(d) {
+    for (int i = 0; i < 32; ++i) {
+      values[i] = i;
+    }
+  }
+
+  test_context_base_inline_runner(test_context_base_inline_runner &&other) : destroy_times(other.destroy_times) {
+    other.destroy_times = nullptr;
+    memcpy(values, other.values, sizeof(values));
+  }
+
+  test_context_base_inline_runner(const test_context_base_inline_runner &) = delete;
+
+  ~test_context_base_inline_runner() {
+    if (nullptr != destroy_times) {
+      ++(*destroy_times);
+    }
+  }
+
+  int operator()(void *priv_data) {
+    // the runner object is placed on the stack of this coroutine
+    copp::coroutine_context *self = copp::this_coroutine::get_coroutine();
+    unsigned char *stack_top = reinterpret_cast<unsigned char *>(self->get_private_buffer());
+    CASE_EXPECT_LT(reinterpret_cast<unsigned char *>(this), stack_top);
+    CASE_EXPECT_GT(reinterpret_cast<unsigned char *>(this), reinterpret_cast<unsigned char *>(&stack_top));
+
+    int sum = 0;
+    for (int i = 0; i < 32; ++i) {
+      sum += values[i];
+    }
+    self->yield();
+    return sum + *reinterpret_cast<int *>(priv_data);
+  }
+};
+
+CASE_TEST(coroutine, inline_runner) {
+  int destroy_times = 0;
+  int priv_value = 1000;
+  {
+    test_context_base_inline_runner runner(&destroy_times);
+    copp::coroutine_context_default::ptr_t co =
+        copp::coroutine_context_default::create(std::move(runner), 64 * 1024, 64, 64);
+    CASE_EXPECT_TRUE(!!co);
+    if (!co) {
+      return;
+    }
+
+    // move-only runner is not stored in std::function
+    CASE_EXPECT_FALSE(!!co->get_runner());
+    CASE_EXPECT_EQ(64, co->get_private_buffer_size());
+
+    CASE_EXPECT_EQ(0, co->start(&priv_value));
+    CASE_EXPECT_EQ(0, co->resume());
+    CASE_EXPECT_TRUE(co->is_finished());
+    CASE_EXPECT_EQ(496 + 1000, co->get_ret_code());
+    CASE_EXPECT_EQ(0, destroy_times);
+  }
+
+  // runner is destroyed with the coroutine
+  CASE_EXPECT_EQ(1, destroy_times);
+
+  // lambda runner
+  int captured = 0;
+  copp::coroutine_context_default::ptr_t co = copp::coroutine_context_default::create([&captured](void *) {
+    ++captured;
+    return captured;
+  });
+  CASE_EXPECT_TRUE(!!co);
+  if (co) {
+    CASE_EXPECT_EQ(0, co->start());
+    CASE_EXPECT_EQ(1, co->get_ret_code());
+  }
+}
+
+static int test_context_base_reset_runner(void *priv_data) {
+  copp::coroutine_context *self = copp::this_coroutine::get_coroutine();
+  // reset() can not be applied to a running coroutine
+  CASE_EXPECT_EQ(copp::COPP_EC_IS_RUNNING, copp::this_coroutine::get<copp::coroutine_context_default>()->reset(
+                                                  test_context_base_reset_runner));
+  self->yield();
+  return *reinterpret_cast<int *>(self->get_private_buffer()) + (nullptr == priv_data ? 0 : 1);
+}
+
+CASE_TEST(coroutine, reset_and_reuse) {
+  int destroy_times = 0;
+  test_context_base_inline_runner runner(&destroy_times);
+  copp::coroutine_context_default::ptr_t co =
+      copp::coroutine_context_default::create(std::move(runner), 64 * 1024, sizeof(int));
+  CASE_EXPECT_TRUE(!!co);
+  if (!co) {
+    return;
+  }
+
+  *reinterpret_cast<int *>(co->get_private_buffer()) = 100;
+  void *private_buffer = co->get_private_buffer();
+
+  // can not reset before exited
+  CASE_EXPECT_EQ(copp::COPP_EC_IS_RUNNING, co->reset(test_context_base_reset_runner));
+
+  int priv_value = 1000;
+  CASE_EXPECT_EQ(0, co->start(&priv_value));
+  CASE_EXPECT_EQ(copp::COPP_EC_IS_RUNNING, co->reset(test_context_base_reset_runner));
+  CASE_EXPECT_EQ(0, co->resume());
+  CASE_EXPECT_TRUE(co->is_finished());
+  CASE_EXPECT_EQ(1496, co->get_ret_code());
+
+  for (int i = 0; i < 3; ++i) {
+    // the old runner is destroyed, and the stack is reused
+    CASE_EXPECT_EQ(0, co->reset(test_context_base_reset_runner));
+    CASE_EXPECT_EQ(1, destroy_times);
+    CASE_EXPECT_FALSE(co->is_finished());
+    CASE_EXPECT_EQ(0, co->get_ret_code());
+    CASE_EXPECT_EQ(private_buffer, co->get_private_buffer());
+    CASE_EXPECT_EQ(100 + i, *reinterpret_cast<int *>(co->get_private_buffer()));
+
+    CASE_EXPECT_EQ(0, co->start(&priv_value));
+    CASE_EXPECT_FALSE(co->is_finished());
+    CASE_EXPECT_EQ(0, co->resume());
+    CASE_EXPECT_TRUE(co->is_finished());
+    CASE_EXPECT_EQ(101 + i, co->get_ret_code());
+
+    ++(*reinterpret_cast<int *>(co->get_private_buffer()));
+  }
+
+  // reset with empty runner, it's not ready until set_runner()
+  CASE_EXPECT_EQ(0, co->reset(copp::coroutine_context_default::callback_type()));
+  CASE_EXPECT_EQ(copp::COPP_EC_NOT_INITED, co->start());
+  CASE_EXPECT_EQ(copp::COPP_EC_NOT_INITED, co->reset(test_context_base_reset_runner));
+  CASE_EXPECT_EQ(0, co->set_runner(test_context_base_reset_runner));
+  CASE_EXPECT_EQ(0, co->start());
+  CASE_EXPECT_EQ(0, co->resume());
+  CASE_EXPECT_EQ(103, co->get_ret_code());
+}
+
+static int test_context_base_single_thread_runner(void *priv_data) {
+  copp::coroutine_context *self = copp::this_coroutine::get_coroutine();
+  if (nullptr != priv_data) {
+    // switch to a shared coroutine, and come back when it's resumed by switch_to() again
+    copp::coroutine_context *next = reinterpret_cast<copp::coroutine_context *>(priv_data);
+    CASE_EXPECT_EQ(0, self->switch_to(*next, self));
+  }
+
+  CASE_EXPECT_EQ(copp::COPP_EC_IS_RUNNING, self->start());
+  self->yield();
+  return 7;
+}
+
+static int test_context_base_shared_thread_runner(void *priv_data) {
+  copp::coroutine_context *self = copp::this_coroutine::get_coroutine();
+  copp::coroutine_context *next = reinterpret_cast<copp::coroutine_context *>(priv_data);
+  CASE_EXPECT_EQ(0, self->switch_to(*next));
+  return 8;
+}
+
+CASE_TEST(coroutine, single_thread_policy) {
+  using single_thread_coroutine_type = copp::coroutine_context_single_thread_default;
+
+  copp::coroutine_context_default::ptr_t shared_co =
+      copp::coroutine_context_default::create(test_context_base_shared_thread_runner);
+  single_thread_coroutine_type::ptr_t co = single_thread_coroutine_type::create(test_context_base_single_thread_runner);
+  CASE_EXPECT_TRUE(!!shared_co);
+  CASE_EXPECT_TRUE(!!co);
+  CASE_EXPECT_FALSE(shared_co->check_flags(copp::coroutine_context::flag_type::EN_CFT_THREAD_CONFINED));
+  CASE_EXPECT_TRUE(co->check_flags(copp::coroutine_context::flag_type::EN_CFT_THREAD_CONFINED));
+  // internal flag can not be changed by user
+  CASE_EXPECT_FALSE(co->unset_flags(copp::coroutine_context::flag_type::EN_CFT_THREAD_CONFINED));
+
+  {
+    single_thread_coroutine_type::ptr_t co_ref = co;
+    CASE_EXPECT_EQ(2, co->use_count());
+  }
+  CASE_EXPECT_EQ(1, co->use_count());
+
+  CASE_EXPECT_EQ(copp::COPP_EC_ALREADY_INITED, co->set_runner(test_context_base_single_thread_runner));
+  CASE_EXPECT_EQ(copp::COPP_EC_NOT_RUNNING, co->yield());
+
+  // confined -> shared -> confined, and then back to this caller
+  CASE_EXPECT_EQ(0, co->start(shared_co.get()));
+  CASE_EXPECT_FALSE(co->is_finished());
+  CASE_EXPECT_FALSE(shared_co->is_finished());
+
+  CASE_EXPECT_EQ(0, co->resume());
+  CASE_EXPECT_TRUE(co->is_finished());
+  CASE_EXPECT_EQ(7, co->get_ret_code());
+  CASE_EXPECT_EQ(copp::COPP_EC_NOT_READY, co->resume());
+
+  // shared_co is still suspended in switch_to()
+  CASE_EXPECT_EQ(0, shared_co->resume());
+  CASE_EXPECT_TRUE(shared_co->is_finished());
+  CASE_EXPECT_EQ(8, shared_co->get_ret_code());
+
+  CASE_EXPECT_EQ(0, co->reset(test_context_base_single_thread_runner));
+  CASE_EXPECT_TRUE(co->check_flags(copp::coroutine_context::flag_type::EN_CFT_THREAD_CONFINED));
+  CASE_EXPECT_EQ(0, co->start());
+  CASE_EXPECT_EQ(0, co->resume());
+  CASE_EXPECT_EQ(7, co->get_ret_code());
+}
+
+static int test_context_base_stack_color_runner(void *) {
+  copp::coroutine_context *self = copp::this_coroutine::get_coroutine();
+  // private buffer is still writable after moving down
+  *reinterpret_cast<size_t *>(self->get_private_buffer()) = self->get_private_buffer_size();
+  self->yield();
+  return 0;
+}
+
+CASE_TEST(coroutine, stack_color) {
+  const size_t stack_size = 64 * 1024;
+  const size_t color_count = 4;
+  unsigned char *stack_buff = new unsigned char[stack_size * color_count * 2];
+  size_t old_color_count = copp::coroutine_context::get_stack_color_count();
+  copp::coroutine_context::set_stack_color_count(color_count);
+  CASE_EXPECT_EQ(color_count, copp::coroutine_context::get_stack_color_count());
+
+  {
+    size_t color_mask = 0;
+    std::vector<test_context_base_coroutine_context_test_type::ptr_t> co_arr;
+    for (size_t i = 0; i < color_count * 2; ++i) {
+      copp::allocator::stack_allocator_memory alloc(stack_buff + i * stack_size, stack_size);
+      co_arr.push_back(
+          test_context_base_coroutine_context_test_type::create(test_context_base_stack_color_runner, alloc, 0, 16));
+      CASE_EXPECT_TRUE(!!co_arr.back());
+      if (!co_arr.back()) {
+        continue;
+      }
+
+      // |...this..PRIVATE DATA..COLOR..stack top|
+      unsigned char *private_end = reinterpret_cast<unsigned char *>(co_arr.back()->get_private_buffer()) +
+                                   co_arr.back()->get_private_buffer_size();
+      size_t color_offset = static_cast<size_t>(stack_buff + (i + 1) * stack_size - private_end);
+      CASE_EXPECT_EQ(0, color_offset % LIBCOPP_MACRO_COROUTINE_STACK_COLOR_UNIT);
+      CASE_EXPECT_LT(color_offset, color_count * LIBCOPP_MACRO_COROUTINE_STACK_COLOR_UNIT);
+      color_mask |= static_cast<size_t>(1) << (color_offset / LIBCOPP_MACRO_COROUTINE_STACK_COLOR_UNIT);
+      CASE_EXPECT_LT(reinterpret_cast<unsigned char *>(co_arr.back().get()),
+                     reinterpret_cast<unsigned char *>(co_arr.back()->get_private_buffer()));
+
+      CASE_EXPECT_EQ(0, co_arr.back()->start());
+      CASE_EXPECT_EQ(co_arr.back()->get_private_buffer_size(),
+                     *reinterpret_cast<size_t *>(co_arr.back()->get_private_buffer()));
+      CASE_EXPECT_EQ(0, co_arr.back()->resume());
+      CASE_EXPECT_TRUE(co_arr.back()->is_finished());
+
+      // reset keeps the color
+      CASE_EXPECT_EQ(0, co_arr.back()->reset(test_context_base_stack_color_runner));
+      CASE_EXPECT_EQ(0, co_arr.back()->start());
+      CASE_EXPECT_EQ(0, co_arr.back()->resume());
+    }
+
+    // all colors are used
+    CASE_EXPECT_EQ((static_cast<size_t>(1) << color_count) - 1, color_mask);
+  }
+
+  copp::coroutine_context::set_stack_color_count(0);
+  CASE_EXPECT_EQ(1, copp::coroutine_context::get_stack_color_count());
+  CASE_EXPECT_EQ(0, copp::coroutine_context::next_stack_color_offset());
+
+  copp::coroutine_context::set_stack_color_count(old_color_count);
+  delete[] stack_buff;
+}
+
+static int test_context_base_resume_batch_runner(void *priv_data) {
+  copp::coroutine_context *self = copp::this_coroutine::get_coroutine();
+  int *switch_times = reinterpret_cast<int *>(priv_data);
+  // every coroutine yields (index + 1) times, the index is saved in private buffer
+  size_t index = *reinterpret_cast<size_t *>(self->get_private_buffer());
+  for (size_t i = 0; i <= index; ++i) {
+    ++(*switch_times);
+    self->yield(reinterpret_cast<void **>(&switch_times));
+  }
+
+#if defined(LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR) && LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR
+  if (1 == index) {
+    throw std::runtime_error("resume_batch");
+  }
+#endif
+  return static_cast<int>(index);
+}
+
+CASE_TEST(coroutine, resume_batch) {
+  std::vector<copp::coroutine_context_default::ptr_t> co_holder;
+  std::vector<copp::coroutine_context *> co_arr;
+  for (size_t i = 0; i < 4; ++i) {
+    co_holder.push_back(
+        copp::coroutine_context_default::create(test_context_base_resume_batch_runner, 0, sizeof(size_t)));
+    CASE_EXPECT_TRUE(!!co_holder.back());
+    *reinterpret_cast<size_t *>(co_holder.back()->get_private_buffer()) = i;
+    co_arr.push_back(co_holder.back().get());
+
+    // empty slots are skipped
+    co_arr.push_back(nullptr);
+  }
+
+  // coroutines which are not started are started by resume_batch()
+  int switch_times = 0;
+  CASE_EXPECT_EQ(0, co_holder[0]->start(&switch_times));
+  CASE_EXPECT_EQ(1, switch_times);
+
+  size_t resume_times = 0;
+  size_t batch_times = 0;
+  while (true) {
+#if defined(LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR) && LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR
+    std::exception_ptr unhandled;
+    size_t resumed = copp::coroutine_context::resume_batch(
+        unhandled, copp::gsl::span<copp::coroutine_context *>(co_arr.data(), co_arr.size()), &switch_times);
+    // coroutine 1 throws after its last yield, and other coroutines are still resumed in the same batch
+    CASE_EXPECT_EQ(2 == batch_times, !!unhandled);
+#else
+    size_t resumed = copp::coroutine_context::resume_batch(
+        copp::gsl::span<copp::coroutine_context *>(co_arr.data(), co_arr.size()), &switch_times);
+#endif
+    if (0 == resumed) {
+      break;
+    }
+    resume_times += resumed;
+    ++batch_times;
+  }
+
+  // 1 + 2 + 3 + 4 yields, and every coroutine is resumed once more to finish
+  CASE_EXPECT_EQ(10, switch_times);
+  CASE_EXPECT_EQ(5, batch_times);
+  CASE_EXPECT_EQ(13, resume_times);
+  for (size_t i = 0; i < co_holder.size(); ++i) {
+    CASE_EXPECT_TRUE(co_holder[i]->is_finished());
+  }
+  CASE_EXPECT_EQ(3, co_holder[3]->get_ret_code());
+
+  // finished coroutines are skipped
+  CASE_EXPECT_EQ(0, copp::coroutine_context::resume_batch(
+                        copp::gsl::span<copp::coroutine_context *>(co_arr.data(), co_arr.size())));
+  CASE_EXPECT_EQ(0, copp::coroutine_context::resume_batch(copp::gsl::span<copp::coroutine_context *>()));
+}
+
 #if defined(LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR) && LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR
 static int test_context_base_foo_runner_throw_exception(void *) { return static_cast<int>(std::string().at(1)); }
 
@@ -0,0 +1,82 @@
+// Copyright 2023 owent
+
+#include <libcopp/coroutine/coroutine_context_container.h>
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+#include "frame/test_macros.h"
+
+namespace {
+struct coroutine_context_resume_with_test_data {
+  copp::coroutine_context *co;
+  int ontop_count;
+  int loop_count;
+  int cancel_token;
+  int value_token;
+};
+
+static int coroutine_context_resume_with_test_runner(void *priv_data) {
+  coroutine_context_resume_with_test_data *data = reinterpret_cast<coroutine_context_resume_with_test_data *>(priv_data);
+  copp::coroutine_context *self = copp::this_coroutine::get_coroutine();
+
+  while (true) {
+    ++data->loop_count;
+    void *recv = nullptr;
+    self->yield(&recv);
+
+    // injected by ontop callback
+    if (recv == &data->cancel_token) {
+      return -1;
+    }
+  }
+}
+
+static void *coroutine_context_resume_with_test_cancel(copp::coroutine_context *co, void *priv_data) {
+  coroutine_context_resume_with_test_data *data = reinterpret_cast<coroutine_context_resume_with_test_data *>(priv_data);
+  CASE_EXPECT_EQ(data->co, co);
+  CASE_EXPECT_EQ(co, copp::this_coroutine::get_coroutine());
+  ++data->ontop_count;
+  return &data->cancel_token;
+}
+
+static void *coroutine_context_resume_with_test_value(copp::coroutine_context *co, void *priv_data) {
+  coroutine_context_resume_with_test_data *data = reinterpret_cast<coroutine_context_resume_with_test_data *>(priv_data);
+  CASE_EXPECT_EQ(co, copp::this_coroutine::get_coroutine());
+  ++data->ontop_count;
+  return data;
+}
+}  // namespace
+
+CASE_TEST(coroutine_context_resume_with, cancel) {
+  coroutine_context_resume_with_test_data data;
+  memset(&data, 0, sizeof(data));
+
+  copp::coroutine_context_default::ptr_t co =
+      copp::coroutine_context_default::create(coroutine_context_resume_with_test_runner);
+  data.co = co.get();
+
+  CASE_EXPECT_EQ(copp::COPP_EC_ARGS_ERROR, co->resume_with(nullptr, &data));
+
+  // ontop callback also works before coroutine is started, its return value is passed to runner
+  CASE_EXPECT_EQ(0, co->resume_with(coroutine_context_resume_with_test_value, &data));
+  CASE_EXPECT_EQ(1, data.ontop_count);
+  CASE_EXPECT_EQ(1, data.loop_count);
+  CASE_EXPECT_EQ(nullptr, copp::this_coroutine::get_coroutine());
+
+  CASE_EXPECT_EQ(0, co->resume(&data.value_token));
+  CASE_EXPECT_EQ(2, data.loop_count);
+  CASE_EXPECT_FALSE(co->is_finished());
+
+  // cancel in one switch
+  CASE_EXPECT_EQ(0, co->resume_with(coroutine_context_resume_with_test_cancel, &data));
+  CASE_EXPECT_EQ(2, data.ontop_count);
+  CASE_EXPECT_EQ(2, data.loop_count);
+  CASE_EXPECT_TRUE(co->is_finished());
+  CASE_EXPECT_EQ(-1, co->get_ret_code());
+  CASE_EXPECT_EQ(nullptr, copp::this_coroutine::get_coroutine());
+
+  CASE_EXPECT_EQ(copp::COPP_EC_NOT_READY, co->resume_with(coroutine_context_resume_with_test_cancel, &data));
+  CASE_EXPECT_EQ(2, data.ontop_count);
+}
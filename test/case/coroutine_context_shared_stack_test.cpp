@@ -0,0 +1,185 @@
+// Copyright 2023 owent
+
+#include <libcopp/coroutine/coroutine_context_container.h>
+#include <libcopp/coroutine/coroutine_context_shared_stack.h>
+#include <libcopp/stack/stack_traits.h>
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include "frame/test_macros.h"
+
+typedef copp::coroutine_context_shared_stack_default coroutine_context_shared_stack_test_type;
+typedef coroutine_context_shared_stack_test_type::group_type coroutine_context_shared_stack_test_group_type;
+
+struct coroutine_context_shared_stack_test_runner {
+  int index;
+  int yield_times;
+  int sum;
+
+  int operator()(void *) {
+    // locals must be kept after other coroutines run on the same stack
+    int values[16];
+    for (int i = 0; i < 16; ++i) {
+      values[i] = index * 100 + i;
+    }
+
+    for (int i = 0; i < yield_times; ++i) {
+      copp::this_coroutine::yield();
+      for (int j = 0; j < 16; ++j) {
+        CASE_EXPECT_EQ(index * 100 + j, values[j]);
+      }
+      sum += values[i & 15];
+    }
+    return index;
+  }
+};
+
+CASE_TEST(coroutine_context_shared_stack, basic) {
+  coroutine_context_shared_stack_test_group_type::ptr_type group =
+      coroutine_context_shared_stack_test_group_type::create(2, 64 * 1024);
+  CASE_EXPECT_TRUE(!!group);
+  if (!group) {
+    return;
+  }
+  CASE_EXPECT_EQ(2, group->get_stack_number());
+
+  const int co_number = 8;
+  const int yield_times = 5;
+  std::vector<coroutine_context_shared_stack_test_runner> runners;
+  std::vector<coroutine_context_shared_stack_test_type::ptr_t> co_arr;
+  runners.resize(co_number);
+  for (int i = 0; i < co_number; ++i) {
+    runners[i].index = i + 1;
+    runners[i].yield_times = yield_times;
+    runners[i].sum = 0;
+  }
+
+  for (int i = 0; i < co_number; ++i) {
+    co_arr.push_back(coroutine_context_shared_stack_test_type::create(&runners[i], group, 64));
+    CASE_EXPECT_TRUE(!!co_arr.back());
+    CASE_EXPECT_EQ(64, co_arr.back()->get_private_buffer_size());
+    CASE_EXPECT_NE(nullptr, co_arr.back()->get_private_buffer());
+  }
+
+  for (int i = 0; i < co_number; ++i) {
+    CASE_EXPECT_EQ(0, co_arr[i]->start());
+  }
+
+  // only the last coroutine of each run stack keeps its data on the run stack
+  for (int i = 0; i < co_number; ++i) {
+    CASE_EXPECT_EQ(i + 2 >= co_number, co_arr[i]->is_on_run_stack());
+    if (i + 2 < co_number) {
+      CASE_EXPECT_GT(co_arr[i]->get_saved_size(), 0);
+      // saved data is much smaller than the run stack
+      CASE_EXPECT_LT(co_arr[i]->get_saved_size(), 4096);
+    }
+  }
+
+  for (int loop = 0; loop < yield_times; ++loop) {
+    for (int i = 0; i < co_number; ++i) {
+      CASE_EXPECT_EQ(0, co_arr[i]->resume());
+    }
+  }
+
+  for (int i = 0; i < co_number; ++i) {
+    CASE_EXPECT_TRUE(co_arr[i]->is_finished());
+    CASE_EXPECT_EQ(i + 1, co_arr[i]->get_ret_code());
+    CASE_EXPECT_GT(runners[i].sum, 0);
+  }
+
+  // coroutines keep the group alive
+  coroutine_context_shared_stack_test_group_type *group_ptr = group.get();
+  group.reset();
+  CASE_EXPECT_EQ(2, group_ptr->get_stack_number());
+  co_arr.clear();
+}
+
+static coroutine_context_shared_stack_test_type::ptr_t g_coroutine_context_shared_stack_test_inner;
+static int g_coroutine_context_shared_stack_test_inner_res = 0;
+
+static int coroutine_context_shared_stack_test_nested_runner(void *) {
+  g_coroutine_context_shared_stack_test_inner_res = g_coroutine_context_shared_stack_test_inner->start();
+  return 0;
+}
+
+static int coroutine_context_shared_stack_test_inner_runner(void *) { return 0; }
+
+CASE_TEST(coroutine_context_shared_stack, nested_on_same_stack) {
+  coroutine_context_shared_stack_test_group_type::ptr_type group =
+      coroutine_context_shared_stack_test_group_type::create(1, 64 * 1024);
+  CASE_EXPECT_TRUE(!!group);
+  if (!group) {
+    return;
+  }
+
+  coroutine_context_shared_stack_test_type::ptr_t outer =
+      coroutine_context_shared_stack_test_type::create(coroutine_context_shared_stack_test_nested_runner, group);
+  g_coroutine_context_shared_stack_test_inner =
+      coroutine_context_shared_stack_test_type::create(coroutine_context_shared_stack_test_inner_runner, group);
+
+  // can not start a coroutine on the run stack used by the running coroutine
+  CASE_EXPECT_EQ(0, outer->start());
+  CASE_EXPECT_EQ(copp::COPP_EC_ACCESS_VIOLATION, g_coroutine_context_shared_stack_test_inner_res);
+  CASE_EXPECT_TRUE(outer->is_finished());
+
+  // the run stack can be used after outer finished
+  CASE_EXPECT_EQ(0, g_coroutine_context_shared_stack_test_inner->start());
+  CASE_EXPECT_TRUE(g_coroutine_context_shared_stack_test_inner->is_finished());
+  g_coroutine_context_shared_stack_test_inner.reset();
+}
+
+static coroutine_context_shared_stack_test_type::ptr_t g_coroutine_context_shared_stack_test_switch_target;
+static int g_coroutine_context_shared_stack_test_switch_res = 0;
+
+static int coroutine_context_shared_stack_test_switch_runner(void *) {
+  g_coroutine_context_shared_stack_test_switch_res =
+      copp::this_coroutine::get_coroutine()->switch_to(*g_coroutine_context_shared_stack_test_switch_target);
+  return 0;
+}
+
+CASE_TEST(coroutine_context_shared_stack, reject_switch_to_and_resume_batch) {
+  coroutine_context_shared_stack_test_group_type::ptr_type group =
+      coroutine_context_shared_stack_test_group_type::create(1, 64 * 1024);
+  CASE_EXPECT_TRUE(!!group);
+  if (!group) {
+    return;
+  }
+
+  coroutine_context_shared_stack_test_runner runners[2];
+  coroutine_context_shared_stack_test_type::ptr_t co_arr[2];
+  for (int i = 0; i < 2; ++i) {
+    runners[i].index = i + 1;
+    runners[i].yield_times = 1;
+    runners[i].sum = 0;
+    co_arr[i] = coroutine_context_shared_stack_test_type::create(&runners[i], group);
+    CASE_EXPECT_TRUE(!!co_arr[i]);
+    CASE_EXPECT_TRUE(co_arr[i]->check_flags(copp::coroutine_context::flag_type::EN_CFT_SHARED_STACK));
+    CASE_EXPECT_EQ(0, co_arr[i]->start());
+  }
+
+  // stack data of co_arr[0] is saved, switching into it directly would run on the stack data of co_arr[1]
+  CASE_EXPECT_FALSE(co_arr[0]->is_on_run_stack());
+  g_coroutine_context_shared_stack_test_switch_target = co_arr[0];
+  copp::coroutine_context_default::ptr_t switch_co =
+      copp::coroutine_context_default::create(coroutine_context_shared_stack_test_switch_runner);
+  CASE_EXPECT_EQ(0, switch_co->start());
+  CASE_EXPECT_EQ(copp::COPP_EC_ARGS_ERROR, g_coroutine_context_shared_stack_test_switch_res);
+  CASE_EXPECT_TRUE(switch_co->is_finished());
+  g_coroutine_context_shared_stack_test_switch_target.reset();
+
+  // resume_batch() skips them too
+  copp::coroutine_context *batch[2] = {co_arr[0].get(), co_arr[1].get()};
+  CASE_EXPECT_EQ(0, copp::coroutine_context::resume_batch(copp::gsl::span<copp::coroutine_context *>(batch, 2)));
+  CASE_EXPECT_FALSE(co_arr[0]->is_finished());
+  CASE_EXPECT_FALSE(co_arr[1]->is_finished());
+
+  // they still work with their own resume()
+  for (int i = 0; i < 2; ++i) {
+    CASE_EXPECT_EQ(0, co_arr[i]->resume());
+    CASE_EXPECT_TRUE(co_arr[i]->is_finished());
+    CASE_EXPECT_EQ(i + 1, co_arr[i]->get_ret_code());
+  }
+}
@@ -0,0 +1,206 @@
+// Copyright 2023 owent
+
+#include <libcopp/coroutine/coroutine_context_container.h>
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include "frame/test_macros.h"
+
+namespace {
+struct coroutine_context_switch_to_test_data {
+  copp::coroutine_context_default::ptr_t co_a;
+  copp::coroutine_context_default::ptr_t co_b;
+  std::vector<int> sequence;
+  int switch_to_res;
+};
+
+static coroutine_context_switch_to_test_data *g_coroutine_context_switch_to_test_data = nullptr;
+
+static int coroutine_context_switch_to_test_runner_a(void *) {
+  coroutine_context_switch_to_test_data &data = *g_coroutine_context_switch_to_test_data;
+  data.sequence.push_back(1);
+
+  // switch to self is not allowed
+  CASE_EXPECT_EQ(copp::COPP_EC_ARGS_ERROR, data.co_a->switch_to(*data.co_a));
+
+  data.switch_to_res = data.co_a->switch_to(*data.co_b, &data);
+  CASE_EXPECT_EQ(data.co_a.get(), copp::this_coroutine::get_coroutine());
+  data.sequence.push_back(4);
+  return 1;
+}
+
+static int coroutine_context_switch_to_test_runner_b(void *priv_data) {
+  coroutine_context_switch_to_test_data &data = *g_coroutine_context_switch_to_test_data;
+  CASE_EXPECT_EQ(&data, priv_data);
+  CASE_EXPECT_EQ(data.co_b.get(), copp::this_coroutine::get_coroutine());
+  data.sequence.push_back(2);
+
+  // yield to the caller of co_a
+  data.co_b->yield();
+  CASE_EXPECT_EQ(data.co_b.get(), copp::this_coroutine::get_coroutine());
+  data.sequence.push_back(3);
+
+  // co_a finishes and jumps to the caller of co_b
+  CASE_EXPECT_EQ(0, data.co_b->switch_to(*data.co_a));
+  CASE_EXPECT_EQ(data.co_b.get(), copp::this_coroutine::get_coroutine());
+  data.sequence.push_back(5);
+  return 2;
+}
+}  // namespace
+
+CASE_TEST(coroutine_context_switch_to, basic) {
+  coroutine_context_switch_to_test_data data;
+  data.switch_to_res = -1;
+  g_coroutine_context_switch_to_test_data = &data;
+
+  data.co_a = copp::coroutine_context_default::create(coroutine_context_switch_to_test_runner_a);
+  data.co_b = copp::coroutine_context_default::create(coroutine_context_switch_to_test_runner_b);
+  CASE_EXPECT_TRUE(!!data.co_a);
+  CASE_EXPECT_TRUE(!!data.co_b);
+  if (!data.co_a || !data.co_b) {
+    return;
+  }
+
+  // switch_to() can only be called by the running coroutine
+  CASE_EXPECT_EQ(copp::COPP_EC_NOT_RUNNING, data.co_a->switch_to(*data.co_b));
+
+  // co_a -> co_b -> main
+  CASE_EXPECT_EQ(0, data.co_a->start());
+  CASE_EXPECT_EQ(nullptr, copp::this_coroutine::get_coroutine());
+  CASE_EXPECT_EQ(2, data.sequence.size());
+  CASE_EXPECT_FALSE(data.co_a->is_finished());
+  CASE_EXPECT_FALSE(data.co_b->is_finished());
+
+  // co_b -> co_a -> main
+  CASE_EXPECT_EQ(0, data.co_b->resume());
+  CASE_EXPECT_EQ(nullptr, copp::this_coroutine::get_coroutine());
+  CASE_EXPECT_EQ(4, data.sequence.size());
+  CASE_EXPECT_EQ(0, data.switch_to_res);
+  CASE_EXPECT_TRUE(data.co_a->is_finished());
+  CASE_EXPECT_EQ(1, data.co_a->get_ret_code());
+  CASE_EXPECT_FALSE(data.co_b->is_finished());
+
+  // co_b -> main
+  CASE_EXPECT_EQ(0, data.co_b->resume());
+  CASE_EXPECT_TRUE(data.co_b->is_finished());
+  CASE_EXPECT_EQ(2, data.co_b->get_ret_code());
+
+  CASE_EXPECT_EQ(5, data.sequence.size());
+  for (size_t i = 0; i < data.sequence.size(); ++i) {
+    CASE_EXPECT_EQ(static_cast<int>(i + 1), data.sequence[i]);
+  }
+
+  g_coroutine_context_switch_to_test_data = nullptr;
+}
+
+namespace {
+struct coroutine_context_switch_to_test_ring {
+  std::vector<copp::coroutine_context_default::ptr_t> co_arr;
+  int left_times;
+  int switch_times;
+};
+
+static int coroutine_context_switch_to_test_ring_runner(void *priv_data) {
+  coroutine_context_switch_to_test_ring *ring = reinterpret_cast<coroutine_context_switch_to_test_ring *>(priv_data);
+  copp::coroutine_context *self = copp::this_coroutine::get_coroutine();
+  while (ring->left_times > 0) {
+    --ring->left_times;
+
+    // find the next coroutine of ring
+    size_t index = 0;
+    while (ring->co_arr[index].get() != self) {
+      ++index;
+    }
+    copp::coroutine_context *next = ring->co_arr[(index + 1) % ring->co_arr.size()].get();
+    CASE_EXPECT_EQ(0, self->switch_to(*next, ring));
+    CASE_EXPECT_EQ(self, copp::this_coroutine::get_coroutine());
+    ++ring->switch_times;
+  }
+  return 0;
+}
+}  // namespace
+
+CASE_TEST(coroutine_context_switch_to, ring) {
+  coroutine_context_switch_to_test_ring ring;
+  ring.left_times = 100;
+  ring.switch_times = 0;
+  for (int i = 0; i < 4; ++i) {
+    ring.co_arr.push_back(copp::coroutine_context_default::create(coroutine_context_switch_to_test_ring_runner));
+  }
+
+  // all switches happen without returning to main
+  CASE_EXPECT_EQ(0, ring.co_arr[0]->start(&ring));
+  CASE_EXPECT_EQ(0, ring.left_times);
+  CASE_EXPECT_EQ(nullptr, copp::this_coroutine::get_coroutine());
+
+  // the last coroutine finishes and returns to main, others are suspended in switch_to()
+  size_t finished_count = 0;
+  for (size_t i = 0; i < ring.co_arr.size(); ++i) {
+    if (ring.co_arr[i]->is_finished()) {
+      ++finished_count;
+    }
+  }
+  CASE_EXPECT_EQ(1, finished_count);
+
+  for (size_t i = 0; i < ring.co_arr.size(); ++i) {
+    if (!ring.co_arr[i]->is_finished()) {
+      CASE_EXPECT_EQ(0, ring.co_arr[i]->resume());
+    }
+    CASE_EXPECT_TRUE(ring.co_arr[i]->is_finished());
+  }
+  CASE_EXPECT_EQ(100, ring.switch_times);
+}
+
+namespace {
+struct coroutine_context_switch_to_test_reset {
+  copp::coroutine_context_default::ptr_t co_from;
+  copp::coroutine_context_default::ptr_t co_target;
+  int target_run_times;
+};
+
+static int coroutine_context_switch_to_test_reset_from_runner(void *priv_data) {
+  coroutine_context_switch_to_test_reset *data = reinterpret_cast<coroutine_context_switch_to_test_reset *>(priv_data);
+  CASE_EXPECT_EQ(0, data->co_from->switch_to(*data->co_target, data));
+  return 0;
+}
+
+static int coroutine_context_switch_to_test_reset_target_runner(void *priv_data) {
+  coroutine_context_switch_to_test_reset *data = reinterpret_cast<coroutine_context_switch_to_test_reset *>(priv_data);
+  ++data->target_run_times;
+  return data->target_run_times;
+}
+}  // namespace
+
+CASE_TEST(coroutine_context_switch_to, reset_finished_target) {
+  coroutine_context_switch_to_test_reset data;
+  data.target_run_times = 0;
+  data.co_from = copp::coroutine_context_default::create(coroutine_context_switch_to_test_reset_from_runner);
+  data.co_target = copp::coroutine_context_default::create(coroutine_context_switch_to_test_reset_target_runner);
+  CASE_EXPECT_TRUE(!!data.co_from);
+  CASE_EXPECT_TRUE(!!data.co_target);
+  if (!data.co_from || !data.co_target) {
+    return;
+  }
+
+  // co_from -> co_target finishes -> main
+  CASE_EXPECT_EQ(0, data.co_from->start(&data));
+  CASE_EXPECT_EQ(1, data.target_run_times);
+  CASE_EXPECT_TRUE(data.co_target->is_finished());
+  CASE_EXPECT_FALSE(data.co_from->is_finished());
+
+  // the finished target can be reset and run again
+  CASE_EXPECT_EQ(0, data.co_target->reset(coroutine_context_switch_to_test_reset_target_runner));
+  CASE_EXPECT_FALSE(data.co_target->is_finished());
+  CASE_EXPECT_EQ(0, data.co_target->start(&data));
+  CASE_EXPECT_EQ(2, data.target_run_times);
+  CASE_EXPECT_EQ(2, data.co_target->get_ret_code());
+  CASE_EXPECT_TRUE(data.co_target->is_finished());
+
+  // co_from is still suspended in switch_to()
+  CASE_EXPECT_EQ(0, data.co_from->resume());
+  CASE_EXPECT_TRUE(data.co_from->is_finished());
+  CASE_EXPECT_EQ(0, data.co_from->reset(coroutine_context_switch_to_test_reset_from_runner));
+}
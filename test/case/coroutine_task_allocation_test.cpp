@@ -0,0 +1,163 @@
+// Copyright 2023 owent
+
+#include <libcotask/task.h>
+#include <libcotask/task_manager.h>
+#include <libcotask/task_manager_sharded.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <list>
+#include <new>
+#include <vector>
+
+#include "frame/test_allocation_counter.h"
+#include "frame/test_macros.h"
+
+#ifdef LIBCOTASK_MACRO_ENABLED
+
+namespace {
+static int coroutine_task_allocation_action(void *) {
+  cotask::this_task::get_task()->yield();
+  return 1;
+}
+
+#if defined(LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR) && LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR
+static int coroutine_task_allocation_throw_action(void *) {
+  cotask::this_task::get_task()->yield();
+  // exception objects are allocated by the C++ runtime, not operator new
+  throw 1;
+}
+#endif
+}  // namespace
+
+CASE_TEST(coroutine_task_allocation, start_resume_without_next) {
+  using task_ptr_type = cotask::task<>::ptr_t;
+  task_ptr_type co_task = cotask::task<>::create(coroutine_task_allocation_action, 64 * 1024);
+  CASE_EXPECT_TRUE(!!co_task);
+  if (!co_task) {
+    return;
+  }
+
+  size_t allocation_times = 0;
+  // make sure the counter works
+  {
+    test_allocation_counter_guard guard(allocation_times);
+    std::list<int> nodes;
+    nodes.push_back(1);
+  }
+  CASE_EXPECT_EQ(1, static_cast<int>(allocation_times));
+
+  {
+    test_allocation_counter_guard guard(allocation_times);
+    CASE_EXPECT_EQ(0, co_task->start());
+    CASE_EXPECT_EQ(cotask::EN_TS_WAITING, co_task->get_status());
+    CASE_EXPECT_EQ(0, co_task->resume());
+    CASE_EXPECT_EQ(cotask::EN_TS_DONE, co_task->get_status());
+  }
+
+  CASE_EXPECT_EQ(1, co_task->get_ret_code());
+  CASE_EXPECT_EQ(0, static_cast<int>(allocation_times));
+}
+
+CASE_TEST(coroutine_task_allocation, start_resume_with_next) {
+  using task_ptr_type = cotask::task<>::ptr_t;
+  task_ptr_type co_task = cotask::task<>::create(coroutine_task_allocation_action, 64 * 1024);
+  task_ptr_type next_task = cotask::task<>::create(coroutine_task_allocation_action, 64 * 1024);
+  CASE_EXPECT_TRUE(!!co_task);
+  CASE_EXPECT_TRUE(!!next_task);
+  if (!co_task || !next_task) {
+    return;
+  }
+
+  co_task->next(next_task);
+  CASE_EXPECT_EQ(0, co_task->start());
+  CASE_EXPECT_EQ(cotask::EN_TS_CREATED, next_task->get_status());
+
+  // next tasks are still started when the task is finished
+  CASE_EXPECT_EQ(0, co_task->resume());
+  CASE_EXPECT_EQ(cotask::EN_TS_DONE, co_task->get_status());
+  CASE_EXPECT_EQ(cotask::EN_TS_WAITING, next_task->get_status());
+
+  size_t allocation_times = 0;
+  {
+    test_allocation_counter_guard guard(allocation_times);
+    CASE_EXPECT_EQ(0, next_task->resume());
+  }
+  CASE_EXPECT_EQ(cotask::EN_TS_DONE, next_task->get_status());
+  CASE_EXPECT_EQ(0, static_cast<int>(allocation_times));
+}
+
+template <class TMGR>
+static void coroutine_task_allocation_manager_batch() {
+  using task_ptr_type = cotask::task<>::ptr_t;
+  typename TMGR::ptr_type task_mgr = TMGR::create();
+
+  // more than 2 chunks of task_manager
+  const size_t task_number = 2 * cotask::task_manager<cotask::task<> >::BATCH_CHUNK_SIZE + 3;
+  std::vector<task_ptr_type> tasks;
+  std::vector<typename TMGR::batch_item_type> items;
+  std::vector<int> results;
+  tasks.reserve(task_number);
+  items.reserve(task_number + 1);
+  for (size_t i = 0; i < task_number; ++i) {
+    tasks.push_back(cotask::task<>::create(coroutine_task_allocation_action, 64 * 1024));
+    CASE_EXPECT_EQ(0, task_mgr->add_task(tasks.back()));
+    items.push_back(typename TMGR::batch_item_type(tasks.back()->get_id(), nullptr));
+  }
+  items.push_back(typename TMGR::batch_item_type(0, nullptr));
+  results.resize(items.size(), 1);
+
+  size_t allocation_times = 0;
+  {
+    test_allocation_counter_guard guard(allocation_times);
+    CASE_EXPECT_EQ(task_number, task_mgr->start_batch(items, results));
+    CASE_EXPECT_EQ(task_number, task_mgr->resume_batch(items, results));
+  }
+  CASE_EXPECT_EQ(0, static_cast<int>(allocation_times));
+  CASE_EXPECT_EQ(0, results.front());
+  CASE_EXPECT_EQ(copp::COPP_EC_NOT_FOUND, results.back());
+  CASE_EXPECT_EQ(0, static_cast<int>(task_mgr->get_task_size()));
+  for (size_t i = 0; i < task_number; ++i) {
+    CASE_EXPECT_EQ(cotask::EN_TS_DONE, tasks[i]->get_status());
+  }
+}
+
+CASE_TEST(coroutine_task_allocation, manager_batch) {
+  coroutine_task_allocation_manager_batch<cotask::task_manager<cotask::task<> > >();
+}
+
+CASE_TEST(coroutine_task_allocation, sharded_manager_batch) {
+  coroutine_task_allocation_manager_batch<cotask::task_manager_sharded<cotask::task<>, 4> >();
+}
+
+#if defined(LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR) && LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR
+CASE_TEST(coroutine_task_allocation, rethrow_unhandled_exception) {
+  using task_ptr_type = cotask::task<>::ptr_t;
+  task_ptr_type co_task = cotask::task<>::create(coroutine_task_allocation_throw_action, 64 * 1024);
+  CASE_EXPECT_TRUE(!!co_task);
+  if (!co_task) {
+    return;
+  }
+
+  size_t allocation_times = 0;
+  bool has_exception = false;
+  {
+    test_allocation_counter_guard guard(allocation_times);
+    CASE_EXPECT_EQ(0, co_task->start());
+    // the unhandled exception is kept inline and rethrown, no list is created for it
+    try {
+      co_task->resume();
+    } catch (int v) {
+      has_exception = 1 == v;
+    }
+  }
+
+  CASE_EXPECT_TRUE(has_exception);
+  CASE_EXPECT_EQ(cotask::EN_TS_DONE, co_task->get_status());
+  CASE_EXPECT_EQ(0, static_cast<int>(allocation_times));
+}
+#endif
+
+#endif
@@ -2,11 +2,14 @@
 
 #include <libcotask/task.h>
 #include <libcotask/task_manager.h>
+#include <libcotask/task_manager_sharded.h>
 
 #include <cstdio>
 #include <cstring>
 #include <iostream>
 #include <memory>
+#include <set>
+#include <vector>
 
 #include "frame/test_macros.h"
 
@@ -60,6 +63,20 @@ CASE_TEST(coroutine_task_manager, tickspec_t) {
   CASE_EXPECT_FALSE(l <= r);
 }
 
+CASE_TEST(coroutine_task_manager, make_tickspec) {
+  cotask::detail::tickspec_t t = cotask::detail::make_tickspec(123, 2500000000LL);
+  CASE_EXPECT_EQ(125, static_cast<int>(t.tv_sec));
+  CASE_EXPECT_EQ(500000000, t.tv_nsec);
+
+  t = cotask::detail::make_tickspec(123, -1);
+  CASE_EXPECT_EQ(122, static_cast<int>(t.tv_sec));
+  CASE_EXPECT_EQ(999999999, t.tv_nsec);
+
+  t = cotask::detail::make_tickspec(123, 1000000000);
+  CASE_EXPECT_EQ(124, static_cast<int>(t.tv_sec));
+  CASE_EXPECT_EQ(0, t.tv_nsec);
+}
+
 CASE_TEST(coroutine_task_manager, task_timer_node) {
   cotask::detail::task_timer_node<cotask::task<>::id_type> l;
   cotask::detail::task_timer_node<cotask::task<>::id_type> r;
@@ -169,9 +186,547 @@ CASE_TEST(coroutine_task_manager, add_and_timeout) {
 
   CASE_EXPECT_EQ(copp::COPP_EC_TASK_IS_EXITING, task_mgr->add_task(co_another_task));
 
+  // nanoseconds of timeout are carried into seconds: 9s + 1.5s = 10.5s
+  task_ptr_type co_nsec_task = cotask::task<>::create(test_context_task_manager_action());
+  CASE_EXPECT_EQ(0, task_mgr->add_task(co_nsec_task, 0, 1500000000));
+  task_mgr->tick(10, 400000000);
+  CASE_EXPECT_EQ(cotask::EN_TS_CREATED, co_nsec_task->get_status());
+  task_mgr->tick(10, 600000000);
+  CASE_EXPECT_EQ(cotask::EN_TS_TIMEOUT, co_nsec_task->get_status());
+
   task_mgr.reset();
 }
 
+CASE_TEST(coroutine_task_manager, add_and_timeout_with_timer_wheel) {
+  typedef cotask::task<>::ptr_t task_ptr_type;
+  task_ptr_type co_task = cotask::task<>::create(test_context_task_manager_action());
+  task_ptr_type co_another_task = cotask::task<>::create(test_context_task_manager_action());  // share action
+  task_ptr_type co_nsec_task = cotask::task<>::create(test_context_task_manager_action());
+
+  typedef cotask::task_manager<cotask::task<>, cotask::task_timer_wheel<cotask::task<>::id_type> > mgr_t;
+  mgr_t::ptr_t task_mgr = mgr_t::create();
+
+  g_test_coroutine_task_manager_status = 0;
+
+  task_mgr->add_task(co_task, 5, 0);
+  task_mgr->add_task(co_another_task);
+  task_mgr->add_task(co_nsec_task, 100, 0);
+
+  CASE_EXPECT_EQ(3, (int)task_mgr->get_task_size());
+  CASE_EXPECT_EQ(2, (int)task_mgr->get_tick_checkpoint_size());
+
+  task_mgr->tick(3);
+  CASE_EXPECT_EQ(3, (int)task_mgr->get_task_size());
+  CASE_EXPECT_EQ(2, (int)task_mgr->get_tick_checkpoint_size());
+  // update timeout to 3.5s + 500us
+  CASE_EXPECT_EQ(0, task_mgr->set_timeout(co_nsec_task->get_id(), 0, 500000));
+  CASE_EXPECT_EQ(2, (int)task_mgr->get_tick_checkpoint_size());
+
+  task_mgr->tick(8);
+  CASE_EXPECT_EQ(8, (int)task_mgr->get_last_tick_time().tv_sec);
+  CASE_EXPECT_EQ(2, (int)task_mgr->get_task_size());
+  CASE_EXPECT_TRUE(cotask::EN_TS_TIMEOUT == co_nsec_task->get_status());
+
+  // tick reset timeout: 3 + 5 = 8
+  CASE_EXPECT_EQ(1, (int)task_mgr->get_tick_checkpoint_size());
+  CASE_EXPECT_EQ(1, (int)task_mgr->get_checkpoints().size());
+  if (!task_mgr->get_checkpoints().empty()) {
+    CASE_EXPECT_EQ(8, (int)task_mgr->get_checkpoints().begin()->expired_time.tv_sec);
+    CASE_EXPECT_EQ(co_task->get_id(), task_mgr->get_checkpoints().begin()->task_id);
+  }
+  CASE_EXPECT_FALSE(cotask::EN_TS_TIMEOUT == co_task->get_status());
+
+  // checkpoint in the same tick slot of timer wheel should also be expired after 8s
+  task_mgr->tick(8, 1);
+  CASE_EXPECT_EQ(1, (int)task_mgr->get_task_size());
+  CASE_EXPECT_EQ(0, (int)task_mgr->get_tick_checkpoint_size());
+  CASE_EXPECT_TRUE(cotask::EN_TS_TIMEOUT == co_task->get_status());
+
+  CASE_EXPECT_NE(co_task, task_mgr->find_task(co_task->get_id()));
+  CASE_EXPECT_EQ(co_another_task, task_mgr->find_task(co_another_task->get_id()));
+
+  // remove task with timer
+  CASE_EXPECT_EQ(0, task_mgr->set_timeout(co_another_task->get_id(), 3600, 0));
+  CASE_EXPECT_EQ(1, (int)task_mgr->get_tick_checkpoint_size());
+  CASE_EXPECT_EQ(0, task_mgr->remove_task(co_another_task->get_id()));
+  CASE_EXPECT_EQ(0, (int)task_mgr->get_tick_checkpoint_size());
+  task_mgr->tick(7200);
+  CASE_EXPECT_EQ(cotask::EN_TS_CREATED, co_another_task->get_status());
+
+  // nanoseconds of timeout are carried into seconds: 7200s + 1.5s = 7201.5s
+  CASE_EXPECT_EQ(0, task_mgr->add_task(co_another_task, 0, 1500000000));
+  task_mgr->tick(7201, 400000000);
+  CASE_EXPECT_EQ(cotask::EN_TS_CREATED, co_another_task->get_status());
+  task_mgr->tick(7201, 600000000);
+  CASE_EXPECT_EQ(cotask::EN_TS_TIMEOUT, co_another_task->get_status());
+}
+
+CASE_TEST(coroutine_task_manager, timer_wheel_match_timer_set) {
+  typedef cotask::task_timer_set<uint64_t> set_type;
+  typedef cotask::task_timer_wheel<uint64_t> wheel_type;
+  set_type timer_set;
+  wheel_type timer_wheel;
+  std::vector<set_type::handle_type> set_handles;
+  std::vector<wheel_type::handle_type> wheel_handles;
+
+  const uint64_t task_count = 2048;
+  uint64_t seed = 20231018;
+  auto next_random = [&seed]() {
+    seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+    return seed >> 33;
+  };
+
+  // timeouts from 0.1ms to about 3 days
+  auto random_checkpoint = [&next_random](const cotask::detail::tickspec_t &now, uint64_t task_id) {
+    cotask::detail::task_timer_node<uint64_t> ret;
+    uint64_t timeout_nsec = (next_random() % 1000000000) * ((next_random() % 4 == 0) ? 262144 : 1) + 100000;
+    ret.task_id = task_id;
+    ret.expired_time.tv_sec = now.tv_sec + static_cast<time_t>(timeout_nsec / 1000000000);
+    ret.expired_time.tv_nsec = now.tv_nsec + static_cast<int>(timeout_nsec % 1000000000);
+    if (ret.expired_time.tv_nsec >= 1000000000) {
+      ++ret.expired_time.tv_sec;
+      ret.expired_time.tv_nsec -= 1000000000;
+    }
+    return ret;
+  };
+
+  cotask::detail::tickspec_t now;
+  now.tv_sec = 0;
+  now.tv_nsec = 0;
+  for (uint64_t i = 0; i < task_count; ++i) {
+    cotask::detail::task_timer_node<uint64_t> checkpoint = random_checkpoint(now, i);
+    set_handles.push_back(timer_set.insert(checkpoint));
+    wheel_handles.push_back(timer_wheel.insert(checkpoint));
+  }
+
+  // relative checkpoints plus the nanoseconds of first tick may be greater than a second, and must be carried
+  now.tv_sec = 1700000000;
+  now.tv_nsec = 987654321;
+  timer_set.rebase(now, [&set_handles](uint64_t task_id, set_type::handle_type handle) {
+    set_handles[static_cast<size_t>(task_id)] = handle;
+  });
+  timer_wheel.rebase(now, [](uint64_t, wheel_type::handle_type) {});
+  CASE_EXPECT_TRUE(timer_set.get_checkpoints() == timer_wheel.get_checkpoints());
+  bool all_normalized = true;
+  for (const cotask::detail::task_timer_node<uint64_t> &checkpoint : timer_wheel.get_checkpoints()) {
+    if (checkpoint.expired_time.tv_nsec < 0 || checkpoint.expired_time.tv_nsec >= 1000000000) {
+      all_normalized = false;
+    }
+  }
+  CASE_EXPECT_TRUE(all_normalized);
+
+  size_t expired_count = 0;
+  bool all_matched = true;
+  for (int round = 0; round < 4096 && !timer_set.empty(); ++round) {
+    // update some timers
+    for (int i = 0; i < 8; ++i) {
+      size_t task_id = static_cast<size_t>(next_random() % task_count);
+      if (set_handles[task_id] == timer_set.end()) {
+        continue;
+      }
+      timer_set.erase(set_handles[task_id]);
+      timer_wheel.erase(wheel_handles[task_id]);
+      if (next_random() % 8 == 0) {
+        set_handles[task_id] = timer_set.end();
+        wheel_handles[task_id] = timer_wheel.end();
+        continue;
+      }
+
+      cotask::detail::task_timer_node<uint64_t> checkpoint = random_checkpoint(now, task_id);
+      set_handles[task_id] = timer_set.insert(checkpoint);
+      wheel_handles[task_id] = timer_wheel.insert(checkpoint);
+    }
+
+    // tick with steps from 0.1ms to about 1 day
+    uint64_t step_nsec = (next_random() % 100000000) * ((next_random() % 16 == 0) ? 1024 : 1) + 100000;
+    now.tv_sec += static_cast<time_t>(step_nsec / 1000000000);
+    now.tv_nsec += static_cast<int>(step_nsec % 1000000000);
+    if (now.tv_nsec >= 1000000000) {
+      ++now.tv_sec;
+      now.tv_nsec -= 1000000000;
+    }
+
+    std::set<uint64_t> set_expired;
+    std::set<uint64_t> wheel_expired;
+    uint64_t task_id;
+    timer_set.advance(now);
+    while (timer_set.pop_expired(now, task_id)) {
+      set_expired.insert(task_id);
+      set_handles[static_cast<size_t>(task_id)] = timer_set.end();
+    }
+    timer_wheel.advance(now);
+    while (timer_wheel.pop_expired(now, task_id)) {
+      wheel_expired.insert(task_id);
+      wheel_handles[static_cast<size_t>(task_id)] = timer_wheel.end();
+    }
+
+    expired_count += set_expired.size();
+    if (set_expired != wheel_expired || timer_set.size() != timer_wheel.size()) {
+      all_matched = false;
+      break;
+    }
+  }
+
+  CASE_EXPECT_TRUE(all_matched);
+  CASE_EXPECT_TRUE(timer_set.get_checkpoints() == timer_wheel.get_checkpoints());
+  CASE_EXPECT_GT(expired_count, static_cast<size_t>(0));
+  CASE_MSG_INFO() << "Expired " << expired_count << " checkpoints, " << timer_wheel.size() << " remain" << std::endl;
+
+  timer_wheel.clear();
+  CASE_EXPECT_TRUE(timer_wheel.empty());
+  CASE_EXPECT_TRUE(timer_wheel.get_checkpoints().empty());
+}
+
+CASE_TEST(coroutine_task_manager, task_slot_map) {
+  typedef cotask::task_slot_map<cotask::task<>::id_type, int> slot_map_t;
+  slot_map_t slot_map;
+
+  std::vector<cotask::task<>::id_type> keys;
+  for (int i = 0; i < 8; ++i) {
+    std::pair<slot_map_t::iterator, bool> res = slot_map.emplace(0, i);
+    CASE_EXPECT_TRUE(res.second);
+    CASE_EXPECT_NE(0, res.first->first);
+    keys.push_back(res.first->first);
+  }
+  CASE_EXPECT_EQ(8, (int)slot_map.size());
+
+  for (int i = 0; i < 8; ++i) {
+    slot_map_t::iterator iter = slot_map.find(keys[static_cast<size_t>(i)]);
+    CASE_EXPECT_TRUE(iter != slot_map.end());
+    if (iter != slot_map.end()) {
+      CASE_EXPECT_EQ(i, iter->second);
+    }
+  }
+
+  // erase will move the last value, other keys are still valid
+  CASE_EXPECT_EQ(1, (int)slot_map.erase(keys[2]));
+  CASE_EXPECT_EQ(0, (int)slot_map.erase(keys[2]));
+  CASE_EXPECT_TRUE(slot_map.end() == slot_map.find(keys[2]));
+  CASE_EXPECT_EQ(7, (int)slot_map.size());
+  CASE_EXPECT_EQ(7, slot_map.find(keys[7])->second);
+
+  // the slot will be reused with a new generation, so the stale key is still rejected
+  std::pair<slot_map_t::iterator, bool> reuse = slot_map.emplace(0, 100);
+  CASE_EXPECT_TRUE(reuse.second);
+  CASE_EXPECT_NE(keys[2], reuse.first->first);
+  CASE_EXPECT_EQ(keys[2] & 0xffffffffULL, reuse.first->first & 0xffffffffULL);
+  CASE_EXPECT_TRUE(slot_map.end() == slot_map.find(keys[2]));
+  CASE_EXPECT_EQ(100, slot_map.find(reuse.first->first)->second);
+
+  int sum = 0;
+  for (slot_map_t::iterator iter = slot_map.begin(); iter != slot_map.end(); ++iter) {
+    sum += iter->second;
+  }
+  CASE_EXPECT_EQ(0 + 1 + 3 + 4 + 5 + 6 + 7 + 100, sum);
+
+  slot_map.clear();
+  CASE_EXPECT_TRUE(slot_map.empty());
+  CASE_EXPECT_TRUE(slot_map.end() == slot_map.find(keys[0]));
+}
+
+CASE_TEST(coroutine_task_manager, add_and_timeout_with_slot_map) {
+  typedef cotask::task<>::ptr_t task_ptr_type;
+  task_ptr_type co_task = cotask::task<>::create(test_context_task_manager_action());
+  task_ptr_type co_another_task = cotask::task<>::create(test_context_task_manager_action());
+
+  typedef cotask::task_manager<cotask::task<>, cotask::task_timer_set<cotask::task<>::id_type>,
+                               cotask::task_container_slot_map>
+      mgr_t;
+  mgr_t::ptr_t task_mgr = mgr_t::create();
+
+  g_test_coroutine_task_manager_status = 0;
+
+  mgr_t::id_type task_key = 0;
+  mgr_t::id_type another_task_key = 0;
+  CASE_EXPECT_EQ(0, task_mgr->add_task(co_task, 5, 0, &task_key));
+  CASE_EXPECT_EQ(0, task_mgr->add_task(co_another_task, 0, 0, &another_task_key));
+  CASE_EXPECT_NE(0, task_key);
+  CASE_EXPECT_NE(0, another_task_key);
+  CASE_EXPECT_NE(task_key, another_task_key);
+
+  CASE_EXPECT_EQ(2, (int)task_mgr->get_task_size());
+  CASE_EXPECT_EQ(1, (int)task_mgr->get_tick_checkpoint_size());
+  CASE_EXPECT_EQ(co_task, task_mgr->find_task(task_key));
+  CASE_EXPECT_EQ(co_another_task, task_mgr->find_task(another_task_key));
+
+  task_mgr->tick(3);
+  task_mgr->tick(9);
+  CASE_EXPECT_EQ(1, (int)task_mgr->get_task_size());
+  CASE_EXPECT_EQ(0, (int)task_mgr->get_tick_checkpoint_size());
+  CASE_EXPECT_TRUE(cotask::EN_TS_TIMEOUT == co_task->get_status());
+  CASE_EXPECT_TRUE(nullptr == task_mgr->find_task(task_key));
+
+  // start and resume by the key allocated by manager
+  g_test_coroutine_task_manager_status = 0;
+  CASE_EXPECT_EQ(0, task_mgr->start(another_task_key));
+  CASE_EXPECT_EQ(1, g_test_coroutine_task_manager_status);
+  CASE_EXPECT_EQ(0, task_mgr->resume(another_task_key));
+  CASE_EXPECT_EQ(2, g_test_coroutine_task_manager_status);
+  CASE_EXPECT_TRUE(co_another_task->is_completed());
+
+#  if defined(LIBCOTASK_MACRO_AUTO_CLEANUP_MANAGER) && LIBCOTASK_MACRO_AUTO_CLEANUP_MANAGER
+  // finished task is removed by manager key
+  CASE_EXPECT_EQ(0, (int)task_mgr->get_task_size());
+  CASE_EXPECT_EQ(copp::COPP_EC_NOT_FOUND, task_mgr->resume(another_task_key));
+#  endif
+}
+
+CASE_TEST(coroutine_task_manager, sharded_add_and_timeout) {
+  typedef cotask::task<>::ptr_t task_ptr_type;
+  typedef cotask::task_manager_sharded<cotask::task<>, 4> mgr_t;
+  mgr_t::ptr_type task_mgr = mgr_t::create();
+
+  std::vector<task_ptr_type> tasks;
+  for (int i = 0; i < 16; ++i) {
+    tasks.push_back(cotask::task<>::create(test_context_task_manager_action()));
+    // half of tasks will timeout at 3 + 5 = 8
+    CASE_EXPECT_EQ(0, task_mgr->add_task(tasks.back(), (i & 1) ? 5 : 0, 0));
+  }
+  CASE_EXPECT_EQ(copp::COPP_EC_ALREADY_EXIST, task_mgr->add_task(tasks[0]));
+
+  CASE_EXPECT_EQ(16, (int)task_mgr->get_task_size());
+  CASE_EXPECT_EQ(8, (int)task_mgr->get_tick_checkpoint_size());
+
+  // tasks are spread over shards
+  for (size_t i = 0; i < mgr_t::shard_count; ++i) {
+    CASE_EXPECT_LT(0, (int)task_mgr->get_shard(i).get_task_size());
+  }
+  for (size_t i = 0; i < tasks.size(); ++i) {
+    CASE_EXPECT_EQ(tasks[i], task_mgr->find_task(tasks[i]->get_id()));
+    CASE_EXPECT_EQ(tasks[i], task_mgr->get_shard(mgr_t::get_shard_index(tasks[i]->get_id())).find_task(
+                                 tasks[i]->get_id()));
+  }
+
+  task_mgr->tick(3);
+  CASE_EXPECT_EQ(3, (int)task_mgr->get_last_tick_time().tv_sec);
+  CASE_EXPECT_EQ(0, task_mgr->set_timeout(tasks[0]->get_id(), 100, 0));
+  CASE_EXPECT_EQ(9, (int)task_mgr->get_tick_checkpoint_size());
+
+  task_mgr->tick(9);
+  CASE_EXPECT_EQ(8, (int)task_mgr->get_task_size());
+  CASE_EXPECT_EQ(1, (int)task_mgr->get_tick_checkpoint_size());
+  for (size_t i = 0; i < tasks.size(); ++i) {
+    CASE_EXPECT_EQ(0 != (i & 1), cotask::EN_TS_TIMEOUT == tasks[i]->get_status());
+  }
+
+  CASE_EXPECT_EQ(0, task_mgr->kill(tasks[2]->get_id()));
+  CASE_EXPECT_EQ(cotask::EN_TS_KILLED, tasks[2]->get_status());
+  CASE_EXPECT_EQ(0, task_mgr->remove_task(tasks[4]->get_id()));
+  CASE_EXPECT_EQ(copp::COPP_EC_NOT_FOUND, task_mgr->remove_task(tasks[4]->get_id()));
+  CASE_EXPECT_EQ(6, (int)task_mgr->get_task_size());
+
+  task_mgr->reset();
+  CASE_EXPECT_EQ(0, (int)task_mgr->get_task_size());
+  CASE_EXPECT_EQ(0, (int)task_mgr->get_tick_checkpoint_size());
+  CASE_EXPECT_EQ(cotask::EN_TS_KILLED, tasks[0]->get_status());
+}
+
+CASE_TEST(coroutine_task_manager, batch_operations) {
+  typedef cotask::task<>::ptr_t task_ptr_type;
+  typedef cotask::task_manager<cotask::task<> > mgr_t;
+  mgr_t::ptr_t task_mgr = mgr_t::create();
+
+  std::vector<task_ptr_type> tasks;
+  for (int i = 0; i < 4; ++i) {
+    tasks.push_back(cotask::task<>::create(test_context_task_manager_action()));
+    CASE_EXPECT_EQ(0, task_mgr->add_task(tasks.back(), 10, 0));
+  }
+
+  g_test_coroutine_task_manager_status = 0;
+
+  // the last item is not found
+  std::vector<mgr_t::batch_item_type> items;
+  for (size_t i = 0; i < 3; ++i) {
+    items.push_back(mgr_t::batch_item_type(tasks[i]->get_id(), nullptr));
+  }
+  items.push_back(mgr_t::batch_item_type(0, nullptr));
+  std::vector<int> results;
+  results.resize(items.size(), 1);
+
+  CASE_EXPECT_EQ(3, (int)task_mgr->start_batch(items, results));
+  CASE_EXPECT_EQ(3, g_test_coroutine_task_manager_status);
+  CASE_EXPECT_EQ(0, results[0]);
+  CASE_EXPECT_EQ(0, results[1]);
+  CASE_EXPECT_EQ(0, results[2]);
+  CASE_EXPECT_EQ(copp::COPP_EC_NOT_FOUND, results[3]);
+
+  // finished tasks are removed
+  items.resize(2);
+  CASE_EXPECT_EQ(2, (int)task_mgr->resume_batch(items, results));
+  CASE_EXPECT_EQ(5, g_test_coroutine_task_manager_status);
+  CASE_EXPECT_TRUE(tasks[0]->is_completed());
+  CASE_EXPECT_TRUE(tasks[1]->is_completed());
+  CASE_EXPECT_EQ(2, (int)task_mgr->get_task_size());
+  CASE_EXPECT_EQ(2, (int)task_mgr->get_tick_checkpoint_size());
+
+  CASE_EXPECT_EQ(0, (int)task_mgr->resume_batch(items, results));
+  CASE_EXPECT_EQ(copp::COPP_EC_NOT_FOUND, results[0]);
+  CASE_EXPECT_EQ(copp::COPP_EC_NOT_FOUND, results[1]);
+
+  // results can be omitted
+  items.clear();
+  items.push_back(mgr_t::batch_item_type(tasks[2]->get_id(), nullptr));
+  items.push_back(mgr_t::batch_item_type(tasks[3]->get_id(), nullptr));
+  CASE_EXPECT_EQ(2, (int)task_mgr->kill_batch(items, cotask::EN_TS_TIMEOUT));
+  CASE_EXPECT_EQ(cotask::EN_TS_TIMEOUT, tasks[2]->get_status());
+  CASE_EXPECT_EQ(cotask::EN_TS_TIMEOUT, tasks[3]->get_status());
+  CASE_EXPECT_EQ(0, (int)task_mgr->get_task_size());
+  CASE_EXPECT_EQ(0, (int)task_mgr->get_tick_checkpoint_size());
+}
+
+CASE_TEST(coroutine_task_manager, sharded_batch_operations) {
+  typedef cotask::task<>::ptr_t task_ptr_type;
+  typedef cotask::task_manager_sharded<cotask::task<>, 4> mgr_t;
+  mgr_t::ptr_type task_mgr = mgr_t::create();
+
+  std::vector<task_ptr_type> tasks;
+  std::vector<mgr_t::batch_item_type> items;
+  for (int i = 0; i < 16; ++i) {
+    tasks.push_back(cotask::task<>::create(test_context_task_manager_action()));
+    CASE_EXPECT_EQ(0, task_mgr->add_task(tasks.back()));
+    items.push_back(mgr_t::batch_item_type(tasks.back()->get_id(), nullptr));
+  }
+  // not found items are kept in origin order
+  items.insert(items.begin() + 3, mgr_t::batch_item_type(0, nullptr));
+
+  g_test_coroutine_task_manager_status = 0;
+  std::vector<int> results;
+  results.resize(items.size(), 1);
+  CASE_EXPECT_EQ(16, (int)task_mgr->start_batch(items, results));
+  CASE_EXPECT_EQ(16, g_test_coroutine_task_manager_status);
+  for (size_t i = 0; i < results.size(); ++i) {
+    CASE_EXPECT_EQ(3 == i ? copp::COPP_EC_NOT_FOUND : 0, results[i]);
+  }
+
+  items.resize(8);
+  CASE_EXPECT_EQ(7, (int)task_mgr->resume_batch(items, results));
+  CASE_EXPECT_EQ(23, g_test_coroutine_task_manager_status);
+  CASE_EXPECT_EQ(9, (int)task_mgr->get_task_size());
+
+  items.clear();
+  for (size_t i = 7; i < tasks.size(); ++i) {
+    items.push_back(mgr_t::batch_item_type(tasks[i]->get_id(), nullptr));
+  }
+  CASE_EXPECT_EQ(9, (int)task_mgr->kill_batch(items, cotask::EN_TS_KILLED, results));
+  CASE_EXPECT_EQ(0, (int)task_mgr->get_task_size());
+  for (size_t i = 7; i < tasks.size(); ++i) {
+    CASE_EXPECT_EQ(cotask::EN_TS_KILLED, tasks[i]->get_status());
+  }
+}
+
+template <class TMGR>
+static void test_coroutine_task_manager_tick_with_max_expire() {
+  typedef cotask::task<>::ptr_t task_ptr_type;
+  typename TMGR::ptr_type task_mgr = TMGR::create();
+
+  std::vector<task_ptr_type> tasks;
+  for (int i = 0; i < 10; ++i) {
+    tasks.push_back(cotask::task<>::create(test_context_task_manager_action()));
+    CASE_EXPECT_EQ(0, task_mgr->add_task(tasks.back(), 5, 0));
+  }
+
+  // all tasks will timeout at 1 + 5 = 6
+  task_mgr->tick(1);
+
+  size_t pending = 0;
+  CASE_EXPECT_EQ(0, task_mgr->tick(7, 0, 3, &pending));
+  CASE_EXPECT_EQ(7, (int)pending);
+  CASE_EXPECT_TRUE(task_mgr->has_pending_expire());
+  CASE_EXPECT_EQ(7, (int)task_mgr->get_pending_expire_count());
+  CASE_EXPECT_EQ(7, (int)task_mgr->get_task_size());
+  CASE_EXPECT_EQ(7, (int)task_mgr->get_tick_checkpoint_size());
+  CASE_EXPECT_EQ(7, (int)task_mgr->get_last_tick_time().tv_sec);
+
+  // carried over tasks are removed even if time is not changed
+  CASE_EXPECT_EQ(0, task_mgr->tick(7, 0, 3, &pending));
+  CASE_EXPECT_EQ(4, (int)pending);
+  CASE_EXPECT_EQ(4, (int)task_mgr->get_task_size());
+
+  CASE_EXPECT_EQ(0, task_mgr->tick(7, 0, 0, &pending));
+  CASE_EXPECT_EQ(4, (int)pending);
+  CASE_EXPECT_EQ(4, (int)task_mgr->get_task_size());
+
+  int timeout_count = 0;
+  for (size_t i = 0; i < tasks.size(); ++i) {
+    if (cotask::EN_TS_TIMEOUT == tasks[i]->get_status()) {
+      ++timeout_count;
+    }
+  }
+  CASE_EXPECT_EQ(6, timeout_count);
+
+  // tick without budget removes all the rest
+  CASE_EXPECT_EQ(0, task_mgr->tick(8));
+  CASE_EXPECT_FALSE(task_mgr->has_pending_expire());
+  CASE_EXPECT_EQ(0, (int)task_mgr->get_pending_expire_count());
+  CASE_EXPECT_EQ(0, (int)task_mgr->get_task_size());
+  CASE_EXPECT_EQ(0, (int)task_mgr->get_tick_checkpoint_size());
+
+  CASE_EXPECT_EQ(0, task_mgr->tick(8, 0, 3, &pending));
+  CASE_EXPECT_EQ(0, (int)pending);
+}
+
+CASE_TEST(coroutine_task_manager, tick_with_max_expire) {
+  test_coroutine_task_manager_tick_with_max_expire<cotask::task_manager<cotask::task<> > >();
+  test_coroutine_task_manager_tick_with_max_expire<
+      cotask::task_manager<cotask::task<>, cotask::task_timer_wheel<cotask::task<>::id_type> > >();
+  test_coroutine_task_manager_tick_with_max_expire<cotask::task_manager_sharded<cotask::task<>, 4> >();
+}
+
+namespace {
+using test_coroutine_task_manager_sharded_type = cotask::task_manager_sharded<cotask::task<>, 2>;
+static test_coroutine_task_manager_sharded_type *g_test_coroutine_task_manager_sharded = nullptr;
+static std::vector<cotask::task<>::ptr_t> *g_test_coroutine_task_manager_added_tasks = nullptr;
+
+class test_context_task_manager_add_on_timeout_action : public cotask::impl::task_action_impl {
+ public:
+  int operator()(void *) {
+    cotask::this_task::get_task()->yield();
+
+    // add a new timeout task to the manager which is ticking
+    if (nullptr != g_test_coroutine_task_manager_sharded && nullptr != g_test_coroutine_task_manager_added_tasks &&
+        cotask::EN_TS_TIMEOUT == cotask::this_task::get_task()->get_status()) {
+      g_test_coroutine_task_manager_added_tasks->push_back(
+          cotask::task<>::create(test_context_task_manager_action()));
+      g_test_coroutine_task_manager_sharded->add_task(g_test_coroutine_task_manager_added_tasks->back(), 100, 0);
+    }
+    return 0;
+  }
+};
+}  // namespace
+
+CASE_TEST(coroutine_task_manager, sharded_tick_with_max_expire_add_on_timeout) {
+  test_coroutine_task_manager_sharded_type::ptr_type task_mgr = test_coroutine_task_manager_sharded_type::create();
+  std::vector<cotask::task<>::ptr_t> tasks;
+  std::vector<cotask::task<>::ptr_t> added_tasks;
+  added_tasks.reserve(16);
+  g_test_coroutine_task_manager_sharded = task_mgr.get();
+  g_test_coroutine_task_manager_added_tasks = &added_tasks;
+
+  for (int i = 0; i < 8; ++i) {
+    tasks.push_back(cotask::task<>::create(test_context_task_manager_add_on_timeout_action()));
+    CASE_EXPECT_EQ(0, task_mgr->add_task(tasks.back(), 5, 0));
+    CASE_EXPECT_EQ(0, task_mgr->start(tasks.back()->get_id()));
+  }
+  task_mgr->tick(1);
+
+  // every timeout task adds a checkpoint back, the budget must still be counted by removed tasks
+  size_t pending = 0;
+  size_t expired = 0;
+  CASE_EXPECT_EQ(0, task_mgr->tick(7, 0, 3, &pending, &expired));
+  CASE_EXPECT_EQ(5, (int)pending);
+  CASE_EXPECT_EQ(3, (int)expired);
+  CASE_EXPECT_EQ(3, (int)added_tasks.size());
+  CASE_EXPECT_EQ(8, (int)task_mgr->get_tick_checkpoint_size());
+
+  CASE_EXPECT_EQ(0, task_mgr->tick(7, 0, 5, &pending));
+  CASE_EXPECT_EQ(0, (int)pending);
+  CASE_EXPECT_EQ(8, (int)added_tasks.size());
+
+  g_test_coroutine_task_manager_sharded = nullptr;
+  g_test_coroutine_task_manager_added_tasks = nullptr;
+  task_mgr->reset();
+}
+
 CASE_TEST(coroutine_task_manager, kill) {
   typedef cotask::task<>::ptr_t task_ptr_type;
   task_ptr_type co_task = cotask::task<>::create(test_context_task_manager_action());
@@ -344,11 +899,14 @@ struct test_context_task_manager_action_mt_thread : public cotask::impl::task_ac
   }
 };
 
+template <class TMGR = cotask::task_manager<cotask::task<> > >
 struct test_context_task_manager_mt_thread_runner {
-  typedef cotask::task_manager<cotask::task<> > mgr_t;
+  typedef TMGR mgr_t;
   int run_count;
-  mgr_t::ptr_t task_mgr;
-  test_context_task_manager_mt_thread_runner(mgr_t::ptr_t mgr) : run_count(0), task_mgr(mgr) {}
+  typename mgr_t::ptr_type task_mgr;
+  time_t timeout_sec;
+  test_context_task_manager_mt_thread_runner(typename mgr_t::ptr_type mgr, time_t timeout = 0)
+      : run_count(0), task_mgr(mgr), timeout_sec(timeout) {}
 
   int operator()() {
     typedef cotask::task<>::ptr_t task_ptr_type;
@@ -356,7 +914,7 @@ struct test_context_task_manager_mt_thread_runner {
     task_ptr_type co_task =
         cotask::task<>::create(test_context_task_manager_action_mt_thread(), 16 * 1024);  // use 16KB for stack
     cotask::task<>::id_t task_id = co_task->get_id();
-    task_mgr->add_task(co_task);
+    task_mgr->add_task(co_task, timeout_sec, 0);
 
     task_mgr->start(task_id, &run_count);
 
@@ -377,12 +935,42 @@ CASE_TEST(coroutine_task_manager, create_and_run_mt) {
 
   std::unique_ptr<std::thread> thds[test_context_task_manager_action_mt_thread_num];
   for (int i = 0; i < test_context_task_manager_action_mt_thread_num; ++i) {
-    thds[i].reset(new std::thread(test_context_task_manager_mt_thread_runner(task_mgr)));
+    thds[i].reset(new std::thread(test_context_task_manager_mt_thread_runner<mgr_t>(task_mgr)));
+  }
+
+  for (int i = 0; i < test_context_task_manager_action_mt_thread_num; ++i) {
+    thds[i]->join();
+  }
+
+  CASE_EXPECT_EQ(test_context_task_manager_action_mt_run_times * test_context_task_manager_action_mt_thread_num,
+                 g_test_coroutine_task_manager_atomic.load());
+}
+
+CASE_TEST(coroutine_task_manager, sharded_create_and_run_mt) {
+  typedef cotask::task_manager_sharded<cotask::task<>, 8> mgr_t;
+  mgr_t::ptr_type task_mgr = mgr_t::create();
+
+  g_test_coroutine_task_manager_atomic.store(0);
+
+  // one thread keeps ticking while others add tasks with timeout, the timeout is far longer than ticked time
+  LIBCOPP_COPP_NAMESPACE_ID::util::lock::atomic_int_type<int> producers_done;
+  producers_done.store(0);
+  std::thread tick_thd([&task_mgr, &producers_done]() {
+    for (int i = 0; 0 == producers_done.load(); ++i) {
+      task_mgr->tick(1 + i / 1000, (i % 1000) * 1000000);
+    }
+  });
+
+  std::unique_ptr<std::thread> thds[test_context_task_manager_action_mt_thread_num];
+  for (int i = 0; i < test_context_task_manager_action_mt_thread_num; ++i) {
+    thds[i].reset(new std::thread(test_context_task_manager_mt_thread_runner<mgr_t>(task_mgr, 3600)));
   }
 
   for (int i = 0; i < test_context_task_manager_action_mt_thread_num; ++i) {
     thds[i]->join();
   }
+  producers_done.store(1);
+  tick_thd.join();
 
   CASE_EXPECT_EQ(test_context_task_manager_action_mt_run_times * test_context_task_manager_action_mt_thread_num,
                  g_test_coroutine_task_manager_atomic.load());
@@ -454,6 +1042,71 @@ CASE_TEST(coroutine_task_manager, exception_safe) {
   CASE_EXPECT_EQ(0, task_mgr1->get_tick_checkpoint_size());
   CASE_EXPECT_TRUE(co_task->is_completed());
 }
+
+CASE_TEST(coroutine_task_manager, sharded_tick_exception_safe) {
+  typedef cotask::task<>::ptr_t task_ptr_type;
+  typedef cotask::task_manager_sharded<cotask::task<>, 4> mgr_t;
+  mgr_t::ptr_type task_mgr = mgr_t::create();
+
+  // every shard has timeout tasks which throw when killed
+  std::vector<task_ptr_type> tasks;
+  for (int i = 0; i < 8; ++i) {
+    tasks.push_back(cotask::task<>::create(test_context_task_manager_action_with_exception()));
+    CASE_EXPECT_EQ(0, task_mgr->add_task(tasks.back(), 5, 0));
+    tasks.back()->start();
+  }
+  task_mgr->tick(3);
+
+  int check_status = g_test_coroutine_task_manager_status;
+  int catch_count = 0;
+  try {
+    task_mgr->tick(9);
+  } catch (const std::exception &e) {
+    ++catch_count;
+    CASE_MSG_INFO() << "Catch a exception: " << e.what() << std::endl;
+  }
+
+  // the rest shards are still ticked after the first exception
+  CASE_EXPECT_EQ(1, catch_count);
+  CASE_EXPECT_EQ(check_status + 8, g_test_coroutine_task_manager_status);
+  CASE_EXPECT_EQ(0, (int)task_mgr->get_task_size());
+  CASE_EXPECT_EQ(0, (int)task_mgr->get_tick_checkpoint_size());
+
+  tasks.clear();
+  for (int i = 0; i < 8; ++i) {
+    tasks.push_back(cotask::task<>::create(test_context_task_manager_action_with_exception()));
+    CASE_EXPECT_EQ(0, task_mgr->add_task(tasks.back(), 5, 0));
+    tasks.back()->start();
+  }
+
+  check_status = g_test_coroutine_task_manager_status;
+  catch_count = 0;
+  size_t pending = 1;
+  size_t expired = 0;
+  try {
+    task_mgr->tick(20, 0, 6, &pending, &expired);
+  } catch (const std::exception &e) {
+    ++catch_count;
+    CASE_MSG_INFO() << "Catch a exception: " << e.what() << std::endl;
+  }
+
+  CASE_EXPECT_EQ(1, catch_count);
+  CASE_EXPECT_EQ(check_status + 6, g_test_coroutine_task_manager_status);
+  CASE_EXPECT_EQ(6, (int)expired);
+  CASE_EXPECT_EQ(2, (int)pending);
+  CASE_EXPECT_EQ(2, (int)task_mgr->get_task_size());
+
+  // tasks carried over still throw when they are killed by the next tick
+  catch_count = 0;
+  try {
+    task_mgr->tick(20, 0, 6, &pending, &expired);
+  } catch (const std::exception &) {
+    ++catch_count;
+  }
+  CASE_EXPECT_EQ(1, catch_count);
+  CASE_EXPECT_EQ(0, (int)pending);
+  CASE_EXPECT_EQ(0, (int)task_mgr->get_task_size());
+}
 #  endif
 #else
 CASE_TEST(coroutine_task_manager, disabled) {}
@@ -7,6 +7,7 @@
 #include <cstdio>
 #include <cstring>
 #include <iostream>
+#include <list>
 #include <memory>
 #include <set>
 #include <vector>
@@ -552,6 +553,103 @@ CASE_TEST(coroutine_task, await_task) {
   }
 }
 
+CASE_TEST(coroutine_task, await_all_any) {
+  typedef cotask::task<>::ptr_t task_ptr_type;
+  std::vector<task_ptr_type> workers;
+  for (int i = 0; i < 5; ++i) {
+    workers.push_back(cotask::task<>::create([](void *) {
+      cotask::this_task::get_task()->yield();
+      return 0;
+    }));
+    CASE_EXPECT_TRUE(!!workers.back());
+  }
+
+  int wakeup_times = 0;
+  int await_all_res = -1;
+  int await_any_res = -1;
+  task_ptr_type waiter = cotask::task<>::create([&](void *) {
+    cotask::task<> *self = cotask::task<>::this_task();
+    await_all_res = self->await_all(copp::gsl::span<task_ptr_type>(workers.data(), 3));
+    ++wakeup_times;
+
+    await_any_res = self->await_any(copp::gsl::span<task_ptr_type>(workers.data() + 3, 2));
+    ++wakeup_times;
+
+    // already finished
+    CASE_EXPECT_EQ(0, self->await_all(copp::gsl::span<task_ptr_type>(workers.data(), 3)));
+    CASE_EXPECT_EQ(copp::COPP_EC_TASK_CAN_NOT_WAIT_SELF,
+                   self->await_any(copp::gsl::span<task_ptr_type>(&waiter, 1)));
+
+    self->yield();
+    ++wakeup_times;
+    return 0;
+  });
+  CASE_EXPECT_TRUE(!!waiter);
+
+  for (size_t i = 0; i < workers.size(); ++i) {
+    workers[i]->start();
+  }
+
+  waiter->start();
+  CASE_EXPECT_TRUE(waiter->is_awaiting());
+  CASE_EXPECT_EQ(0, wakeup_times);
+
+  // parked task can not be resumed by others
+  CASE_EXPECT_EQ(copp::COPP_EC_TASK_IS_AWAITING, waiter->resume());
+  CASE_EXPECT_EQ(0, wakeup_times);
+
+  // woken up only by the last one of await_all
+  workers[1]->resume();
+  CASE_EXPECT_EQ(0, wakeup_times);
+  workers[0]->resume();
+  CASE_EXPECT_EQ(0, wakeup_times);
+  workers[2]->resume();
+  CASE_EXPECT_EQ(1, wakeup_times);
+  CASE_EXPECT_EQ(0, await_all_res);
+  CASE_EXPECT_TRUE(waiter->is_awaiting());
+
+  // woken up by the first one of await_any, and the other one will not resume it
+  workers[4]->resume();
+  CASE_EXPECT_EQ(2, wakeup_times);
+  CASE_EXPECT_EQ(0, await_any_res);
+  CASE_EXPECT_FALSE(waiter->is_awaiting());
+  CASE_EXPECT_EQ(cotask::EN_TS_WAITING, waiter->get_status());
+
+  workers[3]->resume();
+  CASE_EXPECT_EQ(2, wakeup_times);
+  CASE_EXPECT_EQ(cotask::EN_TS_WAITING, waiter->get_status());
+
+  waiter->resume();
+  CASE_EXPECT_EQ(3, wakeup_times);
+  CASE_EXPECT_TRUE(waiter->is_completed());
+}
+
+CASE_TEST(coroutine_task, await_all_killed) {
+  typedef cotask::task<>::ptr_t task_ptr_type;
+  task_ptr_type worker = cotask::task<>::create([](void *) {
+    cotask::this_task::get_task()->yield();
+    return 0;
+  });
+  worker->start();
+
+  int await_res = 0;
+  task_ptr_type waiter = cotask::task<>::create([&worker, &await_res](void *) {
+    await_res = cotask::task<>::this_task()->await_all(copp::gsl::span<task_ptr_type>(&worker, 1));
+    return 0;
+  });
+  waiter->start();
+  CASE_EXPECT_TRUE(waiter->is_awaiting());
+
+  // the notification is removed from worker, so waiter is released after killed
+  waiter->kill();
+  CASE_EXPECT_EQ(copp::COPP_EC_TASK_IS_EXITING, await_res);
+  CASE_EXPECT_FALSE(waiter->is_awaiting());
+  CASE_EXPECT_EQ(1, static_cast<int>(waiter->use_count()));
+
+  worker->resume();
+  CASE_EXPECT_TRUE(worker->is_completed());
+}
+
 static int test_context_task_then_action_func(void *priv_data) {
   CASE_EXPECT_EQ(&g_test_coroutine_task_status, priv_data);
   ++g_test_coroutine_task_on_finished;
@@ -624,6 +722,106 @@ class task_action_of_issue18 {
   int operator()(void *) { return 0; }
 };
 
+CASE_TEST(coroutine_task, resume_batch) {
+  typedef cotask::task<>::ptr_t task_ptr_type;
+  std::vector<task_ptr_type> task_arr;
+  int switch_times = 0;
+  for (int i = 0; i < 4; ++i) {
+    // every task yields (i + 1) times
+    task_arr.push_back(cotask::task<>::create([i, &switch_times](void *) {
+      for (int j = 0; j <= i; ++j) {
+        ++switch_times;
+        cotask::this_task::get_task()->yield();
+      }
+      return i;
+    }));
+    CASE_EXPECT_TRUE(!!task_arr.back());
+  }
+  task_arr.push_back(task_ptr_type());
+
+  // killed task is skipped
+  task_arr.push_back(cotask::task<>::create([](void *) { return 0; }));
+  CASE_EXPECT_EQ(0, task_arr.back()->kill());
+
+  size_t resume_times = 0;
+  size_t batch_times = 0;
+  while (true) {
+    size_t resumed = cotask::task<>::resume_batch(copp::gsl::span<task_ptr_type>(task_arr.data(), task_arr.size()));
+    if (0 == resumed) {
+      break;
+    }
+    resume_times += resumed;
+    ++batch_times;
+  }
+
+  CASE_EXPECT_EQ(10, switch_times);
+  CASE_EXPECT_EQ(5, batch_times);
+  CASE_EXPECT_EQ(14, resume_times);
+  for (int i = 0; i < 4; ++i) {
+    CASE_EXPECT_TRUE(task_arr[static_cast<size_t>(i)]->is_completed());
+    CASE_EXPECT_EQ(cotask::EN_TS_DONE, task_arr[static_cast<size_t>(i)]->get_status());
+    CASE_EXPECT_EQ(i, task_arr[static_cast<size_t>(i)]->get_ret_code());
+  }
+  CASE_EXPECT_EQ(cotask::EN_TS_KILLED, task_arr.back()->get_status());
+}
+
+#  if defined(LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR) && LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR
+namespace {
+class test_coroutine_task_override_sink : public cotask::task<> {
+ public:
+  using cotask::task<>::cancel;
+  using cotask::task<>::kill;
+  using cotask::task<>::resume;
+  using cotask::task<>::start;
+
+  test_coroutine_task_override_sink() : cotask::task<>(0), start_times(0), cancel_times(0), kill_times(0) {}
+
+  int start(cotask::impl::task_exception_sink &unhandled, void *priv_data,
+            cotask::EN_TASK_STATUS expected_status) LIBCOPP_MACRO_NOEXCEPT override {
+    ++start_times;
+    return cotask::task<>::start(unhandled, priv_data, expected_status);
+  }
+
+  int cancel(cotask::impl::task_exception_sink &, void *) LIBCOPP_MACRO_NOEXCEPT override {
+    // there is no action to notify, just count it
+    ++cancel_times;
+    return 0;
+  }
+
+  int kill(cotask::impl::task_exception_sink &, cotask::EN_TASK_STATUS, void *) LIBCOPP_MACRO_NOEXCEPT override {
+    ++kill_times;
+    return 0;
+  }
+
+  int start_times;
+  int cancel_times;
+  int kill_times;
+};
+}  // namespace
+
+CASE_TEST(coroutine_task, override_exception_sink) {
+  test_coroutine_task_override_sink task_inst;
+  std::list<std::exception_ptr> unhandled;
+
+  // all other overloads dispatch to the overridden sink overloads
+  task_inst.start(nullptr);
+  task_inst.start(unhandled, nullptr);
+  task_inst.resume(nullptr);
+  task_inst.resume(unhandled, nullptr);
+  CASE_EXPECT_EQ(4, task_inst.start_times);
+
+  cotask::impl::task_impl &base = task_inst;
+  base.cancel(nullptr);
+  task_inst.cancel(unhandled, nullptr);
+  CASE_EXPECT_EQ(2, task_inst.cancel_times);
+
+  base.kill(cotask::EN_TS_KILLED, nullptr);
+  task_inst.kill(unhandled, cotask::EN_TS_KILLED, nullptr);
+  CASE_EXPECT_EQ(2, task_inst.kill_times);
+  CASE_EXPECT_TRUE(unhandled.empty());
+}
+#  endif
+
 CASE_TEST(coroutine_task, github_issues_18) {
   using simple_task_t = cotask::task<>;
 
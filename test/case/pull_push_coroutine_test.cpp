@@ -0,0 +1,273 @@
+// Copyright 2023 owent
+
+#include <libcopp/coroutine/pull_push_coroutine.h>
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "frame/test_macros.h"
+
+namespace {
+struct pull_push_coroutine_test_value {
+  static int alive;
+  int value;
+
+  explicit pull_push_coroutine_test_value(int v) : value(v) { ++alive; }
+  pull_push_coroutine_test_value(const pull_push_coroutine_test_value &other) : value(other.value) { ++alive; }
+  pull_push_coroutine_test_value(pull_push_coroutine_test_value &&other) : value(other.value) {
+    other.value = -1;
+    ++alive;
+  }
+  ~pull_push_coroutine_test_value() { --alive; }
+};
+
+int pull_push_coroutine_test_value::alive = 0;
+}  // namespace
+
+CASE_TEST(pull_push_coroutine, pull_range_for) {
+  bool finished = false;
+  {
+    copp::pull_coroutine<int> source(
+        [&finished](copp::push_coroutine<int> &sink) {
+          for (int i = 0; i < 5; ++i) {
+            sink(i * 2);
+          }
+          finished = true;
+        },
+        64 * 1024);
+    CASE_EXPECT_TRUE(!!source.get_coroutine());
+    CASE_EXPECT_TRUE(!!source);
+    CASE_EXPECT_EQ(0, source.get());
+
+    std::vector<int> values;
+    for (int &v : source) {
+      values.push_back(v);
+    }
+
+    CASE_EXPECT_EQ(5, static_cast<int>(values.size()));
+    for (size_t i = 0; i < values.size(); ++i) {
+      CASE_EXPECT_EQ(static_cast<int>(i * 2), values[i]);
+    }
+    CASE_EXPECT_TRUE(finished);
+    CASE_EXPECT_FALSE(!!source);
+    CASE_EXPECT_TRUE(source.begin() == source.end());
+  }
+}
+
+CASE_TEST(pull_push_coroutine, pull_destroy_before_finished) {
+  int quit_times = 0;
+  {
+    copp::pull_coroutine<pull_push_coroutine_test_value> source(
+        [&quit_times](copp::push_coroutine<pull_push_coroutine_test_value> &sink) {
+          int i = 0;
+          while (sink) {
+            // the value is constructed in the slot directly
+            sink(i++);
+          }
+          ++quit_times;
+        },
+        64 * 1024);
+
+    copp::pull_coroutine<pull_push_coroutine_test_value> moved(std::move(source));
+    CASE_EXPECT_FALSE(!!source);
+    CASE_EXPECT_FALSE(!!source.get_coroutine());
+
+    for (int i = 0; i < 3; ++i) {
+      CASE_EXPECT_TRUE(!!moved);
+      CASE_EXPECT_EQ(i, moved.get().value);
+      CASE_EXPECT_EQ(1, pull_push_coroutine_test_value::alive);
+      moved();
+    }
+    CASE_EXPECT_EQ(0, quit_times);
+  }
+
+  // the coroutine is resumed once and quits
+  CASE_EXPECT_EQ(1, quit_times);
+  CASE_EXPECT_EQ(0, pull_push_coroutine_test_value::alive);
+}
+
+CASE_TEST(pull_push_coroutine, destroy_before_unconditional_loop_finished) {
+  int push_times = 0;
+  {
+    copp::pull_coroutine<int> source(
+        [&push_times](copp::push_coroutine<int> &sink) {
+          // generator which never checks the sink
+          for (int i = 0;; ++i) {
+            ++push_times;
+            sink(i);
+          }
+        },
+        64 * 1024);
+
+    for (int i = 0; i < 3; ++i) {
+      CASE_EXPECT_TRUE(!!source);
+      CASE_EXPECT_EQ(i, source.get());
+      source();
+    }
+    CASE_EXPECT_EQ(4, push_times);
+  }
+
+  // resumed once, the next push unwinds the coroutine or switches back to the destructor
+  CASE_EXPECT_EQ(5, push_times);
+
+  int pull_times = 0;
+  {
+    copp::push_coroutine<int> sink(
+        [&pull_times](copp::pull_coroutine<int> &source) {
+          // consumer which never checks the source
+          for (;;) {
+            ++pull_times;
+            source();
+          }
+        },
+        64 * 1024);
+
+    sink(1)(2);
+    CASE_EXPECT_EQ(2, pull_times);
+  }
+
+  CASE_EXPECT_EQ(3, pull_times);
+}
+
+#if defined(LIBCOPP_MACRO_ENABLE_EXCEPTION) && LIBCOPP_MACRO_ENABLE_EXCEPTION
+CASE_TEST(pull_push_coroutine, close_unwind_stack) {
+  {
+    copp::pull_coroutine<int> source(
+        [](copp::push_coroutine<int> &sink) {
+          // destroyed only if the stack is unwound
+          pull_push_coroutine_test_value guard(0);
+          for (int i = 0;; ++i) {
+            sink(i);
+          }
+        },
+        64 * 1024);
+
+    CASE_EXPECT_EQ(0, source.get());
+    CASE_EXPECT_EQ(1, pull_push_coroutine_test_value::alive);
+  }
+  CASE_EXPECT_EQ(0, pull_push_coroutine_test_value::alive);
+
+  {
+    copp::push_coroutine<int> sink(
+        [](copp::pull_coroutine<int> &source) {
+          pull_push_coroutine_test_value guard(0);
+          for (;;) {
+            source();
+          }
+        },
+        64 * 1024);
+
+    sink(1);
+    CASE_EXPECT_EQ(1, pull_push_coroutine_test_value::alive);
+    sink.close();
+    CASE_EXPECT_FALSE(!!sink.get_coroutine());
+  }
+  CASE_EXPECT_EQ(0, pull_push_coroutine_test_value::alive);
+}
+
+#  if defined(LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR) && LIBCOPP_MACRO_ENABLE_STD_EXCEPTION_PTR
+CASE_TEST(pull_push_coroutine, close_rethrow_exception) {
+  copp::pull_coroutine<int> source(
+      [](copp::push_coroutine<int> &sink) {
+        sink(1);
+        pull_push_coroutine_test_value guard(0);
+        throw std::runtime_error("quit on close");
+      },
+      64 * 1024);
+  CASE_EXPECT_EQ(1, source.get());
+
+  bool caught = false;
+  try {
+    source.close();
+  } catch (const std::runtime_error &e) {
+    caught = true;
+    CASE_EXPECT_EQ(std::string("quit on close"), e.what());
+  }
+  CASE_EXPECT_TRUE(caught);
+  CASE_EXPECT_FALSE(!!source.get_coroutine());
+  CASE_EXPECT_EQ(0, pull_push_coroutine_test_value::alive);
+
+  // it's also reported by close(std::exception_ptr&)
+  copp::pull_coroutine<int> another(
+      [](copp::push_coroutine<int> &sink) {
+        sink(1);
+        throw std::runtime_error("quit on close");
+      },
+      64 * 1024);
+  std::exception_ptr eptr;
+  another.close(eptr);
+  CASE_EXPECT_TRUE(!!eptr);
+}
+#  endif
+#endif
+
+CASE_TEST(pull_push_coroutine, push_values) {
+  std::vector<std::string> received;
+  bool closed = false;
+  {
+    copp::push_coroutine<std::string> sink(
+        [&received, &closed](copp::pull_coroutine<std::string> &source) {
+          for (std::string &v : source) {
+            received.push_back(std::move(v));
+          }
+          closed = true;
+        },
+        64 * 1024);
+    CASE_EXPECT_TRUE(!!sink);
+    CASE_EXPECT_TRUE(received.empty());
+
+    std::string third = "third";
+    sink(std::string("first"))("second")(third);
+    CASE_EXPECT_EQ(3, static_cast<int>(received.size()));
+    CASE_EXPECT_EQ("third", third);
+    CASE_EXPECT_FALSE(closed);
+    CASE_EXPECT_TRUE(!!sink);
+  }
+
+  CASE_EXPECT_TRUE(closed);
+  if (received.size() == 3) {
+    CASE_EXPECT_EQ("first", received[0]);
+    CASE_EXPECT_EQ("second", received[1]);
+    CASE_EXPECT_EQ("third", received[2]);
+  }
+}
+
+CASE_TEST(pull_push_coroutine, push_finished) {
+  int sum = 0;
+  int called = 0;
+  {
+    copp::push_coroutine<pull_push_coroutine_test_value> sink(
+        [&sum](copp::pull_coroutine<pull_push_coroutine_test_value> &source) {
+          // only take two values
+          sum += source.get().value;
+          source();
+          if (source) {
+            sum += source.get().value;
+          }
+        },
+        64 * 1024);
+
+    for (int i = 1; i <= 5; ++i) {
+      if (!sink) {
+        break;
+      }
+      ++called;
+      sink(pull_push_coroutine_test_value(i));
+    }
+    CASE_EXPECT_FALSE(!!sink);
+    CASE_EXPECT_EQ(0, pull_push_coroutine_test_value::alive);
+  }
+
+  CASE_EXPECT_EQ(3, sum);
+  CASE_EXPECT_EQ(2, called);
+
+  // fn is never called if nothing is pushed
+  {
+    copp::push_coroutine<int> sink([&called](copp::pull_coroutine<int> &) { ++called; }, 64 * 1024);
+  }
+  CASE_EXPECT_EQ(2, called);
+}
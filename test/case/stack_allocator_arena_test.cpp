@@ -0,0 +1,204 @@
+// Copyright 2023 owent
+
+#include <libcopp/coroutine/coroutine_context_container.h>
+#include <libcopp/stack/stack_traits.h>
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include "frame/test_macros.h"
+
+#ifdef LIBCOPP_MACRO_SYS_POSIX
+
+typedef copp::coroutine_context_container<copp::allocator::stack_allocator_arena> stack_allocator_arena_test_type;
+
+static int stack_allocator_arena_test_runner(void *) {
+  int count = 3;
+  copp::coroutine_context *self = copp::this_coroutine::get_coroutine();
+  while (count-- > 0) {
+    self->yield();
+  }
+  return 0;
+}
+
+CASE_TEST(stack_allocator_arena_test, basic) {
+  const size_t stack_number = 67;  // not aligned to bitmap word
+  copp::allocator::stack_arena::ptr_type arena =
+      copp::allocator::stack_arena::create(copp::stack_traits::minimum_size(), stack_number, true);
+  CASE_EXPECT_TRUE(!!arena);
+  if (!arena) {
+    return;
+  }
+
+  CASE_EXPECT_TRUE(arena->has_guard_page());
+  CASE_EXPECT_EQ(stack_number, arena->get_stack_number());
+  CASE_EXPECT_EQ(copp::stack_traits::round_to_page_size(copp::stack_traits::minimum_size()), arena->get_stack_size());
+
+  std::vector<copp::stack_context> stack_arr;
+  stack_arr.resize(stack_number);
+  for (size_t i = 0; i < stack_number; ++i) {
+    arena->allocate(stack_arr[i], arena->get_stack_size());
+    CASE_EXPECT_NE(nullptr, stack_arr[i].sp);
+    CASE_EXPECT_TRUE(arena->contains(stack_arr[i]));
+    CASE_EXPECT_EQ(arena->get_stack_size() + copp::stack_traits::page_size(), stack_arr[i].size);
+    if (i > 0) {
+      CASE_EXPECT_NE(stack_arr[i - 1].sp, stack_arr[i].sp);
+    }
+
+    // the whole stack except guard page is writable
+    memset(static_cast<char *>(stack_arr[i].sp) - arena->get_stack_size(), 0, arena->get_stack_size());
+  }
+  CASE_EXPECT_EQ(stack_number, arena->get_used_stack_number());
+
+  // full
+  copp::stack_context full_ctx;
+  arena->allocate(full_ctx, arena->get_stack_size());
+  CASE_EXPECT_EQ(nullptr, full_ctx.sp);
+
+  // released slot will be reused
+  void *reuse_sp = stack_arr[stack_number / 2].sp;
+  arena->deallocate(stack_arr[stack_number / 2]);
+  CASE_EXPECT_EQ(stack_number - 1, arena->get_used_stack_number());
+  arena->allocate(stack_arr[stack_number / 2], 0);
+  CASE_EXPECT_EQ(reuse_sp, stack_arr[stack_number / 2].sp);
+
+  // too large
+  copp::stack_context large_ctx;
+  arena->deallocate(stack_arr[0]);
+  arena->allocate(large_ctx, arena->get_stack_size() + 1);
+  CASE_EXPECT_EQ(nullptr, large_ctx.sp);
+  arena->allocate(stack_arr[0], arena->get_stack_size());
+  CASE_EXPECT_NE(nullptr, stack_arr[0].sp);
+
+  for (size_t i = 0; i < stack_number; ++i) {
+    arena->deallocate(stack_arr[i]);
+  }
+  CASE_EXPECT_EQ(0, arena->get_used_stack_number());
+}
+
+CASE_TEST(stack_allocator_arena_test, coroutine_without_guard_page) {
+  const size_t stack_number = 128;
+  // guard page is disabled by default
+  copp::allocator::stack_arena::ptr_type arena =
+      copp::allocator::stack_arena::create(copp::stack_traits::minimum_size(), stack_number);
+  CASE_EXPECT_TRUE(!!arena);
+  if (!arena) {
+    return;
+  }
+  CASE_EXPECT_FALSE(arena->has_guard_page());
+
+  std::vector<stack_allocator_arena_test_type::ptr_t> co_arr;
+  for (size_t i = 0; i < stack_number; ++i) {
+    copp::allocator::stack_allocator_arena alloc(arena);
+    co_arr.push_back(
+        stack_allocator_arena_test_type::create(stack_allocator_arena_test_runner, alloc, arena->get_stack_size()));
+    CASE_EXPECT_TRUE(!!co_arr.back());
+  }
+  CASE_EXPECT_EQ(stack_number, arena->get_used_stack_number());
+
+  {
+    copp::allocator::stack_allocator_arena alloc(arena);
+    CASE_EXPECT_TRUE(
+        !stack_allocator_arena_test_type::create(stack_allocator_arena_test_runner, alloc, arena->get_stack_size()));
+  }
+
+  for (size_t i = 0; i < co_arr.size(); ++i) {
+    if (co_arr[i]) {
+      co_arr[i]->start();
+    }
+  }
+
+  bool continue_flag = true;
+  while (continue_flag) {
+    continue_flag = false;
+    for (size_t i = 0; i < co_arr.size(); ++i) {
+      if (co_arr[i] && 0 == co_arr[i]->resume()) {
+        continue_flag = true;
+      }
+    }
+  }
+
+  for (size_t i = 0; i < co_arr.size(); ++i) {
+    if (co_arr[i]) {
+      CASE_EXPECT_TRUE(co_arr[i]->is_finished());
+    }
+  }
+
+  // coroutines keep the arena alive
+  copp::allocator::stack_arena *arena_ptr = arena.get();
+  arena.reset();
+  CASE_EXPECT_EQ(stack_number, arena_ptr->get_used_stack_number());
+  co_arr.clear();
+}
+
+CASE_TEST(stack_allocator_arena_test, create_batch) {
+  const size_t stack_number = 100;  // more than one group of create_batch()
+  copp::allocator::stack_arena::ptr_type arena =
+      copp::allocator::stack_arena::create(copp::stack_traits::minimum_size(), stack_number);
+  CASE_EXPECT_TRUE(!!arena);
+  if (!arena) {
+    return;
+  }
+
+  // partial failure, out[stack_number, ...) are empty
+  std::vector<stack_allocator_arena_test_type::ptr_t> co_arr;
+  co_arr.resize(stack_number + 10);
+  std::vector<int> run_times;
+  run_times.resize(co_arr.size(), 0);
+  {
+    copp::allocator::stack_allocator_arena alloc(arena);
+    size_t created = stack_allocator_arena_test_type::create_batch(
+        co_arr,
+        [&run_times](size_t index) {
+          int *counter = &run_times[index];
+          return [counter](void *) {
+            ++(*counter);
+            return 0;
+          };
+        },
+        alloc, arena->get_stack_size(), sizeof(size_t));
+    CASE_EXPECT_EQ(stack_number, created);
+  }
+  CASE_EXPECT_EQ(stack_number, arena->get_used_stack_number());
+
+  for (size_t i = 0; i < co_arr.size(); ++i) {
+    if (i >= stack_number) {
+      CASE_EXPECT_TRUE(!co_arr[i]);
+      continue;
+    }
+
+    CASE_EXPECT_TRUE(!!co_arr[i]);
+    if (!co_arr[i]) {
+      continue;
+    }
+    CASE_EXPECT_GE(co_arr[i]->get_private_buffer_size(), sizeof(size_t));
+    CASE_EXPECT_EQ(0, co_arr[i]->start());
+    CASE_EXPECT_TRUE(co_arr[i]->is_finished());
+    CASE_EXPECT_EQ(1, run_times[i]);
+  }
+
+  co_arr.clear();
+  CASE_EXPECT_EQ(0, arena->get_used_stack_number());
+
+  // function runner, and stacks are given back when the stack size is too small
+  co_arr.resize(8);
+  {
+    copp::allocator::stack_allocator_arena alloc(arena);
+    CASE_EXPECT_EQ(8, stack_allocator_arena_test_type::create_batch(
+                          co_arr, [](size_t) { return &stack_allocator_arena_test_runner; }, alloc,
+                          arena->get_stack_size()));
+    CASE_EXPECT_EQ(8, arena->get_used_stack_number());
+    CASE_EXPECT_TRUE(!!co_arr[7]->get_runner());
+
+    std::vector<stack_allocator_arena_test_type::ptr_t> failed_arr;
+    failed_arr.resize(8);
+    CASE_EXPECT_EQ(0, stack_allocator_arena_test_type::create_batch(
+                          failed_arr, [](size_t) { return &stack_allocator_arena_test_runner; }, alloc,
+                          arena->get_stack_size(), arena->get_stack_size()));
+    CASE_EXPECT_EQ(8, arena->get_used_stack_number());
+  }
+}
+
+#endif
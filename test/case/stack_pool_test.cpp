@@ -1,13 +1,18 @@
 // Copyright 2023 owent
 
 #include <libcopp/stack/stack_pool.h>
+#include <libcopp/stack/stack_size_class_pool.h>
+#include <libcopp/stack/stack_size_policy.h>
 #include <libcotask/task.h>
 
 #include <cstdio>
 #include <cstring>
 #include <iostream>
+#include <memory>
+#include <thread>
 #include <vector>
 
+#include "frame/test_allocation_counter.h"
 #include "frame/test_macros.h"
 
 typedef copp::stack_pool<copp::allocator::stack_allocator_malloc> stack_pool_t;
@@ -199,4 +204,772 @@ CASE_TEST(stack_pool_test, full_size) {
   CASE_EXPECT_TRUE(!tp2);
 
   global_stack_pool.reset();
-}
\ No newline at end of file
+}
+namespace {
+struct stack_pool_test_counter_t {
+  size_t allocate_times;
+  size_t deallocate_times;
+};
+static stack_pool_test_counter_t g_stack_pool_test_counter = {0, 0};
+
+class stack_pool_test_counting_allocator {
+ public:
+  void allocate(copp::stack_context &ctx, std::size_t size) {
+    ++g_stack_pool_test_counter.allocate_times;
+    alloc_.allocate(ctx, size);
+  }
+
+  void deallocate(copp::stack_context &ctx) {
+    ++g_stack_pool_test_counter.deallocate_times;
+    alloc_.deallocate(ctx);
+  }
+
+ private:
+  copp::allocator::stack_allocator_malloc alloc_;
+};
+}  // namespace
+
+CASE_TEST(stack_pool_test, gc_after_update_stack_size) {
+  using counting_pool_t = copp::stack_pool<stack_pool_test_counting_allocator>;
+  counting_pool_t::ptr_t pool = counting_pool_t::create();
+  pool->set_auto_gc(false);
+  pool->set_stack_size(256 * 1024);
+  memset(&g_stack_pool_test_counter, 0, sizeof(g_stack_pool_test_counter));
+
+  const size_t stack_arr_sz = 8;
+  std::vector<copp::stack_context> stack_arr;
+  stack_arr.resize(stack_arr_sz);
+  for (size_t i = 0; i < stack_arr_sz; ++i) {
+    pool->allocate(stack_arr[i]);
+    CASE_EXPECT_NE(nullptr, stack_arr[i].sp);
+  }
+  for (size_t i = 0; i < stack_arr_sz; ++i) {
+    pool->deallocate(stack_arr[i]);
+  }
+  size_t old_stack_size = pool->get_stack_size() + pool->get_stack_size_offset();
+
+  // stacks of the old size are still in free list, gc should count them by their real size
+  pool->update_stack_size(64 * 1024);
+  CASE_EXPECT_EQ(stack_arr_sz, pool->get_limit().free_stack_number);
+  CASE_EXPECT_EQ(stack_arr_sz / 2, pool->gc());
+  CASE_EXPECT_EQ(stack_arr_sz / 2, g_stack_pool_test_counter.deallocate_times);
+  CASE_EXPECT_EQ(stack_arr_sz / 2, pool->get_limit().free_stack_number);
+  CASE_EXPECT_EQ(stack_arr_sz / 2 * old_stack_size, pool->get_limit().free_stack_size);
+
+  // bigger cached stacks can still be reused
+  copp::stack_context ctx;
+  pool->allocate(ctx);
+  CASE_EXPECT_EQ(old_stack_size, ctx.size);
+  CASE_EXPECT_EQ(stack_arr_sz, g_stack_pool_test_counter.allocate_times);
+  pool->deallocate(ctx);
+}
+
+#ifdef LIBCOPP_MACRO_SYS_POSIX
+static void stack_pool_test_grow_one_page(size_t magazine_number) {
+  using posix_pool_t = copp::stack_pool<copp::allocator::stack_allocator_posix>;
+  posix_pool_t::ptr_t pool = posix_pool_t::create();
+  pool->set_auto_gc(false);
+  pool->set_magazine_number(magazine_number);
+  pool->set_stack_size(64 * 1024);
+
+  copp::stack_context ctx;
+  pool->allocate(ctx);
+  CASE_EXPECT_NE(nullptr, ctx.sp);
+  // the guard page is counted in ctx.size
+  CASE_EXPECT_EQ(pool->get_stack_size() + pool->get_stack_size_offset(), ctx.size);
+  CASE_EXPECT_LT(0, pool->get_stack_size_offset());
+  pool->deallocate(ctx);
+  CASE_EXPECT_EQ(1, pool->get_limit().free_stack_number);
+
+  // the cached stack is as big as the new stack size, but its usable size is one guard page smaller
+  size_t new_stack_size = pool->update_stack_size(64 * 1024 + copp::stack_traits::page_size());
+  pool->allocate(ctx);
+  CASE_EXPECT_NE(nullptr, ctx.sp);
+  CASE_EXPECT_GE(ctx.size - pool->get_stack_size_offset(), new_stack_size);
+  pool->deallocate(ctx);
+}
+
+CASE_TEST(stack_pool_test, update_stack_size_grow_one_page) {
+  stack_pool_test_grow_one_page(0);
+  stack_pool_test_grow_one_page(2);
+}
+#endif
+
+CASE_TEST(stack_pool_test, no_allocation_in_steady_state) {
+  using counting_pool_t = copp::stack_pool<stack_pool_test_counting_allocator>;
+  counting_pool_t::ptr_t pool = counting_pool_t::create();
+  pool->set_auto_gc(false);
+  memset(&g_stack_pool_test_counter, 0, sizeof(g_stack_pool_test_counter));
+
+  const size_t stack_arr_sz = 64;
+  std::vector<copp::stack_context> stack_arr;
+  stack_arr.resize(stack_arr_sz);
+
+  // warm up
+  for (size_t i = 0; i < stack_arr_sz; ++i) {
+    pool->allocate(stack_arr[i]);
+    CASE_EXPECT_NE(nullptr, stack_arr[i].sp);
+  }
+  for (size_t i = 0; i < stack_arr_sz; ++i) {
+    pool->deallocate(stack_arr[i]);
+  }
+  CASE_EXPECT_EQ(stack_arr_sz, g_stack_pool_test_counter.allocate_times);
+  CASE_EXPECT_EQ(0, g_stack_pool_test_counter.deallocate_times);
+  CASE_EXPECT_EQ(stack_arr_sz, pool->get_limit().free_stack_number);
+
+  // steady state, all stacks come from the free list and the free list nodes are stored in the cached stacks
+  size_t heap_allocation_times = 0;
+  for (int round = 0; round < 16; ++round) {
+    size_t null_stack_number = 0;
+    {
+      test_allocation_counter_guard guard(heap_allocation_times);
+      for (size_t i = 0; i < stack_arr_sz; ++i) {
+        pool->allocate(stack_arr[i]);
+        if (nullptr == stack_arr[i].sp) {
+          ++null_stack_number;
+        }
+      }
+      for (size_t i = 0; i < stack_arr_sz; ++i) {
+        pool->deallocate(stack_arr[i]);
+      }
+    }
+    CASE_EXPECT_EQ(0, null_stack_number);
+    CASE_EXPECT_EQ(0, heap_allocation_times);
+    CASE_EXPECT_EQ(stack_arr_sz, pool->get_limit().free_stack_number);
+    CASE_EXPECT_EQ(0, pool->get_limit().used_stack_number);
+  }
+  CASE_EXPECT_EQ(stack_arr_sz, g_stack_pool_test_counter.allocate_times);
+  CASE_EXPECT_EQ(0, g_stack_pool_test_counter.deallocate_times);
+
+  // FILO, the last recycled stack should be reused first
+  void *last_sp = stack_arr[stack_arr_sz - 1].sp;
+  copp::stack_context reuse_ctx;
+  pool->allocate(reuse_ctx);
+  CASE_EXPECT_EQ(last_sp, reuse_ctx.sp);
+  pool->deallocate(reuse_ctx);
+
+  // gc release the oldest stacks
+  pool->gc();
+  CASE_EXPECT_EQ(stack_arr_sz / 2, pool->get_limit().free_stack_number);
+  CASE_EXPECT_EQ(stack_arr_sz / 2, g_stack_pool_test_counter.deallocate_times);
+  pool->allocate(reuse_ctx);
+  CASE_EXPECT_EQ(last_sp, reuse_ctx.sp);
+  pool->deallocate(reuse_ctx);
+
+  pool->clear();
+  CASE_EXPECT_EQ(0, pool->get_limit().free_stack_number);
+  CASE_EXPECT_EQ(stack_arr_sz, g_stack_pool_test_counter.deallocate_times);
+  pool.reset();
+  CASE_EXPECT_EQ(stack_arr_sz, g_stack_pool_test_counter.deallocate_times);
+}
+
+CASE_TEST(stack_pool_test, magazine) {
+  using counting_pool_t = copp::stack_pool<stack_pool_test_counting_allocator>;
+  counting_pool_t::ptr_t pool = counting_pool_t::create();
+  pool->set_auto_gc(false);
+  pool->set_magazine_number(1);
+  pool->set_magazine_size(8);
+  memset(&g_stack_pool_test_counter, 0, sizeof(g_stack_pool_test_counter));
+
+  const size_t stack_arr_sz = 32;
+  std::vector<copp::stack_context> stack_arr;
+  stack_arr.resize(stack_arr_sz);
+
+  for (size_t i = 0; i < stack_arr_sz; ++i) {
+    pool->allocate(stack_arr[i]);
+    CASE_EXPECT_NE(nullptr, stack_arr[i].sp);
+  }
+  CASE_EXPECT_EQ(stack_arr_sz, pool->get_limit().used_stack_number);
+
+  // magazine keep at most 8 stacks, and flush 4 of them to the shared free list once
+  for (size_t i = 0; i < stack_arr_sz; ++i) {
+    pool->deallocate(stack_arr[i]);
+    CASE_EXPECT_EQ(stack_arr_sz - i - 1, pool->get_limit().used_stack_number);
+    CASE_EXPECT_EQ(i + 1, pool->get_limit().free_stack_number);
+  }
+  CASE_EXPECT_EQ(stack_arr_sz * (pool->get_stack_size() + pool->get_stack_size_offset()),
+                 pool->get_limit().free_stack_size);
+  CASE_EXPECT_EQ(0, pool->get_limit().used_stack_size);
+
+  // the last recycled stack is still in magazine and will be reused first
+  void *last_sp = stack_arr[stack_arr_sz - 1].sp;
+  copp::stack_context reuse_ctx;
+  pool->allocate(reuse_ctx);
+  CASE_EXPECT_EQ(last_sp, reuse_ctx.sp);
+  CASE_EXPECT_EQ(1, pool->get_limit().used_stack_number);
+  CASE_EXPECT_EQ(stack_arr_sz - 1, pool->get_limit().free_stack_number);
+  pool->deallocate(reuse_ctx);
+
+  // refill from shared free list without any allocation
+  for (size_t i = 0; i < stack_arr_sz; ++i) {
+    pool->allocate(stack_arr[i]);
+    CASE_EXPECT_NE(nullptr, stack_arr[i].sp);
+  }
+  CASE_EXPECT_EQ(stack_arr_sz, g_stack_pool_test_counter.allocate_times);
+  CASE_EXPECT_EQ(0, pool->get_limit().free_stack_number);
+  for (size_t i = 0; i < stack_arr_sz; ++i) {
+    pool->deallocate(stack_arr[i]);
+  }
+
+  pool->clear();
+  CASE_EXPECT_EQ(0, pool->get_limit().free_stack_number);
+  CASE_EXPECT_EQ(stack_arr_sz, g_stack_pool_test_counter.deallocate_times);
+}
+
+CASE_TEST(stack_pool_test, magazine_multi_thread) {
+  global_stack_pool = stack_pool_t::create();
+  global_stack_pool->set_magazine_number(4);
+  global_stack_pool->set_magazine_size(16);
+
+  std::unique_ptr<std::thread> thds[4];
+  for (int i = 0; i < 4; ++i) {
+    thds[i].reset(new std::thread([]() {
+      std::vector<stack_pool_test_task_t::ptr_t> task_arr;
+      for (int round = 0; round < 64; ++round) {
+        for (int j = 0; j < 32; ++j) {
+          copp::allocator::stack_allocator_pool<stack_pool_t> alloc(global_stack_pool);
+          stack_pool_test_task_t::ptr_t tp = stack_pool_test_task_t::create(stack_pool_test_task_action, alloc);
+          CASE_EXPECT_TRUE(!!tp);
+          task_arr.push_back(tp);
+        }
+        task_arr.clear();
+      }
+    }));
+  }
+
+  for (int i = 0; i < 4; ++i) {
+    thds[i]->join();
+  }
+
+  CASE_EXPECT_EQ(0, global_stack_pool->get_limit().used_stack_number);
+  CASE_EXPECT_EQ(0, global_stack_pool->get_limit().used_stack_size);
+  CASE_EXPECT_GT(global_stack_pool->get_limit().free_stack_number, 0);
+
+  global_stack_pool.reset();
+}
+
+typedef copp::stack_size_class_pool<copp::allocator::default_statck_allocator> stack_size_class_pool_t;
+struct stack_size_class_pool_test_macro_coroutine {
+  using stack_allocator_type = copp::allocator::stack_allocator_pool<stack_size_class_pool_t>;
+  using coroutine_type = copp::coroutine_context_container<stack_allocator_type>;
+  using value_type = int;
+};
+typedef cotask::task<stack_size_class_pool_test_macro_coroutine> stack_size_class_pool_test_task_t;
+
+CASE_TEST(stack_pool_test, size_class) {
+  // stack size can not be less than stack_traits::minimum_size()
+  const size_t base = copp::stack_traits::round_to_page_size(copp::stack_traits::minimum_size() + 1);
+  stack_size_class_pool_t::ptr_type pool = stack_size_class_pool_t::create();
+  pool->set_size_classes({16 * base, base, 4 * base, base});
+  CASE_EXPECT_EQ(3, pool->get_size_class_number());
+  CASE_EXPECT_EQ(base, pool->get_size_class(0)->get_stack_size());
+  CASE_EXPECT_EQ(4 * base, pool->get_size_class(1)->get_stack_size());
+  CASE_EXPECT_EQ(16 * base, pool->get_size_class(2)->get_stack_size());
+
+  CASE_EXPECT_EQ(0, pool->find_size_class(1));
+  CASE_EXPECT_EQ(0, pool->find_size_class(base));
+  CASE_EXPECT_EQ(1, pool->find_size_class(base + 1));
+  CASE_EXPECT_EQ(2, pool->find_size_class(16 * base));
+  CASE_EXPECT_EQ(3, pool->find_size_class(16 * base + 1));
+
+  // per-class limits
+  pool->get_size_class(0)->set_max_stack_number(4);
+  pool->get_size_class(0)->set_auto_gc(false);
+  pool->get_size_class(1)->set_auto_gc(false);
+
+  std::vector<stack_size_class_pool_test_task_t::ptr_t> task_arr;
+  for (int i = 0; i < 4; ++i) {
+    copp::allocator::stack_allocator_pool<stack_size_class_pool_t> alloc(pool);
+    stack_size_class_pool_test_task_t::ptr_t tp =
+        stack_size_class_pool_test_task_t::create(stack_pool_test_task_action, alloc, base - 64);
+    CASE_EXPECT_TRUE(!!tp);
+    task_arr.push_back(tp);
+
+    tp = stack_size_class_pool_test_task_t::create(stack_pool_test_task_action, alloc, 3 * base);
+    CASE_EXPECT_TRUE(!!tp);
+    task_arr.push_back(tp);
+  }
+
+  {
+    copp::allocator::stack_allocator_pool<stack_size_class_pool_t> alloc(pool);
+    stack_size_class_pool_test_task_t::ptr_t tp =
+        stack_size_class_pool_test_task_t::create(stack_pool_test_task_action, alloc, base);
+    CASE_EXPECT_TRUE(!tp);
+
+    // too large for all size classes, use origin allocator
+    tp = stack_size_class_pool_test_task_t::create(stack_pool_test_task_action, alloc, 32 * base);
+    CASE_EXPECT_TRUE(!!tp);
+    CASE_EXPECT_EQ(0, tp->start());
+  }
+
+  CASE_EXPECT_EQ(4, pool->get_size_class(0)->get_limit().used_stack_number);
+  CASE_EXPECT_EQ(4, pool->get_size_class(1)->get_limit().used_stack_number);
+  CASE_EXPECT_EQ(0, pool->get_size_class(2)->get_limit().used_stack_number);
+  CASE_EXPECT_EQ(8, pool->get_limit().used_stack_number);
+
+  task_arr.clear();
+  CASE_EXPECT_EQ(0, pool->get_limit().used_stack_number);
+  CASE_EXPECT_EQ(4, pool->get_size_class(0)->get_limit().free_stack_number);
+  CASE_EXPECT_EQ(4, pool->get_size_class(1)->get_limit().free_stack_number);
+
+  // reuse cached stacks in the same size class
+  {
+    copp::allocator::stack_allocator_pool<stack_size_class_pool_t> alloc(pool);
+    stack_size_class_pool_test_task_t::ptr_t tp =
+        stack_size_class_pool_test_task_t::create(stack_pool_test_task_action, alloc, 2 * base);
+    CASE_EXPECT_TRUE(!!tp);
+    CASE_EXPECT_EQ(3, pool->get_size_class(1)->get_limit().free_stack_number);
+    CASE_EXPECT_EQ(4, pool->get_size_class(0)->get_limit().free_stack_number);
+    CASE_EXPECT_EQ(0, tp->start());
+  }
+  CASE_EXPECT_EQ(8, pool->get_limit().free_stack_number);
+
+  // per-class gc
+  pool->get_size_class(0)->gc();
+  CASE_EXPECT_EQ(2, pool->get_size_class(0)->get_limit().free_stack_number);
+  CASE_EXPECT_EQ(4, pool->get_size_class(1)->get_limit().free_stack_number);
+
+  pool->clear();
+  CASE_EXPECT_EQ(0, pool->get_limit().free_stack_number);
+}
+
+CASE_TEST(stack_pool_test, size_class_power_of_two) {
+  const size_t base = copp::stack_traits::round_to_page_size(copp::stack_traits::minimum_size() + 1);
+  stack_size_class_pool_t::ptr_type pool = stack_size_class_pool_t::create();
+  pool->set_power_of_two_size_classes(base, 16 * base);
+  CASE_EXPECT_EQ(5, pool->get_size_class_number());
+  CASE_EXPECT_EQ(base, pool->get_size_class(0)->get_stack_size());
+  CASE_EXPECT_EQ(16 * base, pool->get_size_class(4)->get_stack_size());
+
+  pool->get_size_class(3)->set_auto_gc(false);
+
+  copp::stack_context ctx;
+  pool->allocate(ctx, 6 * base);
+  CASE_EXPECT_NE(nullptr, ctx.sp);
+  CASE_EXPECT_EQ(1, pool->get_size_class(3)->get_limit().used_stack_number);
+  pool->deallocate(ctx);
+  CASE_EXPECT_EQ(0, pool->get_size_class(3)->get_limit().used_stack_number);
+  CASE_EXPECT_EQ(1, pool->get_size_class(3)->get_limit().free_stack_number);
+}
+
+CASE_TEST(stack_pool_test, size_class_guard_offset) {
+  const size_t base = copp::stack_traits::round_to_page_size(copp::stack_traits::minimum_size() + 1);
+  size_t offset;
+  {
+    copp::stack_context ctx;
+    copp::allocator::default_statck_allocator alloc;
+    alloc.allocate(ctx, base);
+    CASE_EXPECT_NE(nullptr, ctx.sp);
+    offset = ctx.size - base;
+    alloc.deallocate(ctx);
+  }
+  if (0 == offset) {
+    CASE_MSG_INFO() << "default stack allocator has no guard page, skip this test" << std::endl;
+    return;
+  }
+
+  // real size of stacks in the first size class is equal to the second size class
+  stack_size_class_pool_t::ptr_type pool = stack_size_class_pool_t::create();
+  pool->set_size_classes({base, base + offset});
+  CASE_EXPECT_EQ(2, pool->get_size_class_number());
+  pool->get_size_class(0)->set_auto_gc(false);
+  pool->get_size_class(1)->set_auto_gc(false);
+
+  copp::stack_context ctx_small;
+  copp::stack_context ctx_big;
+  pool->allocate(ctx_small, base);
+  pool->allocate(ctx_big, base + offset);
+  CASE_EXPECT_EQ(base + offset, ctx_small.size);
+  CASE_EXPECT_EQ(base + offset + offset, ctx_big.size);
+  CASE_EXPECT_EQ(1, pool->get_size_class(0)->get_limit().used_stack_number);
+  CASE_EXPECT_EQ(1, pool->get_size_class(1)->get_limit().used_stack_number);
+
+  pool->deallocate(ctx_small);
+  pool->deallocate(ctx_big);
+  CASE_EXPECT_EQ(0, pool->get_size_class(0)->get_limit().used_stack_number);
+  CASE_EXPECT_EQ(1, pool->get_size_class(0)->get_limit().free_stack_number);
+  CASE_EXPECT_EQ(0, pool->get_size_class(1)->get_limit().used_stack_number);
+  CASE_EXPECT_EQ(1, pool->get_size_class(1)->get_limit().free_stack_number);
+
+  pool->clear();
+}
+
+#ifdef LIBCOPP_MACRO_SYS_POSIX
+namespace {
+struct stack_pool_test_trim_counter_t {
+  size_t allocate_times;
+  size_t deallocate_times;
+  size_t trim_times;
+};
+static stack_pool_test_trim_counter_t g_stack_pool_test_trim_counter = {0, 0, 0};
+
+class stack_pool_test_trim_allocator {
+ public:
+  void allocate(copp::stack_context &ctx, std::size_t size) {
+    ++g_stack_pool_test_trim_counter.allocate_times;
+    alloc_.allocate(ctx, size);
+  }
+
+  void deallocate(copp::stack_context &ctx) {
+    ++g_stack_pool_test_trim_counter.deallocate_times;
+    alloc_.deallocate(ctx);
+  }
+
+  void trim(copp::stack_context &ctx, std::size_t keep_size) {
+    ++g_stack_pool_test_trim_counter.trim_times;
+    alloc_.trim(ctx, keep_size);
+  }
+
+ private:
+  copp::allocator::stack_allocator_posix alloc_;
+};
+}  // namespace
+
+CASE_TEST(stack_pool_test, gc_trim) {
+  using trim_pool_t = copp::stack_pool<stack_pool_test_trim_allocator>;
+  trim_pool_t::ptr_t pool = trim_pool_t::create();
+  pool->set_auto_gc(false);
+  pool->set_gc_trim(true);
+  pool->set_gc_trim_keep_size(copp::stack_traits::page_size());
+  memset(&g_stack_pool_test_trim_counter, 0, sizeof(g_stack_pool_test_trim_counter));
+
+  const size_t stack_arr_sz = 16;
+  std::vector<copp::stack_context> stack_arr;
+  stack_arr.resize(stack_arr_sz);
+
+  for (size_t i = 0; i < stack_arr_sz; ++i) {
+    pool->allocate(stack_arr[i]);
+    CASE_EXPECT_NE(nullptr, stack_arr[i].sp);
+    // touch the whole stack
+    memset(static_cast<char *>(stack_arr[i].sp) - pool->get_stack_size(), 0x5a, pool->get_stack_size());
+  }
+  for (size_t i = 0; i < stack_arr_sz; ++i) {
+    pool->deallocate(stack_arr[i]);
+  }
+
+  // gc trim the oldest stacks, but keep them in pool
+  CASE_EXPECT_EQ(stack_arr_sz / 2, pool->gc());
+  CASE_EXPECT_EQ(0, g_stack_pool_test_trim_counter.deallocate_times);
+  CASE_EXPECT_EQ(stack_arr_sz / 2, g_stack_pool_test_trim_counter.trim_times);
+  CASE_EXPECT_EQ(stack_arr_sz, pool->get_limit().free_stack_number);
+  CASE_EXPECT_EQ(stack_arr_sz / 2, pool->get_limit().trimmed_stack_number);
+  CASE_EXPECT_EQ(stack_arr_sz / 2 * (pool->get_stack_size() + pool->get_stack_size_offset()),
+                 pool->get_limit().trimmed_stack_size);
+
+  // trimmed stacks are not trimmed again
+  CASE_EXPECT_EQ(stack_arr_sz / 4, pool->gc());
+  CASE_EXPECT_EQ(stack_arr_sz / 2 + stack_arr_sz / 4, g_stack_pool_test_trim_counter.trim_times);
+  CASE_EXPECT_EQ(stack_arr_sz / 2 + stack_arr_sz / 4, pool->get_limit().trimmed_stack_number);
+
+  // untrimmed stacks are used first, and then trimmed stacks are reused without allocating from system
+  for (size_t i = 0; i < stack_arr_sz; ++i) {
+    pool->allocate(stack_arr[i]);
+    CASE_EXPECT_NE(nullptr, stack_arr[i].sp);
+    if (i < stack_arr_sz / 4) {
+      CASE_EXPECT_EQ(stack_arr_sz / 2 + stack_arr_sz / 4, pool->get_limit().trimmed_stack_number);
+    }
+
+    // trimmed pages are still mapped and writable
+    memset(static_cast<char *>(stack_arr[i].sp) - pool->get_stack_size(), 0x5a, pool->get_stack_size());
+  }
+  CASE_EXPECT_EQ(stack_arr_sz, g_stack_pool_test_trim_counter.allocate_times);
+  CASE_EXPECT_EQ(0, pool->get_limit().free_stack_number);
+  CASE_EXPECT_EQ(0, pool->get_limit().trimmed_stack_number);
+  CASE_EXPECT_EQ(0, pool->get_limit().trimmed_stack_size);
+
+  for (size_t i = 0; i < stack_arr_sz; ++i) {
+    pool->deallocate(stack_arr[i]);
+  }
+
+  // release stacks when trim is disabled
+  pool->set_gc_trim(false);
+  CASE_EXPECT_EQ(stack_arr_sz / 2, pool->gc());
+  CASE_EXPECT_EQ(stack_arr_sz / 2, g_stack_pool_test_trim_counter.deallocate_times);
+  CASE_EXPECT_EQ(0, pool->get_limit().trimmed_stack_number);
+
+  pool.reset();
+  CASE_EXPECT_EQ(stack_arr_sz, g_stack_pool_test_trim_counter.deallocate_times);
+}
+
+CASE_TEST(stack_pool_test, gc_trim_release) {
+  using trim_pool_t = copp::stack_pool<stack_pool_test_trim_allocator>;
+  trim_pool_t::ptr_t pool = trim_pool_t::create();
+  pool->set_auto_gc(false);
+  pool->set_gc_trim(true);
+  pool->set_min_stack_number(2);
+  memset(&g_stack_pool_test_trim_counter, 0, sizeof(g_stack_pool_test_trim_counter));
+
+  const size_t stack_arr_sz = 16;
+  std::vector<copp::stack_context> stack_arr;
+  stack_arr.resize(stack_arr_sz);
+  for (size_t i = 0; i < stack_arr_sz; ++i) {
+    pool->allocate(stack_arr[i]);
+    CASE_EXPECT_NE(nullptr, stack_arr[i].sp);
+  }
+  for (size_t i = 0; i < stack_arr_sz; ++i) {
+    pool->deallocate(stack_arr[i]);
+  }
+
+  // untrimmed stacks are trimmed first, and then trimmed stacks are released until reach the min limits
+  size_t gc_times = 0;
+  while (pool->gc() > 0 && gc_times < stack_arr_sz) {
+    ++gc_times;
+  }
+  CASE_EXPECT_LT(gc_times, stack_arr_sz);
+  CASE_EXPECT_LT(0, g_stack_pool_test_trim_counter.trim_times);
+  CASE_EXPECT_EQ(stack_arr_sz - 2, g_stack_pool_test_trim_counter.deallocate_times);
+  CASE_EXPECT_EQ(2, pool->get_limit().free_stack_number);
+
+  // trimmed stacks are also released when they are still more than used
+  pool->set_min_stack_number(0);
+  CASE_EXPECT_LT(0, pool->gc());
+  while (pool->gc() > 0) {
+  }
+  CASE_EXPECT_EQ(stack_arr_sz, g_stack_pool_test_trim_counter.deallocate_times);
+  CASE_EXPECT_EQ(0, pool->get_limit().free_stack_number);
+  CASE_EXPECT_EQ(0, pool->get_limit().trimmed_stack_number);
+  CASE_EXPECT_EQ(0, pool->get_limit().trimmed_stack_size);
+}
+#endif
+
+namespace {
+static int stack_pool_test_watermark_use_stack(size_t use_size) {
+  // use about 1KB of stack every level
+  volatile unsigned char buffer[1024];
+  memset(const_cast<unsigned char *>(buffer), static_cast<int>(use_size & 0xFF), sizeof(buffer));
+  if (use_size <= sizeof(buffer)) {
+    copp::this_coroutine::yield();
+    return buffer[0];
+  }
+
+  return stack_pool_test_watermark_use_stack(use_size - sizeof(buffer)) + buffer[sizeof(buffer) - 1];
+}
+
+static int stack_pool_test_watermark_runner(void *priv_data) {
+  return stack_pool_test_watermark_use_stack(*reinterpret_cast<size_t *>(priv_data));
+}
+}  // namespace
+
+CASE_TEST(stack_pool_test, stack_watermark_histogram) {
+  copp::stack_watermark::stat_type stat;
+  memset(&stat, 0, sizeof(stat));
+
+  copp::stack_watermark::add_sample(stat, 0);
+  copp::stack_watermark::add_sample(stat, 1000);
+  copp::stack_watermark::add_sample(stat, 1025);
+  copp::stack_watermark::add_sample(stat, 64 * 1024);
+  copp::stack_watermark::add_sample(stat, static_cast<size_t>(-1));
+  CASE_EXPECT_EQ(4, stat.sample_number);
+  CASE_EXPECT_EQ(static_cast<size_t>(-1), stat.max_used_size);
+  CASE_EXPECT_EQ(1, stat.histogram[0]);
+  CASE_EXPECT_EQ(1, stat.histogram[1]);
+  CASE_EXPECT_EQ(1, stat.histogram[6]);
+  CASE_EXPECT_EQ(1, stat.histogram[copp::stack_watermark::stat_type::HISTOGRAM_SIZE - 1]);
+  CASE_EXPECT_EQ(64 * 1024, copp::stack_watermark::get_histogram_upper_bound(6));
+}
+
+CASE_TEST(stack_pool_test, stack_watermark_paint) {
+  using watermark_pool_t = copp::stack_pool<copp::allocator::default_statck_allocator>;
+  using watermark_coroutine_t =
+      copp::coroutine_context_container<copp::allocator::stack_allocator_pool<watermark_pool_t> >;
+
+  watermark_pool_t::ptr_t pool = watermark_pool_t::create();
+  pool->set_stack_size(256 * 1024);
+  pool->set_stack_watermark_mode(copp::stack_watermark::mode_type::EN_SWM_PAINT);
+
+  size_t use_sizes[] = {8 * 1024, 100 * 1024};
+  for (size_t i = 0; i < sizeof(use_sizes) / sizeof(use_sizes[0]); ++i) {
+    copp::allocator::stack_allocator_pool<watermark_pool_t> alloc(pool);
+    watermark_coroutine_t::ptr_t co = watermark_coroutine_t::create(stack_pool_test_watermark_runner, alloc);
+    CASE_EXPECT_TRUE(!!co);
+    if (!co) {
+      continue;
+    }
+
+    co->start(&use_sizes[i]);
+    size_t used_size = co->get_stack_watermark();
+    CASE_EXPECT_GE(used_size, use_sizes[i]);
+    CASE_EXPECT_LT(used_size, use_sizes[i] * 2 + 16 * 1024);
+    co->resume();
+  }
+
+  watermark_pool_t::watermark_stat_t stat = pool->get_stack_watermark_stat();
+  CASE_EXPECT_EQ(2, stat.sample_number);
+  CASE_EXPECT_GE(stat.max_used_size, use_sizes[1]);
+  CASE_EXPECT_EQ(1, stat.histogram[copp::stack_watermark::get_histogram_index(stat.max_used_size)]);
+
+  // only paint one of every 2 stacks, unpainted stacks are not measured
+  pool->reset_stack_watermark_stat();
+  pool->set_stack_watermark_sample_rate(2);
+  for (size_t i = 0; i < 4; ++i) {
+    copp::allocator::stack_allocator_pool<watermark_pool_t> alloc(pool);
+    watermark_coroutine_t::ptr_t co = watermark_coroutine_t::create(stack_pool_test_watermark_runner, alloc);
+    CASE_EXPECT_TRUE(!!co);
+    if (co) {
+      co->start(&use_sizes[0]);
+      co->resume();
+    }
+  }
+  CASE_EXPECT_EQ(2, pool->get_stack_watermark_stat().sample_number);
+}
+
+CASE_TEST(stack_pool_test, stack_watermark_clobbered) {
+  using watermark_pool_t = copp::stack_pool<copp::allocator::default_statck_allocator>;
+  watermark_pool_t::ptr_t pool = watermark_pool_t::create();
+  pool->set_stack_size(64 * 1024);
+  pool->set_stack_watermark_mode(copp::stack_watermark::mode_type::EN_SWM_PAINT);
+
+  copp::stack_context ctx;
+  pool->allocate(ctx);
+  CASE_EXPECT_NE(nullptr, ctx.sp);
+  CASE_EXPECT_TRUE(copp::stack_watermark::is_painted(ctx));
+  CASE_EXPECT_EQ(0, copp::stack_watermark::measure(ctx));
+
+  // overwrite the bottom mark, the whole stack is used
+  unsigned char *bottom = static_cast<unsigned char *>(ctx.sp) - ctx.size + copp::stack_traits::page_size();
+  memset(bottom, 0x11, 32);
+  CASE_EXPECT_FALSE(copp::stack_watermark::is_painted(ctx));
+  CASE_EXPECT_EQ(ctx.size, copp::stack_watermark::measure(ctx));
+
+  size_t stack_size = ctx.size;
+  pool->deallocate(ctx);
+  watermark_pool_t::watermark_stat_t stat = pool->get_stack_watermark_stat();
+  CASE_EXPECT_EQ(1, stat.sample_number);
+  CASE_EXPECT_EQ(stack_size, stat.max_used_size);
+
+  // zero is also an overwritten mark, it should not be seen as unpainted
+  pool->allocate(ctx);
+  CASE_EXPECT_TRUE(copp::stack_watermark::is_painted(ctx));
+  bottom = static_cast<unsigned char *>(ctx.sp) - ctx.size + copp::stack_traits::page_size();
+  memset(bottom, 0, 32);
+  CASE_EXPECT_FALSE(copp::stack_watermark::is_painted(ctx));
+  CASE_EXPECT_EQ(ctx.size, copp::stack_watermark::measure(ctx));
+  pool->deallocate(ctx);
+  CASE_EXPECT_EQ(2, pool->get_stack_watermark_stat().sample_number);
+
+  // unpainted stacks are not measured
+  pool->allocate(ctx);
+  copp::stack_watermark::unpaint(ctx);
+  CASE_EXPECT_EQ(0, copp::stack_watermark::measure(ctx));
+  pool->deallocate(ctx);
+  CASE_EXPECT_EQ(2, pool->get_stack_watermark_stat().sample_number);
+}
+
+CASE_TEST(stack_pool_test, stack_watermark_coroutine) {
+  using watermark_coroutine_t = copp::coroutine_context_container<copp::allocator::default_statck_allocator>;
+
+  size_t use_size = 32 * 1024;
+  watermark_coroutine_t::ptr_t co = watermark_coroutine_t::create(stack_pool_test_watermark_runner, 128 * 1024);
+  CASE_EXPECT_TRUE(!!co);
+  if (!co) {
+    return;
+  }
+
+  CASE_EXPECT_EQ(0, co->get_stack_watermark());
+  CASE_EXPECT_EQ(0, co->paint_stack_watermark());
+  CASE_EXPECT_LT(co->get_stack_watermark(), 4 * 1024);
+
+  co->start(&use_size);
+  CASE_EXPECT_GE(co->get_stack_watermark(), use_size);
+  CASE_EXPECT_LT(co->get_stack_watermark(), use_size * 2 + 16 * 1024);
+
+  // paint again when suspended, only stack below the suspended frames is painted
+  size_t suspended_used_size = co->get_stack_watermark();
+  CASE_EXPECT_EQ(0, co->paint_stack_watermark());
+  CASE_EXPECT_LE(co->get_stack_watermark(), suspended_used_size);
+
+  co->resume();
+  CASE_EXPECT_EQ(copp::COPP_EC_ALREADY_FINISHED, co->paint_stack_watermark());
+}
+
+#ifdef LIBCOPP_MACRO_SYS_POSIX
+CASE_TEST(stack_pool_test, stack_watermark_resident) {
+  using watermark_pool_t = copp::stack_pool<copp::allocator::stack_allocator_posix>;
+  using watermark_coroutine_t =
+      copp::coroutine_context_container<copp::allocator::stack_allocator_pool<watermark_pool_t> >;
+
+  watermark_pool_t::ptr_t pool = watermark_pool_t::create();
+  pool->set_stack_size(256 * 1024);
+  pool->set_stack_watermark_mode(copp::stack_watermark::mode_type::EN_SWM_RESIDENT);
+
+  size_t use_size = 64 * 1024;
+  {
+    copp::allocator::stack_allocator_pool<watermark_pool_t> alloc(pool);
+    watermark_coroutine_t::ptr_t co = watermark_coroutine_t::create(stack_pool_test_watermark_runner, alloc);
+    CASE_EXPECT_TRUE(!!co);
+    if (co) {
+      co->start(&use_size);
+      co->resume();
+    }
+  }
+
+  watermark_pool_t::watermark_stat_t stat = pool->get_stack_watermark_stat();
+  CASE_EXPECT_EQ(1, stat.sample_number);
+  CASE_EXPECT_GE(stat.max_used_size, use_size);
+  CASE_EXPECT_LT(stat.max_used_size, 128 * 1024);
+}
+#endif
+
+CASE_TEST(stack_pool_test, stack_size_policy) {
+  using policy_pool_t = copp::stack_pool<copp::allocator::stack_allocator_malloc>;
+  using policy_coroutine_t = copp::coroutine_context_container<copp::allocator::stack_allocator_pool<policy_pool_t> >;
+
+  policy_pool_t::ptr_t pool = policy_pool_t::create();
+  pool->set_auto_gc(false);
+  pool->set_stack_size(512 * 1024);
+  pool->set_stack_watermark_mode(copp::stack_watermark::mode_type::EN_SWM_PAINT);
+
+  copp::stack_size_policy<policy_pool_t> policy(pool);
+  policy.set_min_sample_number(8);
+  policy.set_safety_margin(32 * 1024);
+
+  std::vector<policy_coroutine_t::ptr_t> co_arr;
+  size_t use_size = 20 * 1024;
+  for (size_t i = 0; i < 8; ++i) {
+    // not enough samples
+    CASE_EXPECT_EQ(0, policy.recommend());
+
+    copp::allocator::stack_allocator_pool<policy_pool_t> alloc(pool);
+    co_arr.push_back(policy_coroutine_t::create(stack_pool_test_watermark_runner, alloc));
+    CASE_EXPECT_TRUE(!!co_arr.back());
+    if (co_arr.back()) {
+      co_arr.back()->start(&use_size);
+      co_arr.back()->resume();
+    }
+  }
+  co_arr.clear();
+  CASE_EXPECT_EQ(8, pool->get_limit().free_stack_number);
+
+  // 20KB is in bucket (16KB, 32KB]
+  size_t recommend_size = policy.recommend();
+  CASE_EXPECT_GE(recommend_size, use_size + policy.get_safety_margin());
+  CASE_EXPECT_LE(recommend_size, 64 * 1024 + copp::stack_traits::page_size());
+  CASE_EXPECT_EQ(512 * 1024, pool->get_stack_size());
+
+  // apply without releasing cached stacks
+  CASE_EXPECT_EQ(recommend_size, policy.apply());
+  CASE_EXPECT_EQ(recommend_size, pool->get_stack_size());
+  CASE_EXPECT_EQ(8, pool->get_limit().free_stack_number);
+  CASE_EXPECT_EQ(0, pool->get_stack_watermark_stat().sample_number);
+
+  // old stacks are still used, and released when they are returned
+  {
+    copp::allocator::stack_allocator_pool<policy_pool_t> alloc(pool);
+    policy_coroutine_t::ptr_t co = policy_coroutine_t::create(stack_pool_test_watermark_runner, alloc);
+    CASE_EXPECT_TRUE(!!co);
+    CASE_EXPECT_EQ(7, pool->get_limit().free_stack_number);
+    CASE_EXPECT_EQ(512 * 1024 + pool->get_stack_size_offset(), pool->get_limit().used_stack_size);
+  }
+  CASE_EXPECT_EQ(7, pool->get_limit().free_stack_number);
+  CASE_EXPECT_EQ(0, pool->get_limit().used_stack_number);
+
+  // new stacks use the new size
+  pool->clear();
+  {
+    copp::allocator::stack_allocator_pool<policy_pool_t> alloc(pool);
+    policy_coroutine_t::ptr_t co = policy_coroutine_t::create(stack_pool_test_watermark_runner, alloc);
+    CASE_EXPECT_TRUE(!!co);
+    CASE_EXPECT_EQ(recommend_size + pool->get_stack_size_offset(), pool->get_limit().used_stack_size);
+  }
+  CASE_EXPECT_EQ(1, pool->get_limit().free_stack_number);
+}
@@ -2,12 +2,14 @@
 
 #include <libcopp/coroutine/generator_promise.h>
 #include <libcotask/task_manager.h>
+#include <libcotask/task_manager_sharded.h>
 #include <libcotask/task_promise.h>
 
 #include <cstdio>
 #include <cstring>
 #include <iostream>
 #include <memory>
+#include <vector>
 
 #include "frame/test_macros.h"
 
@@ -293,6 +295,206 @@ CASE_TEST(task_promise_task_manager, add_and_timeout_no_start) {
   task_manager_resume_pending_contexts({});
 }
 
+CASE_TEST(task_promise_task_manager, add_and_timeout_with_timer_wheel) {
+  {
+    task_future_int_type co_task = task_func_await_int();
+    task_future_int_type co_another_task = task_func_await_int();
+
+    using mgr_t = cotask::task_manager<task_future_int_type, cotask::task_timer_wheel<task_future_int_type::id_type>>;
+    mgr_t::ptr_type task_mgr = mgr_t::create();
+
+    task_mgr->add_task(co_task, 5, 0);
+    task_mgr->add_task(co_another_task, 30, 0);
+
+    CASE_EXPECT_EQ(2, (int)task_mgr->get_task_size());
+    CASE_EXPECT_EQ(2, (int)task_mgr->get_tick_checkpoint_size());
+
+    task_mgr->tick(3);
+    co_task.start();
+    // update timeout to 3s + 100s
+    CASE_EXPECT_EQ(0, task_mgr->set_timeout(co_another_task.get_id(), 100, 0));
+
+    task_mgr->tick(8);
+    CASE_EXPECT_EQ(2, (int)task_mgr->get_task_size());
+    CASE_EXPECT_EQ(2, (int)task_mgr->get_tick_checkpoint_size());
+    CASE_EXPECT_EQ(2, (int)task_mgr->get_checkpoints().size());
+    CASE_EXPECT_FALSE(task_future_int_type::task_status_type::kTimeout == co_task.get_status());
+
+    task_mgr->tick(9);
+    CASE_EXPECT_EQ(1, (int)task_mgr->get_task_size());
+    CASE_EXPECT_EQ(1, (int)task_mgr->get_tick_checkpoint_size());
+    CASE_EXPECT_TRUE(task_future_int_type::task_status_type::kTimeout == co_task.get_status());
+    CASE_EXPECT_EQ(nullptr, task_mgr->find_task(co_task.get_id()));
+
+    // 3 + 30 is not expired after updated
+    task_mgr->tick(60);
+    CASE_EXPECT_EQ(1, (int)task_mgr->get_task_size());
+    CASE_EXPECT_FALSE(task_future_int_type::task_status_type::kTimeout == co_another_task.get_status());
+
+    task_mgr->tick(104);
+    CASE_EXPECT_EQ(0, (int)task_mgr->get_task_size());
+    CASE_EXPECT_EQ(0, (int)task_mgr->get_tick_checkpoint_size());
+    CASE_EXPECT_TRUE(task_future_int_type::task_status_type::kTimeout == co_another_task.get_status());
+
+    task_mgr.reset();
+  }
+  task_manager_resume_pending_contexts({});
+}
+
+CASE_TEST(task_promise_task_manager, add_and_timeout_with_slot_map) {
+  {
+    task_future_int_type co_task = task_func_await_int();
+    task_future_int_type co_another_task = task_func_await_int();
+
+    using mgr_t = cotask::task_manager<task_future_int_type, cotask::task_timer_set<task_future_int_type::id_type>,
+                                       cotask::task_container_slot_map>;
+    mgr_t::ptr_type task_mgr = mgr_t::create();
+
+    mgr_t::id_type task_key = 0;
+    mgr_t::id_type another_task_key = 0;
+    CASE_EXPECT_EQ(0, task_mgr->add_task(co_task, 5, 0, &task_key));
+    CASE_EXPECT_EQ(0, task_mgr->add_task(co_another_task, 30, 0, &another_task_key));
+    CASE_EXPECT_NE(0, task_key);
+    CASE_EXPECT_NE(task_key, another_task_key);
+
+    CASE_EXPECT_EQ(2, (int)task_mgr->get_task_size());
+    CASE_EXPECT_EQ(2, (int)task_mgr->get_tick_checkpoint_size());
+    CASE_EXPECT_NE(nullptr, task_mgr->find_task(task_key));
+
+    task_mgr->tick(3);
+    CASE_EXPECT_EQ(0, task_mgr->start(task_key));
+
+    task_mgr->tick(9);
+    CASE_EXPECT_EQ(1, (int)task_mgr->get_task_size());
+    CASE_EXPECT_EQ(1, (int)task_mgr->get_tick_checkpoint_size());
+    CASE_EXPECT_TRUE(task_future_int_type::task_status_type::kTimeout == co_task.get_status());
+    CASE_EXPECT_EQ(nullptr, task_mgr->find_task(task_key));
+
+#    if defined(LIBCOTASK_MACRO_AUTO_CLEANUP_MANAGER) && LIBCOTASK_MACRO_AUTO_CLEANUP_MANAGER
+    // finished task is removed by manager key
+    CASE_EXPECT_EQ(0, task_mgr->start(another_task_key));
+    task_manager_resume_pending_contexts({});
+    CASE_EXPECT_TRUE(co_another_task.is_completed());
+    CASE_EXPECT_EQ(0, (int)task_mgr->get_task_size());
+    CASE_EXPECT_EQ(0, (int)task_mgr->get_tick_checkpoint_size());
+#    endif
+
+    task_mgr.reset();
+  }
+  task_manager_resume_pending_contexts({});
+}
+
+CASE_TEST(task_promise_task_manager, sharded_add_and_timeout) {
+  {
+    task_future_int_type co_task = task_func_await_int();
+    task_future_int_type co_another_task = task_func_await_int();
+
+    using mgr_t = cotask::task_manager_sharded<task_future_int_type, 4>;
+    mgr_t::ptr_type task_mgr = mgr_t::create();
+
+    CASE_EXPECT_EQ(0, task_mgr->add_task(co_task, 5, 0));
+    CASE_EXPECT_EQ(0, task_mgr->add_task(co_another_task, 30, 0));
+    CASE_EXPECT_EQ(copp::COPP_EC_ALREADY_EXIST, task_mgr->add_task(co_task));
+
+    CASE_EXPECT_EQ(2, (int)task_mgr->get_task_size());
+    CASE_EXPECT_EQ(2, (int)task_mgr->get_tick_checkpoint_size());
+    CASE_EXPECT_NE(nullptr, task_mgr->find_task(co_task.get_id()));
+    CASE_EXPECT_EQ(1, (int)task_mgr->get_shard(mgr_t::get_shard_index(co_task.get_id())).get_tick_checkpoint_size());
+
+    task_mgr->tick(3);
+    CASE_EXPECT_EQ(0, task_mgr->start(co_task.get_id()));
+    CASE_EXPECT_EQ(0, task_mgr->set_timeout(co_another_task.get_id(), 100, 0));
+
+    task_mgr->tick(9);
+    CASE_EXPECT_EQ(1, (int)task_mgr->get_task_size());
+    CASE_EXPECT_EQ(1, (int)task_mgr->get_tick_checkpoint_size());
+    CASE_EXPECT_TRUE(task_future_int_type::task_status_type::kTimeout == co_task.get_status());
+    CASE_EXPECT_EQ(nullptr, task_mgr->find_task(co_task.get_id()));
+
+    task_mgr->tick(104);
+    CASE_EXPECT_EQ(0, (int)task_mgr->get_task_size());
+    CASE_EXPECT_TRUE(task_future_int_type::task_status_type::kTimeout == co_another_task.get_status());
+
+    task_mgr.reset();
+  }
+  task_manager_resume_pending_contexts({});
+}
+
+CASE_TEST(task_promise_task_manager, batch_operations) {
+  {
+    task_future_int_type co_task1 = task_func_await_int();
+    task_future_int_type co_task2 = task_func_await_int();
+    task_future_int_type co_task3 = task_func_await_int();
+
+    using mgr_t = cotask::task_manager<task_future_int_type>;
+    mgr_t::ptr_type task_mgr = mgr_t::create();
+
+    CASE_EXPECT_EQ(0, task_mgr->add_task(co_task1, 10, 0));
+    CASE_EXPECT_EQ(0, task_mgr->add_task(co_task2, 10, 0));
+    CASE_EXPECT_EQ(0, task_mgr->add_task(co_task3, 10, 0));
+
+    std::vector<mgr_t::batch_item_type> items = {co_task1.get_id(), co_task2.get_id(), 0};
+    std::vector<int> results;
+    results.resize(items.size(), 1);
+    CASE_EXPECT_EQ(2, (int)task_mgr->start_batch(items, results));
+    CASE_EXPECT_EQ(0, results[0]);
+    CASE_EXPECT_EQ(0, results[1]);
+    CASE_EXPECT_EQ(copp::COPP_EC_NOT_FOUND, results[2]);
+    CASE_EXPECT_EQ(3, (int)task_mgr->get_task_size());
+
+    items = {co_task2.get_id(), co_task3.get_id()};
+    CASE_EXPECT_EQ(2, (int)task_mgr->kill_batch(items, task_future_int_type::task_status_type::kTimeout, results));
+    CASE_EXPECT_TRUE(task_future_int_type::task_status_type::kTimeout == co_task2.get_status());
+    CASE_EXPECT_TRUE(task_future_int_type::task_status_type::kTimeout == co_task3.get_status());
+    CASE_EXPECT_EQ(1, (int)task_mgr->get_task_size());
+    CASE_EXPECT_EQ(1, (int)task_mgr->get_tick_checkpoint_size());
+
+    task_manager_resume_pending_contexts({});
+    CASE_EXPECT_TRUE(co_task1.is_completed());
+#    if defined(LIBCOTASK_MACRO_AUTO_CLEANUP_MANAGER) && LIBCOTASK_MACRO_AUTO_CLEANUP_MANAGER
+    CASE_EXPECT_EQ(0, (int)task_mgr->get_task_size());
+#    endif
+
+    task_mgr.reset();
+  }
+  task_manager_resume_pending_contexts({});
+}
+
+CASE_TEST(task_promise_task_manager, tick_with_max_expire) {
+  {
+    using mgr_t = cotask::task_manager<task_future_int_type>;
+    mgr_t::ptr_type task_mgr = mgr_t::create();
+
+    std::vector<task_future_int_type> tasks;
+    for (int i = 0; i < 5; ++i) {
+      tasks.push_back(task_func_await_int());
+      CASE_EXPECT_EQ(0, task_mgr->add_task(tasks.back(), 5, 0));
+    }
+
+    task_mgr->tick(1);
+
+    size_t pending = 0;
+    CASE_EXPECT_EQ(0, task_mgr->tick(7, 0, 2, &pending));
+    CASE_EXPECT_EQ(3, (int)pending);
+    CASE_EXPECT_EQ(3, (int)task_mgr->get_pending_expire_count());
+    CASE_EXPECT_EQ(3, (int)task_mgr->get_task_size());
+
+    CASE_EXPECT_EQ(0, task_mgr->tick(7, 0, 2, &pending));
+    CASE_EXPECT_EQ(1, (int)pending);
+    CASE_EXPECT_EQ(1, (int)task_mgr->get_task_size());
+
+    CASE_EXPECT_EQ(0, task_mgr->tick(7, 0, 2, &pending));
+    CASE_EXPECT_EQ(0, (int)pending);
+    CASE_EXPECT_EQ(0, (int)task_mgr->get_task_size());
+    for (size_t i = 0; i < tasks.size(); ++i) {
+      CASE_EXPECT_TRUE(task_future_int_type::task_status_type::kTimeout == tasks[i].get_status());
+    }
+
+    task_mgr.reset();
+  }
+  task_manager_resume_pending_contexts({});
+}
+
 CASE_TEST(task_promise_task_manager, add_and_timeout_last_reference) {
   {
     size_t old_resume_generator_count = g_task_manager_future_resume_generator_count;
@@ -0,0 +1,38 @@
+/*
+ * test_allocation_counter.cpp
+ *
+ *  Released under the MIT license
+ */
+
+#include "test_allocation_counter.h"
+
+#include <cstdlib>
+#include <new>
+
+namespace {
+// only count allocations of the thread running the test case
+static thread_local size_t *g_test_allocation_counter = nullptr;
+}  // namespace
+
+test_allocation_counter_guard::test_allocation_counter_guard(size_t &counter) : previous_(g_test_allocation_counter) {
+  counter = 0;
+  g_test_allocation_counter = &counter;
+}
+
+test_allocation_counter_guard::~test_allocation_counter_guard() { g_test_allocation_counter = previous_; }
+
+void *operator new(std::size_t size) {
+  if (nullptr != g_test_allocation_counter) {
+    ++(*g_test_allocation_counter);
+  }
+
+  void *ret = malloc(0 == size ? 1 : size);
+  if (nullptr == ret) {
+    throw std::bad_alloc();
+  }
+  return ret;
+}
+
+void operator delete(void *ptr) noexcept { free(ptr); }
+
+void operator delete(void *ptr, std::size_t) noexcept { free(ptr); }
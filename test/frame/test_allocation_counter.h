@@ -0,0 +1,30 @@
+/*
+ * test_allocation_counter.h
+ *
+ *  Released under the MIT license
+ */
+
+#ifndef TEST_ALLOCATION_COUNTER_H_
+#define TEST_ALLOCATION_COUNTER_H_
+
+#pragma once
+
+#include <cstddef>
+
+/**
+ * @brief count calls of global operator new on current thread while the guard is alive
+ * @note global operator new can only be replaced once in the test program, so all test cases share this one
+ */
+class test_allocation_counter_guard {
+ public:
+  explicit test_allocation_counter_guard(size_t &counter);
+  ~test_allocation_counter_guard();
+
+ private:
+  test_allocation_counter_guard(const test_allocation_counter_guard &) = delete;
+  test_allocation_counter_guard &operator=(const test_allocation_counter_guard &) = delete;
+
+  size_t *previous_;
+};
+
+#endif